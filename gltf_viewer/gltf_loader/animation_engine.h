@@ -0,0 +1,425 @@
+#ifndef ANIMATION_ENGINE_H
+#define ANIMATION_ENGINE_H
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* structure of arrays animation evaluation.
+   a Packed_Animation holds every channel of a Model_Animation grouped by path type, with the
+   key values of a group in one contiguous array and the time tracks shared by several channels
+   stored once. evaluation looks up each time track once, gathers the two keys of every channel
+   into lane arrays, interpolates a whole group in 4 wide SSE loops (lerp for translation and
+   scale, corrected shortest path nlerp for rotation) and composes each node matrix once.
+   the packed animation is read only, all per character state lives in Animation_Pose so
+   thousands of characters can share one animation. the nodes a clip does not drive keep the
+   rest pose of the gltf nodes. included by gltf_loader.h, update_animation_frame samples with it. */
+
+#define ANIMATION_LANES 4
+
+typedef struct
+{
+    unsigned int channels_count;
+    unsigned int components;     // 3 for translation and scale, 4 for rotation
+    unsigned int* target_nodes;  // index in Model_Data::anim_nodes
+    unsigned int* time_tracks;   // time track of each channel
+    unsigned int* values_offset; // first float of the channel keys in values
+    float* values;
+}Packed_Channels;
+
+typedef struct Packed_Animation
+{
+    unsigned int time_tracks_count;
+    unsigned int* times_offset;
+    unsigned int* times_count;
+    float* times;
+    Packed_Channels translations;
+    Packed_Channels rotations;
+    Packed_Channels scales;
+    unsigned int nodes_count;
+    glm::vec3* rest_translations; // of every node
+    glm::quat* rest_rotations;
+    glm::vec3* rest_scales;
+    float duration;
+}Packed_Animation;
+
+typedef struct Animation_Pose
+{
+    unsigned int nodes_count;
+    Packed_Animation* animation; // animation of the last evaluation
+    int* time_cursors;
+    unsigned int* key_index;
+    float* key_factor;
+    float* lanes;                // gather buffer, 9 lane arrays of lanes_size floats
+    unsigned int lanes_size;
+    unsigned int time_tracks_size;
+    glm::vec3* translations;
+    glm::quat* rotations;
+    glm::vec3* scales;
+    glm::mat4* local_transforms;
+}Animation_Pose;
+
+int get_anim_node_index(Model_Data* model, Animation_Node* node)
+{
+    for(unsigned int i = 0; i < model->anim_nodes_count; i++)
+    {
+        if(model->anim_nodes[i] == node)
+            return i;
+    }
+    return -1;
+}
+
+/* returns the time track equal to the channel times, adding it when it is new */
+unsigned int add_time_track(Packed_Animation* packed, Animation_Data* anim_data, unsigned int* times_size)
+{
+    for(unsigned int i = 0; i < packed->time_tracks_count; i++)
+    {
+        if(packed->times_count[i] == (unsigned int)anim_data->count &&
+           memcmp(packed->times + packed->times_offset[i], anim_data->time, sizeof(float) * anim_data->count) == 0)
+            return i;
+    }
+    unsigned int track = packed->time_tracks_count++;
+    packed->times_offset[track] = *times_size;
+    packed->times_count[track] = anim_data->count;
+    memcpy(packed->times + *times_size, anim_data->time, sizeof(float) * anim_data->count);
+    *times_size += anim_data->count;
+    return track;
+}
+
+void pack_channels(Packed_Channels* channels, Packed_Animation* packed, Model_Data* model,
+                   Model_Animation* animation, int path_type, unsigned int* times_size)
+{
+    channels->components = path_type == cgltf_animation_path_type_rotation ? 4 : 3;
+    channels->channels_count = 0;
+    unsigned int values_size = 0;
+    for(unsigned int i = 0; i < animation->anim_data_count; i++)
+    {
+        Animation_Data* anim_data = animation->anim_data[i];
+        if(anim_data->type == path_type && anim_data->count > 0)
+        {
+            channels->channels_count++;
+            values_size += anim_data->count * channels->components;
+        }
+    }
+    channels->target_nodes = (unsigned int*)malloc(sizeof(unsigned int) * channels->channels_count);
+    channels->time_tracks = (unsigned int*)malloc(sizeof(unsigned int) * channels->channels_count);
+    channels->values_offset = (unsigned int*)malloc(sizeof(unsigned int) * channels->channels_count);
+    channels->values = (float*)malloc(sizeof(float) * values_size);
+    unsigned int channel = 0, values_offset = 0;
+    for(unsigned int i = 0; i < animation->anim_data_count; i++)
+    {
+        Animation_Data* anim_data = animation->anim_data[i];
+        if(anim_data->type != path_type || anim_data->count == 0)
+            continue;
+        channels->target_nodes[channel] = get_anim_node_index(model, anim_data->target_node);
+        channels->time_tracks[channel] = add_time_track(packed, anim_data, times_size);
+        channels->values_offset[channel] = values_offset;
+        memcpy(channels->values + values_offset, anim_data->trs, sizeof(float) * anim_data->count * channels->components);
+        values_offset += anim_data->count * channels->components;
+        channel++;
+    }
+}
+
+Packed_Animation* pack_model_animation(Model_Data* model, Model_Animation* animation)
+{
+    Packed_Animation* packed = (Packed_Animation*)malloc(sizeof(Packed_Animation));
+    unsigned int times_capacity = 0;
+    for(unsigned int i = 0; i < animation->anim_data_count; i++)
+    {
+        times_capacity += animation->anim_data[i]->count;
+    }
+    packed->times_offset = (unsigned int*)malloc(sizeof(unsigned int) * animation->anim_data_count);
+    packed->times_count = (unsigned int*)malloc(sizeof(unsigned int) * animation->anim_data_count);
+    packed->times = (float*)malloc(sizeof(float) * times_capacity);
+    packed->time_tracks_count = 0;
+    unsigned int times_size = 0;
+    pack_channels(&packed->translations, packed, model, animation, cgltf_animation_path_type_translation, &times_size);
+    pack_channels(&packed->rotations, packed, model, animation, cgltf_animation_path_type_rotation, &times_size);
+    pack_channels(&packed->scales, packed, model, animation, cgltf_animation_path_type_scale, &times_size);
+    packed->nodes_count = model->anim_nodes_count;
+    packed->rest_translations = (glm::vec3*)malloc(sizeof(glm::vec3) * packed->nodes_count);
+    packed->rest_rotations = (glm::quat*)malloc(sizeof(glm::quat) * packed->nodes_count);
+    packed->rest_scales = (glm::vec3*)malloc(sizeof(glm::vec3) * packed->nodes_count);
+    for(unsigned int i = 0; i < packed->nodes_count; i++)
+    {
+        packed->rest_translations[i] = model->anim_nodes[i]->rest_translation;
+        packed->rest_rotations[i] = model->anim_nodes[i]->rest_rotation;
+        packed->rest_scales[i] = model->anim_nodes[i]->rest_scale;
+    }
+    packed->duration = animation->duration;
+    return packed;
+}
+
+void free_packed_channels(Packed_Channels* channels)
+{
+    free(channels->target_nodes);  channels->target_nodes = NULL;
+    free(channels->time_tracks);  channels->time_tracks = NULL;
+    free(channels->values_offset);  channels->values_offset = NULL;
+    free(channels->values);  channels->values = NULL;
+}
+
+void free_packed_animation(Packed_Animation* packed)
+{
+    free_packed_channels(&packed->translations);
+    free_packed_channels(&packed->rotations);
+    free_packed_channels(&packed->scales);
+    free(packed->times_offset);  packed->times_offset = NULL;
+    free(packed->times_count);  packed->times_count = NULL;
+    free(packed->times);  packed->times = NULL;
+    free(packed->rest_translations);  packed->rest_translations = NULL;
+    free(packed->rest_rotations);  packed->rest_rotations = NULL;
+    free(packed->rest_scales);  packed->rest_scales = NULL;
+    free(packed);  packed = NULL;
+}
+
+Animation_Pose* create_animation_pose(unsigned int nodes_count)
+{
+    Animation_Pose* pose = (Animation_Pose*)malloc(sizeof(Animation_Pose));
+    pose->nodes_count = nodes_count;
+    pose->animation = NULL;
+    pose->time_cursors = NULL;
+    pose->key_index = NULL;
+    pose->key_factor = NULL;
+    pose->time_tracks_size = 0;
+    pose->lanes = NULL;
+    pose->lanes_size = 0;
+    pose->translations = (glm::vec3*)malloc(sizeof(glm::vec3) * nodes_count);
+    pose->rotations = (glm::quat*)malloc(sizeof(glm::quat) * nodes_count);
+    pose->scales = (glm::vec3*)malloc(sizeof(glm::vec3) * nodes_count);
+    pose->local_transforms = (glm::mat4*)malloc(sizeof(glm::mat4) * nodes_count);
+    return pose;
+}
+
+void free_animation_pose(Animation_Pose* pose)
+{
+    free(pose->time_cursors);  pose->time_cursors = NULL;
+    free(pose->key_index);  pose->key_index = NULL;
+    free(pose->key_factor);  pose->key_factor = NULL;
+    free(pose->lanes);  pose->lanes = NULL;
+    free(pose->translations);  pose->translations = NULL;
+    free(pose->rotations);  pose->rotations = NULL;
+    free(pose->scales);  pose->scales = NULL;
+    free(pose->local_transforms);  pose->local_transforms = NULL;
+    free(pose);  pose = NULL;
+}
+
+/* switching animation resets the cursors and puts the nodes the animation does not drive in their rest pose */
+void set_pose_animation(Animation_Pose* pose, Packed_Animation* packed)
+{
+    pose->animation = packed;
+    if(packed->time_tracks_count > pose->time_tracks_size)
+    {
+        pose->time_tracks_size = packed->time_tracks_count;
+        pose->time_cursors = (int*)realloc(pose->time_cursors, sizeof(int) * pose->time_tracks_size);
+        pose->key_index = (unsigned int*)realloc(pose->key_index, sizeof(unsigned int) * pose->time_tracks_size);
+        pose->key_factor = (float*)realloc(pose->key_factor, sizeof(float) * pose->time_tracks_size);
+    }
+    unsigned int channels_count = packed->translations.channels_count;
+    if(packed->rotations.channels_count > channels_count)
+        channels_count = packed->rotations.channels_count;
+    if(packed->scales.channels_count > channels_count)
+        channels_count = packed->scales.channels_count;
+    unsigned int lanes_size = (channels_count + ANIMATION_LANES - 1) / ANIMATION_LANES * ANIMATION_LANES;
+    if(lanes_size > pose->lanes_size)
+    {
+        pose->lanes_size = lanes_size;
+        free(pose->lanes);
+        pose->lanes = (float*)malloc(sizeof(float) * 9 * lanes_size);
+    }
+    for(unsigned int i = 0; i < packed->time_tracks_count; i++)
+    {
+        pose->time_cursors[i] = 0;
+    }
+    memcpy(pose->translations, packed->rest_translations, sizeof(glm::vec3) * pose->nodes_count);
+    memcpy(pose->rotations, packed->rest_rotations, sizeof(glm::quat) * pose->nodes_count);
+    memcpy(pose->scales, packed->rest_scales, sizeof(glm::vec3) * pose->nodes_count);
+}
+
+/* copies key a and key b of every channel into lane arrays:
+   a0..a3 at lanes[c * size], b0..b3 at lanes[(4 + c) * size], factor at lanes[8 * size] */
+void gather_channel_keys(Packed_Channels* channels, Animation_Pose* pose)
+{
+    unsigned int size = pose->lanes_size;
+    unsigned int components = channels->components;
+    float* lanes = pose->lanes;
+    Packed_Animation* packed = pose->animation;
+    for(unsigned int i = 0; i < channels->channels_count; i++)
+    {
+        unsigned int track = channels->time_tracks[i];
+        unsigned int index_1 = pose->key_index[track];
+        unsigned int index_2 = index_1 + 1 < packed->times_count[track] ? index_1 + 1 : index_1;
+        float* key_1 = channels->values + channels->values_offset[i] + index_1 * components;
+        float* key_2 = channels->values + channels->values_offset[i] + index_2 * components;
+        for(unsigned int c = 0; c < components; c++)
+        {
+            lanes[c * size + i] = key_1[c];
+            lanes[(4 + c) * size + i] = key_2[c];
+        }
+        lanes[8 * size + i] = pose->key_factor[track];
+    }
+    // padding lanes interpolate harmless unit quaternions
+    for(unsigned int i = channels->channels_count; i < (channels->channels_count + ANIMATION_LANES - 1) / ANIMATION_LANES * ANIMATION_LANES; i++)
+    {
+        for(unsigned int c = 0; c < 8; c++)
+            lanes[c * size + i] = c == 3 || c == 7 ? 1.0f : 0.0f;
+        lanes[8 * size + i] = 0.0f;
+    }
+}
+
+/* out = a + (b - a) * t for 3 component channels, result left in the a lanes */
+void lerp_channel_lanes(Animation_Pose* pose, unsigned int channels_count)
+{
+    unsigned int size = pose->lanes_size;
+    float* lanes = pose->lanes;
+    float* t = lanes + 8 * size;
+    for(unsigned int c = 0; c < 3; c++)
+    {
+        float* a = lanes + c * size;
+        float* b = lanes + (4 + c) * size;
+#ifdef __SSE2__
+        for(unsigned int i = 0; i < channels_count; i += ANIMATION_LANES)
+        {
+            __m128 va = _mm_loadu_ps(a + i);
+            __m128 vb = _mm_loadu_ps(b + i);
+            __m128 vt = _mm_loadu_ps(t + i);
+            _mm_storeu_ps(a + i, _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(vb, va), vt)));
+        }
+#else
+        for(unsigned int i = 0; i < channels_count; i++)
+            a[i] = a[i] + (b[i] - a[i]) * t[i];
+#endif
+    }
+}
+
+/* shortest path normalized lerp of the quaternion lanes, result left in the a lanes.
+   the factor is first bent with a cubic fit of slerp so wide key pairs keep a near constant
+   angular speed (fit from "Approximating slerp", Arseny Kapoulkine) */
+void nlerp_quaternion_lanes(Animation_Pose* pose, unsigned int channels_count)
+{
+    unsigned int size = pose->lanes_size;
+    float* lanes = pose->lanes;
+    float* ax = lanes;            float* ay = lanes + size;
+    float* az = lanes + 2 * size; float* aw = lanes + 3 * size;
+    float* bx = lanes + 4 * size; float* by = lanes + 5 * size;
+    float* bz = lanes + 6 * size; float* bw = lanes + 7 * size;
+    float* t = lanes + 8 * size;
+#ifdef __SSE2__
+    const __m128 sign_bit = _mm_set1_ps(-0.0f);
+    for(unsigned int i = 0; i < channels_count; i += ANIMATION_LANES)
+    {
+        __m128 vax = _mm_loadu_ps(ax + i), vay = _mm_loadu_ps(ay + i);
+        __m128 vaz = _mm_loadu_ps(az + i), vaw = _mm_loadu_ps(aw + i);
+        __m128 vbx = _mm_loadu_ps(bx + i), vby = _mm_loadu_ps(by + i);
+        __m128 vbz = _mm_loadu_ps(bz + i), vbw = _mm_loadu_ps(bw + i);
+        __m128 vt = _mm_loadu_ps(t + i);
+        // flip b when the quaternions are more than 180 degrees apart
+        __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vax, vbx), _mm_mul_ps(vay, vby)),
+                                _mm_add_ps(_mm_mul_ps(vaz, vbz), _mm_mul_ps(vaw, vbw)));
+        __m128 flip = _mm_and_ps(dot, sign_bit);
+        vbx = _mm_xor_ps(vbx, flip); vby = _mm_xor_ps(vby, flip);
+        vbz = _mm_xor_ps(vbz, flip); vbw = _mm_xor_ps(vbw, flip);
+        __m128 d = _mm_andnot_ps(sign_bit, dot);
+        __m128 fit_a = _mm_add_ps(_mm_set1_ps(1.0904f), _mm_mul_ps(d, _mm_add_ps(_mm_set1_ps(-3.2452f),
+                       _mm_mul_ps(d, _mm_sub_ps(_mm_set1_ps(3.55645f), _mm_mul_ps(d, _mm_set1_ps(1.43519f)))))));
+        __m128 fit_b = _mm_add_ps(_mm_set1_ps(0.848013f), _mm_mul_ps(d, _mm_add_ps(_mm_set1_ps(-1.06021f),
+                       _mm_mul_ps(d, _mm_set1_ps(0.215638f)))));
+        __m128 half_t = _mm_sub_ps(vt, _mm_set1_ps(0.5f));
+        __m128 fit_k = _mm_add_ps(_mm_mul_ps(fit_a, _mm_mul_ps(half_t, half_t)), fit_b);
+        vt = _mm_add_ps(vt, _mm_mul_ps(_mm_mul_ps(vt, half_t), _mm_mul_ps(_mm_sub_ps(vt, _mm_set1_ps(1.0f)), fit_k)));
+        __m128 qx = _mm_add_ps(vax, _mm_mul_ps(_mm_sub_ps(vbx, vax), vt));
+        __m128 qy = _mm_add_ps(vay, _mm_mul_ps(_mm_sub_ps(vby, vay), vt));
+        __m128 qz = _mm_add_ps(vaz, _mm_mul_ps(_mm_sub_ps(vbz, vaz), vt));
+        __m128 qw = _mm_add_ps(vaw, _mm_mul_ps(_mm_sub_ps(vbw, vaw), vt));
+        __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(qx, qx), _mm_mul_ps(qy, qy)),
+                                               _mm_add_ps(_mm_mul_ps(qz, qz), _mm_mul_ps(qw, qw))));
+        __m128 inverse_length = _mm_div_ps(_mm_set1_ps(1.0f), length);
+        _mm_storeu_ps(ax + i, _mm_mul_ps(qx, inverse_length));
+        _mm_storeu_ps(ay + i, _mm_mul_ps(qy, inverse_length));
+        _mm_storeu_ps(az + i, _mm_mul_ps(qz, inverse_length));
+        _mm_storeu_ps(aw + i, _mm_mul_ps(qw, inverse_length));
+    }
+#else
+    for(unsigned int i = 0; i < channels_count; i++)
+    {
+        float dot = ax[i] * bx[i] + ay[i] * by[i] + az[i] * bz[i] + aw[i] * bw[i];
+        float sign = dot < 0.0f ? -1.0f : 1.0f;
+        float d = fabsf(dot);
+        float fit_a = 1.0904f + d * (-3.2452f + d * (3.55645f - d * 1.43519f));
+        float fit_b = 0.848013f + d * (-1.06021f + d * 0.215638f);
+        float fit_k = fit_a * (t[i] - 0.5f) * (t[i] - 0.5f) + fit_b;
+        float ft = t[i] + t[i] * (t[i] - 0.5f) * (t[i] - 1.0f) * fit_k;
+        float qx = ax[i] + (sign * bx[i] - ax[i]) * ft;
+        float qy = ay[i] + (sign * by[i] - ay[i]) * ft;
+        float qz = az[i] + (sign * bz[i] - az[i]) * ft;
+        float qw = aw[i] + (sign * bw[i] - aw[i]) * ft;
+        float inverse_length = 1.0f / sqrtf(qx * qx + qy * qy + qz * qz + qw * qw);
+        ax[i] = qx * inverse_length; ay[i] = qy * inverse_length;
+        az[i] = qz * inverse_length; aw[i] = qw * inverse_length;
+    }
+#endif
+}
+
+void evaluate_translation_channels(Packed_Channels* channels, Animation_Pose* pose, glm::vec3* output)
+{
+    gather_channel_keys(channels, pose);
+    lerp_channel_lanes(pose, channels->channels_count);
+    float* lanes = pose->lanes;
+    unsigned int size = pose->lanes_size;
+    for(unsigned int i = 0; i < channels->channels_count; i++)
+    {
+        output[channels->target_nodes[i]] = glm::vec3(lanes[i], lanes[size + i], lanes[2 * size + i]);
+    }
+}
+
+void evaluate_rotation_channels(Packed_Channels* channels, Animation_Pose* pose)
+{
+    gather_channel_keys(channels, pose);
+    nlerp_quaternion_lanes(pose, channels->channels_count);
+    float* lanes = pose->lanes;
+    unsigned int size = pose->lanes_size;
+    for(unsigned int i = 0; i < channels->channels_count; i++)
+    {
+        pose->rotations[channels->target_nodes[i]] = glm::quat(lanes[3 * size + i], lanes[i],
+                                                               lanes[size + i], lanes[2 * size + i]);
+    }
+}
+
+/* local = translate * rotate * scale, built directly from the vectors and the quaternion */
+void compose_pose_transforms(Animation_Pose* pose)
+{
+    for(unsigned int i = 0; i < pose->nodes_count; i++)
+    {
+        glm::vec3 t = pose->translations[i];
+        glm::quat q = pose->rotations[i];
+        glm::vec3 s = pose->scales[i];
+        float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+        float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+        float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+        glm::mat4& m = pose->local_transforms[i];
+        m[0] = glm::vec4((1.0f - 2.0f * (yy + zz)) * s.x, 2.0f * (xy + wz) * s.x, 2.0f * (xz - wy) * s.x, 0.0f);
+        m[1] = glm::vec4(2.0f * (xy - wz) * s.y, (1.0f - 2.0f * (xx + zz)) * s.y, 2.0f * (yz + wx) * s.y, 0.0f);
+        m[2] = glm::vec4(2.0f * (xz + wy) * s.z, 2.0f * (yz - wx) * s.z, (1.0f - 2.0f * (xx + yy)) * s.z, 0.0f);
+        m[3] = glm::vec4(t, 1.0f);
+    }
+}
+
+/* fills pose->local_transforms with the animation sampled at animation_time */
+void evaluate_packed_animation(Packed_Animation* packed, float animation_time, Animation_Pose* pose)
+{
+    if(pose->animation != packed)
+        set_pose_animation(pose, packed);
+    for(unsigned int i = 0; i < packed->time_tracks_count; i++)
+    {
+        float* times = packed->times + packed->times_offset[i];
+        int count = packed->times_count[i];
+        int index = find_frame_index_from_cursor(animation_time, times, count, &pose->time_cursors[i]);
+        pose->key_index[i] = index;
+        pose->key_factor[i] = index + 1 < count ? get_scale_factor(times[index], times[index + 1], animation_time) : 0.0f;
+    }
+    evaluate_translation_channels(&packed->translations, pose, pose->translations);
+    evaluate_rotation_channels(&packed->rotations, pose);
+    evaluate_translation_channels(&packed->scales, pose, pose->scales);
+    compose_pose_transforms(pose);
+}
+
+#endif // ANIMATION_ENGINE_H
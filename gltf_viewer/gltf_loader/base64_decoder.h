@@ -0,0 +1,196 @@
+#ifndef BASE64_DECODER_H
+#define BASE64_DECODER_H
+
+#include <stddef.h>
+
+/* base64 decoding of the "data:...;base64," uris embedded in gltf files.
+   the vector paths translate 16 (ssse3) or 32 (avx2) characters at once with
+   pshufb lookups (Mula/Lemire/Klomp method) and fall back to the scalar loop
+   for the tail, the cpu is checked at run time so no special build flags are needed. */
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define BASE64_X86_SIMD
+#include <immintrin.h>
+#endif
+
+/* decodes exactly size bytes, returns 0 on an invalid character */
+int base64_decode_scalar(const char* base64, size_t size, unsigned char* out)
+{
+    unsigned int buffer = 0;
+    unsigned int buffer_bits = 0;
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        while (buffer_bits < 8)
+        {
+            char ch = *base64++;
+
+            int index =
+                (unsigned)(ch - 'A') < 26 ? (ch - 'A') :
+                (unsigned)(ch - 'a') < 26 ? (ch - 'a') + 26 :
+                (unsigned)(ch - '0') < 10 ? (ch - '0') + 52 :
+                ch == '+' ? 62 :
+                ch == '/' ? 63 :
+                -1;
+
+            if (index < 0)
+                return 0;
+
+            buffer = (buffer << 6) | index;
+            buffer_bits += 6;
+        }
+
+        out[i] = (unsigned char)(buffer >> (buffer_bits - 8));
+        buffer_bits -= 8;
+    }
+    return 1;
+}
+
+#ifdef BASE64_X86_SIMD
+
+/* 16 characters -> 12 bytes, 16 bytes are written so at least 16 bytes of output must remain */
+__attribute__((target("ssse3")))
+int base64_decode_ssse3(const char** base64, size_t* size, unsigned char** out)
+{
+    const __m128i lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                         0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m128i lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                         0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71,
+                                           0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i mask_2f = _mm_set1_epi8(0x2f);
+    const __m128i pack_shuffle = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+
+    while (*size >= 16)
+    {
+        __m128i str = _mm_loadu_si128((const __m128i*)*base64);
+
+        // classify every character and reject anything outside the base64 alphabet
+        __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(str, 4), mask_2f);
+        __m128i lo_nibbles = _mm_and_si128(str, mask_2f);
+        __m128i lo = _mm_shuffle_epi8(lut_lo, lo_nibbles);
+        __m128i hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+        __m128i invalid = _mm_cmpgt_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128());
+        if (_mm_movemask_epi8(invalid))
+            return 0;
+
+        // ascii -> 6 bit values
+        __m128i eq_2f = _mm_cmpeq_epi8(str, mask_2f);
+        __m128i roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(eq_2f, hi_nibbles));
+        str = _mm_add_epi8(str, roll);
+
+        // pack four 6 bit values into three bytes
+        __m128i merged = _mm_maddubs_epi16(str, _mm_set1_epi32(0x01400140));
+        merged = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+        merged = _mm_shuffle_epi8(merged, pack_shuffle);
+        _mm_storeu_si128((__m128i*)*out, merged);
+
+        *base64 += 16;
+        *out += 12;
+        *size -= 12;
+    }
+    return 1;
+}
+
+/* 32 characters -> 24 bytes, 32 bytes are written so at least 32 bytes of output must remain */
+__attribute__((target("avx2")))
+int base64_decode_avx2(const char** base64, size_t* size, unsigned char** out)
+{
+    const __m256i lut_lo = _mm256_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                            0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+                                            0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                            0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m256i lut_hi = _mm256_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                            0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+                                            0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                            0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m256i lut_roll = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71,
+                                              0, 0, 0, 0, 0, 0, 0, 0,
+                                              0, 16, 19, 4, -65, -65, -71, -71,
+                                              0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i mask_2f = _mm256_set1_epi8(0x2f);
+    const __m256i pack_shuffle = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                                  2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    const __m256i pack_permute = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+
+    while (*size >= 32)
+    {
+        __m256i str = _mm256_loadu_si256((const __m256i*)*base64);
+
+        __m256i hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(str, 4), mask_2f);
+        __m256i lo_nibbles = _mm256_and_si256(str, mask_2f);
+        __m256i lo = _mm256_shuffle_epi8(lut_lo, lo_nibbles);
+        __m256i hi = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+        if (!_mm256_testz_si256(lo, hi))
+            return 0;
+
+        __m256i eq_2f = _mm256_cmpeq_epi8(str, mask_2f);
+        __m256i roll = _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(eq_2f, hi_nibbles));
+        str = _mm256_add_epi8(str, roll);
+
+        __m256i merged = _mm256_maddubs_epi16(str, _mm256_set1_epi32(0x01400140));
+        merged = _mm256_madd_epi16(merged, _mm256_set1_epi32(0x00011000));
+        merged = _mm256_shuffle_epi8(merged, pack_shuffle);
+        // each lane holds 12 bytes, move them next to each other
+        merged = _mm256_permutevar8x32_epi32(merged, pack_permute);
+        _mm256_storeu_si256((__m256i*)*out, merged);
+
+        *base64 += 32;
+        *out += 24;
+        *size -= 24;
+    }
+    return 1;
+}
+
+#endif // BASE64_X86_SIMD
+
+enum
+{
+    BASE64_DECODER_SCALAR,
+    BASE64_DECODER_SSSE3,
+    BASE64_DECODER_AVX2
+};
+
+#ifdef BASE64_X86_SIMD
+int detect_base64_decoder(void)
+{
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+        return BASE64_DECODER_AVX2;
+    if(__builtin_cpu_supports("ssse3"))
+        return BASE64_DECODER_SSSE3;
+    return BASE64_DECODER_SCALAR;
+}
+#endif
+
+int base64_decoder_type(void)
+{
+#ifdef BASE64_X86_SIMD
+    // the loader threads decode buffers at the same time, a local static is initialized once
+    static const int decoder_type = detect_base64_decoder();
+    return decoder_type;
+#else
+    return BASE64_DECODER_SCALAR;
+#endif
+}
+
+/* decodes exactly size bytes from base64 into out, returns 0 on an invalid character */
+int base64_decode(const char* base64, size_t size, unsigned char* out)
+{
+#ifdef BASE64_X86_SIMD
+    switch(base64_decoder_type())
+    {
+        case BASE64_DECODER_AVX2:
+            if(!base64_decode_avx2(&base64, &size, &out))
+                return 0;
+            // fall through, the ssse3 loop handles the next 16 byte blocks
+        case BASE64_DECODER_SSSE3:
+            if(!base64_decode_ssse3(&base64, &size, &out))
+                return 0;
+            break;
+    }
+#endif
+    return base64_decode_scalar(base64, size, out);
+}
+
+#endif // BASE64_DECODER_H
@@ -0,0 +1,311 @@
+#ifndef CPU_SKINNING_H
+#define CPU_SKINNING_H
+
+#include "gltf_loader.h"
+
+#include <atomic>
+
+/* linear blend skinning on the cpu, for rendering without a GPU and to compare with the skinning
+   of model_skinned.vs. every vertex is moved by the sum of its (up to 4) weighted joint matrices,
+   the position as a point and the normal by the 3x3 part of the matrix, renormalized.
+   the input is the primitive geometry and its Bone_Data (read_bone_data), the result is written
+   interleaved in Cpu_Skin_Mesh::output, ready for glBufferSubData.
+   the sse and avx2 kernels blend the matrix columns of a vertex in vector registers (avx2 two
+   columns per register with fma), the cpu is checked at run time like base64_decode.
+   skin_mesh_parallel cuts the vertices in chunks of CPU_SKINNING_CHUNK, the pool threads take the
+   next chunk from a shared counter until none is left, so a thread slowed down by the OS takes
+   fewer chunks instead of holding the others back. */
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define CPU_SKINNING_X86_SIMD
+#include <immintrin.h>
+#endif
+
+#define CPU_SKINNING_CHUNK 4096 // vertices per task of skin_mesh_parallel
+
+enum
+{
+    CPU_SKINNING_SCALAR,
+    CPU_SKINNING_SSE,
+    CPU_SKINNING_AVX2,
+    CPU_SKINNING_KERNELS_COUNT
+};
+
+const char* cpu_skinning_kernel_names[CPU_SKINNING_KERNELS_COUNT] = {"scalar", "sse", "avx2"};
+
+typedef struct
+{
+    Vec3 position;
+    Vec3 normal;
+}Skinned_Vertex;
+
+typedef struct
+{
+    unsigned int vertices_count;
+    Vec3* positions;
+    Vec3* normals;           // +Z for primitives without normals
+    Bone_Data* bones;
+    unsigned int joints_used; // highest joint index + 1, the joint matrices must have as many
+    Skinned_Vertex* output;
+}Cpu_Skin_Mesh;
+
+int cpu_skinning_kernel(void)
+{
+#ifdef CPU_SKINNING_X86_SIMD
+    static int kernel = -1;
+    if(kernel < 0)
+    {
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+            kernel = CPU_SKINNING_AVX2;
+        else if(__builtin_cpu_supports("sse2"))
+            kernel = CPU_SKINNING_SSE;
+        else
+            kernel = CPU_SKINNING_SCALAR;
+    }
+    return kernel;
+#else
+    return CPU_SKINNING_SCALAR;
+#endif
+}
+
+/* returns NULL when the primitive has no joints and weights */
+Cpu_Skin_Mesh* load_cpu_skin_mesh(cgltf_primitive* primitive)
+{
+    cgltf_accessor* position_accessor = get_position_accessor(primitive);
+    if(position_accessor == NULL || get_accessor(primitive, cgltf_attribute_type_joints) == NULL ||
+       get_accessor(primitive, cgltf_attribute_type_weights) == NULL)
+        return NULL;
+    Cpu_Skin_Mesh* mesh = (Cpu_Skin_Mesh*)malloc(sizeof(Cpu_Skin_Mesh));
+    mesh->vertices_count = position_accessor->count;
+    mesh->positions = (Vec3*)read_accessor(position_accessor);
+    cgltf_accessor* normal_accessor = get_accessor(primitive, cgltf_attribute_type_normal);
+    if(normal_accessor != NULL && normal_accessor->count == mesh->vertices_count)
+        mesh->normals = (Vec3*)read_accessor(normal_accessor);
+    else
+    {
+        mesh->normals = (Vec3*)malloc(sizeof(Vec3) * mesh->vertices_count);
+        for(unsigned int i = 0; i < mesh->vertices_count; i++)
+        {
+            mesh->normals[i].x = mesh->normals[i].y = 0.0f;
+            mesh->normals[i].z = 1.0f;
+        }
+    }
+    mesh->bones = read_bone_data(primitive);
+    if(mesh->bones->joints_count < mesh->vertices_count || mesh->bones->weights_count < mesh->vertices_count)
+        mesh->vertices_count = std::min(mesh->bones->joints_count, mesh->bones->weights_count);
+    mesh->joints_used = 0;
+    for(unsigned int i = 0; i < mesh->vertices_count; i++)
+    {
+        float* joints = &mesh->bones->joints[i].x;
+        for(int j = 0; j < 4; j++)
+            mesh->joints_used = std::max(mesh->joints_used, (unsigned int)joints[j] + 1);
+    }
+    mesh->output = (Skinned_Vertex*)malloc(sizeof(Skinned_Vertex) * mesh->vertices_count);
+    return mesh;
+}
+
+void free_cpu_skin_mesh(Cpu_Skin_Mesh* mesh)
+{
+    free(mesh->positions);  mesh->positions = NULL;
+    free(mesh->normals);  mesh->normals = NULL;
+    free_bone_data(mesh->bones);  mesh->bones = NULL;
+    free(mesh->output);  mesh->output = NULL;
+    free(mesh);  mesh = NULL;
+}
+
+void skin_vertices_scalar(Cpu_Skin_Mesh* mesh, const glm::mat4* joint_matrices, unsigned int first, unsigned int end)
+{
+    for(unsigned int i = first; i < end; i++)
+    {
+        const float* joints = &mesh->bones->joints[i].x;
+        const float* weights = &mesh->bones->weights[i].x;
+        glm::mat4 matrix(0.0f);
+        for(int j = 0; j < 4; j++)
+        {
+            if(weights[j] != 0.0f)
+                matrix += joint_matrices[(int)joints[j]] * weights[j];
+        }
+        Vec3* position = &mesh->positions[i];
+        Vec3* normal = &mesh->normals[i];
+        glm::vec4 skinned_position = matrix * glm::vec4(position->x, position->y, position->z, 1.0f);
+        glm::vec3 skinned_normal = glm::mat3(matrix) * glm::vec3(normal->x, normal->y, normal->z);
+        float length = glm::length(skinned_normal);
+        if(length > 0.0f)
+            skinned_normal /= length;
+        Skinned_Vertex* out = &mesh->output[i];
+        out->position.x = skinned_position.x;  out->position.y = skinned_position.y;  out->position.z = skinned_position.z;
+        out->normal.x = skinned_normal.x;  out->normal.y = skinned_normal.y;  out->normal.z = skinned_normal.z;
+    }
+}
+
+#ifdef CPU_SKINNING_X86_SIMD
+
+/* writes x, y, z of the vector without touching the float after them */
+__attribute__((target("sse2")))
+inline void store_skinned_vec3(Vec3* out, __m128 vector)
+{
+    _mm_storel_pi((__m64*)out, vector);
+    _mm_store_ss(&out->z, _mm_movehl_ps(vector, vector));
+}
+
+/* the normal has w = 0 for affine joint matrices */
+__attribute__((target("sse2")))
+inline __m128 normalize_skinned_normal(__m128 normal)
+{
+    __m128 square = _mm_mul_ps(normal, normal);
+    __m128 sum = _mm_add_ps(square, _mm_shuffle_ps(square, square, _MM_SHUFFLE(2, 3, 0, 1)));
+    sum = _mm_add_ss(sum, _mm_movehl_ps(sum, sum));
+    __m128 length = _mm_sqrt_ss(sum);
+    if(_mm_cvtss_f32(length) == 0.0f)
+        return normal;
+    return _mm_div_ps(normal, _mm_shuffle_ps(length, length, 0));
+}
+
+__attribute__((target("sse2")))
+void skin_vertices_sse(Cpu_Skin_Mesh* mesh, const glm::mat4* joint_matrices, unsigned int first, unsigned int end)
+{
+    const float* matrices = &joint_matrices[0][0][0];
+    for(unsigned int i = first; i < end; i++)
+    {
+        const float* joints = &mesh->bones->joints[i].x;
+        const float* weights = &mesh->bones->weights[i].x;
+        __m128 column_0 = _mm_setzero_ps(), column_1 = _mm_setzero_ps();
+        __m128 column_2 = _mm_setzero_ps(), column_3 = _mm_setzero_ps();
+        for(int j = 0; j < 4; j++)
+        {
+            if(weights[j] == 0.0f)
+                continue;
+            const float* matrix = matrices + (int)joints[j] * 16;
+            __m128 weight = _mm_set1_ps(weights[j]);
+            column_0 = _mm_add_ps(column_0, _mm_mul_ps(weight, _mm_loadu_ps(matrix)));
+            column_1 = _mm_add_ps(column_1, _mm_mul_ps(weight, _mm_loadu_ps(matrix + 4)));
+            column_2 = _mm_add_ps(column_2, _mm_mul_ps(weight, _mm_loadu_ps(matrix + 8)));
+            column_3 = _mm_add_ps(column_3, _mm_mul_ps(weight, _mm_loadu_ps(matrix + 12)));
+        }
+        Vec3* position = &mesh->positions[i];
+        Vec3* normal = &mesh->normals[i];
+        __m128 skinned_position = _mm_add_ps(_mm_add_ps(_mm_mul_ps(column_0, _mm_set1_ps(position->x)),
+                                                        _mm_mul_ps(column_1, _mm_set1_ps(position->y))),
+                                             _mm_add_ps(_mm_mul_ps(column_2, _mm_set1_ps(position->z)), column_3));
+        __m128 skinned_normal = _mm_add_ps(_mm_add_ps(_mm_mul_ps(column_0, _mm_set1_ps(normal->x)),
+                                                      _mm_mul_ps(column_1, _mm_set1_ps(normal->y))),
+                                           _mm_mul_ps(column_2, _mm_set1_ps(normal->z)));
+        store_skinned_vec3(&mesh->output[i].position, skinned_position);
+        store_skinned_vec3(&mesh->output[i].normal, normalize_skinned_normal(skinned_normal));
+    }
+}
+
+__attribute__((target("avx2,fma")))
+void skin_vertices_avx2(Cpu_Skin_Mesh* mesh, const glm::mat4* joint_matrices, unsigned int first, unsigned int end)
+{
+    const float* matrices = &joint_matrices[0][0][0];
+    for(unsigned int i = first; i < end; i++)
+    {
+        const float* joints = &mesh->bones->joints[i].x;
+        const float* weights = &mesh->bones->weights[i].x;
+        // columns 0 and 1 in one register, 2 and 3 in the other
+        __m256 columns_01 = _mm256_setzero_ps(), columns_23 = _mm256_setzero_ps();
+        for(int j = 0; j < 4; j++)
+        {
+            if(weights[j] == 0.0f)
+                continue;
+            const float* matrix = matrices + (int)joints[j] * 16;
+            __m256 weight = _mm256_set1_ps(weights[j]);
+            columns_01 = _mm256_fmadd_ps(weight, _mm256_loadu_ps(matrix), columns_01);
+            columns_23 = _mm256_fmadd_ps(weight, _mm256_loadu_ps(matrix + 8), columns_23);
+        }
+        Vec3* position = &mesh->positions[i];
+        Vec3* normal = &mesh->normals[i];
+        // column_0 * x + column_1 * y + column_2 * z + column_3, then the two halves are added
+        __m256 position_xy = _mm256_insertf128_ps(_mm256_set1_ps(position->x), _mm_set1_ps(position->y), 1);
+        __m256 position_z1 = _mm256_insertf128_ps(_mm256_set1_ps(position->z), _mm_set1_ps(1.0f), 1);
+        __m256 normal_xy = _mm256_insertf128_ps(_mm256_set1_ps(normal->x), _mm_set1_ps(normal->y), 1);
+        __m256 normal_z0 = _mm256_insertf128_ps(_mm256_set1_ps(normal->z), _mm_setzero_ps(), 1);
+        __m256 position_sum = _mm256_fmadd_ps(columns_01, position_xy, _mm256_mul_ps(columns_23, position_z1));
+        __m256 normal_sum = _mm256_fmadd_ps(columns_01, normal_xy, _mm256_mul_ps(columns_23, normal_z0));
+        __m128 skinned_position = _mm_add_ps(_mm256_castps256_ps128(position_sum), _mm256_extractf128_ps(position_sum, 1));
+        __m128 skinned_normal = _mm_add_ps(_mm256_castps256_ps128(normal_sum), _mm256_extractf128_ps(normal_sum, 1));
+        store_skinned_vec3(&mesh->output[i].position, skinned_position);
+        store_skinned_vec3(&mesh->output[i].normal, normalize_skinned_normal(skinned_normal));
+    }
+}
+
+#endif
+
+/* skins the vertices [first, end) with the kernel, falls back to the scalar one when the cpu lacks it */
+void skin_vertices(Cpu_Skin_Mesh* mesh, const glm::mat4* joint_matrices, unsigned int first, unsigned int end, int kernel)
+{
+#ifdef CPU_SKINNING_X86_SIMD
+    if(kernel > cpu_skinning_kernel())
+        kernel = cpu_skinning_kernel();
+    switch(kernel)
+    {
+        case CPU_SKINNING_AVX2:
+            skin_vertices_avx2(mesh, joint_matrices, first, end);
+            return;
+        case CPU_SKINNING_SSE:
+            skin_vertices_sse(mesh, joint_matrices, first, end);
+            return;
+    }
+#endif
+    skin_vertices_scalar(mesh, joint_matrices, first, end);
+}
+
+typedef struct
+{
+    Cpu_Skin_Mesh* mesh;
+    const glm::mat4* joint_matrices;
+    int kernel;
+    unsigned int chunks_count;
+    std::atomic<unsigned int> next_chunk;
+}Cpu_Skinning_Job;
+
+void cpu_skinning_task(void* task_data)
+{
+    Cpu_Skinning_Job* job = (Cpu_Skinning_Job*)task_data;
+    for(;;)
+    {
+        unsigned int chunk = job->next_chunk.fetch_add(1);
+        if(chunk >= job->chunks_count)
+            return;
+        unsigned int first = chunk * CPU_SKINNING_CHUNK;
+        unsigned int end = std::min(first + CPU_SKINNING_CHUNK, job->mesh->vertices_count);
+        skin_vertices(job->mesh, job->joint_matrices, first, end, job->kernel);
+    }
+}
+
+/* skins the whole mesh on the pool threads (on the calling thread without a pool).
+   joint_matrices has at least mesh->joints_used matrices, returns false else */
+bool skin_mesh_parallel(Thread_Pool* pool, Cpu_Skin_Mesh* mesh, const glm::mat4* joint_matrices,
+                        unsigned int joints_count, int kernel)
+{
+    if(joints_count < mesh->joints_used)
+    {
+        printf("cpu skinning: the mesh uses %u joints, %u given \n", mesh->joints_used, joints_count);
+        return false;
+    }
+    Cpu_Skinning_Job job;
+    job.mesh = mesh;
+    job.joint_matrices = joint_matrices;
+    job.kernel = kernel;
+    job.chunks_count = (mesh->vertices_count + CPU_SKINNING_CHUNK - 1) / CPU_SKINNING_CHUNK;
+    job.next_chunk = 0;
+    if(pool == NULL || job.chunks_count <= 1)
+    {
+        cpu_skinning_task(&job);
+        return true;
+    }
+    unsigned int tasks_count = std::min(thread_pool_threads_count(pool), job.chunks_count);
+    for(unsigned int i = 0; i < tasks_count; i++)
+        thread_pool_add_task(pool, cpu_skinning_task, &job);
+    thread_pool_wait(pool);
+    return true;
+}
+
+bool skin_mesh(Thread_Pool* pool, Cpu_Skin_Mesh* mesh, const glm::mat4* joint_matrices, unsigned int joints_count)
+{
+    return skin_mesh_parallel(pool, mesh, joint_matrices, joints_count, cpu_skinning_kernel());
+}
+
+#endif // CPU_SKINNING_H
@@ -0,0 +1,196 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <mmsystem.h> // timeBeginPeriod, winmm
+#endif
+
+/* frame pacing of the viewer, pace_frame is called once per frame after the buffer swap:
+   - uncapped: no wait and no vsync, for benchmarks.
+   - vsync: the swap waits for the display (swap interval 1), the pacer only measures.
+   - target rate: each frame ends on a deadline every 1 / rate seconds of the steady clock, counted from
+     the first deadline and not from the end of the last frame so the rate does not drift. the wait
+     sleeps until the sleep margin before the deadline then spins, the margin follows the worst
+     oversleep seen (the scheduler tick), so the frame ends within microseconds of its deadline.
+     the margin stays under half the period so a coarse tick cannot turn the wait into a spin, and on
+     windows the pacer asks for a 1 ms timer resolution while it lives (the default tick is 15.6 ms).
+     a frame later than a whole period moves the deadlines instead of rushing the next frames.
+   the frame times go in a histogram of FRAME_PACER_BIN_NS bins for the percentiles. the swap interval
+   is an attribute of the window, get_frame_pacer_swap_interval gives it before the window is created. */
+
+typedef enum
+{
+    FRAME_PACE_UNCAPPED,
+    FRAME_PACE_VSYNC,
+    FRAME_PACE_TARGET
+}Frame_Pace_Mode;
+
+const char* frame_pace_mode_names[3] = {"uncapped", "vsync", "target"};
+
+#define FRAME_PACER_BIN_NS 10000.0        // 10 us per histogram bin
+#define FRAME_PACER_BINS 10000            // up to 100 ms, longer frames go in the last bin
+#define FRAME_PACER_MIN_MARGIN_NS 500000.0 // never sleep closer than 0.5 ms to the deadline
+
+typedef struct
+{
+    int mode;
+    double rate;              // frames per second of FRAME_PACE_TARGET
+    double period_ns;
+    double deadline_ns;       // end of the current frame in FRAME_PACE_TARGET
+    double last_frame_ns;     // end of the last frame
+    double sleep_margin_ns;   // spin this long before the deadline
+    unsigned int* histogram;
+    unsigned int frames_count;
+    unsigned int missed;      // target frames that ended after their deadline by more than a bin
+    double total_ns;
+    double max_ns;
+}Frame_Pacer;
+
+double get_pacer_time_ns(void)
+{
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* "uncapped", "vsync" or a rate in frames per second */
+bool parse_frame_pace_mode(const char* text, int* mode, double* rate)
+{
+    if(strcmp(text, "uncapped") == 0)
+        *mode = FRAME_PACE_UNCAPPED;
+    else if(strcmp(text, "vsync") == 0)
+        *mode = FRAME_PACE_VSYNC;
+    else
+    {
+        char* end;
+        *rate = strtod(text, &end);
+        if(end == text || *end != '\0' || *rate <= 0.0)
+            return false;
+        *mode = FRAME_PACE_TARGET;
+    }
+    return true;
+}
+
+Frame_Pacer* create_frame_pacer(int mode, double rate)
+{
+    Frame_Pacer* pacer = (Frame_Pacer*)calloc(1, sizeof(Frame_Pacer));
+    pacer->mode = mode;
+    pacer->rate = rate;
+    pacer->period_ns = rate > 0.0 ? 1.0e9 / rate : 0.0;
+    pacer->sleep_margin_ns = std::min(2000000.0, std::max(FRAME_PACER_MIN_MARGIN_NS, pacer->period_ns * 0.5));
+    pacer->histogram = (unsigned int*)calloc(FRAME_PACER_BINS, sizeof(unsigned int));
+#ifdef _WIN32
+    if(mode == FRAME_PACE_TARGET)
+        timeBeginPeriod(1);
+#endif
+    return pacer;
+}
+
+void free_frame_pacer(Frame_Pacer* pacer)
+{
+#ifdef _WIN32
+    if(pacer->mode == FRAME_PACE_TARGET)
+        timeEndPeriod(1);
+#endif
+    free(pacer->histogram);
+    free(pacer);  pacer = NULL;
+}
+
+/* swap interval of the window: 1 for vsync, else 0 so the swap does not wait */
+int get_frame_pacer_swap_interval(Frame_Pacer* pacer)
+{
+    return pacer->mode == FRAME_PACE_VSYNC;
+}
+
+/* sleeps, then spins, until the steady clock reaches deadline_ns, returns the time after the wait */
+double wait_frame_deadline(Frame_Pacer* pacer, double deadline_ns)
+{
+    double now = get_pacer_time_ns();
+    double sleep_ns = deadline_ns - now - pacer->sleep_margin_ns;
+    if(sleep_ns > 0.0)
+    {
+        std::this_thread::sleep_for(std::chrono::nanoseconds((long long)sleep_ns));
+        double woken = get_pacer_time_ns();
+        // the margin grows at once with a late wake up and comes back slowly
+        double oversleep = woken - now - sleep_ns;
+        pacer->sleep_margin_ns = std::max(FRAME_PACER_MIN_MARGIN_NS, std::max(oversleep * 1.25, pacer->sleep_margin_ns * 0.99));
+        pacer->sleep_margin_ns = std::min(pacer->sleep_margin_ns, std::max(FRAME_PACER_MIN_MARGIN_NS, pacer->period_ns * 0.5));
+        now = woken;
+    }
+    while(now < deadline_ns)
+    {
+        std::this_thread::yield();
+        now = get_pacer_time_ns();
+    }
+    return now;
+}
+
+/* after the buffer swap, ends the frame */
+void pace_frame(Frame_Pacer* pacer)
+{
+    double now = get_pacer_time_ns();
+    if(pacer->mode == FRAME_PACE_TARGET)
+    {
+        if(pacer->deadline_ns == 0.0) // first frame
+            pacer->deadline_ns = now;
+        pacer->deadline_ns += pacer->period_ns;
+        if(now > pacer->deadline_ns + FRAME_PACER_BIN_NS)
+            pacer->missed++;
+        if(now > pacer->deadline_ns + pacer->period_ns) // far behind, start again from now
+            pacer->deadline_ns = now;
+        else
+            now = wait_frame_deadline(pacer, pacer->deadline_ns);
+    }
+    if(pacer->last_frame_ns > 0.0)
+    {
+        double frame_ns = now - pacer->last_frame_ns;
+        unsigned int bin = std::min((unsigned int)(frame_ns / FRAME_PACER_BIN_NS), (unsigned int)FRAME_PACER_BINS - 1);
+        pacer->histogram[bin]++;
+        pacer->frames_count++;
+        pacer->total_ns += frame_ns;
+        pacer->max_ns = std::max(pacer->max_ns, frame_ns);
+    }
+    pacer->last_frame_ns = now;
+}
+
+/* frame time under which percentile % of the frames are, to the bin */
+double get_frame_pacer_percentile_ms(Frame_Pacer* pacer, double percentile)
+{
+    if(pacer->frames_count == 0)
+        return 0.0;
+    unsigned int rank = (unsigned int)(pacer->frames_count * percentile / 100.0 + 0.5);
+    unsigned int count = 0;
+    for(unsigned int i = 0; i < FRAME_PACER_BINS; i++)
+    {
+        count += pacer->histogram[i];
+        if(count >= std::max(rank, 1u))
+            return (i + 0.5) * FRAME_PACER_BIN_NS / 1.0e6;
+    }
+    return pacer->max_ns / 1.0e6;
+}
+
+void print_frame_pacer_stats(Frame_Pacer* pacer)
+{
+    if(pacer->frames_count == 0)
+        return;
+    printf("frame pacer (%s", frame_pace_mode_names[pacer->mode]);
+    if(pacer->mode == FRAME_PACE_TARGET)
+        printf(" %.2f fps, %u missed deadlines", pacer->rate, pacer->missed);
+    printf("): %u frames, %.2f fps, frame time average %.3f ms, p50 %.3f ms, p99 %.3f ms, max %.3f ms \n",
+           pacer->frames_count, pacer->frames_count * 1.0e9 / pacer->total_ns, pacer->total_ns / pacer->frames_count / 1.0e6,
+           get_frame_pacer_percentile_ms(pacer, 50.0), get_frame_pacer_percentile_ms(pacer, 99.0), pacer->max_ns / 1.0e6);
+}
+
+#endif // FRAME_PACER_H
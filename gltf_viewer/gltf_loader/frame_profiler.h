@@ -0,0 +1,428 @@
+#ifndef FRAME_PROFILER_H
+#define FRAME_PROFILER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+
+/* frame profiler: the cpu time of each stage of a frame is measured by the Profile_Scope placed in
+   the loader (animation sampling, transform propagation) and in the render loop (uniform upload, draw
+   submission) with the nanosecond steady clock, and the GPU time of the frame by a GL_TIME_ELAPSED
+   query between begin_profiler_frame and end_profiler_frame.
+   the zones are exclusive: a zone opened inside another one (the joint palette upload inside the draw)
+   pauses it, so the zones of a frame add up to at most its cpu time and stack in the graph.
+   the query results are read PROFILE_GPU_QUERIES frames later without waiting for the GPU, a frame
+   whose query is still pending gets no GPU time.
+   the last PROFILE_HISTORY_FRAMES frames are drawn as a rolling bar graph (draw_profiler_graph), and with
+   trace enabled every zone is recorded as a Chrome trace event (chrome://tracing, ui.perfetto.dev) written
+   by write_profiler_trace. the scopes only report between begin and end of a frame on the main thread,
+   the loads and bakes are not profiled. */
+
+typedef enum
+{
+    PROFILE_ANIMATION,   // keyframe sampling, or baked frames lookup
+    PROFILE_TRANSFORMS,  // node hierarchy and joint matrices
+    PROFILE_UPLOAD,      // node matrices, joint palette and camera uniforms
+    PROFILE_DRAW,        // draw calls
+    PROFILE_ZONES_COUNT
+}Profile_Zone;
+
+const char* profile_zone_names[PROFILE_ZONES_COUNT] = {"animation", "transforms", "upload", "draw"};
+
+// graph colors, same order as Profile_Zone
+const float profile_zone_colors[PROFILE_ZONES_COUNT][3] =
+{
+    {0.3f, 0.85f, 0.3f}, {0.3f, 0.6f, 1.0f}, {1.0f, 0.8f, 0.2f}, {1.0f, 0.35f, 0.35f}
+};
+
+#define PROFILE_HISTORY_FRAMES 240
+#define PROFILE_GPU_QUERIES 4
+#define PROFILE_MAX_DEPTH 8
+#define PROFILE_TRACE_MAX_EVENTS (1 << 20)
+#define PROFILE_NO_FRAME 0xffffffffu
+#define PROFILE_GRAPH_MS 33.3f       // time at the top of the graph
+#define PROFILE_GRAPH_HEIGHT 100.0f  // pixels
+#define PROFILE_GRAPH_BAR_WIDTH 2.0f // pixels per frame
+
+// trace events that are not a zone
+#define PROFILE_EVENT_FRAME PROFILE_ZONES_COUNT
+#define PROFILE_EVENT_GPU (PROFILE_ZONES_COUNT + 1)
+
+typedef struct
+{
+    float zone_ms[PROFILE_ZONES_COUNT];
+    float cpu_ms;    // begin_profiler_frame to end_profiler_frame
+    float frame_ms;  // to the next begin_profiler_frame, swap and sleep included
+    float gpu_ms;    // < 0 while unknown
+}Profile_Frame;
+
+typedef struct
+{
+    int type;        // Profile_Zone or PROFILE_EVENT_*
+    unsigned int frame;
+    double start_ns;
+    double duration_ns;
+}Profile_Event;
+
+typedef struct
+{
+    double origin_ns;           // time 0 of the trace
+    double frame_start_ns;
+    double zone_start_ns;       // when the running zone was last resumed
+    int zones[PROFILE_MAX_DEPTH];
+    double zone_starts_ns[PROFILE_MAX_DEPTH];
+    int depth;
+    bool in_frame;
+    Profile_Frame current;
+    Profile_Frame history[PROFILE_HISTORY_FRAMES];
+    Profile_Frame totals;       // sums over every frame
+    Profile_Frame maximums;
+    unsigned int frames_count;
+    unsigned int gpu_frames_count;  // frames whose GPU time was read
+    unsigned int gpu_skipped;       // frames not measured: query slot still pending or invalid result
+    unsigned int queries[PROFILE_GPU_QUERIES];
+    unsigned int query_frames[PROFILE_GPU_QUERIES]; // frame measured by each query, PROFILE_NO_FRAME when free
+    double query_starts_ns[PROFILE_GPU_QUERIES];
+    bool query_running;
+    bool trace;
+    Profile_Event* events;
+    unsigned int events_count;
+    unsigned int events_capacity;
+    bool show_graph;
+    unsigned int graph_VAO, graph_VBO;
+    float* graph_vertices;      // x, y, r, g, b
+}Frame_Profiler;
+
+// the profiler the Profile_Scope report to, NULL when nothing is profiled
+Frame_Profiler* frame_profiler = NULL;
+
+double get_profiler_time_ns(void)
+{
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* needs a GL context, trace: keep every zone for write_profiler_trace */
+Frame_Profiler* create_frame_profiler(bool trace)
+{
+    Frame_Profiler* profiler = (Frame_Profiler*)calloc(1, sizeof(Frame_Profiler));
+    profiler->origin_ns = get_profiler_time_ns();
+    profiler->trace = trace;
+    glGenQueries(PROFILE_GPU_QUERIES, profiler->queries);
+    for(int i = 0; i < PROFILE_GPU_QUERIES; i++)
+        profiler->query_frames[i] = PROFILE_NO_FRAME;
+    return profiler;
+}
+
+void free_frame_profiler(Frame_Profiler* profiler)
+{
+    if(frame_profiler == profiler)
+        frame_profiler = NULL;
+    if(profiler->query_running)
+        glEndQuery(GL_TIME_ELAPSED);
+    glDeleteQueries(PROFILE_GPU_QUERIES, profiler->queries);
+    if(profiler->graph_VAO != 0)
+    {
+        delete_vertex_arrays(1, &profiler->graph_VAO);
+        glDeleteBuffers(1, &profiler->graph_VBO);
+    }
+    free(profiler->graph_vertices);
+    free(profiler->events);
+    free(profiler);  profiler = NULL;
+}
+
+void add_profile_event(Frame_Profiler* profiler, int type, unsigned int frame, double start_ns, double end_ns)
+{
+    if(!profiler->trace || profiler->events_count == PROFILE_TRACE_MAX_EVENTS)
+        return;
+    if(profiler->events_count == profiler->events_capacity)
+    {
+        profiler->events_capacity = profiler->events_capacity > 0 ? profiler->events_capacity * 2 : 4096;
+        profiler->events = (Profile_Event*)realloc(profiler->events, sizeof(Profile_Event) * profiler->events_capacity);
+    }
+    Profile_Event* event = &profiler->events[profiler->events_count++];
+    event->type = type;
+    event->frame = frame;
+    event->start_ns = start_ns - profiler->origin_ns;
+    event->duration_ns = end_ns - start_ns;
+    if(profiler->events_count == PROFILE_TRACE_MAX_EVENTS)
+        printf("profiler: trace full after %u frames, the next frames are not recorded \n", profiler->frames_count);
+}
+
+void begin_profile_zone(Frame_Profiler* profiler, int zone)
+{
+    double now = get_profiler_time_ns();
+    int depth = profiler->depth++;
+    if(depth >= PROFILE_MAX_DEPTH) // too deep, left to the enclosing zone
+        return;
+    if(depth > 0) // pause the enclosing zone
+        profiler->current.zone_ms[profiler->zones[depth - 1]] += (now - profiler->zone_start_ns) / 1.0e6;
+    profiler->zones[depth] = zone;
+    profiler->zone_starts_ns[depth] = now;
+    profiler->zone_start_ns = now;
+}
+
+void end_profile_zone(Frame_Profiler* profiler)
+{
+    if(profiler->depth == 0)
+        return;
+    double now = get_profiler_time_ns();
+    int depth = --profiler->depth;
+    if(depth >= PROFILE_MAX_DEPTH)
+        return;
+    profiler->current.zone_ms[profiler->zones[depth]] += (now - profiler->zone_start_ns) / 1.0e6;
+    add_profile_event(profiler, profiler->zones[depth], profiler->frames_count, profiler->zone_starts_ns[depth], now);
+    profiler->zone_start_ns = now; // the enclosing zone resumes
+}
+
+/* times the rest of the block in a zone of frame_profiler */
+struct Profile_Scope
+{
+    bool active;
+    Profile_Scope(Profile_Zone zone)
+    {
+        active = frame_profiler != NULL && frame_profiler->in_frame;
+        if(active)
+            begin_profile_zone(frame_profiler, zone);
+    }
+    ~Profile_Scope()
+    {
+        if(active)
+            end_profile_zone(frame_profiler);
+    }
+};
+
+/* reads the finished queries into their frames, without waiting. a GPU time longer than the time since
+   the query began is a driver error (the first query of llvmpipe), that frame is left unmeasured */
+void read_profiler_queries(Frame_Profiler* profiler, double now)
+{
+    for(int i = 0; i < PROFILE_GPU_QUERIES; i++)
+    {
+        unsigned int frame = profiler->query_frames[i];
+        if(frame == PROFILE_NO_FRAME)
+            continue;
+        int available = 0;
+        glGetQueryObjectiv(profiler->queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+        if(!available)
+            continue;
+        GLuint64 elapsed_ns = 0;
+        glGetQueryObjectui64v(profiler->queries[i], GL_QUERY_RESULT, &elapsed_ns);
+        profiler->query_frames[i] = PROFILE_NO_FRAME;
+        if(elapsed_ns > now - profiler->query_starts_ns[i])
+        {
+            profiler->gpu_skipped++;
+            continue;
+        }
+        float gpu_ms = elapsed_ns / 1.0e6f;
+        if(profiler->frames_count - frame <= PROFILE_HISTORY_FRAMES)
+            profiler->history[frame % PROFILE_HISTORY_FRAMES].gpu_ms = gpu_ms;
+        profiler->totals.gpu_ms += gpu_ms;
+        profiler->maximums.gpu_ms = std::max(profiler->maximums.gpu_ms, gpu_ms);
+        profiler->gpu_frames_count++;
+        // on the cpu clock the GPU work starts with the frame at the earliest
+        add_profile_event(profiler, PROFILE_EVENT_GPU, frame, profiler->query_starts_ns[i], profiler->query_starts_ns[i] + elapsed_ns);
+    }
+}
+
+void begin_profiler_frame(Frame_Profiler* profiler)
+{
+    double now = get_profiler_time_ns();
+    read_profiler_queries(profiler, now);
+    if(profiler->frames_count > 0)
+    {
+        float frame_ms = (now - profiler->frame_start_ns) / 1.0e6;
+        profiler->history[(profiler->frames_count - 1) % PROFILE_HISTORY_FRAMES].frame_ms = frame_ms;
+        profiler->totals.frame_ms += frame_ms;
+        profiler->maximums.frame_ms = std::max(profiler->maximums.frame_ms, frame_ms);
+    }
+    memset(&profiler->current, 0, sizeof(Profile_Frame));
+    profiler->current.gpu_ms = -1.0f;
+    profiler->frame_start_ns = now;
+    profiler->depth = 0;
+    profiler->in_frame = true;
+    int query = profiler->frames_count % PROFILE_GPU_QUERIES;
+    profiler->query_running = profiler->query_frames[query] == PROFILE_NO_FRAME;
+    if(profiler->query_running)
+    {
+        glBeginQuery(GL_TIME_ELAPSED, profiler->queries[query]);
+        profiler->query_frames[query] = profiler->frames_count;
+        profiler->query_starts_ns[query] = now;
+    }
+    else
+        profiler->gpu_skipped++;
+}
+
+/* before the buffer swap, which waits for the display and is left to the frame time */
+void end_profiler_frame(Frame_Profiler* profiler)
+{
+    if(profiler->query_running)
+        glEndQuery(GL_TIME_ELAPSED);
+    profiler->query_running = false;
+    double now = get_profiler_time_ns();
+    profiler->in_frame = false;
+    profiler->current.cpu_ms = (now - profiler->frame_start_ns) / 1.0e6;
+    profiler->history[profiler->frames_count % PROFILE_HISTORY_FRAMES] = profiler->current;
+    profiler->totals.cpu_ms += profiler->current.cpu_ms;
+    profiler->maximums.cpu_ms = std::max(profiler->maximums.cpu_ms, profiler->current.cpu_ms);
+    for(int i = 0; i < PROFILE_ZONES_COUNT; i++)
+    {
+        profiler->totals.zone_ms[i] += profiler->current.zone_ms[i];
+        profiler->maximums.zone_ms[i] = std::max(profiler->maximums.zone_ms[i], profiler->current.zone_ms[i]);
+    }
+    add_profile_event(profiler, PROFILE_EVENT_FRAME, profiler->frames_count, profiler->frame_start_ns, now);
+    profiler->frames_count++;
+}
+
+void print_frame_profiler_stats(Frame_Profiler* profiler)
+{
+    if(profiler->frames_count == 0)
+        return;
+    float frames = profiler->frames_count;
+    printf("frame profiler: %u frames, ms per frame (average / max): \n", profiler->frames_count);
+    for(int i = 0; i < PROFILE_ZONES_COUNT; i++)
+        printf("%20s %10.3f %10.3f \n", profile_zone_names[i], profiler->totals.zone_ms[i] / frames, profiler->maximums.zone_ms[i]);
+    printf("%20s %10.3f %10.3f \n", "cpu", profiler->totals.cpu_ms / frames, profiler->maximums.cpu_ms);
+    if(profiler->frames_count > 1)
+        printf("%20s %10.3f %10.3f \n", "frame", profiler->totals.frame_ms / (frames - 1), profiler->maximums.frame_ms);
+    if(profiler->gpu_frames_count > 0)
+        printf("%20s %10.3f %10.3f (%u frames measured, %u skipped) \n", "gpu", profiler->totals.gpu_ms / profiler->gpu_frames_count,
+               profiler->maximums.gpu_ms, profiler->gpu_frames_count, profiler->gpu_skipped);
+}
+
+const char* get_profile_event_name(int type)
+{
+    if(type == PROFILE_EVENT_FRAME)
+        return "frame";
+    if(type == PROFILE_EVENT_GPU)
+        return "gpu";
+    return profile_zone_names[type];
+}
+
+/* Chrome trace event format: complete events ("ph":"X") in microseconds, the cpu zones and frames
+   on the thread 1, the GPU time of the frames on the thread 2, averages in otherData */
+bool write_profiler_trace(Frame_Profiler* profiler, const char* file_name)
+{
+    FILE* file = fopen(file_name, "w");
+    if(file == NULL)
+    {
+        printf("could not write %s \n", file_name);
+        return false;
+    }
+    fprintf(file, "{\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"cpu\"}},\n");
+    fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"gpu\"}}");
+    for(unsigned int i = 0; i < profiler->events_count; i++)
+    {
+        Profile_Event* event = &profiler->events[i];
+        fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%u}}",
+                get_profile_event_name(event->type), event->type == PROFILE_EVENT_GPU ? 2 : 1,
+                event->start_ns / 1000.0, event->duration_ns / 1000.0, event->frame);
+    }
+    float frames = std::max(profiler->frames_count, 1u);
+    fprintf(file, "\n],\n\"displayTimeUnit\":\"ms\",\n\"otherData\":{\"frames\":%u", profiler->frames_count);
+    for(int i = 0; i < PROFILE_ZONES_COUNT; i++)
+        fprintf(file, ",\"%s_ms\":%.4f", profile_zone_names[i], profiler->totals.zone_ms[i] / frames);
+    fprintf(file, ",\"cpu_ms\":%.4f", profiler->totals.cpu_ms / frames);
+    if(profiler->gpu_frames_count > 0)
+        fprintf(file, ",\"gpu_ms\":%.4f", profiler->totals.gpu_ms / profiler->gpu_frames_count);
+    fprintf(file, "}}\n");
+    bool success = !ferror(file);
+    fclose(file);
+    if(success)
+        printf("profiler trace: %u events written to %s \n", profiler->events_count, file_name);
+    else
+        printf("could not write %s \n", file_name);
+    return success;
+}
+
+/* two triangles from the pixel rectangle (x0, y0) (x1, y1), y up */
+float* add_profiler_graph_quad(float* vertices, float x0, float y0, float x1, float y1, const float* color,
+                               int screen_width, int screen_height)
+{
+    const float corners[6][2] = {{x0, y0}, {x1, y0}, {x1, y1}, {x0, y0}, {x1, y1}, {x0, y1}};
+    for(int i = 0; i < 6; i++)
+    {
+        *vertices++ = corners[i][0] * 2.0f / screen_width - 1.0f;
+        *vertices++ = corners[i][1] * 2.0f / screen_height - 1.0f;
+        *vertices++ = color[0];
+        *vertices++ = color[1];
+        *vertices++ = color[2];
+    }
+    return vertices;
+}
+
+/* the last PROFILE_HISTORY_FRAMES frames in the bottom left corner, the newest on the right: a bar per
+   frame with the zones stacked in their colors, the rest of the cpu time in grey and the rest of the
+   frame time in dark grey, a white mark at the GPU time. the lines are 16.7 ms (60 fps) and the top
+   PROFILE_GRAPH_MS. shader_id: profiler_graph.vs and profiler_graph.fs */
+void draw_profiler_graph(Frame_Profiler* profiler, unsigned int shader_id, int screen_width, int screen_height)
+{
+    const unsigned int quads_count = PROFILE_HISTORY_FRAMES * (PROFILE_ZONES_COUNT + 3) + 3;
+    if(profiler->graph_VAO == 0)
+    {
+        profiler->graph_vertices = (float*)malloc(sizeof(float) * 30 * quads_count);
+        glGenVertexArrays(1, &profiler->graph_VAO);
+        glGenBuffers(1, &profiler->graph_VBO);
+        bind_vertex_array(profiler->graph_VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, profiler->graph_VBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 30 * quads_count, NULL, GL_STREAM_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(2 * sizeof(float)));
+    }
+    const float panel_color[3] = {0.08f, 0.08f, 0.08f};
+    const float line_color[3] = {0.45f, 0.45f, 0.45f};
+    const float cpu_color[3] = {0.6f, 0.6f, 0.6f};
+    const float frame_color[3] = {0.25f, 0.25f, 0.25f};
+    const float gpu_color[3] = {1.0f, 1.0f, 1.0f};
+    const float left = 8.0f, bottom = 8.0f;
+    const float scale = PROFILE_GRAPH_HEIGHT / PROFILE_GRAPH_MS;
+    const float right = left + PROFILE_HISTORY_FRAMES * PROFILE_GRAPH_BAR_WIDTH;
+    const float top = bottom + PROFILE_GRAPH_HEIGHT;
+    float* vertices = profiler->graph_vertices;
+    vertices = add_profiler_graph_quad(vertices, left, bottom, right, top, panel_color, screen_width, screen_height);
+    unsigned int shown = std::min(profiler->frames_count, (unsigned int)PROFILE_HISTORY_FRAMES);
+    for(unsigned int i = 0; i < shown; i++)
+    {
+        unsigned int frame = profiler->frames_count - shown + i;
+        Profile_Frame* history = &profiler->history[frame % PROFILE_HISTORY_FRAMES];
+        float x0 = right - (shown - i) * PROFILE_GRAPH_BAR_WIDTH;
+        float x1 = x0 + PROFILE_GRAPH_BAR_WIDTH;
+        // the newest frame has no frame time yet
+        float frame_ms = frame + 1 < profiler->frames_count ? history->frame_ms : history->cpu_ms;
+        vertices = add_profiler_graph_quad(vertices, x0, bottom, x1, bottom + std::min(frame_ms * scale, PROFILE_GRAPH_HEIGHT),
+                                           frame_color, screen_width, screen_height);
+        float y = bottom;
+        for(int zone = 0; zone < PROFILE_ZONES_COUNT; zone++)
+        {
+            float y1 = std::min(y + history->zone_ms[zone] * scale, top);
+            vertices = add_profiler_graph_quad(vertices, x0, y, x1, y1, profile_zone_colors[zone], screen_width, screen_height);
+            y = y1;
+        }
+        vertices = add_profiler_graph_quad(vertices, x0, y, x1, std::min(bottom + history->cpu_ms * scale, top),
+                                           cpu_color, screen_width, screen_height);
+        if(history->gpu_ms >= 0.0f)
+        {
+            float gpu_y = std::min(bottom + history->gpu_ms * scale, top - 1.0f);
+            vertices = add_profiler_graph_quad(vertices, x0, gpu_y, x1, gpu_y + 1.0f, gpu_color, screen_width, screen_height);
+        }
+    }
+    float line_y = bottom + 1000.0f / 60.0f * scale;
+    vertices = add_profiler_graph_quad(vertices, left, line_y, right, line_y + 1.0f, line_color, screen_width, screen_height);
+    vertices = add_profiler_graph_quad(vertices, left, top - 1.0f, right, top, line_color, screen_width, screen_height);
+    unsigned int vertices_count = (vertices - profiler->graph_vertices) / 5;
+
+    bind_vertex_array(profiler->graph_VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, profiler->graph_VBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 30 * quads_count, NULL, GL_STREAM_DRAW); // orphan
+    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(float) * 5 * vertices_count, profiler->graph_vertices);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    use_program(shader_id);
+    glDisable(GL_DEPTH_TEST);
+    glDrawArrays(GL_TRIANGLES, 0, vertices_count);
+    glEnable(GL_DEPTH_TEST);
+}
+
+#endif // FRAME_PROFILER_H
@@ -13,6 +13,17 @@
 #define CGLTF_IMPLEMENTATION
 #include "cgltf.h"
 
+#include <algorithm>
+
+#include "base64_decoder.h"
+#include "thread_pool.h"
+#include "mapped_file.h"
+#include "mesh_optimizer.h"
+#include "tim_loader.h"
+#include "render_state.h"
+#include "node_matrix_buffer.h"
+#include "frame_profiler.h"
+
 typedef struct
 {
     float x, y, z, w;
@@ -35,6 +46,14 @@ typedef struct
     glm::mat4 scale;
 }TRS_Transform;
 
+/* joints and weights of a skinned vertex, the joints index Model_Data::joint_matrices.
+   the weights of the vertices of rigid meshes are 0 */
+typedef struct
+{
+    unsigned short joints[4];
+    float weights[4];
+}Skin_Vertex;
+
 typedef struct
 {
     unsigned int VAO, VBO[2], EBO;
@@ -45,18 +64,38 @@ typedef struct
     Vec3* vertices;
     Vec2* texcoord;
     glm::mat4 bone_matrix;
+    unsigned int* indices;
+    unsigned int indices_count;
+    unsigned int index_type;  // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT in the uploaded index buffer
+    unsigned int base_vertex; // first vertex of the mesh in Model_Data::VBO
+    unsigned int base_index;  // first index of the mesh in Model_Data::EBO
+    Skin_Vertex* skin_vertices; // one per vertex for skinned meshes, else NULL
 }Mesh_Data;
 
+/* interleaved vertex of the model buffer, see setup_model_buffer */
+typedef struct
+{
+    Vec3 position;
+    Vec2 texcoord;
+    unsigned int bone_index; // index of the mesh, selects its bone matrix in draw_model_merged
+}Model_Vertex;
+
 typedef struct Animation_Data Animation_Data;
 typedef glm::mat4 (*Interpolate_Animation)(Animation_Data*, float);
+typedef struct Packed_Animation Packed_Animation; // see animation_engine.h
+typedef struct Animation_Pose Animation_Pose;
 
 typedef struct Animation_Node
 {
     Mesh_Data* mesh;
     TRS_Transform trs;
+    glm::vec3 rest_translation; // TRS of the gltf node, kept by the channels an animation does not drive
+    glm::quat rest_rotation;
+    glm::vec3 rest_scale;
     glm::mat4 local_transform;
     glm::mat4 global_transform;
     Animation_Node* parent;
+    int parent_index; // index of the parent in Model_Data::sorted_nodes, -1 for root nodes
 	Animation_Node** children;
 	Animation_Data* trans_anim;
 	Animation_Data* rot_anim;
@@ -68,6 +107,7 @@ typedef struct Animation_Data
 {
     int type;
     int count;
+    int cursor; // key frame index of the last lookup, see find_animation_frame_index
     float *time;
     float *trs;
     Animation_Node* target_node;
@@ -82,26 +122,96 @@ typedef struct
     float ticks_per_second;
 }Animation_Timer;
 
+/* an animation pre-sampled at a fixed frame rate, see bake_model_animations */
+typedef struct
+{
+    float frame_rate;
+    float duration;
+    unsigned int frames_count;
+    unsigned int nodes_count;
+    unsigned int joints_count;
+    unsigned int frame_matrices_count; // nodes_count + joints_count
+    glm::mat4* matrices;         // global matrix of every anim node then joint matrix of every joint (see Model_Skin) for every frame
+    int interpolate;             // lerp the matrices of the two frames around the time, else nearest frame
+    unsigned int palette_buffer; // matrices uploaded as a RGBA32F texture buffer, 0 when the CPU does the lookup
+    unsigned int palette_texture;
+}Baked_Animation;
+
 typedef struct
 {
     unsigned int anim_data_count;
     Animation_Data** anim_data;
     float duration;
+    Baked_Animation* baked; // NULL until the animation is baked
+    Packed_Animation* packed; // NULL until the animation is first sampled, see update_animation_frame
 }Model_Animation;
 
+#define ANIMATION_STEP_RATE 30.0 // keyframes per second of the PS1 models, the rate of -anim-steps in the viewer
+
+/* the clock of the animation of a model, see advance_animation_clock */
+typedef struct
+{
+    double step;             // seconds per simulation step, 0 samples the animation at the time of every frame
+    bool interpolate;        // draw between the poses of the two steps around the time, else the pose of the last step
+    long long steps;         // steps since the clip started, step n is at n * step in the clip
+    double elapsed;          // time since the last step, or the clip time when step is 0
+    glm::vec3* translations; // local TRS of every anim node in two poses, NULL before the first step
+    glm::quat* rotations;
+    glm::vec3* scales;
+    long long pose_steps[2]; // step of each pose, -1 when it is not sampled
+    int last_pose;           // pose of the last step, the other one is of the next step
+    bool next_pose_end;      // the next step loops the clip, its pose is the end of the clip and not the start
+    float drawn_alpha;       // blend factor of the poses in the node and joint matrices, -1 when unknown
+}Animation_Clock;
+
+/* a gltf skin: the vertices of its meshes follow its joints instead of their node */
+typedef struct
+{
+    unsigned int joints_count;
+    unsigned int* joint_nodes;         // anim node of each joint
+    glm::mat4* inverse_bind_matrices;  // see get_inverse_bind_matrices
+    unsigned int first_joint;          // first matrix of the skin in Model_Data::joint_matrices
+}Model_Skin;
+
 typedef struct
 {
     unsigned int meshes_count;
     Mesh_Data** meshes;
+    unsigned int VAO, VBO, EBO; // every mesh in one Model_Vertex buffer and one index buffer
+    unsigned int vertices_count;
+    unsigned int indices_count;
+    unsigned int index_type;
+    unsigned int skin_VBO;   // Skin_Vertex of every vertex of VBO, 0 without skins
+    Model_Skin** skins;
+    unsigned int skins_count;
+    unsigned int joints_count;     // of all the skins
+    glm::mat4* joint_matrices;     // joint global transform * inverse bind matrix, see update_model_skins
+    bool joint_matrices_changed;   // not uploaded to joint_buffer yet
+    unsigned int joint_buffer;     // texture buffer of the joint matrices, read by model_skinned.vs
+    unsigned int joint_texture;
     unsigned int texture;
+    unsigned int palette_texture; // palette of an indexed texture (see create_tim_texture), 0 when texture is RGBA
+    int palette_row;              // clut row of a TIM texture, read by model_indexed.fs and expanded in image_pixels
+    unsigned char* image_pixels;  // RGBA texture kept on the cpu by MODEL_LOAD_NO_GPU (see soft_rasterizer.h), else NULL
+    int image_width, image_height;
+    int texture_array_image; // image of the texture in a Texture_Array (see pack_model_texture), -1 when not packed
+    glm::vec4 texture_rect;  // corner and size of the image in its layer, in layer coordinates
+    int texture_layer;
+    glm::ivec2 texture_wrap; // wrap modes of the sampler in s and t, see get_texture_array_wrap
+    Node_Matrix_Buffer* node_matrices; // buffer the matrices of the frame are in (see write_model_node_matrices), NULL before
+    long node_matrices_offset;
     Animation_Node** anim_nodes;
     unsigned int anim_nodes_count;
+    Animation_Node* sorted_nodes; // the anim_nodes in one block, parents before their children
     Animation_Node** root_nodes;
     unsigned int root_nodes_count;
     Model_Animation** animations;
     unsigned int animations_count;
     Model_Animation* curren_animation;
     float animation_time;
+    Animation_Clock clock;
+    Animation_Pose* pose; // evaluation state of the packed animations, NULL before the first sampling
+    Mapped_File* cache_file; // .gvc file backing the vertex and animation arrays, NULL when loaded from gltf
 }Model_Data;
 
 typedef struct
@@ -114,12 +224,6 @@ typedef struct
     unsigned int joints_size;
 }Bone_Data;
 
-typedef struct
-{
-    unsigned int meshes_count;
-    Mesh_Data* meshes;
-}Morph_Target_Data;
-
 size_t float_count(cgltf_accessor* accessor)
 {
     cgltf_size floats_per_element = cgltf_num_components(accessor->type);
@@ -153,10 +257,14 @@ unsigned int* read_indices(cgltf_accessor* accessor)
 {
     size_t available_numbers = index_count(accessor);
     //printf("available_numbers=%d\n",available_numbers);
-    int mem_size = cgltf_accessor_unpack_indices(accessor, NULL, sizeof(int), available_numbers) * sizeof(int);
+    int mem_size = available_numbers * sizeof(unsigned int);
     unsigned int* index_buffer = (unsigned int*)malloc(mem_size);
-    //cgltf_accessor_unpack_indices(accessor, index_buffer, sizeof(int), available_numbers);
-    printf("indices_mem_size=%d\n",mem_size);
+    if(cgltf_accessor_unpack_indices(accessor, index_buffer, sizeof(unsigned int), available_numbers) != available_numbers)
+    {
+        // sparse or bufferless index accessors are not supported
+        free(index_buffer);
+        return NULL;
+    }
     return index_buffer;
 }
 
@@ -505,13 +613,8 @@ glm::mat4 interpolate_position(Animation_Data* anim_data, float animation_time);
 glm::mat4 interpolate_rotation(Animation_Data* anim_data, float animation_time);
 glm::mat4 interpolate_scaling(Animation_Data* anim_data, float animation_time);
 
-Animation_Data* read_animation_data(cgltf_animation_channel* channel)
+void set_animation_data_interpolation(Animation_Data* data)
 {
-    Animation_Data* data = (Animation_Data*)malloc(sizeof(Animation_Data));
-    data->type = channel->target_path;
-    data->count = channel->sampler->input->count;
-    data->time = read_accessor(channel->sampler->input);
-    data->trs = read_accessor(channel->sampler->output);
     switch(data->type)
     {
         case cgltf_animation_path_type_translation:
@@ -523,7 +626,20 @@ Animation_Data* read_animation_data(cgltf_animation_channel* channel)
         case cgltf_animation_path_type_scale:
             data->interpolate_animation = interpolate_scaling;
             break;
+        default:
+            data->interpolate_animation = NULL;
     }
+}
+
+Animation_Data* read_animation_data(cgltf_animation_channel* channel)
+{
+    Animation_Data* data = (Animation_Data*)malloc(sizeof(Animation_Data));
+    data->type = channel->target_path;
+    data->count = channel->sampler->input->count;
+    data->cursor = 0;
+    data->time = read_accessor(channel->sampler->input);
+    data->trs = read_accessor(channel->sampler->output);
+    set_animation_data_interpolation(data);
     return data;
 }
 
@@ -618,20 +734,75 @@ int get_animation_frame_index(float animation_current_time, float* animation_tim
     assert(0);
 }
 
-/* Gets normalized value for Lerp & Slerp*/
+/* Binary search for the index of the last key frame at or before animation_time,
+ clamped to [0, animation_times_count - 2] so that index + 1 is always a valid key*/
+int search_animation_frame_index(float animation_current_time, float* animation_times, int animation_times_count)
+{
+    int last_index = animation_times_count - 2;
+    if (last_index <= 0)
+        return 0;
+    float* next_time = std::upper_bound(animation_times + 1, animation_times + last_index + 1, animation_current_time);
+    return (next_time - animation_times) - 1;
+}
+
+#define ANIMATION_CURSOR_MAX_STEPS 4
+
+/* Same result as get_animation_frame_index, but starts from the key frame found by the previous
+ call: while the playback moves forward the cursor only advances a key or two, seeks backwards,
+ loops and big jumps fall back to the binary search*/
+int find_frame_index_from_cursor(float animation_current_time, float* animation_times, int animation_times_count, int* cursor)
+{
+    int last_index = animation_times_count - 2;
+    int index = *cursor;
+    if (last_index <= 0)
+        return 0;
+    if (index > last_index || animation_current_time < animation_times[index])
+    {
+        index = search_animation_frame_index(animation_current_time, animation_times, animation_times_count);
+    }
+    else
+    {
+        for (int steps = 0; index < last_index && animation_current_time >= animation_times[index + 1]; steps++)
+        {
+            if (steps == ANIMATION_CURSOR_MAX_STEPS)
+            {
+                index = search_animation_frame_index(animation_current_time, animation_times, animation_times_count);
+                break;
+            }
+            index++;
+        }
+    }
+    *cursor = index;
+    return index;
+}
+
+int find_animation_frame_index(Animation_Data* anim_data, float animation_current_time)
+{
+    return find_frame_index_from_cursor(animation_current_time, anim_data->time, anim_data->count, &anim_data->cursor);
+}
+
+/* Gets normalized value for Lerp & Slerp, clamped so times outside the track hold the first/last key*/
 float get_scale_factor(float last_time_stamp, float next_time_stamp, float animation_time)
 {
     float scale_factor = 0.0f;
     float midway_length = animation_time - last_time_stamp;
     float frames_diff = next_time_stamp - last_time_stamp;
+    if (frames_diff <= 0.0f)
+        return 0.0f;
     scale_factor = midway_length / frames_diff;
+    if (scale_factor < 0.0f)
+        scale_factor = 0.0f;
+    else if (scale_factor > 1.0f)
+        scale_factor = 1.0f;
     return scale_factor;
 }
 
+#include "animation_engine.h" // uses the key frame lookup above
+
 glm::mat4 interpolate_position(Animation_Data* anim_data, float animation_time)
 {
-    int index_1 = get_animation_frame_index(animation_time, anim_data->time, anim_data->count);
-    int index_2 = index_1 + 1;
+    int index_1 = find_animation_frame_index(anim_data, animation_time);
+    int index_2 = index_1 + 1 < anim_data->count ? index_1 + 1 : index_1; // single key tracks
     float scale_factor = get_scale_factor(anim_data->time[index_1],
         anim_data->time[index_2], animation_time);
     glm::vec3* positions = (glm::vec3*)anim_data->trs;
@@ -641,8 +812,8 @@ glm::mat4 interpolate_position(Animation_Data* anim_data, float animation_time)
 
 glm::mat4 interpolate_rotation(Animation_Data* anim_data, float animation_time)
 {
-    int index_1 = get_animation_frame_index(animation_time, anim_data->time, anim_data->count);
-    int index_2 = index_1 + 1;
+    int index_1 = find_animation_frame_index(anim_data, animation_time);
+    int index_2 = index_1 + 1 < anim_data->count ? index_1 + 1 : index_1; // single key tracks
     float scale_factor = get_scale_factor(anim_data->time[index_1],
         anim_data->time[index_2], animation_time);
     glm::quat quat_1 = get_glm_quat(anim_data->trs + (index_1 << 2));
@@ -654,8 +825,8 @@ glm::mat4 interpolate_rotation(Animation_Data* anim_data, float animation_time)
 
 glm::mat4 interpolate_scaling(Animation_Data* anim_data, float animation_time)
 {
-    int index_1 = get_animation_frame_index(animation_time, anim_data->time, anim_data->count);
-    int index_2 = index_1 + 1;
+    int index_1 = find_animation_frame_index(anim_data, animation_time);
+    int index_2 = index_1 + 1 < anim_data->count ? index_1 + 1 : index_1; // single key tracks
     float scale_factor = get_scale_factor(anim_data->time[index_1],
         anim_data->time[index_2], animation_time);
     glm::vec3* scales = (glm::vec3*)anim_data->trs;
@@ -831,56 +1002,53 @@ void print_morph_target(cgltf_primitive* primitive)
     }
 }
 
-Morph_Target_Data* read_morph_target(cgltf_primitive* primitive)
+/* weights of the targets_count morph targets at the time, a weights channel has targets_count
+   values per key (see morph_engine.h for the targets) */
+void interpolate_weights(Animation_Data* anim_data, float animation_time, float* weights, unsigned int targets_count)
 {
-    Morph_Target_Data* data = (Morph_Target_Data*)malloc(sizeof(Morph_Target_Data));
-    data->meshes = (Mesh_Data*)malloc(sizeof(Mesh_Data) * primitive->targets_count);
-    data->meshes_count = primitive->targets_count;
-    cgltf_morph_target* targets = primitive->targets;
-    cgltf_attribute* attribute; float* vertex_array;
-    for(int i = 0; i < primitive->targets_count; i++)
-    {
-        for(int j = 0; j < targets[i].attributes_count; j++)
-        {
-            attribute = &targets[i].attributes[j];
-            if(attribute->type == cgltf_attribute_type_position)
-            {
-                vertex_array = read_accessor(attribute->data);
-                data->meshes[i].vertices = (Vec3*)vertex_array;
-                data->meshes[i].vertices_count = attribute->data->count;
-                data->meshes[i].vertices_size = attribute->data->count * sizeof(Vec3);
-            }
-        }
-    }
-    return data;
+    int index_1 = find_animation_frame_index(anim_data, animation_time);
+    int index_2 = index_1 + 1 < anim_data->count ? index_1 + 1 : index_1; // single key tracks
+    float scale_factor = get_scale_factor(anim_data->time[index_1],
+        anim_data->time[index_2], animation_time);
+    float* weights_1 = &anim_data->trs[index_1 * targets_count];
+    float* weights_2 = &anim_data->trs[index_2 * targets_count];
+    for(unsigned int i = 0; i < targets_count; i++)
+        weights[i] = weights_1[i] + (weights_2[i] - weights_1[i]) * scale_factor;
 }
 
-void free_morph_target(Morph_Target_Data* data)
+void update_morph_animation(Animation_Data* anim_data, Animation_Timer* anim_timer, float* weights, unsigned int targets_count)
 {
-    for(int i = 0; i < data->meshes_count; i++)
-    {
-        free(data->meshes[i].vertices); data->meshes[i].vertices = NULL;
-    }
-    data->meshes = NULL;
-    free(data); data = NULL;
+    anim_timer->currrent_time += (anim_timer->delta_time / 1000);
+    anim_timer->currrent_time = fmod(anim_timer->currrent_time, anim_timer->duration);
+    interpolate_weights(anim_data, anim_timer->currrent_time, weights, targets_count);
 }
 
-glm::vec2 interpolate_weight(Animation_Data* anim_data, float animation_time)
+/* 16 bit indices when every vertex can be reached with them */
+unsigned int get_index_type(unsigned int vertices_count)
 {
-    int index_1 = get_animation_frame_index(animation_time, anim_data->time, anim_data->count);
-    int index_2 = index_1 + 1;
-    float scale_factor = get_scale_factor(anim_data->time[index_1],
-        anim_data->time[index_2], animation_time);
-    glm::vec2* weights = (glm::vec2*)anim_data->trs;
-    glm::vec2 final_weight = glm::mix(weights[index_1], weights[index_2], scale_factor);
-    return final_weight;
+    return vertices_count <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
 }
 
-glm::vec2 update_morph_animation(Animation_Data* anim_data, Animation_Timer* anim_timer)
+unsigned int get_index_size(unsigned int index_type)
 {
-    anim_timer->currrent_time += (anim_timer->delta_time / 1000);
-    anim_timer->currrent_time = fmod(anim_timer->currrent_time, anim_timer->duration);
-    return interpolate_weight(anim_data, anim_timer->currrent_time);
+    return index_type == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+}
+
+/* copies indices + base_vertex into an index buffer of index_type */
+void write_index_buffer(void* index_buffer, unsigned int index_type, unsigned int* indices, unsigned int indices_count, unsigned int base_vertex)
+{
+    if(index_type == GL_UNSIGNED_SHORT)
+    {
+        unsigned short* short_indices = (unsigned short*)index_buffer;
+        for(unsigned int i = 0; i < indices_count; i++)
+            short_indices[i] = (unsigned short)(indices[i] + base_vertex);
+    }
+    else
+    {
+        unsigned int* int_indices = (unsigned int*)index_buffer;
+        for(unsigned int i = 0; i < indices_count; i++)
+            int_indices[i] = indices[i] + base_vertex;
+    }
 }
 
 void setup_mesh(Mesh_Data* mesh)
@@ -891,7 +1059,7 @@ void setup_mesh(Mesh_Data* mesh)
     glGenBuffers(1, &mesh->EBO);
 
     // load data into buffers
-    glBindVertexArray(mesh->VAO);
+    bind_vertex_array(mesh->VAO);
 
     // position attribute
     glBindBuffer(GL_ARRAY_BUFFER, mesh->VBO[0]);
@@ -905,10 +1073,120 @@ void setup_mesh(Mesh_Data* mesh)
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(1);
 
-    glBindVertexArray(0);
+    // indices
+    mesh->index_type = get_index_type(mesh->vertices_count);
+    mesh->base_index = 0;
+    unsigned int index_size = get_index_size(mesh->index_type);
+    void* index_buffer = malloc(index_size * mesh->indices_count);
+    write_index_buffer(index_buffer, mesh->index_type, mesh->indices, mesh->indices_count, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_size * mesh->indices_count, index_buffer, GL_STATIC_DRAW);
+    free(index_buffer);
+
+    bind_vertex_array(0);
+}
+
+#define WELD_VERTEX_SIZE (sizeof(Vec3) + sizeof(Vec2))
+
+unsigned int hash_weld_vertex(Vec3* position, Vec2* texcoord)
+{
+    // FNV-1a over the position and texcoord bytes
+    unsigned int hash = 2166136261u;
+    unsigned char* bytes = (unsigned char*)position;
+    for(unsigned int i = 0; i < sizeof(Vec3); i++)
+        hash = (hash ^ bytes[i]) * 16777619u;
+    bytes = (unsigned char*)texcoord;
+    for(unsigned int i = 0; i < sizeof(Vec2); i++)
+        hash = (hash ^ bytes[i]) * 16777619u;
+    return hash;
+}
+
+/* Turns the triangle soup of the mesh into unique vertices + indices, vertices are merged
+ when position, texcoord and skin are bitwise equal*/
+void weld_mesh_vertices(Mesh_Data* mesh)
+{
+    unsigned int count = mesh->vertices_count;
+    mesh->indices_count = count;
+    mesh->indices = (unsigned int*)malloc(sizeof(unsigned int) * count);
+    unsigned int table_size = 1;
+    while(table_size < count * 2)
+        table_size <<= 1;
+    // open addressing table of unique vertex index + 1, 0 for empty slots
+    unsigned int* table = (unsigned int*)calloc(table_size, sizeof(unsigned int));
+    unsigned int unique_count = 0;
+    for(unsigned int i = 0; i < count; i++)
+    {
+        unsigned int slot = hash_weld_vertex(&mesh->vertices[i], &mesh->texcoord[i]) & (table_size - 1);
+        while(table[slot] != 0)
+        {
+            unsigned int unique = table[slot] - 1;
+            if(memcmp(&mesh->vertices[unique], &mesh->vertices[i], sizeof(Vec3)) == 0 &&
+               memcmp(&mesh->texcoord[unique], &mesh->texcoord[i], sizeof(Vec2)) == 0 &&
+               (mesh->skin_vertices == NULL ||
+                memcmp(&mesh->skin_vertices[unique], &mesh->skin_vertices[i], sizeof(Skin_Vertex)) == 0))
+                break;
+            slot = (slot + 1) & (table_size - 1);
+        }
+        if(table[slot] == 0)
+        {
+            // unique_count <= i, the vertex moves down in place
+            mesh->vertices[unique_count] = mesh->vertices[i];
+            mesh->texcoord[unique_count] = mesh->texcoord[i];
+            if(mesh->skin_vertices != NULL)
+                mesh->skin_vertices[unique_count] = mesh->skin_vertices[i];
+            table[slot] = ++unique_count;
+        }
+        mesh->indices[i] = table[slot] - 1;
+    }
+    free(table);
+    mesh->vertices_count = mesh->texcoord_count = unique_count;
+    mesh->vertices_size = unique_count * sizeof(Vec3);
+    mesh->texcoord_size = unique_count * sizeof(Vec2);
+}
+
+/* JOINTS_0 and WEIGHTS_0 of the primitive, NULL when it is not skinned. the joints are read as
+ integers and stay relative to the skin until offset_skin_joints, the weights are scaled to a sum of 1*/
+Skin_Vertex* read_skin_vertices(cgltf_primitive* primitive, unsigned int vertices_count)
+{
+    cgltf_accessor* joints = get_accessor(primitive, cgltf_attribute_type_joints);
+    cgltf_accessor* weights = get_accessor(primitive, cgltf_attribute_type_weights);
+    if(joints == NULL || weights == NULL || joints->count < vertices_count || weights->count < vertices_count)
+        return NULL;
+    Skin_Vertex* skin_vertices = (Skin_Vertex*)malloc(sizeof(Skin_Vertex) * vertices_count);
+    for(unsigned int i = 0; i < vertices_count; i++)
+    {
+        Skin_Vertex* vertex = &skin_vertices[i];
+        cgltf_uint vertex_joints[4] = {0, 0, 0, 0};
+        for(int j = 0; j < 4; j++)
+            vertex->weights[j] = 0.0f;
+        cgltf_accessor_read_uint(joints, i, vertex_joints, 4);
+        cgltf_accessor_read_float(weights, i, vertex->weights, 4);
+        float weights_sum = vertex->weights[0] + vertex->weights[1] + vertex->weights[2] + vertex->weights[3];
+        for(int j = 0; j < 4; j++)
+        {
+            vertex->joints[j] = (unsigned short)vertex_joints[j];
+            if(weights_sum > 0.0f)
+                vertex->weights[j] /= weights_sum;
+        }
+    }
+    return skin_vertices;
 }
 
-Mesh_Data* load_mesh(cgltf_mesh* mesh)
+/* moves the joints of a skinned mesh from its skin to the model joint matrices */
+void offset_skin_joints(Mesh_Data* mesh, unsigned int first_joint)
+{
+    if(mesh->skin_vertices == NULL)
+        return;
+    for(unsigned int i = 0; i < mesh->vertices_count; i++)
+    {
+        for(int j = 0; j < 4; j++)
+            mesh->skin_vertices[i].joints[j] += first_joint;
+    }
+}
+
+/* reads the mesh without creating its buffers, see setup_model_buffer.
+ the source indices are used when the primitive has some, else the soup is welded*/
+Mesh_Data* load_mesh_data(cgltf_mesh* mesh)
 {
     Mesh_Data* data = (Mesh_Data*)malloc(sizeof(Mesh_Data));
     cgltf_accessor* accessor = get_position_accessor(&mesh->primitives[0]);
@@ -916,20 +1194,101 @@ Mesh_Data* load_mesh(cgltf_mesh* mesh)
     data->vertices_count = accessor->count;
     data->vertices_size = accessor->count * sizeof(Vec3);
     accessor = get_texcoord_accessor(&mesh->primitives[0]);
-    data->texcoord = (Vec2*)read_accessor(accessor);;
-    data->texcoord_count = accessor->count;
-    data->texcoord_size = accessor->count * sizeof(Vec2);
+    if(accessor != NULL)
+    {
+        data->texcoord = (Vec2*)read_accessor(accessor);;
+        data->texcoord_count = accessor->count;
+    }
+    else
+    {
+        // primitive without texture coordinates, every vertex samples the first texel
+        data->texcoord = (Vec2*)calloc(data->vertices_count, sizeof(Vec2));
+        data->texcoord_count = data->vertices_count;
+    }
+    data->texcoord_size = data->texcoord_count * sizeof(Vec2);
+    data->VAO = data->VBO[0] = data->VBO[1] = data->EBO = 0;
+    data->base_vertex = data->base_index = 0;
+    data->index_type = GL_UNSIGNED_INT;
+    data->indices = NULL;
+    data->skin_vertices = read_skin_vertices(&mesh->primitives[0], data->vertices_count);
+    if(mesh->primitives[0].indices != NULL)
+    {
+        data->indices = read_indices(mesh->primitives[0].indices);
+        data->indices_count = mesh->primitives[0].indices->count;
+    }
+    if(data->indices == NULL && data->texcoord_count == data->vertices_count)
+        weld_mesh_vertices(data);
+    else if(data->indices == NULL)
+    {
+        data->indices_count = data->vertices_count;
+        data->indices = (unsigned int*)malloc(sizeof(unsigned int) * data->indices_count);
+        for(unsigned int i = 0; i < data->indices_count; i++)
+            data->indices[i] = i;
+    }
+    return data;
+}
+
+typedef struct
+{
+    unsigned int triangles_count;
+    unsigned int misses_before; // vertex cache misses, see count_vertex_cache_misses
+    unsigned int misses_after;
+}Mesh_Optimization_Stats;
+
+/* reorders the triangles of the mesh for the vertex cache then its vertices for fetch locality */
+void optimize_mesh(Mesh_Data* mesh, Mesh_Optimization_Stats* stats)
+{
+    stats->triangles_count += mesh->indices_count / 3;
+    stats->misses_before += count_vertex_cache_misses(mesh->indices, mesh->indices_count, mesh->vertices_count, VERTEX_CACHE_SIZE);
+    optimize_vertex_cache(mesh->indices, mesh->indices_count, mesh->vertices_count, VERTEX_CACHE_SIZE);
+    stats->misses_after += count_vertex_cache_misses(mesh->indices, mesh->indices_count, mesh->vertices_count, VERTEX_CACHE_SIZE);
+    if(mesh->texcoord_count != mesh->vertices_count)
+        return;
+    unsigned int* remap = optimize_vertex_fetch(mesh->indices, mesh->indices_count, mesh->vertices_count);
+    Vec3* vertices = (Vec3*)malloc(mesh->vertices_size);
+    Vec2* texcoord = (Vec2*)malloc(mesh->texcoord_size);
+    remap_vertex_array(vertices, mesh->vertices, remap, mesh->vertices_count, sizeof(Vec3));
+    remap_vertex_array(texcoord, mesh->texcoord, remap, mesh->vertices_count, sizeof(Vec2));
+    free(mesh->vertices);  mesh->vertices = vertices;
+    free(mesh->texcoord);  mesh->texcoord = texcoord;
+    if(mesh->skin_vertices != NULL)
+    {
+        Skin_Vertex* skin_vertices = (Skin_Vertex*)malloc(sizeof(Skin_Vertex) * mesh->vertices_count);
+        remap_vertex_array(skin_vertices, mesh->skin_vertices, remap, mesh->vertices_count, sizeof(Skin_Vertex));
+        free(mesh->skin_vertices);  mesh->skin_vertices = skin_vertices;
+    }
+    free(remap);
+}
+
+void print_mesh_optimization_stats(Mesh_Optimization_Stats* stats)
+{
+    if(stats->triangles_count == 0)
+        return;
+    printf("vertex cache (%d entries) ACMR: %.3f -> %.3f for %u triangles \n", VERTEX_CACHE_SIZE,
+           stats->misses_before / (float)stats->triangles_count, stats->misses_after / (float)stats->triangles_count,
+           stats->triangles_count);
+}
+
+Mesh_Data* load_mesh(cgltf_mesh* mesh)
+{
+    Mesh_Data* data = load_mesh_data(mesh);
     setup_mesh(data);
     return data;
 }
 
 void free_mesh(Mesh_Data* mesh)
 {
-    glDeleteVertexArrays(1, &mesh->VAO);
-    glDeleteBuffers(2, mesh->VBO);
-    glDeleteBuffers(1, &mesh->EBO);
+    // meshes of MODEL_LOAD_NO_GPU models have no GL object, and maybe no GL context to delete them
+    if(mesh->VAO != 0)
+    {
+        delete_vertex_arrays(1, &mesh->VAO);
+        glDeleteBuffers(2, mesh->VBO);
+        glDeleteBuffers(1, &mesh->EBO);
+    }
     free(mesh->vertices); mesh->vertices = NULL;
     free(mesh->texcoord); mesh->texcoord = NULL;
+    free(mesh->indices); mesh->indices = NULL;
+    free(mesh->skin_vertices); mesh->skin_vertices = NULL;
     free(mesh); mesh = NULL;
 }
 
@@ -939,24 +1298,155 @@ void draw_mesh(Mesh_Data* mesh)
     //glActiveTexture(GL_TEXTURE0);
     //glBindTexture(GL_TEXTURE_2D, texture);
     // draw mesh
-    glBindVertexArray(mesh->VAO);
-    glDrawArrays(GL_TRIANGLES, 0, mesh->vertices_count);
+    bind_vertex_array(mesh->VAO);
+    glDrawElements(GL_TRIANGLES, mesh->indices_count, mesh->index_type,
+                   (void*)((size_t)mesh->base_index * get_index_size(mesh->index_type)));
+}
+
+void set_model_vertex_attributes(void)
+{
+    unsigned int stride = sizeof(Model_Vertex);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Model_Vertex, position));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Model_Vertex, texcoord));
+    glEnableVertexAttribArray(1);
+    glVertexAttribIPointer(2, 1, GL_UNSIGNED_INT, stride, (void*)offsetof(Model_Vertex, bone_index));
+    glEnableVertexAttribArray(2);
 }
 
+#define SKIN_JOINTS_ATTRIBUTE 8 // the per instance attributes of model_crowd.vs follow
+#define SKIN_WEIGHTS_ATTRIBUTE 9
 
-unsigned int load_texture_from_memory(cgltf_texture* gltf_texture, cgltf_options* options)
+/* reads Model_Data::skin_VBO, leaves it bound */
+void set_skin_vertex_attributes(unsigned int skin_VBO)
 {
-    unsigned char *image_buffer;
-	const char* comma = strchr(gltf_texture->image->uri, ',');
-	unsigned int base64_size = buffer_base64_size((char*)comma + 1);
-	void (*memory_free)(void*, void*) = options->memory.free_func ? options->memory.free_func : &cgltf_default_free;
-	cgltf_load_buffer_base64(options, base64_size, comma + 1, (void**)&image_buffer);
+    unsigned int stride = sizeof(Skin_Vertex);
+    glBindBuffer(GL_ARRAY_BUFFER, skin_VBO);
+    glVertexAttribIPointer(SKIN_JOINTS_ATTRIBUTE, 4, GL_UNSIGNED_SHORT, stride, (void*)offsetof(Skin_Vertex, joints));
+    glEnableVertexAttribArray(SKIN_JOINTS_ATTRIBUTE);
+    glVertexAttribPointer(SKIN_WEIGHTS_ATTRIBUTE, 4, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Skin_Vertex, weights));
+    glEnableVertexAttribArray(SKIN_WEIGHTS_ATTRIBUTE);
+}
+
+/* the skin vertices of every mesh in one buffer, zero weights for the rigid meshes.
+ returns 0 when no mesh is skinned*/
+unsigned int setup_model_skin_buffer(Model_Data* model)
+{
+    bool skinned = false;
+    for(unsigned int i = 0; i < model->meshes_count; i++)
+        skinned |= model->meshes[i]->skin_vertices != NULL;
+    if(!skinned)
+        return 0;
+    Skin_Vertex* skin_vertices = (Skin_Vertex*)calloc(model->vertices_count, sizeof(Skin_Vertex));
+    for(unsigned int i = 0; i < model->meshes_count; i++)
+    {
+        Mesh_Data* mesh = model->meshes[i];
+        if(mesh->skin_vertices != NULL)
+            memcpy(skin_vertices + mesh->base_vertex, mesh->skin_vertices, sizeof(Skin_Vertex) * mesh->vertices_count);
+    }
+    unsigned int skin_VBO;
+    glGenBuffers(1, &skin_VBO);
+    glBindBuffer(GL_ARRAY_BUFFER, skin_VBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(Skin_Vertex) * model->vertices_count, skin_vertices, GL_STATIC_DRAW);
+    free(skin_vertices);
+    return skin_VBO;
+}
+
+/* first vertex and index of every mesh in the model buffer and the totals, without any GL call */
+void set_model_buffer_ranges(Model_Data* model)
+{
+    model->vertices_count = model->indices_count = 0;
+    for(unsigned int i = 0; i < model->meshes_count; i++)
+    {
+        model->meshes[i]->base_vertex = model->vertices_count;
+        model->meshes[i]->base_index = model->indices_count;
+        model->vertices_count += model->meshes[i]->vertices_count;
+        model->indices_count += model->meshes[i]->indices_count;
+    }
+    model->index_type = get_index_type(model->vertices_count);
+}
+
+/* Packs the vertices of every mesh in one interleaved buffer and their indices in one index buffer.
+ the model VAO draws the whole model at once (draw_model_merged), each mesh VAO shares the buffers
+ and draws its own index range (draw_mesh)*/
+void setup_model_buffer(Model_Data* model)
+{
+    set_model_buffer_ranges(model);
+    unsigned int index_size = get_index_size(model->index_type);
+    Model_Vertex* vertices = (Model_Vertex*)malloc(sizeof(Model_Vertex) * model->vertices_count);
+    for(unsigned int i = 0; i < model->meshes_count; i++)
+    {
+        Mesh_Data* mesh = model->meshes[i];
+        Model_Vertex* mesh_vertices = vertices + mesh->base_vertex;
+        for(unsigned int j = 0; j < mesh->vertices_count; j++)
+        {
+            mesh_vertices[j].position = mesh->vertices[j];
+            if(j < mesh->texcoord_count)
+                mesh_vertices[j].texcoord = mesh->texcoord[j];
+            else
+                mesh_vertices[j].texcoord.x = mesh_vertices[j].texcoord.y = 0.0f;
+            mesh_vertices[j].bone_index = i;
+        }
+    }
+    void* indices = malloc(index_size * model->indices_count);
+    for(unsigned int i = 0; i < model->meshes_count; i++)
+    {
+        Mesh_Data* mesh = model->meshes[i];
+        mesh->index_type = model->index_type;
+        write_index_buffer((char*)indices + (size_t)mesh->base_index * index_size, model->index_type,
+                           mesh->indices, mesh->indices_count, mesh->base_vertex);
+    }
+    // the soup is what the loader uploaded before indexing, one vertex per index
+    size_t soup_size = sizeof(Model_Vertex) * model->indices_count;
+    size_t indexed_size = sizeof(Model_Vertex) * model->vertices_count + index_size * model->indices_count;
+    printf("model geometry: %u vertices -> %u unique, %.1f KB -> %.1f KB with %d bit indices \n",
+           model->indices_count, model->vertices_count, soup_size / 1024.0f, indexed_size / 1024.0f, index_size * 8);
+
+    glGenBuffers(1, &model->VBO);
+    glBindBuffer(GL_ARRAY_BUFFER, model->VBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(Model_Vertex) * model->vertices_count, vertices, GL_STATIC_DRAW);
+    free(vertices);
+    glGenBuffers(1, &model->EBO);
+    model->skin_VBO = setup_model_skin_buffer(model);
+
+    glGenVertexArrays(1, &model->VAO);
+    bind_vertex_array(model->VAO);
+    if(model->skin_VBO != 0)
+        set_skin_vertex_attributes(model->skin_VBO);
+    glBindBuffer(GL_ARRAY_BUFFER, model->VBO);
+    set_model_vertex_attributes();
+    // the element buffer binding is VAO state, bind it with the VAO
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, model->EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_size * model->indices_count, indices, GL_STATIC_DRAW);
+    free(indices);
+    for(unsigned int i = 0; i < model->meshes_count; i++)
+    {
+        Mesh_Data* mesh = model->meshes[i];
+        glGenVertexArrays(1, &mesh->VAO);
+        bind_vertex_array(mesh->VAO);
+        if(model->skin_VBO != 0)
+            set_skin_vertex_attributes(model->skin_VBO);
+        glBindBuffer(GL_ARRAY_BUFFER, model->VBO);
+        set_model_vertex_attributes();
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, model->EBO);
+    }
+    bind_vertex_array(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void free_model_buffer(Model_Data* model)
+{
+    delete_vertex_arrays(1, &model->VAO);
+    glDeleteBuffers(1, &model->VBO);
+    glDeleteBuffers(1, &model->EBO);
+    glDeleteBuffers(1, &model->skin_VBO);
+    model->VAO = model->VBO = model->EBO = model->skin_VBO = 0;
+}
 
-    int texture_wrap_s = gltf_texture->sampler->wrap_s;
-    int texture_wrap_t = gltf_texture->sampler->wrap_t;
-    int texture_min_filter = gltf_texture->sampler->min_filter;
-    int texture_mag_filter = gltf_texture->sampler->mag_filter;
 
+/* creates and binds a texture without storage */
+unsigned int create_texture_object(int texture_wrap_s, int texture_wrap_t, int texture_min_filter, int texture_mag_filter)
+{
     // load and create a texture
     // -------------------------
     unsigned int texture;
@@ -965,29 +1455,183 @@ unsigned int load_texture_from_memory(cgltf_texture* gltf_texture, cgltf_options
     // that's because On some drivers it is required to assign a texture unit to each sampler uniform
     // GL_TEXTURE0 is always by default activated
     //glActiveTexture(GL_TEXTURE0); // activate the texture unit first before binding texture
-    glBindTexture(GL_TEXTURE_2D, texture); // all upcoming GL_TEXTURE_2D operations now have effect on this texture object
+    bind_texture(0, GL_TEXTURE_2D, texture); // all upcoming GL_TEXTURE_2D operations now have effect on this texture object
     // set the texture wrapping parameters
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, texture_wrap_s);	// set texture wrapping to GL_REPEAT (default wrapping method)
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, texture_wrap_t);
     // set texture filtering parameters
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, texture_min_filter);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, texture_mag_filter);
-    // load image, create texture and generate mipmaps
-    int width, height, nrChannels;
-    //stbi_set_flip_vertically_on_load(true); // tell stb_image.h to flip loaded texture's on the y-axis.
-    unsigned char *data = stbi_load_from_memory(image_buffer, base64_size, &width, &height, &nrChannels, 0);
-    memory_free(options->memory.user_data, image_buffer);
-    if (data)
+    return texture;
+}
+
+/* uploads RGBA pixels to a new texture object with the given sampler parameters */
+unsigned int create_texture(unsigned char* pixels, int width, int height, int texture_wrap_s, int texture_wrap_t,
+                            int texture_min_filter, int texture_mag_filter)
+{
+    unsigned int texture = create_texture_object(texture_wrap_s, texture_wrap_t, texture_min_filter, texture_mag_filter);
+    if (pixels)
     {
         // note that png has transparency and thus an alpha channel, so make sure to tell OpenGL the data type is of GL_RGBA
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
         glGenerateMipmap(GL_TEXTURE_2D);
     }
     else
     {
         printf("Failed to load texture \n");
     }
-    stbi_image_free(data);
+
+    return texture;
+}
+
+/* decoded image of a texture and its sampler, ready for create_texture_from_image */
+typedef struct
+{
+    unsigned char* pixels; // RGBA, NULL when the image could not be decoded
+    int width, height;
+    int wrap_s, wrap_t;
+    int min_filter, mag_filter;
+}Texture_Image;
+
+/* base64 and png decoding only, no GL call so it can run on any thread */
+void decode_texture_image(cgltf_texture* gltf_texture, cgltf_options* options, Texture_Image* image)
+{
+    image->pixels = NULL;
+    image->width = image->height = 0;
+    cgltf_sampler* sampler = gltf_texture->sampler;
+    image->wrap_s = sampler ? sampler->wrap_s : GL_REPEAT;
+    image->wrap_t = sampler ? sampler->wrap_t : GL_REPEAT;
+    image->min_filter = sampler && sampler->min_filter ? sampler->min_filter : GL_LINEAR;
+    image->mag_filter = sampler && sampler->mag_filter ? sampler->mag_filter : GL_LINEAR;
+    if(gltf_texture->image == NULL || gltf_texture->image->uri == NULL)
+        return;
+    const char* comma = strchr(gltf_texture->image->uri, ',');
+    if(comma == NULL)
+        return;
+    unsigned char *image_buffer;
+    unsigned int base64_size = buffer_base64_size((char*)comma + 1);
+    void (*memory_free)(void*, void*) = options->memory.free_func ? options->memory.free_func : &cgltf_default_free;
+    if(cgltf_load_buffer_base64(options, base64_size, comma + 1, (void**)&image_buffer) != cgltf_result_success)
+        return;
+    int channels_count;
+    //stbi_set_flip_vertically_on_load(true); // tell stb_image.h to flip loaded texture's on the y-axis.
+    image->pixels = stbi_load_from_memory(image_buffer, base64_size, &image->width, &image->height, &channels_count, 4);
+    memory_free(options->memory.user_data, image_buffer);
+}
+
+unsigned int create_texture_from_image(Texture_Image* image)
+{
+    return create_texture(image->pixels, image->width, image->height, image->wrap_s, image->wrap_t,
+                          image->min_filter, image->mag_filter);
+}
+
+/* 4 and 8 bit images: returns the GL_R8UI index texture and sets palette_texture to the RGBA palette
+   (palette_size x palette_rows texels). 16 and 24 bit images: returns an RGBA texture and sets
+   palette_texture to 0. PlayStation textures are not filtered, the indices can not be anyway */
+unsigned int create_tim_texture(Tim_Image* image, unsigned int* palette_texture)
+{
+    *palette_texture = 0;
+    if(image->indices == NULL)
+        return create_texture(image->pixels, image->width, image->height, GL_REPEAT, GL_REPEAT, GL_NEAREST, GL_NEAREST);
+    // the rows of the index texture are not 4 bytes aligned when the width is not
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    unsigned int texture = create_texture_object(GL_REPEAT, GL_REPEAT, GL_NEAREST, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8UI, image->width, image->height, 0, GL_RED_INTEGER, GL_UNSIGNED_BYTE, image->indices);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    *palette_texture = create_texture_object(GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_NEAREST, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image->palette_size, image->palette_rows, 0, GL_RGBA, GL_UNSIGNED_BYTE, image->palette);
+    return texture;
+}
+
+void free_texture_image(Texture_Image* image)
+{
+    if(image->pixels != NULL)
+        stbi_image_free(image->pixels);
+    image->pixels = NULL;
+}
+
+typedef struct
+{
+    cgltf_texture* gltf_texture;
+    cgltf_options* options;
+    Texture_Image image;
+}Texture_Decode_Task;
+
+void decode_texture_task(void* task_data)
+{
+    Texture_Decode_Task* task = (Texture_Decode_Task*)task_data;
+    decode_texture_image(task->gltf_texture, task->options, &task->image);
+}
+
+/* decodes the image on the pool, the task must stay alive until thread_pool_wait.
+   without pool the image is decoded right away, without texture the image stays empty */
+void start_texture_decode(Texture_Decode_Task* task, cgltf_texture* gltf_texture, cgltf_options* options, Thread_Pool* pool)
+{
+    task->gltf_texture = gltf_texture;
+    task->options = options;
+    task->image.pixels = NULL;
+    task->image.width = task->image.height = 0;
+    if(gltf_texture == NULL)
+        return;
+    if(pool != NULL)
+        thread_pool_add_task(pool, decode_texture_task, task);
+    else
+        decode_texture_task(task);
+}
+
+/* streams texture images to the GPU through a pixel buffer object: the pixels are copied into the
+   mapped buffer and glTexImage2D reads them from there, so the driver can do the transfer
+   asynchronously instead of copying the client memory before returning.
+   the images differ in size, so the storage is given again with glBufferData for each one, which
+   orphans the storage a transfer may still be reading: the driver hands out new memory and the copy
+   never waits. that is all the overlap needed, a second buffer or mapping with
+   GL_MAP_INVALIDATE_BUFFER_BIT would only do the same thing again */
+typedef struct
+{
+    unsigned int buffer;
+}Texture_Upload_Buffer;
+
+void create_texture_upload_buffer(Texture_Upload_Buffer* upload)
+{
+    glGenBuffers(1, &upload->buffer);
+}
+
+void free_texture_upload_buffer(Texture_Upload_Buffer* upload)
+{
+    glDeleteBuffers(1, &upload->buffer);
+    upload->buffer = 0;
+}
+
+unsigned int upload_texture_image(Texture_Upload_Buffer* upload, Texture_Image* image)
+{
+    if(image->pixels == NULL)
+        return create_texture_from_image(image);
+    size_t size = (size_t)image->width * image->height * 4;
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload->buffer);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+    void* mapped_pixels = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT);
+    if(mapped_pixels == NULL)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return create_texture_from_image(image);
+    }
+    memcpy(mapped_pixels, image->pixels, size);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    unsigned int texture = create_texture_object(image->wrap_s, image->wrap_t, image->min_filter, image->mag_filter);
+    // with a pixel unpack buffer bound the data pointer is an offset in it
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image->width, image->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    return texture;
+}
+
+unsigned int load_texture_from_memory(cgltf_texture* gltf_texture, cgltf_options* options)
+{
+    // load image, create texture and generate mipmaps
+    Texture_Image image;
+    decode_texture_image(gltf_texture, options, &image);
+    unsigned int texture = create_texture_from_image(&image);
+    free_texture_image(&image);
 
     return texture;
 }
@@ -1006,12 +1650,32 @@ Model_Animation* load_model_animation(cgltf_animation* gltf_anim, cgltf_node* gl
         model_anim->anim_data[i]->target_node = anim_nodes[index];
     }
     Animation_Data* anim_data = model_anim->anim_data[0];
-    model_anim->duration = anim_data->time[anim_data->count-1];
+    model_anim->duration = anim_data->count > 0 ? anim_data->time[anim_data->count-1] : 0.0f;
+    model_anim->baked = NULL;
+    model_anim->packed = NULL;
     return model_anim;
 }
 
+void free_baked_animation(Baked_Animation* baked)
+{
+    if(baked->palette_texture != 0)
+        delete_textures(1, &baked->palette_texture);
+    if(baked->palette_buffer != 0)
+        glDeleteBuffers(1, &baked->palette_buffer);
+    free(baked->matrices);  baked->matrices = NULL;
+    free(baked);  baked = NULL;
+}
+
 void free_model_animation(Model_Animation* model_anim)
 {
+    if(model_anim->baked != NULL)
+    {
+        free_baked_animation(model_anim->baked);  model_anim->baked = NULL;
+    }
+    if(model_anim->packed != NULL)
+    {
+        free_packed_animation(model_anim->packed);  model_anim->packed = NULL;
+    }
     for(unsigned int i = 0; i < model_anim->anim_data_count; i++)
     {
         free_animation_data(model_anim->anim_data[i]); model_anim->anim_data[i] = NULL;
@@ -1078,8 +1742,13 @@ void get_node_children_and_parent(Animation_Node* anim_node, cgltf_node* gltf_no
     {
         index = gltf_node->parent - gltf_data->nodes;
         anim_node->parent = model->anim_nodes[index];
+        anim_node->parent_index = anim_node->parent - model->sorted_nodes;
+    }
+    else
+    {
+        anim_node->parent = NULL;
+        anim_node->parent_index = -1;
     }
-    else anim_node->parent = NULL;
     anim_node->children_count = gltf_node->children_count;
     for(int i = 0; i < gltf_node->children_count; i ++)
     {
@@ -1088,27 +1757,70 @@ void get_node_children_and_parent(Animation_Node* anim_node, cgltf_node* gltf_no
     }
 }
 
-Animation_Node* load_animation_node(cgltf_node* gltf_node, cgltf_data* gltf_data, Model_Data* model)
+/* the TRS of a gltf node, a node given by a matrix is split in translation, rotation and scale */
+void get_node_rest_trs(cgltf_node* node, glm::vec3* translation, glm::quat* rotation, glm::vec3* scale)
 {
-    Animation_Node* anim_node = (Animation_Node*)malloc(sizeof(Animation_Node));
-    unsigned int index;
-    if(gltf_node->mesh != NULL)
+    *translation = glm::vec3(0.0f);
+    *rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    *scale = glm::vec3(1.0f);
+    if(node->has_matrix)
     {
-        index = gltf_node->mesh - gltf_data->meshes;
-        anim_node->mesh = model->meshes[index];
+        glm::mat4 matrix = glm::make_mat4(node->matrix);
+        glm::mat3 rotation_matrix = glm::mat3(matrix);
+        for(int i = 0; i < 3; i++)
+        {
+            (*scale)[i] = glm::length(rotation_matrix[i]);
+            if((*scale)[i] > 0.0f)
+                rotation_matrix[i] /= (*scale)[i];
+        }
+        *translation = glm::vec3(matrix[3]);
+        *rotation = glm::normalize(glm::quat_cast(rotation_matrix));
+        return;
     }
-    else anim_node->mesh = NULL;
-    anim_node->children = (Animation_Node**)malloc(sizeof(Animation_Node*) * gltf_node->children_count);
-    anim_node->trs.trans = anim_node->trs.rot = anim_node->trs.scale = glm::mat4(1.0f);
-    anim_node->local_transform = anim_node->global_transform = glm::mat4(1.0f);
-    anim_node->trans_anim = anim_node->rot_anim = anim_node->scale_anim = NULL;
-    return anim_node;
+    if(node->has_translation)
+        *translation = glm::make_vec3(node->translation);
+    if(node->has_rotation)
+        *rotation = glm::normalize(get_glm_quat(node->rotation));
+    if(node->has_scale)
+        *scale = glm::make_vec3(node->scale);
 }
 
-void free_animation_node(Animation_Node* anim_node)
+/* the TRS matrices of update_animation_frame_trs back to the rest pose */
+void reset_node_rest_pose(Animation_Node* node)
 {
-    free(anim_node->children);  anim_node->children = NULL;
-    free(anim_node);  anim_node = NULL;
+    node->trs.trans = glm::translate(glm::mat4(1.0f), node->rest_translation);
+    node->trs.rot = glm::toMat4(node->rest_rotation);
+    node->trs.scale = glm::scale(glm::mat4(1.0f), node->rest_scale);
+}
+
+void reset_model_rest_pose(Model_Data* model)
+{
+    for(unsigned int i = 0; i < model->anim_nodes_count; i++)
+    {
+        reset_node_rest_pose(model->anim_nodes[i]);
+    }
+}
+
+void load_animation_node(Animation_Node* anim_node, cgltf_node* gltf_node, cgltf_data* gltf_data, Model_Data* model)
+{
+    unsigned int index;
+    if(gltf_node->mesh != NULL)
+    {
+        index = gltf_node->mesh - gltf_data->meshes;
+        anim_node->mesh = model->meshes[index];
+    }
+    else anim_node->mesh = NULL;
+    anim_node->children = (Animation_Node**)malloc(sizeof(Animation_Node*) * gltf_node->children_count);
+    get_node_rest_trs(gltf_node, &anim_node->rest_translation, &anim_node->rest_rotation, &anim_node->rest_scale);
+    reset_node_rest_pose(anim_node);
+    anim_node->local_transform = anim_node->global_transform = glm::mat4(1.0f);
+    anim_node->trans_anim = anim_node->rot_anim = anim_node->scale_anim = NULL;
+}
+
+/* the node itself belongs to Model_Data::sorted_nodes */
+void free_animation_node(Animation_Node* anim_node)
+{
+    free(anim_node->children);  anim_node->children = NULL;
 }
 
 void get_animation_node_trs_transform(Animation_Node* node, Animation_Data* anim_data, int index)
@@ -1155,16 +1867,224 @@ void calculate_animation_nodes_transform(Animation_Node* root_node)
     }
 }
 
+/* Same result as calculate_animation_nodes_transform on every root node, in one linear pass:
+ the sorted nodes put each parent before its children so its global transform is already done*/
+void calculate_sorted_nodes_transform(Model_Data* model)
+{
+    Animation_Node* nodes = model->sorted_nodes;
+    for(unsigned int i = 0; i < model->anim_nodes_count; i++)
+    {
+        Animation_Node* node = &nodes[i];
+        TRS_Transform* trs = &node->trs;
+        node->local_transform = trs->trans * trs->rot * trs->scale;
+        if(node->parent_index >= 0)
+            node->global_transform = nodes[node->parent_index].global_transform * node->local_transform;
+        else
+            node->global_transform = node->local_transform;
+        if(node->mesh != NULL)
+            node->mesh->bone_matrix = node->global_transform;
+    }
+}
+
+/* Linear pass for callers that already wrote the local transforms*/
+void calculate_sorted_nodes_global_transform(Model_Data* model)
+{
+    Animation_Node* nodes = model->sorted_nodes;
+    for(unsigned int i = 0; i < model->anim_nodes_count; i++)
+    {
+        Animation_Node* node = &nodes[i];
+        if(node->parent_index >= 0)
+            node->global_transform = nodes[node->parent_index].global_transform * node->local_transform;
+        else
+            node->global_transform = node->local_transform;
+        if(node->mesh != NULL)
+            node->mesh->bone_matrix = node->global_transform;
+    }
+}
+
+/* forgets the sampled poses and goes back to the start of the clip */
+void reset_animation_clock(Model_Data* model)
+{
+    model->clock.steps = 0;
+    model->clock.elapsed = 0.0;
+    model->clock.pose_steps[0] = model->clock.pose_steps[1] = -1;
+    model->clock.last_pose = 0;
+    model->clock.next_pose_end = false;
+    model->clock.drawn_alpha = -1.0f;
+    model->animation_time = 0.0f;
+}
+
+/* a new model samples its animation at the time of every frame, like before the fixed steps */
+void init_animation_clock(Model_Data* model)
+{
+    model->clock.step = 0.0;
+    model->clock.interpolate = true;
+    model->clock.translations = NULL;
+    model->clock.rotations = NULL;
+    model->clock.scales = NULL;
+    reset_animation_clock(model);
+}
+
+/* a model without skins, see load_model_skins */
+void clear_model_skins(Model_Data* model)
+{
+    model->skins = NULL;
+    model->skins_count = model->joints_count = 0;
+    model->joint_matrices = NULL;
+    model->joint_matrices_changed = false;
+    model->joint_buffer = model->joint_texture = 0;
+}
+
+/* Reads the skins of the file and moves the joints of the skinned meshes to the model joint matrices,
+ before setup_model_buffer. a mesh used by several skinned nodes follows the skin of the first one*/
+void load_model_skins(Model_Data* model, cgltf_data* gltf_data)
+{
+    clear_model_skins(model);
+    if(gltf_data->skins_count == 0)
+        return;
+    model->skins_count = gltf_data->skins_count;
+    model->skins = (Model_Skin**)malloc(sizeof(Model_Skin*) * model->skins_count);
+    for(unsigned int i = 0; i < model->skins_count; i++)
+    {
+        cgltf_skin* gltf_skin = &gltf_data->skins[i];
+        Model_Skin* skin = (Model_Skin*)malloc(sizeof(Model_Skin));
+        skin->joints_count = gltf_skin->joints_count;
+        skin->first_joint = model->joints_count;
+        skin->joint_nodes = (unsigned int*)malloc(sizeof(unsigned int) * skin->joints_count);
+        for(unsigned int j = 0; j < skin->joints_count; j++)
+            skin->joint_nodes[j] = gltf_skin->joints[j] - gltf_data->nodes;
+        if(gltf_skin->inverse_bind_matrices != NULL)
+            skin->inverse_bind_matrices = get_inverse_bind_matrices(gltf_skin);
+        else
+        {
+            // the joints are already in the space of the mesh
+            skin->inverse_bind_matrices = new glm::mat4[skin->joints_count];
+            for(unsigned int j = 0; j < skin->joints_count; j++)
+                skin->inverse_bind_matrices[j] = glm::mat4(1.0f);
+        }
+        model->joints_count += skin->joints_count;
+        model->skins[i] = skin;
+    }
+    if(model->joints_count > 65536)
+        printf("%u joints, the joint indices of the vertices are 16 bit \n", model->joints_count);
+    bool* skinned_meshes = (bool*)calloc(model->meshes_count, sizeof(bool));
+    for(unsigned int i = 0; i < gltf_data->nodes_count; i++)
+    {
+        cgltf_node* node = &gltf_data->nodes[i];
+        if(node->mesh == NULL || node->skin == NULL)
+            continue;
+        unsigned int mesh_index = node->mesh - gltf_data->meshes;
+        if(skinned_meshes[mesh_index])
+            continue;
+        skinned_meshes[mesh_index] = true;
+        offset_skin_joints(model->meshes[mesh_index], model->skins[node->skin - gltf_data->skins]->first_joint);
+    }
+    free(skinned_meshes);
+    model->joint_matrices = (glm::mat4*)malloc(sizeof(glm::mat4) * model->joints_count);
+    for(unsigned int i = 0; i < model->joints_count; i++)
+        model->joint_matrices[i] = glm::mat4(1.0f);
+    model->joint_matrices_changed = true;
+}
+
+void free_model_skins(Model_Data* model)
+{
+    for(unsigned int i = 0; i < model->skins_count; i++)
+    {
+        free(model->skins[i]->joint_nodes);
+        delete[] model->skins[i]->inverse_bind_matrices;
+        free(model->skins[i]);  model->skins[i] = NULL;
+    }
+    free(model->skins);  model->skins = NULL;
+    free(model->joint_matrices);  model->joint_matrices = NULL;
+    if(model->joint_buffer != 0)
+    {
+        glDeleteBuffers(1, &model->joint_buffer);
+        delete_textures(1, &model->joint_texture);
+    }
+    model->skins_count = model->joints_count = 0;
+}
+
+/* joint global transform * inverse bind matrix of every joint, after the global transforms of the nodes.
+ the skinned vertices are placed by their joints only, the transform of the mesh node is not used*/
+void update_model_skins(Model_Data* model)
+{
+    for(unsigned int i = 0; i < model->skins_count; i++)
+    {
+        Model_Skin* skin = model->skins[i];
+        glm::mat4* joint_matrices = model->joint_matrices + skin->first_joint;
+        for(unsigned int j = 0; j < skin->joints_count; j++)
+            joint_matrices[j] = model->anim_nodes[skin->joint_nodes[j]]->global_transform * skin->inverse_bind_matrices[j];
+    }
+    if(model->skins_count > 0)
+        model->joint_matrices_changed = true;
+}
+
+/* Fills sorted_order with the node indices sorted by depth in the hierarchy, parents first.
+ parent_indices uses -1 for root nodes. returns false for a cyclic hierarchy, which has no depth order:
+ a chain of parents longer than the nodes goes through one of them twice*/
+bool sort_nodes_by_depth(int* parent_indices, unsigned int nodes_count, unsigned int* sorted_order)
+{
+    unsigned int* depths = (unsigned int*)malloc(sizeof(unsigned int) * nodes_count);
+    unsigned int max_depth = 0;
+    for(unsigned int i = 0; i < nodes_count; i++)
+    {
+        unsigned int depth = 0;
+        for(int parent = parent_indices[i]; parent >= 0; parent = parent_indices[parent])
+        {
+            if(++depth >= nodes_count)
+            {
+                printf("node %u: cyclic node hierarchy \n", i);
+                free(depths);
+                return false;
+            }
+        }
+        depths[i] = depth;
+        if(depth > max_depth)
+            max_depth = depth;
+    }
+    unsigned int sorted_count = 0;
+    for(unsigned int depth = 0; depth <= max_depth; depth++)
+    {
+        for(unsigned int i = 0; i < nodes_count; i++)
+        {
+            if(depths[i] == depth)
+                sorted_order[sorted_count++] = i;
+        }
+    }
+    free(depths);
+    return true;
+}
+
+/* Allocates the nodes of the model in one block in depth order and points anim_nodes at them,
+ anim_nodes keeps the file order so node indices from gltf or the cache stay valid.
+ returns false without allocating anything when the hierarchy is cyclic*/
+bool allocate_sorted_nodes(Model_Data* model, int* parent_indices, unsigned int nodes_count)
+{
+    unsigned int* sorted_order = (unsigned int*)malloc(sizeof(unsigned int) * nodes_count);
+    if(!sort_nodes_by_depth(parent_indices, nodes_count, sorted_order))
+    {
+        free(sorted_order);
+        return false;
+    }
+    model->anim_nodes_count = nodes_count;
+    model->anim_nodes = (Animation_Node**)malloc(sizeof(Animation_Node*) * nodes_count);
+    model->sorted_nodes = (Animation_Node*)malloc(sizeof(Animation_Node) * nodes_count);
+    for(unsigned int i = 0; i < nodes_count; i++)
+    {
+        model->anim_nodes[sorted_order[i]] = &model->sorted_nodes[i];
+    }
+    free(sorted_order);
+    return true;
+}
+
 void load_animation_frame(Model_Data* model, Model_Animation* animation, int frame_index)
 {
     for(int i = 0; i < animation->anim_data_count; i++)
     {
         get_animation_node_trs_transform(animation->anim_data[i]->target_node, animation->anim_data[i], frame_index);
     }
-    for(int i = 0; i < model->root_nodes_count; i++)
-    {
-        calculate_animation_nodes_transform(model->root_nodes[i]);
-    }
+    calculate_sorted_nodes_transform(model);
+    update_model_skins(model);
 }
 
 Animation_Node** get_root_nodes(Model_Data* model, cgltf_data* gltf_data)
@@ -1180,22 +2100,103 @@ Animation_Node** get_root_nodes(Model_Data* model, cgltf_data* gltf_data)
     return root_nodes;
 }
 
-Model_Data* load_model(cgltf_data* gltf_data, cgltf_options* options)
+/* the arrays of a model loaded from a .gvc cache point into the mapped file, unhook them before freeing */
+void detach_model_cache_arrays(Model_Data* model)
 {
-    unsigned int meshes_count = gltf_data->meshes_count;
+    for(unsigned int i = 0; i < model->meshes_count; i++)
+    {
+        model->meshes[i]->vertices = NULL;
+        model->meshes[i]->texcoord = NULL;
+        model->meshes[i]->indices = NULL;
+    }
+    for(unsigned int i = 0; i < model->animations_count; i++)
+    {
+        for(unsigned int j = 0; j < model->animations[i]->anim_data_count; j++)
+        {
+            model->animations[i]->anim_data[j]->time = NULL;
+            model->animations[i]->anim_data[j]->trs = NULL;
+        }
+    }
+}
+
+/* load_flags of load_model and load_gltf_model_parallel */
+#define MODEL_LOAD_OPTIMIZE_MESHES 1 // reorder the meshes for the vertex cache before uploading them (see optimize_mesh)
+#define MODEL_LOAD_NO_TEXTURE 2      // skip the embedded image, the texture is left to the caller
+#define MODEL_LOAD_TIM_TEXTURE 4     // load_gltf_model_parallel only: texture from the .TIM file next to the gltf file
+#define MODEL_LOAD_NO_GPU 8          // no GL call: the meshes keep their arrays and the texture stays in image_pixels
+
+/* the welding, optimize_mesh and the vertex remap index the vertex arrays without bounds checks, an index
+   past the vertices of the first primitive (the one load_mesh_data reads) fails the load */
+bool validate_mesh_indices(cgltf_data* gltf_data)
+{
+    for(unsigned int i = 0; i < gltf_data->meshes_count; i++)
+    {
+        cgltf_primitive* primitive = &gltf_data->meshes[i].primitives[0];
+        cgltf_accessor* positions = get_position_accessor(primitive);
+        if(primitive->indices == NULL || positions == NULL)
+            continue;
+        for(cgltf_size j = 0; j < primitive->indices->count; j++)
+        {
+            cgltf_size index = cgltf_accessor_read_index(primitive->indices, j);
+            if(index >= positions->count)
+            {
+                printf("mesh %u: index %u out of %u vertices \n", i, (unsigned int)index, (unsigned int)positions->count);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/* pool is optional, when given the texture is decoded on it while the meshes and nodes are loaded.
+   returns NULL when a mesh has invalid indices or the node hierarchy is cyclic, parse_gltf_file already
+   rejects both with cgltf_validate but gltf_data may come from elsewhere */
+Model_Data* load_model(cgltf_data* gltf_data, cgltf_options* options, Thread_Pool* pool, unsigned int load_flags)
+{
+    if(!validate_mesh_indices(gltf_data))
+        return NULL;
     Model_Data* model = (Model_Data*)malloc(sizeof(Model_Data));
+    // the node block first, a cyclic hierarchy fails before anything else is loaded
+    int* parent_indices = (int*)malloc(sizeof(int) * gltf_data->nodes_count);
+    for(unsigned int i = 0; i < gltf_data->nodes_count; i++)
+    {
+        cgltf_node* parent = gltf_data->nodes[i].parent;
+        parent_indices[i] = parent != NULL ? parent - gltf_data->nodes : -1;
+    }
+    bool nodes_sorted = allocate_sorted_nodes(model, parent_indices, gltf_data->nodes_count);
+    free(parent_indices);
+    if(!nodes_sorted)
+    {
+        free(model);
+        return NULL;
+    }
+    Texture_Decode_Task texture_task;
+    cgltf_texture* gltf_texture = gltf_data->textures_count > 0 ? &gltf_data->textures[0] : NULL;
+    if(load_flags & MODEL_LOAD_NO_TEXTURE)
+        gltf_texture = NULL;
+    start_texture_decode(&texture_task, gltf_texture, options, pool);
+    unsigned int meshes_count = gltf_data->meshes_count;
     model->meshes = (Mesh_Data**)malloc(sizeof(Mesh_Data*) * meshes_count);
     model->meshes_count = meshes_count;
+    Mesh_Optimization_Stats stats = {0, 0, 0};
     for(unsigned int i = 0; i < meshes_count; i++)
     {
-        model->meshes[i] = load_mesh(&gltf_data->meshes[i]);
+        model->meshes[i] = load_mesh_data(&gltf_data->meshes[i]);
+        if(load_flags & MODEL_LOAD_OPTIMIZE_MESHES)
+            optimize_mesh(model->meshes[i], &stats);
+    }
+    print_mesh_optimization_stats(&stats);
+    load_model_skins(model, gltf_data);
+    if(load_flags & MODEL_LOAD_NO_GPU)
+    {
+        set_model_buffer_ranges(model);
+        model->VAO = model->VBO = model->EBO = model->skin_VBO = 0;
     }
-    model->texture = load_texture_from_memory(&gltf_data->textures[0], options);
-    model->anim_nodes_count = gltf_data->nodes_count;
-    model->anim_nodes = (Animation_Node**)malloc(sizeof(Animation_Node*) * gltf_data->nodes_count);
+    else
+        setup_model_buffer(model);
     for(unsigned int i = 0; i < gltf_data->nodes_count; i++)
     {
-        model->anim_nodes[i] = load_animation_node(&gltf_data->nodes[i], gltf_data, model);
+        load_animation_node(model->anim_nodes[i], &gltf_data->nodes[i], gltf_data, model);
     }
     for(unsigned int i = 0; i < gltf_data->nodes_count; i++)
     {
@@ -1209,83 +2210,395 @@ Model_Data* load_model(cgltf_data* gltf_data, cgltf_options* options)
     {
         model->animations[i] = load_model_animation(&gltf_data->animations[i], gltf_data->nodes, model->anim_nodes);
     }
-    model->curren_animation = model->animations[0];
-    load_animation_data(model->curren_animation);
-    model->animation_time = 0.0;
+    model->curren_animation = NULL;
+    if(model->animations_count > 0)
+    {
+        model->curren_animation = model->animations[0];
+        load_animation_data(model->curren_animation);
+    }
+    init_animation_clock(model);
+    model->pose = NULL;
+    model->cache_file = NULL;
+    if(pool != NULL)
+        thread_pool_wait(pool);
+    model->texture = 0;
+    model->image_pixels = NULL;
+    model->image_width = model->image_height = 0;
+    if(load_flags & MODEL_LOAD_NO_GPU)
+    {
+        // the decoded image is kept for the software rasterizer
+        model->image_pixels = texture_task.image.pixels;
+        model->image_width = texture_task.image.width;
+        model->image_height = texture_task.image.height;
+        texture_task.image.pixels = NULL;
+    }
+    else if(!(load_flags & MODEL_LOAD_NO_TEXTURE))
+        model->texture = create_texture_from_image(&texture_task.image);
+    model->palette_texture = 0;
+    model->palette_row = 0;
+    model->texture_array_image = -1;
+    model->node_matrices = NULL;
+    free_texture_image(&texture_task.image);
     return model;
 }
 
 void free_model(Model_Data* model)
 {
+    if(model->cache_file != NULL)
+        detach_model_cache_arrays(model);
     for(unsigned int i = 0; i < model->meshes_count; i++)
     {
         free_mesh(model->meshes[i]); model->meshes[i] = NULL;
     }
     free(model->meshes);  model->meshes = NULL;
-    glDeleteTextures(1, &model->texture);
+    if(model->VAO != 0)
+    {
+        free_model_buffer(model);
+        delete_textures(1, &model->texture);
+        delete_textures(1, &model->palette_texture);
+    }
+    free(model->image_pixels);  model->image_pixels = NULL; // stb_image allocates with malloc
     for(unsigned int i = 0; i < model->anim_nodes_count; i++)
     {
         free_animation_node(model->anim_nodes[i]); model->anim_nodes[i] = NULL;
     }
     free(model->anim_nodes);  model->anim_nodes = NULL;
+    free(model->sorted_nodes);  model->sorted_nodes = NULL;
     free(model->root_nodes);  model->root_nodes = NULL;
     for(unsigned int i = 0; i < model->animations_count; i++)
     {
         free_model_animation(model->animations[i]); model->animations[i] = NULL;
     }
     free(model->animations);  model->animations = NULL;
+    free_model_skins(model);
+    free(model->clock.translations);  model->clock.translations = NULL;
+    free(model->clock.rotations);  model->clock.rotations = NULL;
+    free(model->clock.scales);  model->clock.scales = NULL;
+    if(model->pose != NULL)
+    {
+        free_animation_pose(model->pose);  model->pose = NULL;
+    }
+    if(model->cache_file != NULL)
+    {
+        unmap_file(model->cache_file);  model->cache_file = NULL;
+    }
     free(model);  model = NULL;
 }
 
-Model_Data* load_gltf_model(char* model_file)
+const char* get_base64_uri_data(const char* uri)
 {
-    cgltf_options options;
-	memset(&options, 0, sizeof(cgltf_options));
+    if(uri == NULL || strncmp(uri, "data:", 5) != 0)
+        return NULL;
+    const char* comma = strchr(uri, ',');
+    if (comma && comma - uri >= 7 && strncmp(comma - 7, ";base64", 7) == 0)
+        return comma + 1;
+    return NULL;
+}
+
+typedef struct
+{
+    cgltf_options* options;
+    cgltf_buffer* buffers;
+    unsigned int buffers_count;
+    cgltf_result result;
+}Buffers_Decode_Task;
+
+void decode_buffers_task(void* task_data)
+{
+    Buffers_Decode_Task* task = (Buffers_Decode_Task*)task_data;
+    cgltf_options* options = task->options;
+    void* (*memory_alloc)(void*, cgltf_size) = options->memory.alloc_func ? options->memory.alloc_func : &cgltf_default_alloc;
+    void (*memory_free)(void*, void*) = options->memory.free_func ? options->memory.free_func : &cgltf_default_free;
+    task->result = cgltf_result_success;
+    for(unsigned int i = 0; i < task->buffers_count; i++)
+    {
+        cgltf_buffer* buffer = &task->buffers[i];
+        const char* base64 = get_base64_uri_data(buffer->uri);
+        if(buffer->data != NULL || base64 == NULL)
+            continue;
+        // the vector decoder reads whole blocks, make sure the string really holds size bytes
+        if(strlen(base64) < (buffer->size * 4 + 2) / 3)
+        {
+            task->result = cgltf_result_data_too_short;
+            return;
+        }
+        unsigned char* data = (unsigned char*)memory_alloc(options->memory.user_data, buffer->size);
+        if(data == NULL)
+        {
+            task->result = cgltf_result_out_of_memory;
+            return;
+        }
+        if(!base64_decode(base64, buffer->size, data))
+        {
+            memory_free(options->memory.user_data, data);
+            task->result = cgltf_result_io_error;
+            return;
+        }
+        buffer->data = data;
+        buffer->data_free_method = cgltf_data_free_method_memory_free;
+    }
+}
+
+/* decodes every base64 buffer of gltf_data on the thread pool, the decoded data is left in
+   cgltf_buffer::data so cgltf_load_buffers skips them and cgltf_free releases them */
+cgltf_result load_buffers_parallel(cgltf_options* options, cgltf_data* gltf_data, Thread_Pool* pool)
+{
+    cgltf_size total_size = 0;
+    for(cgltf_size i = 0; i < gltf_data->buffers_count; i++)
+    {
+        if(get_base64_uri_data(gltf_data->buffers[i].uri) != NULL)
+            total_size += gltf_data->buffers[i].size;
+    }
+    if(total_size == 0)
+        return cgltf_result_success;
+
+    // models like Omnimon have thousands of tiny buffers, group them into a few tasks per thread
+    cgltf_size task_size = total_size / (thread_pool_threads_count(pool) * 4) + 1;
+    if(task_size < 64 * 1024)
+        task_size = 64 * 1024;
+    Buffers_Decode_Task* tasks = (Buffers_Decode_Task*)malloc(sizeof(Buffers_Decode_Task) * gltf_data->buffers_count);
+    unsigned int tasks_count = 0;
+    cgltf_size size = 0;
+    for(cgltf_size i = 0; i < gltf_data->buffers_count; i++)
+    {
+        if(size == 0)
+        {
+            tasks[tasks_count].options = options;
+            tasks[tasks_count].buffers = &gltf_data->buffers[i];
+            tasks[tasks_count].buffers_count = 0;
+            tasks_count++;
+        }
+        tasks[tasks_count-1].buffers_count++;
+        size += gltf_data->buffers[i].size;
+        if(size >= task_size)
+            size = 0;
+    }
+    for(unsigned int i = 0; i < tasks_count; i++)
+    {
+        thread_pool_add_task(pool, decode_buffers_task, &tasks[i]);
+    }
+    thread_pool_wait(pool);
+
+    cgltf_result result = cgltf_result_success;
+    for(unsigned int i = 0; i < tasks_count; i++)
+    {
+        if(tasks[i].result != cgltf_result_success)
+            result = tasks[i].result;
+    }
+    free(tasks);
+    return result;
+}
+
+/* parses the gltf file and loads its buffers, returns NULL on failure.
+   pool = NULL decodes the buffers serially with cgltf_load_buffers */
+cgltf_data* parse_gltf_file(char* model_file, cgltf_options* options, Thread_Pool* pool)
+{
+	memset(options, 0, sizeof(cgltf_options));
 	cgltf_data* gltf_data = NULL;
-	cgltf_result result = cgltf_parse_file(&options, model_file, &gltf_data);
+	cgltf_result result = cgltf_parse_file(options, model_file, &gltf_data);
 
     if (result == cgltf_result_success)
-		result = cgltf_load_buffers(&options, gltf_data, model_file);
+    {
+        if(pool != NULL)
+            result = load_buffers_parallel(options, gltf_data, pool);
+        if(result == cgltf_result_success)
+            result = cgltf_load_buffers(options, gltf_data, model_file);
+    }
     else
         printf("could not parse gltf file: %s \n", model_file);
 
 	if (result == cgltf_result_success)
+	{
 		result = cgltf_validate(gltf_data);
+		// out of range indices and accessors past their buffers end here
+		if(result != cgltf_result_success)
+			printf("invalid gltf file (cgltf_validate error %d): %s \n", (int)result, model_file);
+	}
     else
          printf("could not load buffers ! \n");
 
+    if(result != cgltf_result_success)
+    {
+        cgltf_free(gltf_data);
+        return NULL;
+    }
+    return gltf_data;
+}
+
+/* load_flags: MODEL_LOAD_* flags, with MODEL_LOAD_TIM_TEXTURE the embedded image is only decoded
+   when the .TIM file is missing or invalid */
+Model_Data* load_gltf_model_parallel(char* model_file, Thread_Pool* pool, unsigned int load_flags)
+{
+    Tim_Image* tim_image = NULL;
+    if(load_flags & MODEL_LOAD_TIM_TEXTURE)
+    {
+        char tim_file[260];
+        get_tim_file_name(model_file, tim_file, sizeof(tim_file));
+        tim_image = load_tim_file(tim_file);
+        if(tim_image != NULL)
+            load_flags |= MODEL_LOAD_NO_TEXTURE;
+        else
+            printf("no TIM texture for %s, using the embedded image \n", model_file);
+    }
+
+    cgltf_options options;
+	cgltf_data* gltf_data = parse_gltf_file(model_file, &options, pool);
+
     Model_Data* model = NULL;
 
-    if(result == cgltf_result_success)
-        model = load_model(gltf_data, &options);
+    if(gltf_data != NULL)
+        model = load_model(gltf_data, &options, pool, load_flags);
 
     cgltf_free(gltf_data);
 
+    if(tim_image != NULL)
+    {
+        if(model != NULL)
+        {
+            print_tim_image(tim_image);
+            if(load_flags & MODEL_LOAD_NO_GPU)
+            {
+                model->image_pixels = expand_tim_image(tim_image, model->palette_row);
+                model->image_width = tim_image->width;
+                model->image_height = tim_image->height;
+            }
+            else
+                model->texture = create_tim_texture(tim_image, &model->palette_texture);
+        }
+        free_tim_image(tim_image);
+    }
+
     return model;
 }
 
+Model_Data* load_gltf_model(char* model_file)
+{
+    return load_gltf_model_parallel(model_file, NULL, 0);
+}
+
+/* binds the texture on unit 0 and the palette of an indexed texture on unit 2 with its row,
+   the samplers of shaders/model_indexed.fs. a model packed in a Texture_Array only sets the uniforms
+   of shaders/model_array.fs, the array is bound once by bind_texture_array */
+void bind_model_texture(Model_Data* model, unsigned int shader_id)
+{
+    if(model->texture_array_image >= 0)
+    {
+        glUniform4fv(get_uniform_location(shader_id, UNIFORM_TEXTURE_RECT), 1, &model->texture_rect[0]);
+        glUniform1i(get_uniform_location(shader_id, UNIFORM_TEXTURE_LAYER), model->texture_layer);
+        glUniform2iv(get_uniform_location(shader_id, UNIFORM_TEXTURE_WRAP), 1, &model->texture_wrap[0]);
+        return;
+    }
+    if(model->palette_texture != 0)
+    {
+        bind_texture(2, GL_TEXTURE_2D, model->palette_texture);
+        glUniform1i(get_uniform_location(shader_id, UNIFORM_PALETTE_ROW), model->palette_row);
+    }
+    bind_texture(0, GL_TEXTURE_2D, model->texture);
+}
+
 void draw_model(Model_Data* model, unsigned int shader_id)
 {
     Mesh_Data* mesh;
-    unsigned int bone_matrix_location = glGetUniformLocation(shader_id, "bone_matrix");
+    int bone_matrix_location = get_uniform_location(shader_id, UNIFORM_BONE_MATRIX);
     // bind textures on corresponding texture units
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, model->texture);
+    bind_model_texture(model, shader_id);
     // render model
     for (unsigned int i = 0; i < model->meshes_count; i++)
     {
         mesh = model->meshes[i];
         glUniformMatrix4fv(bone_matrix_location, 1, GL_FALSE, &mesh->bone_matrix[0][0]);
-        glBindVertexArray(mesh->VAO);
-        glDrawArrays(GL_TRIANGLES, 0, mesh->vertices_count);
+        draw_mesh(mesh);
+    }
+    // the vertex array stays bound, the next draw only rebinds it when it is another one
+}
+
+#define MODEL_MAX_BONES 64 // size of node_matrices in model_merged.vs
+
+/* writes the bone matrix of every mesh in the frame region of the buffer, once per frame before
+   draw_model_merged. returns false when the region is full, the model is not drawn then */
+bool write_model_node_matrices(Node_Matrix_Buffer* buffer, Model_Data* model)
+{
+    glm::mat4 bone_matrices[MODEL_MAX_BONES];
+    long offset = -1;
+    // every MODEL_MAX_BONES meshes start on a multiple of the alignment, see draw_model_merged
+    for(unsigned int start = 0; start < model->meshes_count; start += MODEL_MAX_BONES)
+    {
+        unsigned int count = std::min(model->meshes_count - start, (unsigned int)MODEL_MAX_BONES);
+        for(unsigned int i = 0; i < count; i++)
+            bone_matrices[i] = model->meshes[start + i]->bone_matrix;
+        long chunk_offset = write_node_matrices(buffer, bone_matrices, count);
+        if(chunk_offset < 0)
+        {
+            model->node_matrices = NULL;
+            return false;
+        }
+        if(start == 0)
+            offset = chunk_offset;
+    }
+    model->node_matrices = buffer;
+    model->node_matrices_offset = offset;
+    return true;
+}
+
+/* uploads the joint matrices when they changed and binds them on texture unit 1 for model_skinned.vs */
+void bind_model_joint_palette(Model_Data* model, unsigned int shader_id)
+{
+    if(model->joints_count == 0)
+        return;
+    if(model->joint_buffer == 0)
+    {
+        glGenBuffers(1, &model->joint_buffer);
+        glGenTextures(1, &model->joint_texture);
+        glBindBuffer(GL_TEXTURE_BUFFER, model->joint_buffer);
+        glBufferData(GL_TEXTURE_BUFFER, sizeof(glm::mat4) * model->joints_count, NULL, GL_STREAM_DRAW);
+        bind_texture(1, GL_TEXTURE_BUFFER, model->joint_texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, model->joint_buffer);
+    }
+    if(model->joint_matrices_changed)
+    {
+        Profile_Scope scope(PROFILE_UPLOAD);
+        // orphan the buffer so the driver does not wait for the draws of the last frame
+        glBindBuffer(GL_TEXTURE_BUFFER, model->joint_buffer);
+        glBufferData(GL_TEXTURE_BUFFER, sizeof(glm::mat4) * model->joints_count, NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, sizeof(glm::mat4) * model->joints_count, model->joint_matrices);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        model->joint_matrices_changed = false;
+    }
+    glUniform1i(get_uniform_location(shader_id, UNIFORM_JOINT_PALETTE), 1);
+    bind_texture(1, GL_TEXTURE_BUFFER, model->joint_texture);
+}
+
+/* draws the whole model with one draw call, the shader must be model_merged.vs
+   (model_skinned.vs for models with skins).
+   the vertices index the matrices written by write_model_node_matrices, models with more than
+   MODEL_MAX_BONES meshes are drawn in one call per MODEL_MAX_BONES meshes */
+void draw_model_merged(Model_Data* model, unsigned int shader_id)
+{
+    if(model->node_matrices == NULL)
+        return;
+    bind_model_joint_palette(model, shader_id);
+    bind_model_texture(model, shader_id);
+    bind_vertex_array(model->VAO);
+    int node_base_location = get_uniform_location(shader_id, UNIFORM_NODE_BASE);
+    unsigned int index_size = get_index_size(model->index_type);
+    long offset = model->node_matrices_offset;
+    for(unsigned int start = 0; start < model->meshes_count; start += MODEL_MAX_BONES)
+    {
+        unsigned int end = std::min(model->meshes_count, start + MODEL_MAX_BONES);
+        Mesh_Data* first_mesh = model->meshes[start];
+        Mesh_Data* last_mesh = model->meshes[end - 1];
+        unsigned int indices_count = last_mesh->base_index + last_mesh->indices_count - first_mesh->base_index;
+        bind_node_matrices(model->node_matrices, offset);
+        glUniform1i(node_base_location, start);
+        glDrawElements(GL_TRIANGLES, indices_count, model->index_type, (void*)((size_t)first_mesh->base_index * index_size));
+        offset += align_node_matrix_offset((end - start) * sizeof(glm::mat4), model->node_matrices->alignment);
     }
-    // always good practice to set everything back to defaults once configured.
-    //glActiveTexture(GL_TEXTURE0);
-    glBindVertexArray(0);
 }
 
 void interpolate_node_animation(Animation_Node* node, Animation_Data* anim_data, float currrent_time)
 {
+    if(anim_data->count == 0) // some exported clips have empty tracks
+        return;
     switch(anim_data->type)
     {
         case cgltf_animation_path_type_translation:
@@ -1302,18 +2615,20 @@ void interpolate_node_animation(Animation_Node* node, Animation_Data* anim_data,
 
 void step_interpolate_node_animation(Animation_Node* node, Animation_Data* anim_data, float currrent_time)
 {
+    if(anim_data->count == 0)
+        return;
     switch(anim_data->type)
     {
         case cgltf_animation_path_type_translation:
         {
-            int index = get_animation_frame_index(currrent_time, anim_data->time, anim_data->count);
+            int index = find_animation_frame_index(anim_data, currrent_time);
             glm::vec3* positions = (glm::vec3*)anim_data->trs;
             node->trs.trans =  glm::translate(glm::mat4(1.0f), positions[index]);
             break;
         }
         case cgltf_animation_path_type_rotation:
         {
-            int index = get_animation_frame_index(currrent_time, anim_data->time, anim_data->count);
+            int index = find_animation_frame_index(anim_data, currrent_time);
             glm::quat quat_rotation = get_glm_quat(anim_data->trs+index*4);
             quat_rotation = glm::normalize(quat_rotation);
             node->trs.rot = glm::toMat4(quat_rotation);;
@@ -1321,7 +2636,7 @@ void step_interpolate_node_animation(Animation_Node* node, Animation_Data* anim_
         }
         case cgltf_animation_path_type_scale:
         {
-            int index = get_animation_frame_index(currrent_time, anim_data->time, anim_data->count);
+            int index = find_animation_frame_index(anim_data, currrent_time);
             glm::vec3* scales = (glm::vec3*)anim_data->trs;
             node->trs.scale = glm::scale(glm::mat4(1.0f), scales[index]);
             break;
@@ -1329,16 +2644,53 @@ void step_interpolate_node_animation(Animation_Node* node, Animation_Data* anim_
     }
 }
 
+/* hands a pose to the model nodes so draw_model renders it */
+void apply_animation_pose(Model_Data* model, Animation_Pose* pose)
+{
+    for(unsigned int i = 0; i < model->anim_nodes_count; i++)
+    {
+        model->anim_nodes[i]->local_transform = pose->local_transforms[i];
+    }
+    calculate_sorted_nodes_global_transform(model);
+    update_model_skins(model);
+}
+
+void prepare_packed_animation(Model_Data* model, Model_Animation* animation)
+{
+    if(animation->packed == NULL)
+        animation->packed = pack_model_animation(model, animation);
+    if(model->pose == NULL)
+        model->pose = create_animation_pose(model->anim_nodes_count);
+}
+
+/* samples the animation with the packed engine (see animation_engine.h), the animation is packed
+ and the pose of the model created on the first call */
 void update_animation_frame(Model_Data* model, Model_Animation* animation, float currrent_time)
 {
-    for(int i = 0; i < animation->anim_data_count; i++)
+    prepare_packed_animation(model, animation);
     {
-        interpolate_node_animation(animation->anim_data[i]->target_node, animation->anim_data[i], currrent_time);
+        Profile_Scope scope(PROFILE_ANIMATION);
+        evaluate_packed_animation(animation->packed, currrent_time, model->pose);
     }
-    for(int i = 0; i < model->root_nodes_count; i++)
+    Profile_Scope scope(PROFILE_TRANSFORMS);
+    apply_animation_pose(model, model->pose);
+}
+
+/* update_animation_frame with a TRS matrix per node and glm::slerp, the reference of the packed
+ engine in main_animation_engine_benchmark.cpp. nodes the animation does not drive keep their TRS,
+ change_model_animation puts them back to the rest pose*/
+void update_animation_frame_trs(Model_Data* model, Model_Animation* animation, float currrent_time)
+{
     {
-        calculate_animation_nodes_transform(model->root_nodes[i]);
+        Profile_Scope scope(PROFILE_ANIMATION);
+        for(unsigned int i = 0; i < animation->anim_data_count; i++)
+        {
+            interpolate_node_animation(animation->anim_data[i]->target_node, animation->anim_data[i], currrent_time);
+        }
     }
+    Profile_Scope scope(PROFILE_TRANSFORMS);
+    calculate_sorted_nodes_transform(model);
+    update_model_skins(model);
 }
 
 void update_animation_frame_2(Model_Data* model, float currrent_time)
@@ -1347,7 +2699,7 @@ void update_animation_frame_2(Model_Data* model, float currrent_time)
     TRS_Transform* trs;
     for(int i = 0; i < model->anim_nodes_count; i++)
     {
-        anim_node = model->anim_nodes[i];
+        anim_node = &model->sorted_nodes[i]; // parents first
         trs = &anim_node->trs;
         if(anim_node->trans_anim)
             trs->trans =  anim_node->trans_anim->interpolate_animation(anim_node->trans_anim, currrent_time);
@@ -1365,14 +2717,345 @@ void update_animation_frame_2(Model_Data* model, float currrent_time)
     }
 }
 
-void update_skeletal_animation(Model_Data* model, float delta_time)
+/* Samples the animation every 1 / frame_rate seconds, the last frame is taken at the end of the animation*/
+Baked_Animation* bake_model_animation(Model_Data* model, Model_Animation* animation, float frame_rate, int interpolate)
 {
-    model->animation_time += (delta_time / 1000);
-    model->animation_time = fmod(model->animation_time, model->curren_animation->duration);
+    Baked_Animation* baked = (Baked_Animation*)malloc(sizeof(Baked_Animation));
+    baked->frame_rate = frame_rate;
+    baked->duration = animation->duration;
+    baked->frames_count = (unsigned int)ceilf(animation->duration * frame_rate) + 1;
+    baked->nodes_count = model->anim_nodes_count;
+    baked->joints_count = model->joints_count;
+    baked->frame_matrices_count = baked->nodes_count + baked->joints_count;
+    baked->matrices = (glm::mat4*)malloc(sizeof(glm::mat4) * baked->frames_count * baked->frame_matrices_count);
+    baked->interpolate = interpolate;
+    baked->palette_buffer = baked->palette_texture = 0;
+    // nodes the animation does not drive stay in their rest pose
+    for(unsigned int frame = 0; frame < baked->frames_count; frame++)
+    {
+        float frame_time = std::min(frame / frame_rate, animation->duration);
+        update_animation_frame(model, animation, frame_time);
+        glm::mat4* frame_matrices = baked->matrices + frame * baked->frame_matrices_count;
+        for(unsigned int i = 0; i < model->anim_nodes_count; i++)
+        {
+            frame_matrices[i] = model->anim_nodes[i]->global_transform;
+        }
+        for(unsigned int i = 0; i < model->joints_count; i++)
+        {
+            frame_matrices[baked->nodes_count + i] = model->joint_matrices[i];
+        }
+    }
+    return baked;
+}
+
+void bake_model_animations(Model_Data* model, float frame_rate, int interpolate)
+{
+    for(unsigned int i = 0; i < model->animations_count; i++)
+    {
+        if(model->animations[i]->baked != NULL)
+            free_baked_animation(model->animations[i]->baked);
+        model->animations[i]->baked = bake_model_animation(model, model->animations[i], frame_rate, interpolate);
+    }
+    model->animation_time = 0.0f;
+}
+
+/* Moves the baked matrices into a texture buffer, the vertex shader then reads them from
+ bone_palette (see model_baked.vs) and update_baked_animation no longer touches the meshes*/
+void upload_baked_animation(Baked_Animation* baked)
+{
+    glGenBuffers(1, &baked->palette_buffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, baked->palette_buffer);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(glm::mat4) * baked->frames_count * baked->frame_matrices_count, baked->matrices, GL_STATIC_DRAW);
+    glGenTextures(1, &baked->palette_texture);
+    bind_texture(0, GL_TEXTURE_BUFFER, baked->palette_texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, baked->palette_buffer);
+    bind_texture(0, GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void upload_baked_animations(Model_Data* model)
+{
+    for(unsigned int i = 0; i < model->animations_count; i++)
+    {
+        if(model->animations[i]->baked != NULL && model->animations[i]->baked->palette_texture == 0)
+            upload_baked_animation(model->animations[i]->baked);
+    }
+}
+
+/* Gets the two baked frames around animation_time and the lerp factor between them*/
+void get_baked_frames(Baked_Animation* baked, float animation_time, unsigned int* frame_1, unsigned int* frame_2, float* factor)
+{
+    float frame_position = animation_time * baked->frame_rate;
+    unsigned int last_frame = baked->frames_count - 1;
+    unsigned int frame = frame_position > 0.0f ? (unsigned int)frame_position : 0;
+    if(frame >= last_frame)
+    {
+        *frame_1 = *frame_2 = last_frame;
+        *factor = 0.0f;
+        return;
+    }
+    *frame_1 = frame;
+    *frame_2 = frame + 1;
+    // the last frame can be closer than 1 / frame_rate, it is taken at the end of the animation
+    float frame_time_1 = frame / baked->frame_rate;
+    float frame_time_2 = std::min((frame + 1) / baked->frame_rate, baked->duration);
+    *factor = get_scale_factor(frame_time_1, frame_time_2, animation_time);
+    if(!baked->interpolate)
+    {
+        if(*factor >= 0.5f)
+            *frame_1 = *frame_2;
+        *factor = 0.0f;
+    }
+}
+
+void update_baked_animation(Model_Data* model, Baked_Animation* baked, float animation_time)
+{
+    if(baked->palette_texture != 0) // the vertex shader does the lookup
+        return;
+    Profile_Scope scope(PROFILE_ANIMATION);
+    unsigned int frame_1, frame_2;
+    float factor;
+    get_baked_frames(baked, animation_time, &frame_1, &frame_2, &factor);
+    glm::mat4* matrices_1 = baked->matrices + frame_1 * baked->frame_matrices_count;
+    glm::mat4* matrices_2 = baked->matrices + frame_2 * baked->frame_matrices_count;
+    for(unsigned int i = 0; i < model->anim_nodes_count; i++)
+    {
+        Animation_Node* node = model->anim_nodes[i];
+        if(node->mesh == NULL)
+            continue;
+        if(factor > 0.0f)
+            node->mesh->bone_matrix = matrices_1[i] + (matrices_2[i] - matrices_1[i]) * factor;
+        else
+            node->mesh->bone_matrix = matrices_1[i];
+    }
+    for(unsigned int i = baked->nodes_count; i < baked->frame_matrices_count; i++)
+    {
+        if(factor > 0.0f)
+            model->joint_matrices[i - baked->nodes_count] = matrices_1[i] + (matrices_2[i] - matrices_1[i]) * factor;
+        else
+            model->joint_matrices[i - baked->nodes_count] = matrices_1[i];
+    }
+    if(baked->joints_count > 0)
+        model->joint_matrices_changed = true;
+}
+
+/* time in seconds wrapped in the current clip, in double so long sessions do not drift */
+double get_clip_time(Model_Data* model, double time)
+{
+    if(model->curren_animation == NULL || model->curren_animation->duration <= 0.0f)
+        return 0.0;
+    double duration = model->curren_animation->duration;
+    time = fmod(time, duration);
+    return time < 0.0 ? time + duration : time;
+}
+
+/* poses the model at clip_time seconds of the current clip (from 0 to the duration), in the bone and joint matrices */
+void pose_animation(Model_Data* model, float clip_time)
+{
+    model->animation_time = clip_time;
+    if(model->curren_animation == NULL) // a static model keeps its rest pose
+        return;
+    if(model->curren_animation->baked != NULL)
+    {
+        update_baked_animation(model, model->curren_animation->baked, model->animation_time);
+        return;
+    }
     update_animation_frame(model, model->curren_animation, model->animation_time);
     //update_animation_frame_2(model, model->animation_time);
 }
 
+/* poses the model at time seconds of the current clip, looped */
+void sample_animation(Model_Data* model, double time)
+{
+    pose_animation(model, (float)get_clip_time(model, time));
+}
+
+/* copies the local TRS of the model pose (see update_animation_frame) in a pose of the clock */
+void store_animation_pose(Model_Data* model, int pose)
+{
+    unsigned int nodes_count = model->anim_nodes_count;
+    memcpy(model->clock.translations + pose * nodes_count, model->pose->translations, sizeof(glm::vec3) * nodes_count);
+    memcpy(model->clock.rotations + pose * nodes_count, model->pose->rotations, sizeof(glm::quat) * nodes_count);
+    memcpy(model->clock.scales + pose * nodes_count, model->pose->scales, sizeof(glm::vec3) * nodes_count);
+}
+
+/* lerps the translations and scales and slerps the rotations of two poses of the clock, then composes
+   and propagates them like update_animation_frame. with the keyframes on the steps it is the same
+   interpolation as sampling the clip at that time */
+void blend_animation_poses(Model_Data* model, int pose_1, int pose_2, float factor)
+{
+    Animation_Clock* clock = &model->clock;
+    Animation_Pose* pose = model->pose;
+    unsigned int nodes_count = model->anim_nodes_count;
+    {
+        Profile_Scope scope(PROFILE_ANIMATION);
+        glm::vec3* translations_1 = clock->translations + pose_1 * nodes_count;
+        glm::vec3* translations_2 = clock->translations + pose_2 * nodes_count;
+        glm::quat* rotations_1 = clock->rotations + pose_1 * nodes_count;
+        glm::quat* rotations_2 = clock->rotations + pose_2 * nodes_count;
+        glm::vec3* scales_1 = clock->scales + pose_1 * nodes_count;
+        glm::vec3* scales_2 = clock->scales + pose_2 * nodes_count;
+        for(unsigned int i = 0; i < nodes_count; i++)
+        {
+            pose->translations[i] = glm::mix(translations_1[i], translations_2[i], factor);
+            pose->rotations[i] = glm::normalize(glm::slerp(rotations_1[i], rotations_2[i], factor));
+            pose->scales[i] = glm::mix(scales_1[i], scales_2[i], factor);
+        }
+        compose_pose_transforms(pose);
+    }
+    Profile_Scope scope(PROFILE_TRANSFORMS);
+    apply_animation_pose(model, pose);
+}
+
+/* samples the step into a pose of the clock, only the local TRS: the matrices are left to
+   blend_animation_poses. the next step of the clock is blended from the last one: when it loops
+   the clip its pose is taken at the end of the clip, a clip that does not loop would else be
+   blended toward its first pose, and it is sampled again once it becomes the last step */
+void sample_animation_step(Model_Data* model, int pose, long long step, bool next)
+{
+    double time = step * model->clock.step;
+    double clip_time = get_clip_time(model, time);
+    double duration = model->curren_animation->duration;
+    // fmod leaves a step on the loop just after the start or just before the end of the clip
+    bool on_loop = time > 0.0 && (clip_time < 1.0e-6 || duration - clip_time < 1.0e-6);
+    if(on_loop)
+        clip_time = next ? duration : 0.0;
+    prepare_packed_animation(model, model->curren_animation);
+    {
+        Profile_Scope scope(PROFILE_ANIMATION);
+        evaluate_packed_animation(model->curren_animation->packed, (float)clip_time, model->pose);
+    }
+    store_animation_pose(model, pose);
+    model->clock.pose_steps[pose] = step;
+    if(next)
+        model->clock.next_pose_end = on_loop;
+}
+
+/* steps_per_second: simulation rate of the animation (the 30 fps of the keyframes of the PS1 models),
+   0 samples the animation at the time of every frame. interpolate: draw the poses between the steps */
+void set_animation_clock_rate(Model_Data* model, double steps_per_second, bool interpolate)
+{
+    double time = model->clock.steps * model->clock.step + model->clock.elapsed;
+    model->clock.step = steps_per_second > 0.0 ? 1.0 / steps_per_second : 0.0;
+    model->clock.interpolate = interpolate;
+    reset_animation_clock(model);
+    model->clock.elapsed = get_clip_time(model, time);
+}
+
+/* moves the animation clock by delta_time seconds and poses the model at the new time.
+   with a step, the clock counts whole steps and the time since the last one, the clip time of a step
+   is steps * step so no rounding accumulates. a pose only depends on its time: the steps a long frame
+   jumps over are not sampled, and the local TRS of the last step and the next one are kept so the
+   frames between two steps only blend them and propagate the transforms (nothing when the time did
+   not move). without interpolation the model keeps the pose of the last step, like on the PlayStation.
+   baked animations are already sampled, they only need the time. */
+void advance_animation_clock(Model_Data* model, double delta_time)
+{
+    if(model->curren_animation == NULL)
+        return;
+    Animation_Clock* clock = &model->clock;
+    if(clock->step <= 0.0)
+    {
+        clock->elapsed = get_clip_time(model, clock->elapsed + delta_time);
+        sample_animation(model, clock->elapsed);
+        return;
+    }
+    clock->elapsed += delta_time;
+    if(clock->elapsed >= clock->step)
+    {
+        long long steps = (long long)(clock->elapsed / clock->step);
+        clock->steps += steps;
+        clock->elapsed = std::max(0.0, clock->elapsed - steps * clock->step);
+    }
+    float alpha = clock->interpolate ? (float)(clock->elapsed / clock->step) : 0.0f;
+    float clip_time = (float)get_clip_time(model, (clock->steps + alpha) * clock->step);
+    Baked_Animation* baked = model->curren_animation->baked;
+    if(baked != NULL)
+    {
+        if(baked->palette_texture != 0) // the vertex shader does the rest
+            model->animation_time = clip_time;
+        else
+            pose_animation(model, clip_time);
+        return;
+    }
+    model->animation_time = clip_time;
+    if(clock->translations == NULL)
+    {
+        clock->translations = (glm::vec3*)malloc(sizeof(glm::vec3) * model->anim_nodes_count * 2);
+        clock->rotations = (glm::quat*)malloc(sizeof(glm::quat) * model->anim_nodes_count * 2);
+        clock->scales = (glm::vec3*)malloc(sizeof(glm::vec3) * model->anim_nodes_count * 2);
+    }
+    int last = clock->last_pose;
+    if(clock->pose_steps[last] != clock->steps)
+    {
+        if(clock->pose_steps[1 - last] == clock->steps && !clock->next_pose_end) // one step further, the next pose becomes the last one
+        {
+            last = clock->last_pose = 1 - last;
+            clock->drawn_alpha = -1.0f;
+        }
+        else
+        {
+            sample_animation_step(model, last, clock->steps, false);
+            clock->drawn_alpha = -1.0f;
+        }
+    }
+    if(clock->interpolate && clock->pose_steps[1 - last] != clock->steps + 1)
+    {
+        sample_animation_step(model, 1 - last, clock->steps + 1, true);
+        clock->drawn_alpha = -1.0f;
+    }
+    if(alpha != clock->drawn_alpha)
+    {
+        blend_animation_poses(model, last, clock->interpolate ? 1 - last : last, alpha);
+        clock->drawn_alpha = alpha;
+    }
+}
+
+/* poses the model at time seconds of the current clip, the clock goes on from there */
+void set_animation_time(Model_Data* model, double time)
+{
+    reset_animation_clock(model);
+    advance_animation_clock(model, get_clip_time(model, time));
+}
+
+/* delta_time in milliseconds, see advance_animation_clock */
+void update_skeletal_animation(Model_Data* model, float delta_time)
+{
+    advance_animation_clock(model, delta_time / 1000.0);
+}
+
+/* draw_model for animations uploaded with upload_baked_animations, the shader gets the palette
+ texel of the mesh node in the two frames around the animation time, or of the first joint
+ of the frames for skinned meshes*/
+void draw_model_baked(Model_Data* model, unsigned int shader_id)
+{
+    if(model->curren_animation == NULL || model->curren_animation->baked == NULL)
+        return;
+    Baked_Animation* baked = model->curren_animation->baked;
+    unsigned int frame_1, frame_2;
+    float factor;
+    get_baked_frames(baked, model->animation_time, &frame_1, &frame_2, &factor);
+    glUniform1i(get_uniform_location(shader_id, UNIFORM_BONE_PALETTE), 1);
+    glUniform1f(get_uniform_location(shader_id, UNIFORM_BONE_FRAME_FACTOR), factor);
+    int frame_1_location = get_uniform_location(shader_id, UNIFORM_BONE_FRAME_1);
+    int frame_2_location = get_uniform_location(shader_id, UNIFORM_BONE_FRAME_2);
+    int skinned_location = get_uniform_location(shader_id, UNIFORM_SKINNED);
+    bind_texture(1, GL_TEXTURE_BUFFER, baked->palette_texture);
+    bind_model_texture(model, shader_id);
+    for (unsigned int i = 0; i < model->anim_nodes_count; i++)
+    {
+        Animation_Node* node = model->anim_nodes[i];
+        if(node->mesh == NULL)
+            continue;
+        // 4 RGBA32F texels per matrix
+        unsigned int matrix = node->mesh->skin_vertices != NULL ? baked->nodes_count : i;
+        glUniform1i(frame_1_location, (frame_1 * baked->frame_matrices_count + matrix) * 4);
+        glUniform1i(frame_2_location, (frame_2 * baked->frame_matrices_count + matrix) * 4);
+        glUniform1i(skinned_location, node->mesh->skin_vertices != NULL);
+        draw_mesh(node->mesh);
+    }
+}
+
 void change_model_animation(Model_Data* model, int animation_index)
 {
     if(animation_index >= 0 && animation_index <  model->animations_count)
@@ -1380,7 +3063,8 @@ void change_model_animation(Model_Data* model, int animation_index)
         model->curren_animation = model->animations[animation_index];
         //load_animation_data(model->animations[animation_index]);
     }
-    model->animation_time = 0.0;
+    reset_model_rest_pose(model);
+    reset_animation_clock(model);
 }
 
 #endif // GLTF_LOADERL_H
@@ -0,0 +1,439 @@
+#ifndef HEADLESS_RENDERER_H
+#define HEADLESS_RENDERER_H
+
+#include "gltf_loader.h"
+#include "model_cache.h"
+#include "shader_s.h"
+#include "camera.h"
+#include "png_writer.h"
+
+#include <dirent.h>
+#include <chrono>
+
+/* rendering without a window, for thumbnails and image comparisons on machines without display or GPU.
+   the GL context has no surface: EGL on Mesa's surfaceless platform (build with HEADLESS_EGL and
+   link libEGL) or OSMesa (HEADLESS_OSMESA, link libOSMesa), both run on llvmpipe without a GPU.
+   the frames are drawn in a framebuffer object of the asked size, read back and written as png files
+   named model_clip_milliseconds.png, one per clip and time of the Headless_Job.
+   render_headless_directory shares the files of a directory between processes (fork), each one with
+   its own context, llvmpipe already renders with several threads but most of a thumbnail is spent
+   loading the model and writing the png, which only scales with processes. */
+
+#if defined(HEADLESS_EGL)
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#elif defined(HEADLESS_OSMESA)
+#include <GL/osmesa.h>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#define HEADLESS_PROCESSES
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
+
+#define HEADLESS_MAX_TIMES 64
+#define HEADLESS_MAX_FILES 4096
+
+typedef struct
+{
+#if defined(HEADLESS_EGL)
+    EGLDisplay display;
+    EGLContext context;
+#elif defined(HEADLESS_OSMESA)
+    OSMesaContext context;
+    unsigned char buffer[4]; // OSMesa needs a color buffer to make the context current, the frames go in a framebuffer object
+#endif
+}Headless_Context;
+
+typedef struct
+{
+    Headless_Context* context;
+    int width, height;
+    unsigned int framebuffer, color_buffer, depth_buffer;
+    unsigned char* pixels;
+    Shader* shaders[4];      // merged or skinned vertex shader x model.fs or model_indexed.fs
+    Node_Matrix_Buffer* node_matrices;
+    unsigned int frames_count;
+    double render_ms;        // update, draw and read back
+    double write_ms;         // png files
+}Headless_Renderer;
+
+typedef struct
+{
+    int clip;                // animation index, -1 for every animation
+    float times[HEADLESS_MAX_TIMES]; // seconds from the start of the clip
+    int times_count;
+    unsigned int load_flags; // MODEL_LOAD_ flags of gltf files
+    const char* output_directory;
+    void (*model_transform)(Shader* shader);
+}Headless_Job;
+
+double get_headless_time_ms(void)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void free_headless_context(Headless_Context* context)
+{
+#if defined(HEADLESS_EGL)
+    if(context->display != EGL_NO_DISPLAY)
+    {
+        eglMakeCurrent(context->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if(context->context != EGL_NO_CONTEXT)
+            eglDestroyContext(context->display, context->context);
+        eglTerminate(context->display);
+    }
+#elif defined(HEADLESS_OSMESA)
+    if(context->context != NULL)
+        OSMesaDestroyContext(context->context);
+#endif
+    free(context);  context = NULL;
+}
+
+/* a current GL 3.3 context without surface, NULL when it can not be created */
+Headless_Context* create_headless_context(void)
+{
+#if defined(HEADLESS_EGL)
+    Headless_Context* context = (Headless_Context*)calloc(1, sizeof(Headless_Context));
+    context->display = EGL_NO_DISPLAY;
+    context->context = EGL_NO_CONTEXT;
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if(get_platform_display != NULL)
+        context->display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    if(context->display == EGL_NO_DISPLAY)
+        context->display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    EGLint major, minor;
+    if(context->display == EGL_NO_DISPLAY || !eglInitialize(context->display, &major, &minor))
+    {
+        printf("headless: no EGL display \n");
+        context->display = EGL_NO_DISPLAY;
+        free_headless_context(context);
+        return NULL;
+    }
+    eglBindAPI(EGL_OPENGL_API);
+    EGLint config_attributes[] = {EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+    EGLConfig config = NULL;
+    EGLint configs_count = 0;
+    eglChooseConfig(context->display, config_attributes, &config, 1, &configs_count);
+    EGLint context_attributes[] = {EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 3,
+                                   EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE};
+    context->context = eglCreateContext(context->display, configs_count > 0 ? config : NULL, EGL_NO_CONTEXT, context_attributes);
+    if(context->context == EGL_NO_CONTEXT ||
+       !eglMakeCurrent(context->display, EGL_NO_SURFACE, EGL_NO_SURFACE, context->context))
+    {
+        printf("headless: could not create a surfaceless GL 3.3 context (EGL %d.%d) \n", major, minor);
+        free_headless_context(context);
+        return NULL;
+    }
+    if(!gladLoadGLLoader((GLADloadproc)eglGetProcAddress))
+    {
+        free_headless_context(context);
+        return NULL;
+    }
+    return context;
+#elif defined(HEADLESS_OSMESA)
+    Headless_Context* context = (Headless_Context*)calloc(1, sizeof(Headless_Context));
+    const int attributes[] = {OSMESA_FORMAT, OSMESA_RGBA, OSMESA_DEPTH_BITS, 0, OSMESA_PROFILE, OSMESA_CORE_PROFILE,
+                              OSMESA_CONTEXT_MAJOR_VERSION, 3, OSMESA_CONTEXT_MINOR_VERSION, 3, 0};
+    context->context = OSMesaCreateContextAttribs(attributes, NULL);
+    if(context->context == NULL || !OSMesaMakeCurrent(context->context, context->buffer, GL_UNSIGNED_BYTE, 1, 1))
+    {
+        printf("headless: could not create an OSMesa GL 3.3 context \n");
+        free_headless_context(context);
+        return NULL;
+    }
+    if(!gladLoadGLLoader((GLADloadproc)OSMesaGetProcAddress))
+    {
+        free_headless_context(context);
+        return NULL;
+    }
+    return context;
+#else
+    printf("headless: built without HEADLESS_EGL or HEADLESS_OSMESA \n");
+    return NULL;
+#endif
+}
+
+/* a GL context and a width x height framebuffer, NULL when no context can be created */
+Headless_Renderer* create_headless_renderer(int width, int height)
+{
+    Headless_Context* context = create_headless_context();
+    if(context == NULL)
+        return NULL;
+    Headless_Renderer* renderer = (Headless_Renderer*)calloc(1, sizeof(Headless_Renderer));
+    renderer->context = context;
+    renderer->width = width;
+    renderer->height = height;
+    glGenRenderbuffers(1, &renderer->color_buffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderer->color_buffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glGenRenderbuffers(1, &renderer->depth_buffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderer->depth_buffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glGenFramebuffers(1, &renderer->framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, renderer->framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderer->color_buffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderer->depth_buffer);
+    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        printf("headless: the framebuffer is not complete \n");
+    glViewport(0, 0, width, height);
+    glEnable(GL_DEPTH_TEST);
+    renderer->pixels = (unsigned char*)malloc((size_t)width * height * 4);
+    renderer->node_matrices = create_node_matrix_buffer(1024, MODEL_MAX_BONES);
+    return renderer;
+}
+
+void free_headless_renderer(Headless_Renderer* renderer)
+{
+    for(int i = 0; i < 4; i++)
+    {
+        if(renderer->shaders[i] == NULL)
+            continue;
+        delete_shader_program(renderer->shaders[i]->ID);
+        delete renderer->shaders[i];
+    }
+    free_node_matrix_buffer(renderer->node_matrices);
+    glDeleteFramebuffers(1, &renderer->framebuffer);
+    glDeleteRenderbuffers(1, &renderer->color_buffer);
+    glDeleteRenderbuffers(1, &renderer->depth_buffer);
+    free(renderer->pixels);  renderer->pixels = NULL;
+    free_headless_context(renderer->context);
+    free(renderer);  renderer = NULL;
+}
+
+/* the shader main.cpp would pick for the model, compiled once per renderer */
+Shader* get_headless_shader(Headless_Renderer* renderer, Model_Data* model)
+{
+    int skinned = model->skin_VBO != 0;
+    int indexed = model->palette_texture != 0;
+    Shader** shader = &renderer->shaders[skinned * 2 + indexed];
+    if(*shader == NULL)
+    {
+        *shader = new Shader(skinned ? "gltf_loader/shaders/model_skinned.vs" : "gltf_loader/shaders/model_merged.vs",
+                             indexed ? "gltf_loader/shaders/model_indexed.fs" : "gltf_loader/shaders/model.fs");
+        (*shader)->use();
+        (*shader)->setInt(UNIFORM_TEXTURE_PALETTE, 2);
+    }
+    return *shader;
+}
+
+/* "0,0.5,1.25" in seconds */
+bool parse_headless_times(const char* list, Headless_Job* job)
+{
+    job->times_count = 0;
+    const char* cursor = list;
+    while(*cursor != '\0' && job->times_count < HEADLESS_MAX_TIMES)
+    {
+        char* end;
+        float time = strtof(cursor, &end);
+        if(end == cursor)
+            return false;
+        job->times[job->times_count++] = time;
+        cursor = *end == ',' ? end + 1 : end;
+    }
+    return job->times_count > 0;
+}
+
+/* the file name without its directory and extension */
+void get_headless_model_name(const char* model_file, char* name, size_t name_size)
+{
+    const char* slash = strrchr(model_file, '/');
+    const char* backslash = strrchr(model_file, '\\');
+    if(backslash != NULL && (slash == NULL || backslash > slash))
+        slash = backslash;
+    snprintf(name, name_size, "%s", slash != NULL ? slash + 1 : model_file);
+    char* dot = strrchr(name, '.');
+    if(dot != NULL)
+        *dot = '\0';
+}
+
+/* draws the model at the current pose and writes the frame, returns false when the file can not be written */
+bool write_headless_frame(Headless_Renderer* renderer, Model_Data* model, Headless_Job* job, const char* file_name)
+{
+    double start = get_headless_time_ms();
+    begin_node_matrix_frame(renderer->node_matrices);
+    write_model_node_matrices(renderer->node_matrices, model);
+    upload_node_matrices(renderer->node_matrices);
+
+    glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    Shader* shader = get_headless_shader(renderer, model);
+    shader->use();
+    Camera camera(glm::vec3(10.0f, 5.0f, 40.0f)); // the start camera of the viewer
+    shader->setMat4(UNIFORM_PROJECTION, glm::perspective(glm::radians(camera.Zoom), (float)renderer->width / renderer->height, 0.1f, 100.0f));
+    shader->setMat4(UNIFORM_VIEW, camera.GetViewMatrix());
+    job->model_transform(shader);
+    draw_model_merged(model, shader->ID);
+    end_node_matrix_frame(renderer->node_matrices);
+
+    glReadPixels(0, 0, renderer->width, renderer->height, GL_RGBA, GL_UNSIGNED_BYTE, renderer->pixels);
+    double read_time = get_headless_time_ms();
+    renderer->render_ms += read_time - start;
+    bool success = write_png_file(file_name, renderer->pixels, renderer->width, renderer->height, true);
+    renderer->write_ms += get_headless_time_ms() - read_time;
+    renderer->frames_count += success;
+    return success;
+}
+
+/* writes a frame per clip and time of the job, returns the frames written or -1 when the model does not load
+   or has no clip of the index asked */
+int render_headless_model(Headless_Renderer* renderer, const char* model_file, Headless_Job* job)
+{
+    Model_Data* model = NULL;
+    if(is_model_cache_file((char*)model_file))
+        model = load_model_cache((char*)model_file);
+    else
+        model = load_gltf_model_parallel((char*)model_file, NULL, job->load_flags);
+    if(model == NULL)
+    {
+        printf("could not load model: %s \n", model_file);
+        return -1;
+    }
+    int animations_count = (int)model->animations_count;
+    if(job->clip >= 0 && job->clip >= animations_count && animations_count > 0)
+    {
+        printf("no clip %d in %s, it has %d animations \n", job->clip, model_file, animations_count);
+        free_model(model);
+        return -1;
+    }
+    char name[256];
+    get_headless_model_name(model_file, name, sizeof(name));
+    char file_name[512];
+    int frames_count = 0;
+    if(model->animations_count == 0)
+    {
+        // the rest pose only
+        snprintf(file_name, sizeof(file_name), "%s/%s.png", job->output_directory, name);
+        frames_count += write_headless_frame(renderer, model, job, file_name);
+    }
+    int first_clip = job->clip >= 0 ? job->clip : 0;
+    int last_clip = job->clip >= 0 ? std::min(job->clip, animations_count - 1) : animations_count - 1; // no clip without animations
+    for(int clip = first_clip; clip <= last_clip; clip++)
+    {
+        change_model_animation(model, clip);
+        for(int i = 0; i < job->times_count; i++)
+        {
+            // times past the end of the clip wrap like in the viewer
+            set_animation_time(model, job->times[i]);
+            snprintf(file_name, sizeof(file_name), "%s/%s_%d_%d.png", job->output_directory, name, clip,
+                     (int)(job->times[i] * 1000.0f + 0.5f));
+            frames_count += write_headless_frame(renderer, model, job, file_name);
+        }
+    }
+    free_model(model);
+    return frames_count;
+}
+
+/* the files first, first + step... of the list in one context, returns the frames written */
+unsigned int render_headless_files(char** files, int files_count, int first, int step, Headless_Job* job, int width, int height)
+{
+    Headless_Renderer* renderer = create_headless_renderer(width, height);
+    if(renderer == NULL)
+        return 0;
+    int models_count = 0;
+    for(int i = first; i < files_count; i += step)
+        models_count += render_headless_model(renderer, files[i], job) >= 0;
+    unsigned int frames_count = renderer->frames_count;
+    printf("headless %d: %d models, %u frames, %.1f ms rendering, %.1f ms writing png \n", first, models_count,
+           frames_count, renderer->render_ms, renderer->write_ms);
+    free_headless_renderer(renderer);
+    return frames_count;
+}
+
+int compare_headless_files(const void* a, const void* b)
+{
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+/* renders every gltf and gvc file of the directory on processes_count processes (0 = one per core)
+   and prints the throughput, returns the frames written */
+unsigned int render_headless_directory(const char* directory, Headless_Job* job, int width, int height, int processes_count)
+{
+    static char* files[HEADLESS_MAX_FILES];
+    int files_count = 0;
+    DIR* dir = opendir(directory);
+    struct dirent* entry;
+    while(dir != NULL && (entry = readdir(dir)) != NULL && files_count < HEADLESS_MAX_FILES)
+    {
+        char* dot = strrchr(entry->d_name, '.');
+        if(dot == NULL || (strcmp(dot, ".gltf") != 0 && strcmp(dot, ".gvc") != 0))
+            continue;
+        files[files_count] = (char*)malloc(strlen(directory) + strlen(entry->d_name) + 2);
+        sprintf(files[files_count++], "%s/%s", directory, entry->d_name);
+    }
+    if(dir != NULL)
+        closedir(dir);
+    if(files_count == 0)
+    {
+        printf("no gltf or gvc file in %s \n", directory);
+        return 0;
+    }
+    qsort(files, files_count, sizeof(char*), compare_headless_files);
+    if(processes_count <= 0)
+        processes_count = std::max(std::thread::hardware_concurrency(), 1u);
+    processes_count = std::min(processes_count, files_count);
+
+    double start = get_headless_time_ms();
+    unsigned int frames_count = 0;
+#ifdef HEADLESS_PROCESSES
+    // every process creates its own context after the fork, the parent has none
+    pid_t* processes = (pid_t*)malloc(sizeof(pid_t) * processes_count);
+    int* pipes = (int*)malloc(sizeof(int) * 2 * processes_count);
+    fflush(stdout);
+    for(int i = 0; i < processes_count; i++)
+    {
+        if(pipe(&pipes[i * 2]) != 0)
+        {
+            processes[i] = -1;
+            continue;
+        }
+        processes[i] = fork();
+        if(processes[i] < 0)
+        {
+            close(pipes[i * 2]);
+            close(pipes[i * 2 + 1]);
+            continue;
+        }
+        if(processes[i] == 0)
+        {
+            close(pipes[i * 2]);
+            unsigned int process_frames = render_headless_files(files, files_count, i, processes_count, job, width, height);
+            fflush(stdout);
+            if(write(pipes[i * 2 + 1], &process_frames, sizeof(process_frames)) != sizeof(process_frames))
+                _exit(1);
+            _exit(0);
+        }
+        close(pipes[i * 2 + 1]);
+    }
+    for(int i = 0; i < processes_count; i++)
+    {
+        if(processes[i] < 0)
+        {
+            printf("headless %d: could not start the process \n", i);
+            continue;
+        }
+        unsigned int process_frames = 0;
+        if(read(pipes[i * 2], &process_frames, sizeof(process_frames)) != sizeof(process_frames))
+            printf("headless %d: the process failed \n", i);
+        frames_count += process_frames;
+        close(pipes[i * 2]);
+        waitpid(processes[i], NULL, 0);
+    }
+    free(processes);
+    free(pipes);
+#else
+    processes_count = 1;
+    frames_count = render_headless_files(files, files_count, 0, 1, job, width, height);
+#endif
+    double seconds = (get_headless_time_ms() - start) / 1000.0;
+    printf("%s: %d files, %u frames of %dx%d in %.2f s on %d processes, %.1f frames/s, %.1f frames/s per process \n",
+           directory, files_count, frames_count, width, height, seconds, processes_count,
+           frames_count / seconds, frames_count / seconds / processes_count);
+    for(int i = 0; i < files_count; i++)
+        free(files[i]);
+    return frames_count;
+}
+
+#endif // HEADLESS_RENDERER_H
@@ -0,0 +1,121 @@
+#include "glad.h"
+
+#include "gltf_loader.h"
+
+#include <chrono>
+
+/* checks and times the packed animation engine (animation_engine.h) against the TRS matrix path
+   it replaced in update_animation_frame (update_animation_frame_trs). every clip is played at 60 fps,
+   both paths pose the model at each time and the global node matrices and joint matrices are compared.
+   the error is also given relative to the largest matrix value of the clip, the size of the rig.
+   the timings are per evaluation, sampling alone (the local matrices) and the whole update with
+   the global transforms and the joint matrices. the model is loaded without GL. */
+
+const float SAMPLE_TIME = 1.0f / 60.0f;
+const int PASSES_COUNT = 200;
+
+double get_time_ns(void)
+{
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* the sampling part of update_animation_frame_trs, up to the local matrices */
+void sample_animation_trs(Model_Data* model, Model_Animation* animation, float time)
+{
+    for(unsigned int i = 0; i < animation->anim_data_count; i++)
+    {
+        interpolate_node_animation(animation->anim_data[i]->target_node, animation->anim_data[i], time);
+    }
+    for(unsigned int i = 0; i < model->anim_nodes_count; i++)
+    {
+        TRS_Transform* trs = &model->anim_nodes[i]->trs;
+        model->anim_nodes[i]->local_transform = trs->trans * trs->rot * trs->scale;
+    }
+}
+
+void store_pose(Model_Data* model, glm::mat4* matrices)
+{
+    for(unsigned int i = 0; i < model->anim_nodes_count; i++)
+        matrices[i] = model->anim_nodes[i]->global_transform;
+    for(unsigned int i = 0; i < model->joints_count; i++)
+        matrices[model->anim_nodes_count + i] = model->joint_matrices[i];
+}
+
+int main(int argc, char *argv[])
+{
+    char* model_file = (char*)"models/Omnimon/150OMGM.gltf";
+    if(argc > 1)
+        model_file = argv[1];
+
+    Model_Data* model = load_gltf_model_parallel(model_file, NULL, MODEL_LOAD_NO_GPU);
+    if(model == NULL)
+        return -1;
+    unsigned int matrices_count = model->anim_nodes_count + model->joints_count;
+    glm::mat4* reference = (glm::mat4*)malloc(sizeof(glm::mat4) * matrices_count);
+    glm::mat4* packed = (glm::mat4*)malloc(sizeof(glm::mat4) * matrices_count);
+    float volatile sink = 0.0f;
+
+    printf("%s: %u nodes, %u joints, %u animations \n\n", model_file, model->anim_nodes_count, model->joints_count, model->animations_count);
+    printf("%5s %8s %8s %10s %10s %11s %12s %12s %8s %12s %12s %8s \n", "clip", "channels", "samples", "max error",
+           "rig size", "rel. error", "trs sample", "packed", "speedup", "trs update", "packed", "speedup");
+    for(unsigned int a = 0; a < model->animations_count; a++)
+    {
+        change_model_animation(model, a);
+        Model_Animation* animation = model->curren_animation;
+        int samples_count = (int)(animation->duration / SAMPLE_TIME) + 2; // the last one at the end of the clip
+
+        float max_error = 0.0f, rig_size = 0.0f;
+        for(int s = 0; s < samples_count; s++)
+        {
+            float time = std::min(s * SAMPLE_TIME, animation->duration);
+            update_animation_frame_trs(model, animation, time);
+            store_pose(model, reference);
+            update_animation_frame(model, animation, time);
+            store_pose(model, packed);
+            for(unsigned int i = 0; i < matrices_count; i++)
+            {
+                for(int c = 0; c < 4; c++)
+                {
+                    for(int r = 0; r < 4; r++)
+                    {
+                        max_error = std::max(max_error, fabsf(reference[i][c][r] - packed[i][c][r]));
+                        rig_size = std::max(rig_size, fabsf(reference[i][c][r]));
+                    }
+                }
+            }
+        }
+
+        double ns[4];
+        for(int path = 0; path < 4; path++)
+        {
+            double start = get_time_ns();
+            for(int pass = 0; pass < PASSES_COUNT; pass++)
+            {
+                for(int s = 0; s < samples_count; s++)
+                {
+                    float time = std::min(s * SAMPLE_TIME, animation->duration);
+                    if(path == 0)
+                        sample_animation_trs(model, animation, time);
+                    else if(path == 1)
+                        evaluate_packed_animation(animation->packed, time, model->pose);
+                    else if(path == 2)
+                        update_animation_frame_trs(model, animation, time);
+                    else
+                        update_animation_frame(model, animation, time);
+                }
+            }
+            ns[path] = (get_time_ns() - start) / ((double)PASSES_COUNT * samples_count);
+            sink += model->anim_nodes[0]->global_transform[3][0] + model->pose->local_transforms[0][3][0];
+        }
+
+        printf("%5u %8u %8d %10.3g %10.1f %11.3g %12.1f %12.1f %7.2fx %12.1f %12.1f %7.2fx \n", a, animation->anim_data_count,
+               samples_count, max_error, rig_size, rig_size > 0.0f ? max_error / rig_size : 0.0f,
+               ns[0], ns[1], ns[0] / ns[1], ns[2], ns[3], ns[2] / ns[3]);
+    }
+    printf("\ntimes in ns per evaluation \n");
+
+    free(reference);
+    free(packed);
+    free_model(model);
+    return 0;
+}
@@ -0,0 +1,228 @@
+#include <SDL/SDL.h>
+#include "glad.h"
+
+#include "gltf_loader.h"
+#include "model_cache.h"
+#include "model_crowd.h"
+
+#include "shader_s.h"
+#include "camera.h"
+
+#include <chrono>
+
+/* crowd stress test: draws a grid of instances of one model, each playing a random animation
+   from a random time, and reports the frame time as the instance count doubles.
+   vsync is off and every frame ends with glFinish so the time covers the GPU work.
+   after the measures the largest crowd stays on screen (mouse and w a s d move the camera). */
+
+void processInput(void);
+glm::mat4 crowd_model_transform(int model_version, glm::vec3 position, float angle);
+
+const unsigned int SCR_WIDTH = 640;
+const unsigned int SCR_HEIGHT = 480;
+const float INSTANCE_SPACING = 4.0f;
+const int WARMUP_FRAMES = 10;
+const int MEASURED_FRAMES = 120;
+
+Camera camera(glm::vec3(0.0f, 40.0f, 60.0f), glm::vec3(0.0f, 1.0f, 0.0f), -90.0f, -30.0f);
+float lastX = SCR_WIDTH / 2.0f;
+float lastY = SCR_HEIGHT / 2.0f;
+bool firstMouse = true;
+float deltaTime = 0.0f;
+
+bool main_loop = true;
+SDL_Event event;
+Uint8* keys;
+
+double get_time_ms(void)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* lays instances_count instances on a square grid in front of the camera */
+void fill_crowd(Model_Crowd* crowd, unsigned int instances_count, int model_version)
+{
+    clear_model_crowd(crowd);
+    srand(1);
+    unsigned int side = (unsigned int)ceil(sqrt((double)instances_count));
+    for(unsigned int i = 0; i < instances_count; i++)
+    {
+        glm::vec3 position(((int)(i % side) - (int)side / 2) * INSTANCE_SPACING, 0.0f, -(float)(i / side) * INSTANCE_SPACING);
+        float angle = (float)(rand() % 360);
+        unsigned int animation_index = rand() % crowd->model->animations_count;
+        float time_offset = rand() / (float)RAND_MAX * 10.0f;
+        add_crowd_instance(crowd, crowd_model_transform(model_version, position, angle), animation_index, time_offset);
+    }
+}
+
+void render_crowd(Model_Crowd* crowd, Shader* shader)
+{
+    glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    shader->use();
+    glm::mat4 projection_mat = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 1000.0f);
+    shader->setMat4(UNIFORM_PROJECTION, projection_mat);
+    shader->setMat4(UNIFORM_VIEW, camera.GetViewMatrix());
+    draw_model_crowd(crowd, shader->ID);
+}
+
+int main(int argc, char *argv[])
+{
+    char* model_file = (char*)"models/Omnimon/150OMGM.gltf";
+    unsigned int max_instances = 4096;
+    int model_version = 1;
+    float bake_fps = 30.0f;
+
+    if(argc > 1 && argv[1][0] == '-' && argv[1][1] == 'h')
+    {
+        printf("main_crowd.exe [file_name] [max_instances] [model_version:(1,2,3)] [bake_fps] \n\n");
+        return 0;
+    }
+    if(argc > 1)
+        model_file = argv[1];
+    if(argc > 2 && isdigit(argv[2][0]))
+        max_instances = atoi(argv[2]);
+    if(argc > 3 && isdigit(argv[3][0]))
+        model_version = argv[3][0] - '0';
+    if(argc > 4 && isdigit(argv[4][0]))
+        bake_fps = atof(argv[4]);
+
+    SDL_Init(SDL_INIT_VIDEO);
+    SDL_WM_SetCaption("gltf_viewer crowd",NULL);
+    SDL_GL_SetAttribute(SDL_GL_SWAP_CONTROL, 0);
+    SDL_SetVideoMode(SCR_WIDTH, SCR_HEIGHT, 32, SDL_OPENGL);
+
+    if (!gladLoadGLLoader((GLADloadproc)SDL_GL_GetProcAddress))
+    {
+        printf("Failed to initialize GLAD \n");
+        return -1;
+    }
+    glEnable(GL_DEPTH_TEST);
+
+    Model_Data* model = NULL;
+    if(is_model_cache_file(model_file))
+        model = load_model_cache(model_file);
+    else
+        model = load_gltf_model(model_file);
+    if(model == NULL || model->animations_count == 0)
+    {
+        printf("could not load an animated model: %s \n\n", model_file);
+        SDL_Quit();
+        return 1;
+    }
+
+    Model_Crowd* crowd = create_model_crowd(model, max_instances, bake_fps);
+    Shader crowdShader("gltf_loader/shaders/model_crowd.vs", "gltf_loader/shaders/model.fs");
+
+    unsigned int meshes_draws = 0;
+    for(unsigned int i = 0; i < model->anim_nodes_count; i++)
+        meshes_draws += model->anim_nodes[i]->mesh != NULL;
+    printf("%s: %u draw calls per frame \n\n", model_file, meshes_draws);
+    printf("%10s %12s %12s %14s \n", "instances", "frame ms", "update ms", "instances/ms");
+
+    float time = 0.0f;
+    for(unsigned int instances_count = 128; main_loop; instances_count *= 2)
+    {
+        if(instances_count > max_instances)
+            instances_count = max_instances;
+        fill_crowd(crowd, instances_count, model_version);
+        double frames_ms = 0.0, update_ms = 0.0;
+        for(int frame = 0; frame < WARMUP_FRAMES + MEASURED_FRAMES && main_loop; frame++)
+        {
+            double start = get_time_ms();
+            update_model_crowd(crowd, time);
+            double update_end = get_time_ms();
+            render_crowd(crowd, &crowdShader);
+            glFinish();
+            double end = get_time_ms();
+            SDL_GL_SwapBuffers();
+            if(frame >= WARMUP_FRAMES)
+            {
+                frames_ms += end - start;
+                update_ms += update_end - start;
+            }
+            time += 1.0f / 60.0f;
+            processInput();
+        }
+        frames_ms /= MEASURED_FRAMES;
+        update_ms /= MEASURED_FRAMES;
+        printf("%10u %12.3f %12.3f %14.1f \n", instances_count, frames_ms, update_ms, instances_count / frames_ms);
+        if(instances_count == max_instances)
+            break;
+    }
+
+    // keep the largest crowd on screen
+    unsigned int last_ticks = SDL_GetTicks();
+    while (main_loop)
+    {
+        unsigned int ticks = SDL_GetTicks();
+        deltaTime = ticks - last_ticks;
+        last_ticks = ticks;
+        time += deltaTime / 1000.0f;
+        processInput();
+        update_model_crowd(crowd, time);
+        render_crowd(crowd, &crowdShader);
+        SDL_GL_SwapBuffers();
+    }
+
+    delete_shader_program(crowdShader.ID);
+    free_model_crowd(crowd);
+    free_model(model);
+    SDL_Quit();
+    return 0;
+}
+
+void processInput(void)
+{
+    while(SDL_PollEvent(&event) == 1)
+    {
+        switch(event.type)
+        {
+            case SDL_QUIT:
+                main_loop = false;
+                break;
+            case SDL_KEYDOWN:
+                if(event.key.keysym.sym == SDLK_ESCAPE)
+                    main_loop = false;
+                break;
+            case SDL_MOUSEMOTION:
+            {
+                float xpos = static_cast<float>(event.motion.x);
+                float ypos = static_cast<float>(event.motion.y);
+                if (firstMouse)
+                {
+                    lastX = xpos;
+                    lastY = ypos;
+                    firstMouse = false;
+                }
+                camera.ProcessMouseMovement(xpos - lastX, lastY - ypos);
+                lastX = xpos;
+                lastY = ypos;
+                break;
+            }
+        }
+    }
+
+    keys = SDL_GetKeyState(NULL);
+
+    if(keys[SDLK_w])
+        camera.ProcessKeyboard(FORWARD, deltaTime);
+    else if(keys[SDLK_a])
+        camera.ProcessKeyboard(BACKWARD, deltaTime);
+    if(keys[SDLK_s])
+        camera.ProcessKeyboard(LEFT, deltaTime);
+    else if(keys[SDLK_d])
+        camera.ProcessKeyboard(RIGHT, deltaTime);
+}
+
+/* same orientation as the dw*_model_transform of main.cpp, at a smaller scale so a crowd fits */
+glm::mat4 crowd_model_transform(int model_version, glm::vec3 position, float angle)
+{
+    glm::mat4 model_mat = glm::translate(glm::mat4(1.0f), position);
+    model_mat = glm::rotate(model_mat, glm::radians(angle), glm::vec3(0.0f, 1.0f, 0.0f));
+    if(model_version != 3)
+        model_mat = glm::scale(model_mat, glm::vec3(0.005f, 0.005f, 0.005f));
+    if(model_version != 2)
+        model_mat = glm::rotate(model_mat, glm::radians(180.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    return model_mat;
+}
@@ -3,6 +3,7 @@
 #include "gltf_loader/glad.h"
 
 #include "gltf_loader/gltf_loader.h"
+#include "gltf_loader/model_lru_cache.h"
 
 #include "gltf_loader/shader_s.h"
 #include "gltf_loader/camera.h"
@@ -23,13 +24,18 @@ int listdir(char* dir_name);
 Files_List* get_files_list(char* dir_name, char* extension_name);
 void free_files_list(Files_List* files_list);
 void join_path(char* path, char* filename, char* output_path);
-Model_Data* load_gltf_model_2(char* model_file);
-void free_model_2(Model_Data* model);
+void prefetch_neighbour_models(Model_Lru_Cache* model_cache, Files_List* files_list, char* files_path, int file_index);
 void model_transform(Shader *shader);
 
 int model_file_index = 0;
 int model_files_count;
 int change_model = false;
+// meshes uploaded per frame while a model loaded in the background is swapped in
+const unsigned int UPLOAD_MESHES_PER_FRAME = 8;
+// models kept loaded while browsing, and the files loaded ahead on each side of the current one
+const unsigned int MODEL_CACHE_ENTRIES = 16;
+const size_t MODEL_CACHE_BUDGET = 64 * 1024 * 1024;
+const int PREFETCH_FILES = 2;
 
 // settings
 const unsigned int SCR_WIDTH = 640;
@@ -85,7 +91,13 @@ int main(int argc, char *argv[])
     join_path(files_path, gltf_files->files_names[model_file_index], current_file_path);
     if(argc > 1)
         strcpy(current_file_path, argv[1]);
-    Model_Data* model = load_gltf_model_2(current_file_path);
+    Thread_Pool* loader_pool = create_thread_pool(0);
+    // the models are loaded in the background, the current one stays on screen until the next is ready
+    Model_Loader* model_loader = create_model_loader(loader_pool);
+    Model_Lru_Cache* model_cache = create_model_lru_cache(model_loader, MODEL_CACHE_ENTRIES, MODEL_CACHE_BUDGET);
+    Model_Data* model = NULL;
+    get_cached_model(model_cache, current_file_path);
+    prefetch_neighbour_models(model_cache, gltf_files, files_path, model_file_index);
     model_files_count = gltf_files->files_count;
     //model_animation* animation = load_model_animation(&gltf_data->animations[0], gltf_data->nodes, model->anim_nodes);
     /*for(int i = 0; i < animation->anim_data_count; i++)
@@ -120,12 +132,16 @@ int main(int argc, char *argv[])
 
         if(change_model)
         {
-             free_model_2(model);
              join_path(files_path, gltf_files->files_names[model_file_index], current_file_path);
-             model = load_gltf_model_2(current_file_path);
+             get_cached_model(model_cache, current_file_path);
+             prefetch_neighbour_models(model_cache, gltf_files, files_path, model_file_index);
 
              change_model = false;
         }
+        update_model_lru_cache(model_cache, UPLOAD_MESHES_PER_FRAME);
+        Model_Data* requested_model = get_cached_model(model_cache, current_file_path);
+        if(requested_model != NULL)
+            model = requested_model;
 
         // input
         // -----
@@ -141,11 +157,11 @@ int main(int argc, char *argv[])
 
         // pass projection matrix to shader (note that in this case it could change every frame)
         glm::mat4 projection_mat = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        ourShader.setMat4("projection", projection_mat);
+        ourShader.setMat4(UNIFORM_PROJECTION, projection_mat);
 
         // camera/view transformation
         glm::mat4 view_mat = camera.GetViewMatrix();
-        ourShader.setMat4("view", view_mat);
+        ourShader.setMat4(UNIFORM_VIEW, view_mat);
 
         // calculate the model matrix for each object and pass it to shader before drawing
         model_transform(&ourShader);
@@ -153,14 +169,12 @@ int main(int argc, char *argv[])
         // render model
         Mesh_Data* mesh;
         // bind textures on corresponding texture units
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, model->texture);
+        bind_texture(0, GL_TEXTURE_2D, model != NULL ? model->texture : 0);
         // render model
-        for (unsigned int i = 0; i < model->meshes_count; i++)
+        for (unsigned int i = 0; model != NULL && i < model->meshes_count; i++)
         {
             mesh = model->meshes[i];
-            glBindVertexArray(mesh->VAO);
-            glDrawArrays(GL_TRIANGLES, 0, mesh->vertices_count);
+            draw_mesh(mesh);
         };
 
         SDL_GL_SwapBuffers();
@@ -169,11 +183,14 @@ int main(int argc, char *argv[])
 
     // optional: de-allocate all resources once they've outlived their purpose:
     // ------------------------------------------------------------------------
-    glDeleteProgram(ourShader.ID);
+    delete_shader_program(ourShader.ID);
 
     //free_model_animation(animation);
-    free_model_2(model);
+    printf("model cache: %u hits, %u misses \n", model_cache->hits, model_cache->misses);
+    free_model_lru_cache(model_cache);
+    free_model_loader(model_loader);
     free_files_list(gltf_files);
+    free_thread_pool(loader_pool);
 
     SDL_Quit();
     return 0;
@@ -415,52 +432,18 @@ void join_path(char* path, char* filename, char* output_path)
     output_path[len] = '\0';
 }
 
-Model_Data* load_gltf_model_2(char* model_file)
-{
-    cgltf_options options;
-	memset(&options, 0, sizeof(cgltf_options));
-	cgltf_data* gltf_data = NULL;
-	cgltf_result result = cgltf_parse_file(&options, model_file, &gltf_data);
-
-    if (result == cgltf_result_success)
-		result = cgltf_load_buffers(&options, gltf_data, model_file);
-    else
-        printf("could not parse gltf file: %s \n", model_file);
-
-	if (result == cgltf_result_success)
-		result = cgltf_validate(gltf_data);
-    else
-         printf("could not load buffers ! \n");
-
-    Model_Data* model = NULL;
-
-    if(result == cgltf_result_success)
-    {
-        unsigned int meshes_count = gltf_data->meshes_count;
-        model = (Model_Data*)malloc(sizeof(Model_Data));
-        model->meshes = (Mesh_Data**)malloc(sizeof(Mesh_Data*) * meshes_count);
-        model->meshes_count = meshes_count;
-        for(unsigned int i = 0; i < meshes_count; i++)
-        {
-            model->meshes[i] = load_mesh(&gltf_data->meshes[i]);
-        }
-        model->texture = load_texture_from_memory(&gltf_data->textures[0], &options);
-    }
-
-    cgltf_free(gltf_data);
-
-    return model;
-}
-
-void free_model_2(Model_Data* model)
+/* loads the files around file_index in the background, the closest first */
+void prefetch_neighbour_models(Model_Lru_Cache* model_cache, Files_List* files_list, char* files_path, int file_index)
 {
-    for(unsigned int i = 0; i < model->meshes_count; i++)
+    char file_path[200];
+    int files_count = files_list->files_count;
+    for(int i = 1; i <= PREFETCH_FILES && i < files_count; i++)
     {
-        free_mesh(model->meshes[i]); model->meshes[i] = NULL;
+        join_path(files_path, files_list->files_names[(file_index + i) % files_count], file_path);
+        prefetch_cached_model(model_cache, file_path);
+        join_path(files_path, files_list->files_names[(file_index - i + files_count) % files_count], file_path);
+        prefetch_cached_model(model_cache, file_path);
     }
-    free(model->meshes);  model->meshes = NULL;
-    glDeleteTextures(1, &model->texture);
-    free(model);  model = NULL;
 }
 
 void model_transform(Shader *shader)
@@ -470,5 +453,5 @@ void model_transform(Shader *shader)
     model_mat = glm::scale(model_mat, glm::vec3(0.02f, 0.02f, 0.02f));
     model_mat = glm::rotate(model_mat, glm::radians(180.0f), glm::vec3(0.0f, 0.0f, 1.0f));
     model_mat = glm::rotate(model_mat, glm::radians(210.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-    glUniformMatrix4fv(glGetUniformLocation(shader->ID, "model"), 1, GL_FALSE, &model_mat[0][0]);
+    shader->setMat4(UNIFORM_MODEL, model_mat);
 }
@@ -0,0 +1,106 @@
+#include "glad.h"
+
+#include "gltf_loader.h"
+
+#include <chrono>
+
+/* micro benchmark of the key frame lookup used by interpolate_position/rotation/scaling:
+   plays every track from start to end at 60 fps (looping like update_skeletal_animation)
+   and reports the cost of one channel-sample for the linear scan and the cached cursor,
+   plus random seeks that always take the binary search path. */
+
+const int CHANNELS_COUNT = 69; // channels of one Omnimon clip
+const float KEY_FRAME_TIME = 1.0f / 30.0f;
+const float SAMPLE_TIME = 1.0f / 60.0f;
+
+double get_time_ns(void)
+{
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+Animation_Data* create_track(int keys_count)
+{
+    Animation_Data* data = (Animation_Data*)malloc(sizeof(Animation_Data));
+    data->type = cgltf_animation_path_type_translation;
+    data->count = keys_count;
+    data->cursor = 0;
+    data->time = (float*)malloc(sizeof(float) * keys_count);
+    data->trs = (float*)malloc(sizeof(float) * 3 * keys_count);
+    for(int i = 0; i < keys_count; i++)
+    {
+        data->time[i] = i * KEY_FRAME_TIME;
+        data->trs[i*3] = data->trs[i*3+1] = data->trs[i*3+2] = (float)i;
+    }
+    set_animation_data_interpolation(data);
+    return data;
+}
+
+int main(int argc, char *argv[])
+{
+    int keys_counts[] = {16, 64, 256, 1024, 4096};
+    int volatile sink = 0;
+
+    printf("channel-sample cost in ns (%d channels, %.0f fps playback) \n\n", CHANNELS_COUNT, 1.0f / SAMPLE_TIME);
+    printf("%8s %12s %12s %12s %12s \n", "keys", "linear", "cursor", "binary seek", "interp+cursor");
+
+    for(unsigned int k = 0; k < sizeof(keys_counts) / sizeof(int); k++)
+    {
+        int keys_count = keys_counts[k];
+        Animation_Data* tracks[CHANNELS_COUNT];
+        for(int i = 0; i < CHANNELS_COUNT; i++)
+            tracks[i] = create_track(keys_count);
+        float duration = tracks[0]->time[keys_count - 1];
+        int samples_count = (int)(duration / SAMPLE_TIME) * 2; // two loops of the clip
+        double samples = (double)samples_count * CHANNELS_COUNT;
+
+        // linear scan from the first key, the original lookup
+        double start = get_time_ns();
+        float animation_time = 0.0f;
+        for(int s = 0; s < samples_count; s++)
+        {
+            animation_time = fmod(animation_time + SAMPLE_TIME, duration);
+            for(int i = 0; i < CHANNELS_COUNT; i++)
+                sink += get_animation_frame_index(animation_time, tracks[i]->time, keys_count);
+        }
+        double linear_ns = (get_time_ns() - start) / samples;
+
+        // cached cursor
+        start = get_time_ns();
+        animation_time = 0.0f;
+        for(int s = 0; s < samples_count; s++)
+        {
+            animation_time = fmod(animation_time + SAMPLE_TIME, duration);
+            for(int i = 0; i < CHANNELS_COUNT; i++)
+                sink += find_animation_frame_index(tracks[i], animation_time);
+        }
+        double cursor_ns = (get_time_ns() - start) / samples;
+
+        // random seeks
+        srand(1);
+        start = get_time_ns();
+        for(int s = 0; s < samples_count; s++)
+        {
+            animation_time = duration * rand() / (float)RAND_MAX;
+            for(int i = 0; i < CHANNELS_COUNT; i++)
+                sink += find_animation_frame_index(tracks[i], animation_time);
+        }
+        double seek_ns = (get_time_ns() - start) / samples;
+
+        // full translation sample with the cursor
+        start = get_time_ns();
+        animation_time = 0.0f;
+        for(int s = 0; s < samples_count; s++)
+        {
+            animation_time = fmod(animation_time + SAMPLE_TIME, duration);
+            for(int i = 0; i < CHANNELS_COUNT; i++)
+                sink += (int)tracks[i]->interpolate_animation(tracks[i], animation_time)[3][0];
+        }
+        double interpolate_ns = (get_time_ns() - start) / samples;
+
+        printf("%8d %12.2f %12.2f %12.2f %12.2f \n", keys_count, linear_ns, cursor_ns, seek_ns, interpolate_ns);
+
+        for(int i = 0; i < CHANNELS_COUNT; i++)
+            free_animation_data(tracks[i]);
+    }
+    return 0;
+}
@@ -88,7 +88,7 @@ int main(int argc, char *argv[])
         printf("animations_count: %d \n",gltf_data->animations_count);
 	}
 
-    Model_Data* model = load_model(gltf_data, &options);
+    Model_Data* model = load_model(gltf_data, &options, NULL, 0);
     Model_Animation* animation = load_model_animation(&gltf_data->animations[0], gltf_data->nodes, model->anim_nodes);
     /*for(int i = 0; i < animation->anim_data_count; i++)
     {
@@ -130,8 +130,7 @@ int main(int argc, char *argv[])
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         // bind textures on corresponding texture units
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, model->texture);
+        bind_texture(0, GL_TEXTURE_2D, model->texture);
         //glBindTexture(GL_TEXTURE_2D, texture1);
         //glActiveTexture(GL_TEXTURE1);
         //glBindTexture(GL_TEXTURE_2D, texture2);
@@ -141,11 +140,11 @@ int main(int argc, char *argv[])
 
         // pass projection matrix to shader (note that in this case it could change every frame)
         glm::mat4 projection_mat = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        ourShader.setMat4("projection", projection_mat);
+        ourShader.setMat4(UNIFORM_PROJECTION, projection_mat);
 
         // camera/view transformation
         glm::mat4 view_mat = camera.GetViewMatrix();
-        ourShader.setMat4("view", view_mat);
+        ourShader.setMat4(UNIFORM_VIEW, view_mat);
 
         // calculate the model matrix for each object and pass it to shader before drawing
         dw1_model_transform(&ourShader);
@@ -153,7 +152,7 @@ int main(int argc, char *argv[])
         // render model
         for (unsigned int i = 0; i < model->meshes_count; i++)
         {
-            ourShader.setMat4("bone_matrix", model->meshes[i]->bone_matrix);
+            ourShader.setMat4(UNIFORM_BONE_MATRIX, model->meshes[i]->bone_matrix);
             draw_mesh(model->meshes[i]);
         }
 
@@ -163,7 +162,7 @@ int main(int argc, char *argv[])
 
     // optional: de-allocate all resources once they've outlived their purpose:
     // ------------------------------------------------------------------------
-    glDeleteProgram(ourShader.ID);
+    delete_shader_program(ourShader.ID);
 
     free_model_animation(animation);
     free_model(model);
@@ -271,7 +270,7 @@ void dw1_model_transform(Shader *shader)
     model_mat = glm::scale(model_mat, glm::vec3(0.02f, 0.02f, 0.02f));
     model_mat = glm::rotate(model_mat, glm::radians(180.0f), glm::vec3(0.0f, 0.0f, 1.0f));
     model_mat = glm::rotate(model_mat, glm::radians(210.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-    glUniformMatrix4fv(glGetUniformLocation(shader->ID, "model"), 1, GL_FALSE, &model_mat[0][0]);
+    shader->setMat4(UNIFORM_MODEL, model_mat);
 }
 
 void dw2_model_transform(Shader *shader)
@@ -279,7 +278,7 @@ void dw2_model_transform(Shader *shader)
     glm::mat4 model_mat = glm::mat4(1.0f); // make sure to initialize matrix to identity matrix first
     model_mat = glm::translate(model_mat, glm::vec3(10.0f, -20.0f, -40.0f)); // translate it down so it's at the center of the scene
     model_mat = glm::scale(model_mat, glm::vec3(0.02f, 0.02f, 0.02f));
-    glUniformMatrix4fv(glGetUniformLocation(shader->ID, "model"), 1, GL_FALSE, &model_mat[0][0]);
+    shader->setMat4(UNIFORM_MODEL, model_mat);
 }
 
 void dw3_model_transform(Shader *shader)
@@ -288,5 +287,5 @@ void dw3_model_transform(Shader *shader)
     model_mat = glm::translate(model_mat, glm::vec3(10.0f, 3.0f, 20.0f)); // translate it down so it's at the center of the scene
     model_mat = glm::rotate(model_mat, glm::radians(180.0f), glm::vec3(0.0f, 0.0f, 1.0f));
     model_mat = glm::rotate(model_mat, glm::radians(210.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-    glUniformMatrix4fv(glGetUniformLocation(shader->ID, "model"), 1, GL_FALSE, &model_mat[0][0]);
+    shader->setMat4(UNIFORM_MODEL, model_mat);
 }
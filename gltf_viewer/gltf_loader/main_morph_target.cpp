@@ -2,21 +2,26 @@
 #include "glad.h"
 
 #include "gltf_loader.h"
+#include "morph_engine.h"
 
 //#include <iostream>
 
 const char *vertexShaderSource = "#version 330 core\n"
     "layout (location = 0) in vec3 aPos;\n"
-    "layout (location = 1) in vec3 morph_target_1;\n"
-    "layout (location = 2) in vec3 morph_target_2;\n"
-    "uniform float weights[2]\n;"
+    "uniform sampler2D morph_blend;\n"
+    "uniform int morph_width;\n"
+    "uniform int morph_rows;\n"
     "vec3 translation = vec3(-0.5, -0.8, -0);\n"
+    "// weighted sum of the deltas of the vertex, see blend_morph_targets\n"
+    "vec3 morph_delta(int slot)\n"
+    "{\n"
+    "   ivec2 texel = ivec2(gl_VertexID % morph_width, gl_VertexID / morph_width + slot * morph_rows);\n"
+    "   return texelFetch(morph_blend, texel, 0).xyz;\n"
+    "}\n"
     "void main()\n"
     "{\n"
     "   /* gl_Position = transform * vec4(aPos, 1.0); */\n"
-    "   vec3 morph_pos = aPos + \n"
-    "       weights[0] * morph_target_1 + \n"
-    "       weights[1] * morph_target_2; \n"
+    "   vec3 morph_pos = aPos + morph_delta(0); \n"
     "   gl_Position = vec4(morph_pos + translation, 1.0); \n"
     "}\0";
 const char *fragmentShaderSource = "#version 330 core\n"
@@ -94,7 +99,8 @@ int main(int argc, char *argv[])
     anim_timer.duration = anim_data->time[anim_data->count-1];
     anim_timer.ticks_per_second = 0.001;
 	print_morph_target(primitive);
-	Morph_Target_Data* morph_target = read_morph_target(primitive);
+	Morph_Targets* morph_targets = load_morph_targets(primitive);
+	float* weights = (float*)malloc(sizeof(float) * morph_targets->targets_count);
 
 	cgltf_free(data);
 
@@ -138,29 +144,19 @@ int main(int argc, char *argv[])
     glDeleteShader(vertexShader);
     glDeleteShader(fragmentShader);
 
-    unsigned int VBO[3], VAO;
+    unsigned int VBO, VAO;
     glGenVertexArrays(1, &VAO);
-    glGenBuffers(3, VBO);
+    glGenBuffers(1, &VBO);
     // bind the Vertex Array Object first, then bind and set vertex buffer(s), and then configure vertex attributes(s).
     glBindVertexArray(VAO);
 
     // position attribute
-    glBindBuffer(GL_ARRAY_BUFFER, VBO[0]);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, vertex_array_size, vertex_array, GL_STATIC_DRAW);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
 
-    // morph target 1 geometry
-    glBindBuffer(GL_ARRAY_BUFFER, VBO[1]);
-    glBufferData(GL_ARRAY_BUFFER, morph_target->meshes[0].vertices_size, morph_target->meshes[0].vertices, GL_STATIC_DRAW);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)(0));
-    glEnableVertexAttribArray(1);
-
-    // morph target 2 geometry
-    glBindBuffer(GL_ARRAY_BUFFER, VBO[2]);
-    glBufferData(GL_ARRAY_BUFFER,  morph_target->meshes[1].vertices_size,  morph_target->meshes[1].vertices, GL_STATIC_DRAW);
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)(0));
-    glEnableVertexAttribArray(2);
+    // the target deltas are in the texture buffer of morph_targets, no attribute per target
 
     // note that this is allowed, the call to glVertexAttribPointer registered VBO as the vertex attribute's bound vertex buffer object so afterwards we can safely unbind
     glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -201,16 +197,13 @@ int main(int argc, char *argv[])
         glClear(GL_COLOR_BUFFER_BIT);
 
         // interpolate weights based on current animation time
-        glm::vec2 weights = update_morph_animation(anim_data, &anim_timer);
-
+        update_morph_animation(anim_data, &anim_timer, weights, morph_targets->targets_count);
+        blend_morph_targets(morph_targets, weights);
 
-        // get float array uniform location and set it
-        glUseProgram(shaderProgram);
-        unsigned int weightsLoc = glGetUniformLocation(shaderProgram, "weights");
-        unsigned int weights_array_size = 2;
-        glUniform1fv(weightsLoc, weights_array_size, glm::value_ptr(weights));
+        use_program(shaderProgram);
+        bind_morph_targets(morph_targets, shaderProgram, 0);
 
-        glBindVertexArray(VAO); // seeing as we only have a single VAO there's no need to bind it every time, but we'll do so to keep things a bit more organized
+        bind_vertex_array(VAO); // seeing as we only have a single VAO there's no need to bind it every time, but we'll do so to keep things a bit more organized
         glDrawArrays(GL_TRIANGLES, 0, vertex_count);
         // glBindVertexArray(0); // no need to unbind it every time
 
@@ -220,13 +213,15 @@ int main(int argc, char *argv[])
 
     // optional: de-allocate all resources once they've outlived their purpose:
     // ------------------------------------------------------------------------
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(3, VBO);
-    glDeleteProgram(shaderProgram);
+    print_morph_targets_stats(morph_targets);
+    delete_vertex_arrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+    delete_shader_program(shaderProgram);
 
     free(vertex_array);
     free_animation_data(anim_data);
-    free_morph_target(morph_target);
+    free(weights);
+    free_morph_targets(morph_targets);
 
     SDL_Quit();
 
@@ -0,0 +1,84 @@
+#include <SDL/SDL.h>
+#include "glad.h"
+
+#include "gltf_loader.h"
+
+#include <chrono>
+
+/* benchmark of the global transform pass: the recursive walk of calculate_animation_nodes_transform
+   from the root nodes against the linear pass over the depth sorted nodes (calculate_sorted_nodes_transform).
+   both passes run on the same posed model and must give the same bone matrices. */
+
+const int PASSES_COUNT = 200000;
+
+double get_time_ns(void)
+{
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void recursive_pass(Model_Data* model)
+{
+    for(unsigned int i = 0; i < model->root_nodes_count; i++)
+    {
+        calculate_animation_nodes_transform(model->root_nodes[i]);
+    }
+}
+
+double time_pass(Model_Data* model, void (*pass)(Model_Data*))
+{
+    double start = get_time_ns();
+    for(int i = 0; i < PASSES_COUNT; i++)
+    {
+        pass(model);
+    }
+    return (get_time_ns() - start) / PASSES_COUNT;
+}
+
+int main(int argc, char *argv[])
+{
+    char* model_file = (char*)"models/Omnimon/150OMGM.gltf";
+    if(argc > 1)
+        model_file = argv[1];
+
+    // the loader uploads meshes and texture, it needs a GL context
+    SDL_Init(SDL_INIT_VIDEO);
+    SDL_SetVideoMode(64, 64, 32, SDL_OPENGL);
+    if (!gladLoadGLLoader((GLADloadproc)SDL_GL_GetProcAddress))
+    {
+        printf("Failed to initialize GLAD \n");
+        return -1;
+    }
+
+    Model_Data* model = load_gltf_model(model_file);
+    if(model == NULL)
+    {
+        SDL_Quit();
+        return -1;
+    }
+    // pose the rig in the middle of the first animation
+    update_animation_frame_trs(model, model->curren_animation, model->curren_animation->duration * 0.5f);
+
+    glm::mat4* bone_matrices = (glm::mat4*)malloc(sizeof(glm::mat4) * model->meshes_count);
+    recursive_pass(model);
+    for(unsigned int i = 0; i < model->meshes_count; i++)
+        bone_matrices[i] = model->meshes[i]->bone_matrix;
+    calculate_sorted_nodes_transform(model);
+    int same_result = 1;
+    for(unsigned int i = 0; i < model->meshes_count; i++)
+        same_result &= memcmp(&bone_matrices[i], &model->meshes[i]->bone_matrix, sizeof(glm::mat4)) == 0;
+    free(bone_matrices);
+
+    double recursive_ns = time_pass(model, recursive_pass);
+    double linear_ns = time_pass(model, calculate_sorted_nodes_transform);
+
+    printf("%s: %u nodes, %u root nodes, same bone matrices: %s \n\n", model_file,
+           model->anim_nodes_count, model->root_nodes_count, same_result ? "yes" : "NO");
+    printf("%10s %12s %12s \n", "pass", "ns / pass", "ns / node");
+    printf("%10s %12.1f %12.2f \n", "recursive", recursive_ns, recursive_ns / model->anim_nodes_count);
+    printf("%10s %12.1f %12.2f \n", "linear", linear_ns, linear_ns / model->anim_nodes_count);
+    printf("\nspeedup: %.2fx \n", recursive_ns / linear_ns);
+
+    free_model(model);
+    SDL_Quit();
+    return 0;
+}
@@ -93,7 +93,7 @@ int main(int argc, char *argv[])
         printf("animations_count: %d \n",gltf_data->animations_count);
 	}
 
-    Model_Data* model = load_model(gltf_data, &options);
+    Model_Data* model = load_model(gltf_data, &options, NULL, 0);
     animations_count = model->animations_count;
     //model_animation* animation = load_model_animation(&gltf_data->animations[0], gltf_data->nodes, model->anim_nodes);
     /*for(int i = 0; i < animation->anim_data_count; i++)
@@ -0,0 +1,151 @@
+#include "glad.h"
+
+#include "gltf_loader.h"
+#include "cpu_skinning.h"
+
+#include <chrono>
+
+/* benchmark of the cpu skinning (cpu_skinning.h): a mesh of VERTICES_COUNT vertices (the vertices of
+   the skinned primitive of the file repeated, models/simple_skin.gltf by default) with 4 joints per
+   vertex out of JOINTS_COUNT random joint matrices, skinned by each kernel on one thread, then by the
+   best kernel on 1, 2, 4... threads up to the core count. the simd kernels must give the scalar result.
+   no GL context is needed. */
+
+const unsigned int VERTICES_COUNT = 1 << 20;
+const unsigned int JOINTS_COUNT = 64;
+const int PASSES_COUNT = 20;
+
+double get_time_ns(void)
+{
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+float random_float(float min, float max)
+{
+    return min + (max - min) * (float)rand() / RAND_MAX;
+}
+
+/* the vertices of the file mesh repeated up to vertices_count, each copy moved and with random joints */
+Cpu_Skin_Mesh* create_benchmark_mesh(Cpu_Skin_Mesh* file_mesh, unsigned int vertices_count)
+{
+    Cpu_Skin_Mesh* mesh = (Cpu_Skin_Mesh*)malloc(sizeof(Cpu_Skin_Mesh));
+    mesh->vertices_count = vertices_count;
+    mesh->positions = (Vec3*)malloc(sizeof(Vec3) * vertices_count);
+    mesh->normals = (Vec3*)malloc(sizeof(Vec3) * vertices_count);
+    mesh->bones = (Bone_Data*)malloc(sizeof(Bone_Data));
+    mesh->bones->weights = (Vec4*)malloc(sizeof(Vec4) * vertices_count);
+    mesh->bones->joints = (Vec4*)malloc(sizeof(Vec4) * vertices_count);
+    mesh->bones->weights_count = mesh->bones->joints_count = vertices_count;
+    mesh->bones->weights_size = mesh->bones->joints_size = vertices_count * sizeof(Vec4);
+    mesh->joints_used = JOINTS_COUNT;
+    mesh->output = (Skinned_Vertex*)malloc(sizeof(Skinned_Vertex) * vertices_count);
+    for(unsigned int i = 0; i < vertices_count; i++)
+    {
+        unsigned int source = i % file_mesh->vertices_count;
+        float offset = (float)(i / file_mesh->vertices_count % 100);
+        mesh->positions[i] = file_mesh->positions[source];
+        mesh->positions[i].x += offset;
+        mesh->normals[i] = file_mesh->normals[source];
+        float* joints = &mesh->bones->joints[i].x;
+        float* weights = &mesh->bones->weights[i].x;
+        float weights_sum = 0.0f;
+        // a quarter of the vertices have a single joint, like the rigid parts of a character
+        int used_joints = i % 4 == 0 ? 1 : 4;
+        for(int j = 0; j < 4; j++)
+        {
+            joints[j] = (float)(rand() % JOINTS_COUNT);
+            weights[j] = j < used_joints ? random_float(0.1f, 1.0f) : 0.0f;
+            weights_sum += weights[j];
+        }
+        for(int j = 0; j < 4; j++)
+            weights[j] /= weights_sum;
+    }
+    return mesh;
+}
+
+double time_skinning(Thread_Pool* pool, Cpu_Skin_Mesh* mesh, glm::mat4* joint_matrices, int kernel)
+{
+    double start = get_time_ns();
+    for(int i = 0; i < PASSES_COUNT; i++)
+        skin_mesh_parallel(pool, mesh, joint_matrices, JOINTS_COUNT, kernel);
+    return (get_time_ns() - start) / PASSES_COUNT;
+}
+
+float max_skinning_error(Skinned_Vertex* a, Skinned_Vertex* b, unsigned int count)
+{
+    float error = 0.0f;
+    const float* a_floats = &a[0].position.x;
+    const float* b_floats = &b[0].position.x;
+    for(unsigned int i = 0; i < count * 6; i++)
+        error = std::max(error, fabsf(a_floats[i] - b_floats[i]));
+    return error;
+}
+
+int main(int argc, char *argv[])
+{
+    char* model_file = (char*)"models/simple_skin.gltf";
+    if(argc > 1)
+        model_file = argv[1];
+
+    cgltf_options options = {};
+    cgltf_data* gltf_data = parse_gltf_file(model_file, &options, NULL);
+    if(gltf_data == NULL)
+        return -1;
+    Cpu_Skin_Mesh* file_mesh = NULL;
+    for(unsigned int i = 0; i < gltf_data->meshes_count && file_mesh == NULL; i++)
+        file_mesh = load_cpu_skin_mesh(&gltf_data->meshes[i].primitives[0]);
+    if(file_mesh == NULL)
+    {
+        printf("%s has no skinned mesh \n", model_file);
+        cgltf_free(gltf_data);
+        return -1;
+    }
+
+    srand(1);
+    Cpu_Skin_Mesh* mesh = create_benchmark_mesh(file_mesh, VERTICES_COUNT);
+    glm::mat4 joint_matrices[JOINTS_COUNT];
+    for(unsigned int i = 0; i < JOINTS_COUNT; i++)
+    {
+        glm::vec3 axis = glm::normalize(glm::vec3(random_float(-1.0f, 1.0f), random_float(-1.0f, 1.0f), 1.0f));
+        joint_matrices[i] = glm::translate(glm::mat4(1.0f), glm::vec3(random_float(-1.0f, 1.0f), random_float(-1.0f, 1.0f), 0.0f));
+        joint_matrices[i] = glm::rotate(joint_matrices[i], random_float(-3.0f, 3.0f), axis);
+    }
+
+    Skinned_Vertex* scalar_output = (Skinned_Vertex*)malloc(sizeof(Skinned_Vertex) * VERTICES_COUNT);
+    skin_mesh_parallel(NULL, mesh, joint_matrices, JOINTS_COUNT, CPU_SKINNING_SCALAR);
+    memcpy(scalar_output, mesh->output, sizeof(Skinned_Vertex) * VERTICES_COUNT);
+
+    printf("%s: %u vertices (%u in the file), %u joints, %d passes \n\n", model_file, VERTICES_COUNT,
+           file_mesh->vertices_count, JOINTS_COUNT, PASSES_COUNT);
+    printf("%8s %8s %12s %14s %12s \n", "kernel", "threads", "ms / pass", "Mvertices / s", "max error");
+    int best_kernel = cpu_skinning_kernel();
+    for(int kernel = 0; kernel <= best_kernel; kernel++)
+    {
+        double ns = time_skinning(NULL, mesh, joint_matrices, kernel);
+        printf("%8s %8d %12.3f %14.2f %12g \n", cpu_skinning_kernel_names[kernel], 1, ns / 1000000.0,
+               VERTICES_COUNT / ns * 1000.0, max_skinning_error(scalar_output, mesh->output, VERTICES_COUNT));
+    }
+    printf("\n");
+    unsigned int cores_count = std::max(std::thread::hardware_concurrency(), 1u);
+    double one_thread_ns = 0.0;
+    for(unsigned int threads_count = 1; ; threads_count *= 2)
+    {
+        threads_count = std::min(threads_count, cores_count);
+        Thread_Pool* pool = create_thread_pool(threads_count);
+        double ns = time_skinning(pool, mesh, joint_matrices, best_kernel);
+        if(threads_count == 1)
+            one_thread_ns = ns;
+        printf("%8s %8u %12.3f %14.2f %12g   speedup %.2fx \n", cpu_skinning_kernel_names[best_kernel], threads_count,
+               ns / 1000000.0, VERTICES_COUNT / ns * 1000.0, max_skinning_error(scalar_output, mesh->output, VERTICES_COUNT),
+               one_thread_ns / ns);
+        free_thread_pool(pool);
+        if(threads_count == cores_count)
+            break;
+    }
+
+    free(scalar_output);
+    free_cpu_skin_mesh(mesh);
+    free_cpu_skin_mesh(file_mesh);
+    cgltf_free(gltf_data);
+    return 0;
+}
@@ -0,0 +1,172 @@
+#include <SDL/SDL.h>
+#include "glad.h"
+
+#include "gltf_loader.h"
+#include "soft_rasterizer.h"
+
+#include "camera.h"
+
+/* the viewer without GPU: the model is loaded with MODEL_LOAD_NO_GPU, drawn by the software
+   rasterizer (soft_rasterizer.h) on the thread pool, and its color buffer is blitted to a software
+   SDL surface, no GL context is created. the frame time is shown in the window caption every second
+   and the totals of each stage are printed on exit. o and p change the animation. */
+
+void processInput(void);
+glm::mat4 soft_model_transform(int model_version);
+
+const unsigned int SCR_WIDTH = 640;
+const unsigned int SCR_HEIGHT = 480;
+
+Camera camera(glm::vec3(10.0f, 5.0f, 40.0f));
+
+int animation_index = 0;
+int animations_count;
+bool change_animation = true;
+
+bool main_loop = true;
+SDL_Event event;
+
+int main(int argc, char *argv[])
+{
+    char* model_file = (char*)"models/Omnimon/150OMGM.gltf";
+    int model_version = 1;
+    int threads_count = 0;
+    unsigned int load_flags = MODEL_LOAD_NO_GPU;
+
+    if(argc > 1 && argv[1][0] == '-' && argv[1][1] == 'h')
+    {
+        printf("main_soft_rasterizer.exe [file_name] [model_version:(1,2,3)] [threads] [-tim] \n\n");
+        return 0;
+    }
+    if(argc > 1)
+        model_file = argv[1];
+    if(argc > 2 && isdigit(argv[2][0]))
+        model_version = argv[2][0] - '0';
+    if(argc > 3 && isdigit(argv[3][0]))
+        threads_count = atoi(argv[3]);
+    if(argc > 4 && strcmp(argv[4], "-tim") == 0)
+        load_flags |= MODEL_LOAD_TIM_TEXTURE;
+
+    // 0 threads: one per core
+    Thread_Pool* pool = create_thread_pool(threads_count);
+    Model_Data* model = load_gltf_model_parallel(model_file, pool, load_flags);
+    if(model == NULL)
+    {
+        printf("could not load %s \n\n", model_file);
+        free_thread_pool(pool);
+        return 1;
+    }
+    animations_count = model->animations_count;
+
+    SDL_Init(SDL_INIT_VIDEO);
+    SDL_WM_SetCaption("gltf_viewer soft rasterizer",NULL);
+    SDL_Surface* screen = SDL_SetVideoMode(SCR_WIDTH, SCR_HEIGHT, 32, SDL_SWSURFACE);
+
+    Soft_Rasterizer* rasterizer = create_soft_rasterizer(SCR_WIDTH, SCR_HEIGHT, pool);
+    // the color buffer seen as a surface: RGBA bytes are R in the low byte of a little endian pixel
+    SDL_Surface* frame = SDL_CreateRGBSurfaceFrom(rasterizer->color, SCR_WIDTH, SCR_HEIGHT, 32, SCR_WIDTH * 4,
+                                                  0x000000ff, 0x0000ff00, 0x00ff0000, 0);
+    glm::mat4 model_mat = soft_model_transform(model_version);
+    printf("%s: %u threads, %s kernels \n\n", model_file, thread_pool_threads_count(pool), soft_raster_kernel_names[rasterizer->kernel]);
+
+    unsigned int last_frame = SDL_GetTicks();
+    unsigned int last_caption = last_frame;
+    unsigned int caption_frames = rasterizer->frames_count;
+    double caption_ms = 0.0;
+    while (main_loop)
+    {
+        unsigned int current_frame = SDL_GetTicks();
+        float delta_time = current_frame - last_frame;
+        last_frame = current_frame;
+
+        if(change_animation && animations_count > 0)
+        {
+             change_model_animation(model, animation_index);
+             change_animation = false;
+        }
+        update_skeletal_animation(model, delta_time);
+
+        processInput();
+
+        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+        double start = get_soft_time_ms();
+        render_soft_model(rasterizer, model, projection * camera.GetViewMatrix() * model_mat);
+        caption_ms += get_soft_time_ms() - start;
+
+        SDL_BlitSurface(frame, NULL, screen, NULL);
+        SDL_Flip(screen);
+
+        if(current_frame - last_caption >= 1000)
+        {
+            char caption[128];
+            unsigned int frames = rasterizer->frames_count - caption_frames;
+            sprintf(caption, "gltf_viewer soft rasterizer: %.2f ms per frame, %u frames/s", caption_ms / frames,
+                    frames * 1000 / (current_frame - last_caption));
+            SDL_WM_SetCaption(caption, NULL);
+            last_caption = current_frame;
+            caption_frames = rasterizer->frames_count;
+            caption_ms = 0.0;
+        }
+    }
+
+    print_soft_rasterizer_stats(rasterizer);
+    SDL_FreeSurface(frame);
+    free_soft_rasterizer(rasterizer);
+    free_model(model);
+    free_thread_pool(pool);
+    SDL_Quit();
+    return 0;
+}
+
+void processInput(void)
+{
+    while(SDL_PollEvent(&event) == 1)
+    {
+        switch(event.type)
+        {
+            case SDL_QUIT:
+                main_loop = false;
+                break;
+            case SDL_KEYDOWN:
+                switch(event.key.keysym.sym)
+                {
+                    case SDLK_ESCAPE:
+                        main_loop = false;
+                        break;
+                    case SDLK_p:
+                        animation_index += 1;
+                        if(animation_index > animations_count-1)
+                            animation_index = 0;
+                        change_animation = true;
+                        break;
+                    case SDLK_o:
+                        animation_index -= 1;
+                        if(animation_index < 0)
+                            animation_index = animations_count-1;
+                        change_animation = true;
+                        break;
+                    default:
+                        break;
+                }
+                break;
+        }
+    }
+}
+
+/* the dw*_model_transform of main.cpp as a matrix */
+glm::mat4 soft_model_transform(int model_version)
+{
+    glm::mat4 model_mat = glm::mat4(1.0f);
+    if(model_version == 2)
+        model_mat = glm::translate(model_mat, glm::vec3(10.0f, -20.0f, -40.0f));
+    else
+        model_mat = glm::translate(model_mat, glm::vec3(10.0f, 3.0f, 20.0f));
+    if(model_version != 3)
+        model_mat = glm::scale(model_mat, glm::vec3(0.02f, 0.02f, 0.02f));
+    if(model_version != 2)
+    {
+        model_mat = glm::rotate(model_mat, glm::radians(180.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+        model_mat = glm::rotate(model_mat, glm::radians(210.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    }
+    return model_mat;
+}
@@ -0,0 +1,193 @@
+#include <SDL/SDL.h>
+#include <dirent.h>
+#include "glad.h"
+
+#include "gltf_loader.h"
+#include "model_loader.h"
+#include "texture_array.h"
+
+#include "shader_s.h"
+#include "camera.h"
+
+/* mixed model scene: every model of a directory (models/Effects_dw1 by default) on a grid, their
+   textures packed in one Texture_Array so the whole scene binds a single texture per frame.
+   identical textures of different files are stored once, the packing stats are printed at load.
+   mouse and w a s d move the camera. */
+
+void processInput(void);
+
+const unsigned int SCR_WIDTH = 640;
+const unsigned int SCR_HEIGHT = 480;
+const int MAX_MODELS = 256;
+const float MODEL_SPACING = 3.0f;
+// the character textures are 128x256, the effect ones 32 texels high
+const int ARRAY_LAYER_WIDTH = 512;
+const int ARRAY_LAYER_HEIGHT = 256;
+const unsigned int ARRAY_LAYERS = 8;
+
+Camera camera(glm::vec3(0.0f, 10.0f, 30.0f), glm::vec3(0.0f, 1.0f, 0.0f), -90.0f, -20.0f);
+float lastX = SCR_WIDTH / 2.0f;
+float lastY = SCR_HEIGHT / 2.0f;
+bool firstMouse = true;
+float deltaTime = 0.0f;
+
+bool main_loop = true;
+SDL_Event event;
+Uint8* keys;
+
+int main(int argc, char *argv[])
+{
+    char* directory = (char*)"models/Effects_dw1";
+    if(argc > 1 && argv[1][0] == '-' && argv[1][1] == 'h')
+    {
+        printf("main_texture_array.exe [directory] \n\n");
+        return 0;
+    }
+    if(argc > 1)
+        directory = argv[1];
+
+    SDL_Init(SDL_INIT_VIDEO);
+    SDL_WM_SetCaption("gltf_viewer texture array",NULL);
+    SDL_SetVideoMode(SCR_WIDTH, SCR_HEIGHT, 32, SDL_OPENGL);
+    if (!gladLoadGLLoader((GLADloadproc)SDL_GL_GetProcAddress))
+    {
+        printf("Failed to initialize GLAD \n");
+        return -1;
+    }
+    glEnable(GL_DEPTH_TEST);
+
+    static Model_Data* models[MAX_MODELS];
+    int models_count = 0;
+    DIR* dir = opendir(directory);
+    struct dirent* entry;
+    while(dir != NULL && (entry = readdir(dir)) != NULL && models_count < MAX_MODELS)
+    {
+        char* dot = strrchr(entry->d_name, '.');
+        if(dot == NULL || strcmp(dot, ".gltf") != 0)
+            continue;
+        char file_path[512];
+        sprintf(file_path, "%s/%s", directory, entry->d_name);
+        Model_Data* model = load_static_model(file_path, NULL);
+        if(model != NULL)
+            models[models_count++] = model;
+    }
+    if(dir != NULL)
+        closedir(dir);
+    if(models_count == 0)
+    {
+        printf("no gltf file in %s \n", directory);
+        SDL_Quit();
+        return 1;
+    }
+
+    // the PlayStation textures are not filtered
+    Texture_Array* texture_array = create_texture_array(ARRAY_LAYER_WIDTH, ARRAY_LAYER_HEIGHT, ARRAY_LAYERS, GL_NEAREST);
+    int unpacked_count = 0;
+    for(int i = 0; i < models_count; i++)
+        unpacked_count += !pack_model_texture(texture_array, models[i]);
+    print_texture_array_stats(texture_array, models_count - unpacked_count);
+    if(unpacked_count > 0)
+        printf("%d models keep their own texture \n", unpacked_count);
+
+    Shader arrayShader("gltf_loader/shaders/model.vs", "gltf_loader/shaders/model_array.fs");
+    Shader modelShader("gltf_loader/shaders/model.vs", "gltf_loader/shaders/model.fs");
+    int side = (int)ceil(sqrt((double)models_count));
+
+    unsigned int last_ticks = SDL_GetTicks();
+    while (main_loop)
+    {
+        unsigned int ticks = SDL_GetTicks();
+        deltaTime = ticks - last_ticks;
+        last_ticks = ticks;
+        processInput();
+
+        glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glm::mat4 projection_mat = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 1000.0f);
+        glm::mat4 view_mat = camera.GetViewMatrix();
+        glm::mat4 identity(1.0f);
+
+        // packed models first, the array is bound once, then the ones which did not fit
+        for(int pass = 0; pass < 2; pass++)
+        {
+            Shader* shader = pass == 0 ? &arrayShader : &modelShader;
+            shader->use();
+            shader->setMat4(UNIFORM_PROJECTION, projection_mat);
+            shader->setMat4(UNIFORM_VIEW, view_mat);
+            shader->setMat4(UNIFORM_BONE_MATRIX, identity);
+            if(pass == 0)
+                bind_texture_array(texture_array);
+            for(int i = 0; i < models_count; i++)
+            {
+                Model_Data* model = models[i];
+                if((model->texture_array_image >= 0) != (pass == 0))
+                    continue;
+                glm::vec3 position(((i % side) - side / 2) * MODEL_SPACING, 0.0f, -(float)(i / side) * MODEL_SPACING);
+                glm::mat4 model_mat = glm::translate(glm::mat4(1.0f), position);
+                model_mat = glm::scale(model_mat, glm::vec3(0.005f, 0.005f, 0.005f));
+                model_mat = glm::rotate(model_mat, glm::radians(180.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+                shader->setMat4(UNIFORM_MODEL, model_mat);
+                bind_model_texture(model, shader->ID);
+                for(unsigned int j = 0; j < model->meshes_count; j++)
+                    draw_mesh(model->meshes[j]);
+            }
+        }
+        SDL_GL_SwapBuffers();
+    }
+
+    // redundant binds skipped by the render state tracker over the whole run
+    print_render_state_counters();
+    delete_shader_program(arrayShader.ID);
+    delete_shader_program(modelShader.ID);
+    for(int i = 0; i < models_count; i++)
+    {
+        unpack_model_texture(texture_array, models[i]);
+        free_static_model(models[i]);
+    }
+    free_texture_array(texture_array);
+    SDL_Quit();
+    return 0;
+}
+
+void processInput(void)
+{
+    while(SDL_PollEvent(&event) == 1)
+    {
+        switch(event.type)
+        {
+            case SDL_QUIT:
+                main_loop = false;
+                break;
+            case SDL_KEYDOWN:
+                if(event.key.keysym.sym == SDLK_ESCAPE)
+                    main_loop = false;
+                break;
+            case SDL_MOUSEMOTION:
+            {
+                float xpos = static_cast<float>(event.motion.x);
+                float ypos = static_cast<float>(event.motion.y);
+                if (firstMouse)
+                {
+                    lastX = xpos;
+                    lastY = ypos;
+                    firstMouse = false;
+                }
+                camera.ProcessMouseMovement(xpos - lastX, lastY - ypos);
+                lastX = xpos;
+                lastY = ypos;
+                break;
+            }
+        }
+    }
+
+    keys = SDL_GetKeyState(NULL);
+
+    if(keys[SDLK_w])
+        camera.ProcessKeyboard(FORWARD, deltaTime);
+    else if(keys[SDLK_a])
+        camera.ProcessKeyboard(BACKWARD, deltaTime);
+    if(keys[SDLK_s])
+        camera.ProcessKeyboard(LEFT, deltaTime);
+    else if(keys[SDLK_d])
+        camera.ProcessKeyboard(RIGHT, deltaTime);
+}
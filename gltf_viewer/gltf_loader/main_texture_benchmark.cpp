@@ -0,0 +1,126 @@
+#include <SDL/SDL.h>
+#include <dirent.h>
+#include "glad.h"
+
+#include "gltf_loader.h"
+
+#include <chrono>
+
+/* benchmark of the texture pipeline on a whole directory of models (models/Effects_dw1 by default):
+   decoding every embedded image one after the other against decoding them all on the thread pool,
+   then uploading them with glTexImage2D from client memory against upload_texture_image (PBO).
+   every upload pass ends with glFinish so the time covers the transfers. */
+
+const int MAX_FILES = 1024;
+
+double get_time_ms(void)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void free_images(Texture_Decode_Task* tasks, int count)
+{
+    for(int i = 0; i < count; i++)
+        free_texture_image(&tasks[i].image);
+}
+
+int main(int argc, char *argv[])
+{
+    char* directory = (char*)"models/Effects_dw1";
+    unsigned int threads_count = 0;
+    if(argc > 1)
+        directory = argv[1];
+    if(argc > 2 && isdigit(argv[2][0]))
+        threads_count = atoi(argv[2]);
+
+    SDL_Init(SDL_INIT_VIDEO);
+    SDL_SetVideoMode(64, 64, 32, SDL_OPENGL);
+    if (!gladLoadGLLoader((GLADloadproc)SDL_GL_GetProcAddress))
+    {
+        printf("Failed to initialize GLAD \n");
+        return -1;
+    }
+
+    // parse every gltf file of the directory, the images stay base64 in the uris
+    static cgltf_data* gltf_files[MAX_FILES];
+    static cgltf_options options[MAX_FILES];
+    int files_count = 0;
+    DIR* dir = opendir(directory);
+    struct dirent* entry;
+    while(dir != NULL && (entry = readdir(dir)) != NULL && files_count < MAX_FILES)
+    {
+        char* dot = strrchr(entry->d_name, '.');
+        if(dot == NULL || strcmp(dot, ".gltf") != 0)
+            continue;
+        char file_path[512];
+        sprintf(file_path, "%s/%s", directory, entry->d_name);
+        cgltf_data* gltf_data = parse_gltf_file(file_path, &options[files_count], NULL);
+        if(gltf_data != NULL && gltf_data->textures_count > 0)
+            gltf_files[files_count++] = gltf_data;
+        else if(gltf_data != NULL)
+            cgltf_free(gltf_data);
+    }
+    if(dir != NULL)
+        closedir(dir);
+    if(files_count == 0)
+    {
+        printf("no textured gltf file in %s \n", directory);
+        SDL_Quit();
+        return 1;
+    }
+
+    Thread_Pool* pool = create_thread_pool(threads_count);
+    Texture_Decode_Task* tasks = (Texture_Decode_Task*)malloc(sizeof(Texture_Decode_Task) * files_count);
+    unsigned int* textures = (unsigned int*)malloc(sizeof(unsigned int) * files_count);
+
+    double start = get_time_ms();
+    for(int i = 0; i < files_count; i++)
+        start_texture_decode(&tasks[i], &gltf_files[i]->textures[0], &options[i], NULL);
+    double serial_ms = get_time_ms() - start;
+    free_images(tasks, files_count);
+
+    start = get_time_ms();
+    for(int i = 0; i < files_count; i++)
+        start_texture_decode(&tasks[i], &gltf_files[i]->textures[0], &options[i], pool);
+    thread_pool_wait(pool);
+    double pool_ms = get_time_ms() - start;
+
+    size_t pixels_size = 0;
+    for(int i = 0; i < files_count; i++)
+        pixels_size += (size_t)tasks[i].image.width * tasks[i].image.height * 4;
+
+    start = get_time_ms();
+    for(int i = 0; i < files_count; i++)
+        textures[i] = create_texture_from_image(&tasks[i].image);
+    glFinish();
+    double direct_ms = get_time_ms() - start;
+    delete_textures(files_count, textures);
+
+    Texture_Upload_Buffer upload_buffer;
+    create_texture_upload_buffer(&upload_buffer);
+    start = get_time_ms();
+    for(int i = 0; i < files_count; i++)
+        textures[i] = upload_texture_image(&upload_buffer, &tasks[i].image);
+    glFinish();
+    double pbo_ms = get_time_ms() - start;
+    delete_textures(files_count, textures);
+    free_texture_upload_buffer(&upload_buffer);
+
+    printf("%s: %d textures, %.1f MB of pixels, %u decode threads \n\n", directory, files_count,
+           pixels_size / (1024.0 * 1024.0), thread_pool_threads_count(pool));
+    printf("%16s %10s \n", "pass", "ms");
+    printf("%16s %10.2f \n", "decode serial", serial_ms);
+    printf("%16s %10.2f \n", "decode pool", pool_ms);
+    printf("%16s %10.2f \n", "upload direct", direct_ms);
+    printf("%16s %10.2f \n", "upload pbo", pbo_ms);
+    printf("\ndecode speedup: %.2fx \n", serial_ms / pool_ms);
+
+    free_images(tasks, files_count);
+    free(tasks);
+    free(textures);
+    for(int i = 0; i < files_count; i++)
+        cgltf_free(gltf_files[i]);
+    free_thread_pool(pool);
+    SDL_Quit();
+    return 0;
+}
@@ -0,0 +1,93 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/* read only memory mapping of a whole file, pages are loaded on first access */
+typedef struct
+{
+    unsigned char* data;
+    size_t size;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+}Mapped_File;
+
+Mapped_File* map_file(const char* file_name)
+{
+    Mapped_File* mapped_file = (Mapped_File*)malloc(sizeof(Mapped_File));
+#ifdef _WIN32
+    mapped_file->file = CreateFileA(file_name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                                    FILE_ATTRIBUTE_NORMAL, NULL);
+    if(mapped_file->file == INVALID_HANDLE_VALUE)
+    {
+        free(mapped_file);
+        return NULL;
+    }
+    LARGE_INTEGER file_size;
+    GetFileSizeEx(mapped_file->file, &file_size);
+    mapped_file->size = (size_t)file_size.QuadPart;
+    mapped_file->mapping = CreateFileMappingA(mapped_file->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    mapped_file->data = NULL;
+    if(mapped_file->mapping != NULL)
+        mapped_file->data = (unsigned char*)MapViewOfFile(mapped_file->mapping, FILE_MAP_READ, 0, 0, 0);
+    if(mapped_file->data == NULL)
+    {
+        if(mapped_file->mapping != NULL)
+            CloseHandle(mapped_file->mapping);
+        CloseHandle(mapped_file->file);
+        free(mapped_file);
+        return NULL;
+    }
+#else
+    int file = open(file_name, O_RDONLY);
+    if(file < 0)
+    {
+        free(mapped_file);
+        return NULL;
+    }
+    struct stat file_stat;
+    fstat(file, &file_stat);
+    mapped_file->size = file_stat.st_size;
+    mapped_file->data = (unsigned char*)mmap(NULL, mapped_file->size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if(mapped_file->data == MAP_FAILED)
+    {
+        free(mapped_file);
+        return NULL;
+    }
+#endif
+    return mapped_file;
+}
+
+void unmap_file(Mapped_File* mapped_file)
+{
+#ifdef _WIN32
+    UnmapViewOfFile(mapped_file->data);
+    CloseHandle(mapped_file->mapping);
+    CloseHandle(mapped_file->file);
+#else
+    munmap(mapped_file->data, mapped_file->size);
+#endif
+    mapped_file->data = NULL;
+    free(mapped_file);  mapped_file = NULL;
+}
+
+#endif // MAPPED_FILE_H
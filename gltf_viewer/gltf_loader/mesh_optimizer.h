@@ -0,0 +1,179 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <stdlib.h>
+#include <string.h>
+
+/* index buffer optimizations for triangle lists.
+   optimize_vertex_cache reorders the triangles for the post-transform vertex cache with the
+   Tipsify algorithm (Sander, Nehab, Barczak 2007): it fans around the last emitted vertex and
+   jumps to the vertex that is still in the cache with the most triangles left, so most vertices
+   are reused before they leave a FIFO of cache_size entries. optimize_vertex_fetch then renumbers
+   the vertices in the order the triangles first use them, so the vertex buffer is read forward.
+   count_vertex_cache_misses simulates the FIFO cache, the misses per triangle are the ACMR
+   (average cache miss ratio, transformed vertices per triangle, 0.5 at best and 3 at worst)
+   print_mesh_optimization_stats gives for the whole model. */
+
+#define VERTEX_CACHE_SIZE 16
+
+/* a vertex is in the FIFO while less than cache_size vertices went in after it,
+   cache_time starts at 0 and time at cache_size + 1 so every vertex starts out of the cache */
+unsigned int count_vertex_cache_misses(unsigned int* indices, unsigned int indices_count, unsigned int vertices_count,
+                                       unsigned int cache_size)
+{
+    unsigned int* cache_time = (unsigned int*)calloc(vertices_count, sizeof(unsigned int));
+    unsigned int time = cache_size + 1;
+    unsigned int misses = 0;
+    for(unsigned int i = 0; i < indices_count; i++)
+    {
+        unsigned int vertex = indices[i];
+        if(time - cache_time[vertex] > cache_size)
+        {
+            cache_time[vertex] = time++;
+            misses++;
+        }
+    }
+    free(cache_time);
+    return misses;
+}
+
+typedef struct
+{
+    unsigned int* offsets;   // first triangle of each vertex in triangles, vertices_count + 1 entries
+    unsigned int* triangles; // triangles using each vertex
+    unsigned int* live;      // triangles not emitted yet of each vertex
+}Vertex_Adjacency;
+
+void build_vertex_adjacency(Vertex_Adjacency* adjacency, unsigned int* indices, unsigned int indices_count,
+                            unsigned int vertices_count)
+{
+    adjacency->offsets = (unsigned int*)calloc(vertices_count + 1, sizeof(unsigned int));
+    adjacency->triangles = (unsigned int*)malloc(sizeof(unsigned int) * indices_count);
+    adjacency->live = (unsigned int*)calloc(vertices_count, sizeof(unsigned int));
+    for(unsigned int i = 0; i < indices_count; i++)
+        adjacency->live[indices[i]]++;
+    for(unsigned int i = 0; i < vertices_count; i++)
+        adjacency->offsets[i + 1] = adjacency->offsets[i] + adjacency->live[i];
+    // offsets[v] is used as the write cursor, then shifted back
+    for(unsigned int i = 0; i < indices_count; i++)
+        adjacency->triangles[adjacency->offsets[indices[i]]++] = i / 3;
+    for(unsigned int i = vertices_count; i > 0; i--)
+        adjacency->offsets[i] = adjacency->offsets[i - 1];
+    adjacency->offsets[0] = 0;
+}
+
+void free_vertex_adjacency(Vertex_Adjacency* adjacency)
+{
+    free(adjacency->offsets);  adjacency->offsets = NULL;
+    free(adjacency->triangles);  adjacency->triangles = NULL;
+    free(adjacency->live);  adjacency->live = NULL;
+}
+
+/* in place, indices must be a triangle list of vertices lower than vertices_count */
+void optimize_vertex_cache(unsigned int* indices, unsigned int indices_count, unsigned int vertices_count,
+                           unsigned int cache_size)
+{
+    unsigned int triangles_count = indices_count / 3;
+    if(triangles_count == 0 || vertices_count == 0)
+        return;
+    Vertex_Adjacency adjacency;
+    build_vertex_adjacency(&adjacency, indices, triangles_count * 3, vertices_count);
+    unsigned int* cache_time = (unsigned int*)calloc(vertices_count, sizeof(unsigned int));
+    unsigned char* emitted = (unsigned char*)calloc(triangles_count, sizeof(unsigned char));
+    // every emitted vertex is pushed once per triangle, the stack can not hold more than the index count
+    unsigned int* dead_end = (unsigned int*)malloc(sizeof(unsigned int) * triangles_count * 3);
+    unsigned int* output = (unsigned int*)malloc(sizeof(unsigned int) * triangles_count * 3);
+    unsigned int dead_end_count = 0, output_count = 0;
+    unsigned int time = cache_size + 1;
+    unsigned int cursor = 0; // next vertex tried when the dead end stack is empty
+
+    int fanning_vertex = 0;
+    while(fanning_vertex >= 0)
+    {
+        unsigned int first_candidate = dead_end_count;
+        for(unsigned int i = adjacency.offsets[fanning_vertex]; i < adjacency.offsets[fanning_vertex + 1]; i++)
+        {
+            unsigned int triangle = adjacency.triangles[i];
+            if(emitted[triangle])
+                continue;
+            emitted[triangle] = 1;
+            for(unsigned int j = 0; j < 3; j++)
+            {
+                unsigned int vertex = indices[triangle * 3 + j];
+                output[output_count++] = vertex;
+                dead_end[dead_end_count++] = vertex;
+                adjacency.live[vertex]--;
+                if(time - cache_time[vertex] > cache_size)
+                    cache_time[vertex] = time++;
+            }
+        }
+        // the candidates are the vertices of the triangles just emitted, they are still in the cache
+        // unless fanning them would push them out (2 new vertices per triangle at worst)
+        fanning_vertex = -1;
+        int best_priority = -1;
+        for(unsigned int i = first_candidate; i < dead_end_count; i++)
+        {
+            unsigned int vertex = dead_end[i];
+            if(adjacency.live[vertex] == 0)
+                continue;
+            int priority = 0;
+            if(time - cache_time[vertex] + 2 * adjacency.live[vertex] <= cache_size)
+                priority = time - cache_time[vertex];
+            if(priority > best_priority)
+            {
+                best_priority = priority;
+                fanning_vertex = vertex;
+            }
+        }
+        // dead end: go back to a recent vertex with triangles left, else to the next one in input order
+        while(fanning_vertex < 0 && dead_end_count > 0)
+        {
+            unsigned int vertex = dead_end[--dead_end_count];
+            if(adjacency.live[vertex] > 0)
+                fanning_vertex = vertex;
+        }
+        while(fanning_vertex < 0 && cursor < vertices_count)
+        {
+            if(adjacency.live[cursor] > 0)
+                fanning_vertex = cursor;
+            cursor++;
+        }
+    }
+    memcpy(indices, output, sizeof(unsigned int) * output_count);
+    free(output);
+    free(dead_end);
+    free(emitted);
+    free(cache_time);
+    free_vertex_adjacency(&adjacency);
+}
+
+/* renumbers the vertices in order of first use and rewrites indices, returns the remap table
+   (new index of each old vertex) to reorder the vertex arrays with. unused vertices go last. */
+unsigned int* optimize_vertex_fetch(unsigned int* indices, unsigned int indices_count, unsigned int vertices_count)
+{
+    unsigned int* remap = (unsigned int*)malloc(sizeof(unsigned int) * vertices_count);
+    memset(remap, 0xff, sizeof(unsigned int) * vertices_count);
+    unsigned int next_vertex = 0;
+    for(unsigned int i = 0; i < indices_count; i++)
+    {
+        unsigned int vertex = indices[i];
+        if(remap[vertex] == 0xffffffffu)
+            remap[vertex] = next_vertex++;
+        indices[i] = remap[vertex];
+    }
+    for(unsigned int i = 0; i < vertices_count; i++)
+    {
+        if(remap[i] == 0xffffffffu)
+            remap[i] = next_vertex++;
+    }
+    return remap;
+}
+
+/* writes src[i] to dst[remap[i]], elements of element_size bytes */
+void remap_vertex_array(void* dst, const void* src, unsigned int* remap, unsigned int vertices_count, size_t element_size)
+{
+    for(unsigned int i = 0; i < vertices_count; i++)
+        memcpy((unsigned char*)dst + remap[i] * element_size, (const unsigned char*)src + i * element_size, element_size);
+}
+
+#endif // MESH_OPTIMIZER_H
@@ -0,0 +1,544 @@
+#ifndef MODEL_CACHE_H
+#define MODEL_CACHE_H
+
+#include <stdint.h>
+
+#include "gltf_loader.h"
+
+/* .gvc model cache: the prepared Model_Data of a gltf file baked into one versioned binary file.
+   every array sits at a 16 byte aligned offset from the start of the file and the node hierarchy
+   is stored as indices, so loading maps the file and points the meshes, animation tracks and
+   texture pixels straight into it. only little endian files written by the same version are accepted. */
+
+#define MODEL_CACHE_MAGIC 0x31435647 // "GVC1"
+#define MODEL_CACHE_VERSION 3
+#define MODEL_CACHE_BYTE_ORDER 0x01020304
+#define MODEL_CACHE_ALIGNMENT 16
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t file_size;
+    uint32_t meshes_count;
+    uint32_t meshes_offset;     // Model_Cache_Mesh array
+    uint32_t nodes_count;
+    uint32_t nodes_offset;      // Model_Cache_Node array
+    uint32_t root_nodes_count;
+    uint32_t root_nodes_offset; // uint32_t node indices
+    uint32_t animations_count;
+    uint32_t animations_offset; // Model_Cache_Animation array
+    uint32_t texture_width;
+    uint32_t texture_height;
+    uint32_t texture_offset;    // RGBA pixels, 0 when the model has no texture
+    int32_t texture_wrap_s;
+    int32_t texture_wrap_t;
+    int32_t texture_min_filter;
+    int32_t texture_mag_filter;
+}Model_Cache_Header;
+
+typedef struct
+{
+    uint32_t vertices_count;
+    uint32_t vertices_offset; // Vec3 array
+    uint32_t texcoord_count;
+    uint32_t texcoord_offset; // Vec2 array
+    uint32_t indices_count;
+    uint32_t indices_offset;  // uint32_t mesh local vertex indices
+}Model_Cache_Mesh;
+
+typedef struct
+{
+    int32_t mesh_index;       // -1 when the node has no mesh
+    int32_t parent_index;     // -1 for nodes without parent
+    uint32_t children_count;
+    uint32_t children_offset; // uint32_t node indices
+    float translation[3];     // rest TRS, see get_node_rest_trs
+    float rotation[4];        // x, y, z, w
+    float scale[3];
+}Model_Cache_Node;
+
+typedef struct
+{
+    uint32_t channels_count;
+    uint32_t channels_offset; // Model_Cache_Channel array
+    float duration;
+}Model_Cache_Animation;
+
+typedef struct
+{
+    int32_t type;
+    uint32_t count;
+    uint32_t target_node;
+    uint32_t time_offset;     // count floats
+    uint32_t trs_floats_count;
+    uint32_t trs_offset;
+}Model_Cache_Channel;
+
+typedef struct
+{
+    unsigned char* data;
+    size_t size;
+    size_t capacity;
+}Cache_Writer;
+
+#define cache_pointer(base, type, offset) ((type*)((unsigned char*)(base) + (offset)))
+
+/* appends size zeroed bytes at the next aligned offset and returns that offset */
+uint32_t cache_reserve(Cache_Writer* writer, size_t size)
+{
+    size_t offset = (writer->size + MODEL_CACHE_ALIGNMENT - 1) & ~(size_t)(MODEL_CACHE_ALIGNMENT - 1);
+    size_t new_size = offset + size;
+    if(new_size > writer->capacity)
+    {
+        writer->capacity = new_size * 2;
+        writer->data = (unsigned char*)realloc(writer->data, writer->capacity);
+    }
+    memset(writer->data + writer->size, 0, new_size - writer->size);
+    writer->size = new_size;
+    return offset;
+}
+
+uint32_t cache_write(Cache_Writer* writer, const void* data, size_t size)
+{
+    uint32_t offset = cache_reserve(writer, size);
+    if(size > 0)
+        memcpy(writer->data + offset, data, size);
+    return offset;
+}
+
+/* decodes the embedded image of the first texture to RGBA, returns NULL when there is none */
+unsigned char* read_model_texture_pixels(cgltf_data* gltf_data, int* width, int* height)
+{
+    if(gltf_data->textures_count == 0 || gltf_data->textures[0].image == NULL)
+        return NULL;
+    const char* base64 = get_base64_uri_data(gltf_data->textures[0].image->uri);
+    if(base64 == NULL)
+        return NULL;
+    unsigned int image_size = buffer_base64_size((char*)base64);
+    unsigned char* image_buffer = (unsigned char*)malloc(image_size);
+    unsigned char* pixels = NULL;
+    int channels_count;
+    if(base64_decode(base64, image_size, image_buffer))
+        pixels = stbi_load_from_memory(image_buffer, image_size, width, height, &channels_count, 4);
+    free(image_buffer);
+    return pixels;
+}
+
+void write_cache_meshes(Cache_Writer* writer, cgltf_data* gltf_data, bool optimize_meshes)
+{
+    Mesh_Optimization_Stats stats = {0, 0, 0};
+    uint32_t meshes_offset = cache_reserve(writer, sizeof(Model_Cache_Mesh) * gltf_data->meshes_count);
+    cache_pointer(writer->data, Model_Cache_Header, 0)->meshes_count = gltf_data->meshes_count;
+    cache_pointer(writer->data, Model_Cache_Header, 0)->meshes_offset = meshes_offset;
+    for(unsigned int i = 0; i < gltf_data->meshes_count; i++)
+    {
+        // the indexed (welded) mesh, as load_gltf_model prepares it
+        Mesh_Data* mesh_data = load_mesh_data(&gltf_data->meshes[i]);
+        if(optimize_meshes)
+            optimize_mesh(mesh_data, &stats);
+        uint32_t vertices_offset = cache_write(writer, mesh_data->vertices, mesh_data->vertices_size);
+        uint32_t texcoord_offset = cache_write(writer, mesh_data->texcoord, mesh_data->texcoord_size);
+        uint32_t indices_offset = cache_write(writer, mesh_data->indices, mesh_data->indices_count * sizeof(uint32_t));
+        Model_Cache_Mesh* mesh = cache_pointer(writer->data, Model_Cache_Mesh, meshes_offset) + i;
+        mesh->vertices_count = mesh_data->vertices_count;
+        mesh->vertices_offset = vertices_offset;
+        mesh->texcoord_count = mesh_data->texcoord_count;
+        mesh->texcoord_offset = texcoord_offset;
+        mesh->indices_count = mesh_data->indices_count;
+        mesh->indices_offset = indices_offset;
+        // no GL context here, free_mesh would delete buffers
+        free(mesh_data->vertices);
+        free(mesh_data->texcoord);
+        free(mesh_data->indices);
+        free(mesh_data->skin_vertices);
+        free(mesh_data);
+    }
+    print_mesh_optimization_stats(&stats);
+}
+
+void write_cache_nodes(Cache_Writer* writer, cgltf_data* gltf_data)
+{
+    uint32_t nodes_offset = cache_reserve(writer, sizeof(Model_Cache_Node) * gltf_data->nodes_count);
+    cache_pointer(writer->data, Model_Cache_Header, 0)->nodes_count = gltf_data->nodes_count;
+    cache_pointer(writer->data, Model_Cache_Header, 0)->nodes_offset = nodes_offset;
+    for(unsigned int i = 0; i < gltf_data->nodes_count; i++)
+    {
+        cgltf_node* gltf_node = &gltf_data->nodes[i];
+        uint32_t children_offset = cache_reserve(writer, sizeof(uint32_t) * gltf_node->children_count);
+        uint32_t* children = cache_pointer(writer->data, uint32_t, children_offset);
+        for(unsigned int j = 0; j < gltf_node->children_count; j++)
+        {
+            children[j] = gltf_node->children[j] - gltf_data->nodes;
+        }
+        Model_Cache_Node* node = cache_pointer(writer->data, Model_Cache_Node, nodes_offset) + i;
+        node->mesh_index = gltf_node->mesh != NULL ? gltf_node->mesh - gltf_data->meshes : -1;
+        node->parent_index = gltf_node->parent != NULL ? gltf_node->parent - gltf_data->nodes : -1;
+        node->children_count = gltf_node->children_count;
+        node->children_offset = children_offset;
+        glm::vec3 translation, scale;
+        glm::quat rotation;
+        get_node_rest_trs(gltf_node, &translation, &rotation, &scale);
+        memcpy(node->translation, glm::value_ptr(translation), sizeof(node->translation));
+        node->rotation[0] = rotation.x;  node->rotation[1] = rotation.y;
+        node->rotation[2] = rotation.z;  node->rotation[3] = rotation.w;
+        memcpy(node->scale, glm::value_ptr(scale), sizeof(node->scale));
+    }
+    uint32_t root_nodes_offset = cache_reserve(writer, sizeof(uint32_t) * gltf_data->scene->nodes_count);
+    uint32_t* root_nodes = cache_pointer(writer->data, uint32_t, root_nodes_offset);
+    for(unsigned int i = 0; i < gltf_data->scene->nodes_count; i++)
+    {
+        root_nodes[i] = gltf_data->scene->nodes[i] - gltf_data->nodes;
+    }
+    cache_pointer(writer->data, Model_Cache_Header, 0)->root_nodes_count = gltf_data->scene->nodes_count;
+    cache_pointer(writer->data, Model_Cache_Header, 0)->root_nodes_offset = root_nodes_offset;
+}
+
+void write_cache_animations(Cache_Writer* writer, cgltf_data* gltf_data)
+{
+    uint32_t animations_offset = cache_reserve(writer, sizeof(Model_Cache_Animation) * gltf_data->animations_count);
+    cache_pointer(writer->data, Model_Cache_Header, 0)->animations_count = gltf_data->animations_count;
+    cache_pointer(writer->data, Model_Cache_Header, 0)->animations_offset = animations_offset;
+    for(unsigned int i = 0; i < gltf_data->animations_count; i++)
+    {
+        cgltf_animation* gltf_anim = &gltf_data->animations[i];
+        uint32_t channels_offset = cache_reserve(writer, sizeof(Model_Cache_Channel) * gltf_anim->channels_count);
+        float duration = 0.0f;
+        for(unsigned int j = 0; j < gltf_anim->channels_count; j++)
+        {
+            cgltf_animation_channel* gltf_channel = &gltf_anim->channels[j];
+            float* time = read_accessor(gltf_channel->sampler->input);
+            float* trs = read_accessor(gltf_channel->sampler->output);
+            size_t trs_floats_count = float_count(gltf_channel->sampler->output);
+            uint32_t time_offset = cache_write(writer, time, gltf_channel->sampler->input->count * sizeof(float));
+            uint32_t trs_offset = cache_write(writer, trs, trs_floats_count * sizeof(float));
+            // same rule as load_model_animation: the first channel gives the clip duration
+            if(j == 0 && gltf_channel->sampler->input->count > 0)
+                duration = time[gltf_channel->sampler->input->count - 1];
+            free(time);
+            free(trs);
+            Model_Cache_Channel* channel = cache_pointer(writer->data, Model_Cache_Channel, channels_offset) + j;
+            channel->type = gltf_channel->target_path;
+            channel->count = gltf_channel->sampler->input->count;
+            channel->target_node = gltf_channel->target_node - gltf_data->nodes;
+            channel->time_offset = time_offset;
+            channel->trs_floats_count = trs_floats_count;
+            channel->trs_offset = trs_offset;
+        }
+        Model_Cache_Animation* animation = cache_pointer(writer->data, Model_Cache_Animation, animations_offset) + i;
+        animation->channels_count = gltf_anim->channels_count;
+        animation->channels_offset = channels_offset;
+        animation->duration = duration;
+    }
+}
+
+void write_cache_texture(Cache_Writer* writer, cgltf_data* gltf_data)
+{
+    int width = 0, height = 0;
+    unsigned char* pixels = read_model_texture_pixels(gltf_data, &width, &height);
+    if(pixels == NULL)
+    {
+        printf("model has no embedded texture \n");
+        return;
+    }
+    uint32_t texture_offset = cache_write(writer, pixels, width * height * 4);
+    stbi_image_free(pixels);
+    Model_Cache_Header* header = cache_pointer(writer->data, Model_Cache_Header, 0);
+    header->texture_width = width;
+    header->texture_height = height;
+    header->texture_offset = texture_offset;
+    cgltf_sampler* sampler = gltf_data->textures[0].sampler;
+    header->texture_wrap_s = sampler ? sampler->wrap_s : GL_REPEAT;
+    header->texture_wrap_t = sampler ? sampler->wrap_t : GL_REPEAT;
+    header->texture_min_filter = sampler && sampler->min_filter ? sampler->min_filter : GL_LINEAR;
+    header->texture_mag_filter = sampler && sampler->mag_filter ? sampler->mag_filter : GL_LINEAR;
+}
+
+/* files with skins whose meshes have no joints (one node per mesh, like the Digimon models) are rigid */
+bool has_skinned_primitives(cgltf_data* gltf_data)
+{
+    for(unsigned int i = 0; i < gltf_data->meshes_count; i++)
+    {
+        for(unsigned int j = 0; j < gltf_data->meshes[i].primitives_count; j++)
+        {
+            if(get_accessor(&gltf_data->meshes[i].primitives[j], cgltf_attribute_type_joints) != NULL)
+                return true;
+        }
+    }
+    return false;
+}
+
+/* offline bake step, does not need a GL context. returns 1 on success.
+ optimize_meshes: store the meshes reordered for the vertex cache (see optimize_mesh) */
+int bake_model_cache(char* gltf_file, char* cache_file, Thread_Pool* pool, bool optimize_meshes)
+{
+    cgltf_options options;
+    cgltf_data* gltf_data = parse_gltf_file(gltf_file, &options, pool);
+    if(gltf_data == NULL)
+        return 0;
+    if(has_skinned_primitives(gltf_data))
+    {
+        // the cache has no joints and weights, skinned models load from gltf
+        printf("skinned model, not cached: %s \n", gltf_file);
+        cgltf_free(gltf_data);
+        return 0;
+    }
+
+    Cache_Writer writer = {NULL, 0, 0};
+    cache_reserve(&writer, sizeof(Model_Cache_Header));
+    write_cache_meshes(&writer, gltf_data, optimize_meshes);
+    write_cache_nodes(&writer, gltf_data);
+    write_cache_animations(&writer, gltf_data);
+    write_cache_texture(&writer, gltf_data);
+    cgltf_free(gltf_data);
+
+    Model_Cache_Header* header = cache_pointer(writer.data, Model_Cache_Header, 0);
+    header->magic = MODEL_CACHE_MAGIC;
+    header->version = MODEL_CACHE_VERSION;
+    header->byte_order = MODEL_CACHE_BYTE_ORDER;
+    header->file_size = writer.size;
+
+    int success = 0;
+    FILE* file = fopen(cache_file, "wb");
+    if(file)
+    {
+        success = fwrite(writer.data, 1, writer.size, file) == writer.size;
+        fclose(file);
+    }
+    if(!success)
+        printf("could not write model cache: %s \n", cache_file);
+    else
+        printf("baked %s -> %s (%d bytes) \n", gltf_file, cache_file, (int)writer.size);
+    free(writer.data);
+    return success;
+}
+
+int cache_range_valid(Model_Cache_Header* header, uint32_t offset, uint64_t count, uint64_t element_size)
+{
+    return offset % 4 == 0 && (uint64_t)offset + count * element_size <= header->file_size;
+}
+
+/* checks every offset of the cache before anything points into it */
+int validate_model_cache(Mapped_File* mapped_file)
+{
+    if(mapped_file->size < sizeof(Model_Cache_Header))
+        return 0;
+    Model_Cache_Header* header = (Model_Cache_Header*)mapped_file->data;
+    if(header->magic != MODEL_CACHE_MAGIC || header->version != MODEL_CACHE_VERSION ||
+       header->byte_order != MODEL_CACHE_BYTE_ORDER || header->file_size != mapped_file->size)
+        return 0;
+    if(!cache_range_valid(header, header->meshes_offset, header->meshes_count, sizeof(Model_Cache_Mesh)) ||
+       !cache_range_valid(header, header->nodes_offset, header->nodes_count, sizeof(Model_Cache_Node)) ||
+       !cache_range_valid(header, header->root_nodes_offset, header->root_nodes_count, sizeof(uint32_t)) ||
+       !cache_range_valid(header, header->animations_offset, header->animations_count, sizeof(Model_Cache_Animation)))
+        return 0;
+    if(header->texture_offset != 0 &&
+       !cache_range_valid(header, header->texture_offset, (uint64_t)header->texture_width * header->texture_height, 4))
+        return 0;
+
+    Model_Cache_Mesh* meshes = cache_pointer(header, Model_Cache_Mesh, header->meshes_offset);
+    for(unsigned int i = 0; i < header->meshes_count; i++)
+    {
+        if(!cache_range_valid(header, meshes[i].vertices_offset, meshes[i].vertices_count, sizeof(Vec3)) ||
+           !cache_range_valid(header, meshes[i].texcoord_offset, meshes[i].texcoord_count, sizeof(Vec2)) ||
+           !cache_range_valid(header, meshes[i].indices_offset, meshes[i].indices_count, sizeof(uint32_t)))
+            return 0;
+        uint32_t* indices = cache_pointer(header, uint32_t, meshes[i].indices_offset);
+        for(unsigned int j = 0; j < meshes[i].indices_count; j++)
+        {
+            if(indices[j] >= meshes[i].vertices_count)
+                return 0;
+        }
+    }
+    Model_Cache_Node* nodes = cache_pointer(header, Model_Cache_Node, header->nodes_offset);
+    for(unsigned int i = 0; i < header->nodes_count; i++)
+    {
+        if(!cache_range_valid(header, nodes[i].children_offset, nodes[i].children_count, sizeof(uint32_t)))
+            return 0;
+        if(nodes[i].mesh_index >= (int32_t)header->meshes_count || nodes[i].parent_index >= (int32_t)header->nodes_count)
+            return 0;
+        uint32_t* children = cache_pointer(header, uint32_t, nodes[i].children_offset);
+        for(unsigned int j = 0; j < nodes[i].children_count; j++)
+        {
+            if(children[j] >= header->nodes_count)
+                return 0;
+        }
+    }
+    uint32_t* root_nodes = cache_pointer(header, uint32_t, header->root_nodes_offset);
+    for(unsigned int i = 0; i < header->root_nodes_count; i++)
+    {
+        if(root_nodes[i] >= header->nodes_count)
+            return 0;
+    }
+    Model_Cache_Animation* animations = cache_pointer(header, Model_Cache_Animation, header->animations_offset);
+    for(unsigned int i = 0; i < header->animations_count; i++)
+    {
+        if(!cache_range_valid(header, animations[i].channels_offset, animations[i].channels_count, sizeof(Model_Cache_Channel)))
+            return 0;
+        Model_Cache_Channel* channels = cache_pointer(header, Model_Cache_Channel, animations[i].channels_offset);
+        for(unsigned int j = 0; j < animations[i].channels_count; j++)
+        {
+            if(channels[j].target_node >= header->nodes_count ||
+               !cache_range_valid(header, channels[j].time_offset, channels[j].count, sizeof(float)) ||
+               !cache_range_valid(header, channels[j].trs_offset, channels[j].trs_floats_count, sizeof(float)))
+                return 0;
+            // the interpolators and pack_channels read a vec3 or a quat per key of a TRS channel
+            int32_t type = channels[j].type;
+            if(type != cgltf_animation_path_type_translation && type != cgltf_animation_path_type_rotation &&
+               type != cgltf_animation_path_type_scale)
+                return 0;
+            uint64_t key_floats = type == cgltf_animation_path_type_rotation ? 4 : 3;
+            if(channels[j].trs_floats_count != channels[j].count * key_floats)
+                return 0;
+        }
+    }
+    return 1;
+}
+
+Model_Data* load_model_cache(char* cache_file)
+{
+    Mapped_File* mapped_file = map_file(cache_file);
+    if(mapped_file == NULL)
+    {
+        printf("could not open model cache: %s \n", cache_file);
+        return NULL;
+    }
+    if(!validate_model_cache(mapped_file))
+    {
+        printf("invalid or outdated model cache: %s \n", cache_file);
+        unmap_file(mapped_file);
+        return NULL;
+    }
+    Model_Cache_Header* header = (Model_Cache_Header*)mapped_file->data;
+
+    Model_Data* model = (Model_Data*)malloc(sizeof(Model_Data));
+    model->cache_file = mapped_file;
+    // the node block first, a cyclic hierarchy fails before the GL objects are created
+    Model_Cache_Node* cache_nodes = cache_pointer(header, Model_Cache_Node, header->nodes_offset);
+    int* parent_indices = (int*)malloc(sizeof(int) * header->nodes_count);
+    for(unsigned int i = 0; i < header->nodes_count; i++)
+    {
+        parent_indices[i] = cache_nodes[i].parent_index;
+    }
+    bool nodes_sorted = allocate_sorted_nodes(model, parent_indices, header->nodes_count);
+    free(parent_indices);
+    if(!nodes_sorted)
+    {
+        printf("invalid model cache: %s \n", cache_file);
+        free(model);
+        unmap_file(mapped_file);
+        return NULL;
+    }
+
+    Model_Cache_Mesh* cache_meshes = cache_pointer(header, Model_Cache_Mesh, header->meshes_offset);
+    model->meshes_count = header->meshes_count;
+    model->meshes = (Mesh_Data**)malloc(sizeof(Mesh_Data*) * header->meshes_count);
+    for(unsigned int i = 0; i < header->meshes_count; i++)
+    {
+        Mesh_Data* mesh = (Mesh_Data*)malloc(sizeof(Mesh_Data));
+        mesh->vertices = cache_pointer(header, Vec3, cache_meshes[i].vertices_offset);
+        mesh->vertices_count = cache_meshes[i].vertices_count;
+        mesh->vertices_size = cache_meshes[i].vertices_count * sizeof(Vec3);
+        mesh->texcoord = cache_pointer(header, Vec2, cache_meshes[i].texcoord_offset);
+        mesh->texcoord_count = cache_meshes[i].texcoord_count;
+        mesh->texcoord_size = cache_meshes[i].texcoord_count * sizeof(Vec2);
+        mesh->indices = cache_pointer(header, unsigned int, cache_meshes[i].indices_offset);
+        mesh->indices_count = cache_meshes[i].indices_count;
+        mesh->VBO[0] = mesh->VBO[1] = mesh->EBO = 0;
+        mesh->skin_vertices = NULL;
+        model->meshes[i] = mesh;
+    }
+    clear_model_skins(model);
+    setup_model_buffer(model);
+
+    model->texture = 0;
+    model->palette_texture = 0;
+    model->palette_row = 0;
+    model->image_pixels = NULL;
+    model->image_width = model->image_height = 0;
+    model->texture_array_image = -1;
+    model->node_matrices = NULL;
+    if(header->texture_offset != 0)
+        model->texture = create_texture(cache_pointer(header, unsigned char, header->texture_offset),
+                                        header->texture_width, header->texture_height,
+                                        header->texture_wrap_s, header->texture_wrap_t,
+                                        header->texture_min_filter, header->texture_mag_filter);
+
+    for(unsigned int i = 0; i < header->nodes_count; i++)
+    {
+        Animation_Node* anim_node = model->anim_nodes[i];
+        anim_node->mesh = cache_nodes[i].mesh_index >= 0 ? model->meshes[cache_nodes[i].mesh_index] : NULL;
+        anim_node->children = (Animation_Node**)malloc(sizeof(Animation_Node*) * cache_nodes[i].children_count);
+        anim_node->rest_translation = glm::make_vec3(cache_nodes[i].translation);
+        anim_node->rest_rotation = get_glm_quat(cache_nodes[i].rotation);
+        anim_node->rest_scale = glm::make_vec3(cache_nodes[i].scale);
+        reset_node_rest_pose(anim_node);
+        anim_node->local_transform = anim_node->global_transform = glm::mat4(1.0f);
+        anim_node->trans_anim = anim_node->rot_anim = anim_node->scale_anim = NULL;
+    }
+    for(unsigned int i = 0; i < header->nodes_count; i++)
+    {
+        Animation_Node* anim_node = model->anim_nodes[i];
+        uint32_t* children = cache_pointer(header, uint32_t, cache_nodes[i].children_offset);
+        anim_node->parent = cache_nodes[i].parent_index >= 0 ? model->anim_nodes[cache_nodes[i].parent_index] : NULL;
+        anim_node->parent_index = anim_node->parent != NULL ? anim_node->parent - model->sorted_nodes : -1;
+        anim_node->children_count = cache_nodes[i].children_count;
+        for(unsigned int j = 0; j < cache_nodes[i].children_count; j++)
+        {
+            anim_node->children[j] = model->anim_nodes[children[j]];
+        }
+    }
+
+    uint32_t* root_nodes = cache_pointer(header, uint32_t, header->root_nodes_offset);
+    model->root_nodes_count = header->root_nodes_count;
+    model->root_nodes = (Animation_Node**)malloc(sizeof(Animation_Node*) * header->root_nodes_count);
+    for(unsigned int i = 0; i < header->root_nodes_count; i++)
+    {
+        model->root_nodes[i] = model->anim_nodes[root_nodes[i]];
+    }
+
+    Model_Cache_Animation* cache_animations = cache_pointer(header, Model_Cache_Animation, header->animations_offset);
+    model->animations_count = header->animations_count;
+    model->animations = (Model_Animation**)malloc(sizeof(Model_Animation*) * header->animations_count);
+    for(unsigned int i = 0; i < header->animations_count; i++)
+    {
+        Model_Cache_Channel* channels = cache_pointer(header, Model_Cache_Channel, cache_animations[i].channels_offset);
+        Model_Animation* model_anim = (Model_Animation*)malloc(sizeof(Model_Animation));
+        model_anim->anim_data_count = cache_animations[i].channels_count;
+        model_anim->anim_data = (Animation_Data**)malloc(sizeof(Animation_Data*) * cache_animations[i].channels_count);
+        model_anim->duration = cache_animations[i].duration;
+        model_anim->baked = NULL;
+        model_anim->packed = NULL;
+        for(unsigned int j = 0; j < cache_animations[i].channels_count; j++)
+        {
+            Animation_Data* data = (Animation_Data*)malloc(sizeof(Animation_Data));
+            data->type = channels[j].type;
+            data->count = channels[j].count;
+            data->cursor = 0;
+            data->time = cache_pointer(header, float, channels[j].time_offset);
+            data->trs = cache_pointer(header, float, channels[j].trs_offset);
+            data->target_node = model->anim_nodes[channels[j].target_node];
+            set_animation_data_interpolation(data);
+            model_anim->anim_data[j] = data;
+        }
+        model->animations[i] = model_anim;
+    }
+    model->curren_animation = NULL;
+    if(model->animations_count > 0)
+    {
+        model->curren_animation = model->animations[0];
+        load_animation_data(model->curren_animation);
+    }
+    init_animation_clock(model);
+    model->pose = NULL;
+    return model;
+}
+
+int is_model_cache_file(char* file_name)
+{
+    char* dot = strrchr(file_name, '.');
+    return dot != NULL && strcmp(dot, ".gvc") == 0;
+}
+
+#endif // MODEL_CACHE_H
@@ -0,0 +1,206 @@
+#ifndef MODEL_CROWD_H
+#define MODEL_CROWD_H
+
+#include "gltf_loader.h"
+
+/* instanced rendering of many copies of one model.
+   every animation of the model is baked (see bake_model_animation) and the frames of all of them
+   are stored one after the other in a single texture buffer, so instances playing different
+   animations still share one draw per mesh. each instance has its own world transform, animation
+   and time offset, update_model_crowd turns them into a per instance vertex stream
+   (world matrix, palette texels of the two frames around the time, lerp factor) and
+   draw_model_crowd issues one glDrawElementsInstanced per mesh node.
+   the frames of skinned models also hold the joint matrices (see bake_model_animation), the skinned
+   meshes blend them in the shader so skinned crowds cost the same draws as rigid ones. */
+
+typedef struct
+{
+    glm::mat4 transform;
+    unsigned int animation_index;
+    float time_offset;
+}Crowd_Instance;
+
+// per instance vertex attributes, locations 10 to 15 of model_crowd.vs
+typedef struct
+{
+    glm::mat4 transform;
+    int frame_1; // first texel of the frame matrices in the palette
+    int frame_2;
+    float frame_factor;
+}Crowd_Instance_Data;
+
+typedef struct
+{
+    Model_Data* model;
+    unsigned int instances_count;
+    unsigned int instances_size;
+    Crowd_Instance* instances;
+    Crowd_Instance_Data* instances_data;
+    unsigned int instance_buffer;
+    unsigned int* animation_frames; // first palette frame of each animation
+    unsigned int palette_buffer;
+    unsigned int palette_texture;
+}Model_Crowd;
+
+#define CROWD_INSTANCE_ATTRIBUTE 10 // after the vertex and skin attributes of the mesh VAOs, see set_model_vertex_attributes
+
+void setup_crowd_instance_attributes(Model_Crowd* crowd)
+{
+    unsigned int stride = sizeof(Crowd_Instance_Data);
+    for(unsigned int i = 0; i < crowd->model->meshes_count; i++)
+    {
+        bind_vertex_array(crowd->model->meshes[i]->VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, crowd->instance_buffer);
+        // a mat4 attribute takes 4 locations, one per column
+        for(unsigned int column = 0; column < 4; column++)
+        {
+            glVertexAttribPointer(CROWD_INSTANCE_ATTRIBUTE + column, 4, GL_FLOAT, GL_FALSE, stride,
+                                  (void*)(sizeof(glm::vec4) * column));
+            glEnableVertexAttribArray(CROWD_INSTANCE_ATTRIBUTE + column);
+            glVertexAttribDivisor(CROWD_INSTANCE_ATTRIBUTE + column, 1);
+        }
+        glVertexAttribIPointer(CROWD_INSTANCE_ATTRIBUTE + 4, 2, GL_INT, stride,
+                               (void*)offsetof(Crowd_Instance_Data, frame_1));
+        glEnableVertexAttribArray(CROWD_INSTANCE_ATTRIBUTE + 4);
+        glVertexAttribDivisor(CROWD_INSTANCE_ATTRIBUTE + 4, 1);
+        glVertexAttribPointer(CROWD_INSTANCE_ATTRIBUTE + 5, 1, GL_FLOAT, GL_FALSE, stride,
+                              (void*)offsetof(Crowd_Instance_Data, frame_factor));
+        glEnableVertexAttribArray(CROWD_INSTANCE_ATTRIBUTE + 5);
+        glVertexAttribDivisor(CROWD_INSTANCE_ATTRIBUTE + 5, 1);
+    }
+    bind_vertex_array(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/* animations that are not baked yet are baked at frame_rate */
+Model_Crowd* create_model_crowd(Model_Data* model, unsigned int instances_size, float frame_rate)
+{
+    Model_Crowd* crowd = (Model_Crowd*)malloc(sizeof(Model_Crowd));
+    crowd->model = model;
+    crowd->instances_count = 0;
+    crowd->instances_size = instances_size;
+    crowd->instances = (Crowd_Instance*)malloc(sizeof(Crowd_Instance) * instances_size);
+    crowd->instances_data = (Crowd_Instance_Data*)malloc(sizeof(Crowd_Instance_Data) * instances_size);
+
+    crowd->animation_frames = (unsigned int*)malloc(sizeof(unsigned int) * model->animations_count);
+    unsigned int frames_count = 0;
+    for(unsigned int i = 0; i < model->animations_count; i++)
+    {
+        if(model->animations[i]->baked == NULL)
+            model->animations[i]->baked = bake_model_animation(model, model->animations[i], frame_rate, true);
+        crowd->animation_frames[i] = frames_count;
+        frames_count += model->animations[i]->baked->frames_count;
+    }
+    unsigned int frame_size = sizeof(glm::mat4) * (model->anim_nodes_count + model->joints_count);
+    glGenBuffers(1, &crowd->palette_buffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, crowd->palette_buffer);
+    glBufferData(GL_TEXTURE_BUFFER, frame_size * frames_count, NULL, GL_STATIC_DRAW);
+    for(unsigned int i = 0; i < model->animations_count; i++)
+    {
+        Baked_Animation* baked = model->animations[i]->baked;
+        glBufferSubData(GL_TEXTURE_BUFFER, frame_size * crowd->animation_frames[i],
+                        frame_size * baked->frames_count, baked->matrices);
+    }
+    glGenTextures(1, &crowd->palette_texture);
+    bind_texture(0, GL_TEXTURE_BUFFER, crowd->palette_texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, crowd->palette_buffer);
+    bind_texture(0, GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    glGenBuffers(1, &crowd->instance_buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, crowd->instance_buffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(Crowd_Instance_Data) * instances_size, NULL, GL_STREAM_DRAW);
+    setup_crowd_instance_attributes(crowd);
+    return crowd;
+}
+
+/* returns the instance index, -1 when the crowd is full */
+int add_crowd_instance(Model_Crowd* crowd, glm::mat4 transform, unsigned int animation_index, float time_offset)
+{
+    if(crowd->instances_count == crowd->instances_size)
+        return -1;
+    Crowd_Instance* instance = &crowd->instances[crowd->instances_count];
+    instance->transform = transform;
+    instance->animation_index = animation_index < crowd->model->animations_count ? animation_index : 0;
+    instance->time_offset = time_offset;
+    return crowd->instances_count++;
+}
+
+void clear_model_crowd(Model_Crowd* crowd)
+{
+    crowd->instances_count = 0;
+}
+
+/* computes the frames of every instance at time (in seconds) and uploads them */
+void update_model_crowd(Model_Crowd* crowd, float time)
+{
+    unsigned int frame_matrices_count = crowd->model->anim_nodes_count + crowd->model->joints_count;
+    for(unsigned int i = 0; i < crowd->instances_count; i++)
+    {
+        Crowd_Instance* instance = &crowd->instances[i];
+        Crowd_Instance_Data* data = &crowd->instances_data[i];
+        Model_Animation* animation = crowd->model->animations[instance->animation_index];
+        float animation_time = 0.0f;
+        if(animation->duration > 0.0f)
+            animation_time = fmod(time + instance->time_offset, animation->duration);
+        unsigned int frame_1, frame_2;
+        get_baked_frames(animation->baked, animation_time, &frame_1, &frame_2, &data->frame_factor);
+        unsigned int first_frame = crowd->animation_frames[instance->animation_index];
+        data->transform = instance->transform;
+        data->frame_1 = (first_frame + frame_1) * frame_matrices_count * 4;
+        data->frame_2 = (first_frame + frame_2) * frame_matrices_count * 4;
+    }
+    // orphan the buffer so the driver does not wait for the draws of the last frame
+    glBindBuffer(GL_ARRAY_BUFFER, crowd->instance_buffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(Crowd_Instance_Data) * crowd->instances_size, NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(Crowd_Instance_Data) * crowd->instances_count, crowd->instances_data);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/* draws every instance with one draw call per mesh node, the shader must be model_crowd.vs */
+void draw_model_crowd(Model_Crowd* crowd, unsigned int shader_id)
+{
+    Model_Data* model = crowd->model;
+    if(crowd->instances_count == 0)
+        return;
+    glUniform1i(get_uniform_location(shader_id, UNIFORM_BONE_PALETTE), 1);
+    int bone_node_location = get_uniform_location(shader_id, UNIFORM_BONE_NODE);
+    int skinned_location = get_uniform_location(shader_id, UNIFORM_SKINNED);
+    // the joint matrices follow the node matrices in every frame
+    glUniform1i(get_uniform_location(shader_id, UNIFORM_JOINT_BASE), model->anim_nodes_count * 4);
+    bind_texture(1, GL_TEXTURE_BUFFER, crowd->palette_texture);
+    bind_model_texture(model, shader_id);
+    for(unsigned int i = 0; i < model->anim_nodes_count; i++)
+    {
+        Animation_Node* node = model->anim_nodes[i];
+        if(node->mesh == NULL)
+            continue;
+        glUniform1i(bone_node_location, i * 4);
+        Mesh_Data* mesh = node->mesh;
+        glUniform1i(skinned_location, mesh->skin_vertices != NULL);
+        bind_vertex_array(mesh->VAO);
+        glDrawElementsInstanced(GL_TRIANGLES, mesh->indices_count, mesh->index_type,
+                                (void*)((size_t)mesh->base_index * get_index_size(mesh->index_type)), crowd->instances_count);
+    }
+}
+
+void free_model_crowd(Model_Crowd* crowd)
+{
+    // the mesh VAOs outlive the crowd, stop them reading the instance buffer
+    for(unsigned int i = 0; i < crowd->model->meshes_count; i++)
+    {
+        bind_vertex_array(crowd->model->meshes[i]->VAO);
+        for(unsigned int j = 0; j < 6; j++)
+            glDisableVertexAttribArray(CROWD_INSTANCE_ATTRIBUTE + j);
+    }
+    bind_vertex_array(0);
+    glDeleteBuffers(1, &crowd->instance_buffer);
+    delete_textures(1, &crowd->palette_texture);
+    glDeleteBuffers(1, &crowd->palette_buffer);
+    free(crowd->animation_frames);  crowd->animation_frames = NULL;
+    free(crowd->instances);  crowd->instances = NULL;
+    free(crowd->instances_data);  crowd->instances_data = NULL;
+    free(crowd);  crowd = NULL;
+}
+
+#endif // MODEL_CROWD_H
@@ -0,0 +1,286 @@
+#ifndef MODEL_LOADER_H
+#define MODEL_LOADER_H
+
+#include "gltf_loader.h"
+
+/* background loading of static models (meshes and texture, no nodes or animations), the kind of
+   model main_effects browses. a worker thread parses the gltf file, decodes its base64 buffers
+   (on the thread pool when given), unpacks the accessors and decodes the texture image.
+   the render thread only creates the GL objects, update_model_load uploads a few meshes per call
+   so a frame never waits on a whole file, and picks the model up once it is ready. */
+
+typedef enum
+{
+    MODEL_LOAD_QUEUED,
+    MODEL_LOAD_DECODING,
+    MODEL_LOAD_UPLOADING, // decoded, the GL objects are created by update_model_load
+    MODEL_LOAD_READY,
+    MODEL_LOAD_FAILED
+}Model_Load_State;
+
+typedef struct
+{
+    char file_name[260];
+    Model_Load_State state;
+    bool cancelled; // set while decoding, the worker frees the load when it is done
+    Model_Data* model;
+    Texture_Image texture_image;
+    unsigned int uploaded_meshes;
+    size_t memory_size; // see get_static_model_memory_size
+}Model_Load;
+
+typedef struct Model_Loader
+{
+    std::thread thread;
+    std::deque<Model_Load*> loads;
+    std::mutex mutex;
+    std::condition_variable load_available;
+    Thread_Pool* pool; // only used by the worker thread
+    bool running;
+    Texture_Upload_Buffer upload_buffer;
+}Model_Loader;
+
+/* the cpu side of load_static_model: the meshes are read but have no GL objects and the texture
+   image is decoded in texture_image, on the pool while the meshes are read when one is given.
+   returns NULL on failure */
+Model_Data* decode_static_model(char* model_file, Thread_Pool* pool, Texture_Image* texture_image)
+{
+    cgltf_options options;
+    cgltf_data* gltf_data = parse_gltf_file(model_file, &options, pool);
+    texture_image->pixels = NULL;
+    texture_image->width = texture_image->height = 0;
+    if(gltf_data == NULL)
+        return NULL;
+
+    unsigned int meshes_count = gltf_data->meshes_count;
+    Model_Data* model = (Model_Data*)malloc(sizeof(Model_Data));
+    model->meshes = (Mesh_Data**)malloc(sizeof(Mesh_Data*) * meshes_count);
+    model->meshes_count = meshes_count;
+    Texture_Decode_Task texture_task;
+    cgltf_texture* gltf_texture = gltf_data->textures_count > 0 ? &gltf_data->textures[0] : NULL;
+    start_texture_decode(&texture_task, gltf_texture, &options, pool);
+    for(unsigned int i = 0; i < meshes_count; i++)
+    {
+        model->meshes[i] = load_mesh_data(&gltf_data->meshes[i]);
+    }
+    if(pool != NULL)
+        thread_pool_wait(pool);
+    *texture_image = texture_task.image;
+    model->texture = 0;
+    model->palette_texture = 0;
+    model->palette_row = 0;
+    model->image_pixels = NULL;
+    model->image_width = model->image_height = 0;
+    model->texture_array_image = -1;
+    model->node_matrices = NULL;
+    clear_model_skins(model);
+    model->cache_file = NULL;
+
+    cgltf_free(gltf_data);
+    return model;
+}
+
+/* bytes held by the model once uploaded: the cpu arrays the meshes keep, their vertex and
+   index buffers and the texture with its mipmaps */
+size_t get_static_model_memory_size(Model_Data* model, Texture_Image* texture_image)
+{
+    size_t memory_size = sizeof(Model_Data);
+    for(unsigned int i = 0; i < model->meshes_count; i++)
+    {
+        Mesh_Data* mesh = model->meshes[i];
+        size_t index_size = get_index_size(get_index_type(mesh->vertices_count));
+        memory_size += sizeof(Mesh_Data) + (mesh->vertices_size + mesh->texcoord_size) * 2 +
+                       mesh->indices_count * (sizeof(unsigned int) + index_size);
+    }
+    memory_size += (size_t)texture_image->width * texture_image->height * 4 * 4 / 3;
+    return memory_size;
+}
+
+/* frees a model of decode_static_model that has no GL objects yet, safe on any thread */
+void free_decoded_model(Model_Data* model, Texture_Image* texture_image)
+{
+    for(unsigned int i = 0; i < model->meshes_count; i++)
+    {
+        Mesh_Data* mesh = model->meshes[i];
+        free(mesh->vertices);
+        free(mesh->texcoord);
+        free(mesh->indices);
+        free(mesh->skin_vertices);
+        free(mesh);
+    }
+    free(model->meshes);  model->meshes = NULL;
+    free(model);  model = NULL;
+    free_texture_image(texture_image);
+}
+
+Model_Data* load_static_model(char* model_file, Thread_Pool* pool)
+{
+    Texture_Image texture_image;
+    Model_Data* model = decode_static_model(model_file, pool, &texture_image);
+    if(model == NULL)
+        return NULL;
+    for(unsigned int i = 0; i < model->meshes_count; i++)
+    {
+        setup_mesh(model->meshes[i]);
+    }
+    model->texture = create_texture_from_image(&texture_image);
+    free_texture_image(&texture_image);
+    return model;
+}
+
+/* also frees a model whose meshes are only partly uploaded */
+void free_static_model(Model_Data* model)
+{
+    for(unsigned int i = 0; i < model->meshes_count; i++)
+    {
+        free_mesh(model->meshes[i]); model->meshes[i] = NULL;
+    }
+    free(model->meshes);  model->meshes = NULL;
+    delete_textures(1, &model->texture);
+    delete_textures(1, &model->palette_texture);
+    free(model);  model = NULL;
+}
+
+void model_loader_worker(Model_Loader* loader)
+{
+    for(;;)
+    {
+        Model_Load* load;
+        {
+            std::unique_lock<std::mutex> lock(loader->mutex);
+            while(loader->running && loader->loads.empty())
+                loader->load_available.wait(lock);
+            if(!loader->running)
+                return;
+            load = loader->loads.front();
+            loader->loads.pop_front();
+            load->state = MODEL_LOAD_DECODING;
+        }
+        Texture_Image texture_image;
+        Model_Data* model = decode_static_model(load->file_name, loader->pool, &texture_image);
+        {
+            std::lock_guard<std::mutex> lock(loader->mutex);
+            if(!load->cancelled)
+            {
+                load->model = model;
+                load->texture_image = texture_image;
+                load->memory_size = model != NULL ? get_static_model_memory_size(model, &texture_image) : 0;
+                load->state = model != NULL ? MODEL_LOAD_UPLOADING : MODEL_LOAD_FAILED;
+                continue;
+            }
+        }
+        if(model != NULL)
+            free_decoded_model(model, &texture_image);
+        free(load);
+    }
+}
+
+/* pool is optional, when given the worker decodes the base64 buffers on it */
+Model_Loader* create_model_loader(Thread_Pool* pool)
+{
+    Model_Loader* loader = new Model_Loader;
+    loader->pool = pool;
+    loader->running = true;
+    create_texture_upload_buffer(&loader->upload_buffer);
+    loader->thread = std::thread(model_loader_worker, loader);
+    return loader;
+}
+
+/* queues the file for the worker thread, urgent loads go before the queued ones.
+   the load belongs to the caller until take_loaded_model or cancel_model_load */
+Model_Load* request_model_load(Model_Loader* loader, const char* model_file, bool urgent)
+{
+    Model_Load* load = (Model_Load*)malloc(sizeof(Model_Load));
+    strncpy(load->file_name, model_file, sizeof(load->file_name) - 1);
+    load->file_name[sizeof(load->file_name) - 1] = '\0';
+    load->state = MODEL_LOAD_QUEUED;
+    load->cancelled = false;
+    load->model = NULL;
+    load->texture_image.pixels = NULL;
+    load->uploaded_meshes = 0;
+    load->memory_size = 0;
+    {
+        std::lock_guard<std::mutex> lock(loader->mutex);
+        if(urgent)
+            loader->loads.push_front(load);
+        else
+            loader->loads.push_back(load);
+    }
+    loader->load_available.notify_one();
+    return load;
+}
+
+Model_Load_State get_model_load_state(Model_Loader* loader, Model_Load* load)
+{
+    std::lock_guard<std::mutex> lock(loader->mutex);
+    return load->state;
+}
+
+/* render thread: creates the GL objects of at most max_meshes meshes per call, then the texture.
+   returns true once the load is ready or failed */
+bool update_model_load(Model_Loader* loader, Model_Load* load, unsigned int max_meshes)
+{
+    Model_Load_State state = get_model_load_state(loader, load);
+    if(state != MODEL_LOAD_UPLOADING)
+        return state == MODEL_LOAD_READY || state == MODEL_LOAD_FAILED;
+    // the worker is done with the load, no lock needed from here
+    Model_Data* model = load->model;
+    for(unsigned int i = 0; i < max_meshes && load->uploaded_meshes < model->meshes_count; i++)
+    {
+        setup_mesh(model->meshes[load->uploaded_meshes++]);
+    }
+    if(load->uploaded_meshes < model->meshes_count)
+        return false;
+    model->texture = upload_texture_image(&loader->upload_buffer, &load->texture_image);
+    free_texture_image(&load->texture_image);
+    load->state = MODEL_LOAD_READY;
+    return true;
+}
+
+/* returns the model of a finished load (NULL when it failed) and frees the load */
+Model_Data* take_loaded_model(Model_Load* load)
+{
+    Model_Data* model = load->state == MODEL_LOAD_READY ? load->model : NULL;
+    free(load);
+    return model;
+}
+
+/* render thread: drops a load in any state */
+void cancel_model_load(Model_Loader* loader, Model_Load* load)
+{
+    {
+        std::lock_guard<std::mutex> lock(loader->mutex);
+        if(load->state == MODEL_LOAD_DECODING)
+        {
+            load->cancelled = true;
+            return;
+        }
+        if(load->state == MODEL_LOAD_QUEUED)
+        {
+            loader->loads.erase(std::find(loader->loads.begin(), loader->loads.end(), load));
+            free(load);
+            return;
+        }
+    }
+    if(load->model != NULL)
+    {
+        free_texture_image(&load->texture_image);
+        free_static_model(load->model);
+    }
+    free(load);
+}
+
+/* loads still owned by the caller must be cancelled or taken before */
+void free_model_loader(Model_Loader* loader)
+{
+    {
+        std::lock_guard<std::mutex> lock(loader->mutex);
+        loader->running = false;
+    }
+    loader->load_available.notify_all();
+    loader->thread.join();
+    free_texture_upload_buffer(&loader->upload_buffer);
+    delete loader;  loader = NULL;
+}
+
+#endif // MODEL_LOADER_H
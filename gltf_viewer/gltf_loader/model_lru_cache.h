@@ -0,0 +1,190 @@
+#ifndef MODEL_LRU_CACHE_H
+#define MODEL_LRU_CACHE_H
+
+#include "model_loader.h"
+
+/* bounded cache of static models keyed by file name, for browsing a directory of models.
+   every model is loaded by the Model_Loader, get_cached_model asks for the model to show
+   (urgent load) and prefetch_cached_model for the files the user may go to next (background load).
+   when the cache holds more than entries_size models or memory_budget bytes, the least recently
+   used ones are freed, never the model shown or the one requested to replace it. */
+
+typedef struct
+{
+    char file_name[260];
+    Model_Data* model;     // NULL until loaded
+    Model_Load* load;      // pending load, NULL once finished
+    bool failed;
+    size_t memory_size;
+    unsigned int last_use; // Model_Lru_Cache::use_counter at the last request
+}Cached_Model;
+
+typedef struct
+{
+    Model_Loader* loader;
+    Cached_Model* entries;
+    unsigned int entries_count;
+    unsigned int entries_size;
+    size_t memory_budget;
+    size_t memory_used;
+    unsigned int use_counter;
+    Cached_Model* shown; // last model returned by get_cached_model
+    char requested_file[260]; // last file passed to get_cached_model
+    unsigned int hits, misses;
+}Model_Lru_Cache;
+
+Model_Lru_Cache* create_model_lru_cache(Model_Loader* loader, unsigned int entries_size, size_t memory_budget)
+{
+    Model_Lru_Cache* cache = (Model_Lru_Cache*)malloc(sizeof(Model_Lru_Cache));
+    cache->loader = loader;
+    cache->entries = (Cached_Model*)malloc(sizeof(Cached_Model) * entries_size);
+    cache->entries_count = 0;
+    cache->entries_size = entries_size;
+    cache->memory_budget = memory_budget;
+    cache->memory_used = 0;
+    cache->use_counter = 0;
+    cache->shown = NULL;
+    cache->requested_file[0] = '\0';
+    cache->hits = cache->misses = 0;
+    return cache;
+}
+
+Cached_Model* find_cached_model(Model_Lru_Cache* cache, const char* model_file)
+{
+    for(unsigned int i = 0; i < cache->entries_count; i++)
+    {
+        if(strcmp(cache->entries[i].file_name, model_file) == 0)
+            return &cache->entries[i];
+    }
+    return NULL;
+}
+
+void free_cached_model(Model_Lru_Cache* cache, Cached_Model* entry)
+{
+    if(entry->load != NULL)
+        cancel_model_load(cache->loader, entry->load);
+    if(entry->model != NULL)
+        free_static_model(entry->model);
+    cache->memory_used -= entry->memory_size;
+    // the entries stay packed, the last one takes the freed slot
+    Cached_Model* last = &cache->entries[--cache->entries_count];
+    if(cache->shown == last)
+        cache->shown = entry;
+    *entry = *last;
+}
+
+/* frees least recently used entries until the cache fits in its budget with one more entry */
+void evict_cached_models(Model_Lru_Cache* cache, unsigned int entries_needed)
+{
+    while(cache->entries_count + entries_needed > cache->entries_size || cache->memory_used > cache->memory_budget)
+    {
+        Cached_Model* oldest = NULL;
+        for(unsigned int i = 0; i < cache->entries_count; i++)
+        {
+            Cached_Model* entry = &cache->entries[i];
+            if(entry != cache->shown && strcmp(entry->file_name, cache->requested_file) != 0 && (oldest == NULL || entry->last_use < oldest->last_use))
+                oldest = entry;
+        }
+        if(oldest == NULL)
+            return;
+        free_cached_model(cache, oldest);
+    }
+}
+
+Cached_Model* request_cached_model(Model_Lru_Cache* cache, const char* model_file, bool urgent)
+{
+    Cached_Model* entry = find_cached_model(cache, model_file);
+    if(entry == NULL)
+    {
+        evict_cached_models(cache, 1);
+        if(cache->entries_count == cache->entries_size)
+            return NULL;
+        entry = &cache->entries[cache->entries_count++];
+        strncpy(entry->file_name, model_file, sizeof(entry->file_name) - 1);
+        entry->file_name[sizeof(entry->file_name) - 1] = '\0';
+        entry->model = NULL;
+        entry->load = request_model_load(cache->loader, model_file, urgent);
+        entry->failed = false;
+        entry->memory_size = 0;
+    }
+    entry->last_use = ++cache->use_counter;
+    return entry;
+}
+
+/* returns the model when it is loaded, else starts or hurries its load and returns NULL */
+Model_Data* get_cached_model(Model_Lru_Cache* cache, const char* model_file)
+{
+    strncpy(cache->requested_file, model_file, sizeof(cache->requested_file) - 1);
+    cache->requested_file[sizeof(cache->requested_file) - 1] = '\0';
+    Cached_Model* entry = find_cached_model(cache, model_file);
+    if(entry != NULL && entry->model != NULL)
+    {
+        entry->last_use = ++cache->use_counter;
+        if(cache->shown != entry)
+            cache->hits++;
+        cache->shown = entry;
+        return entry->model;
+    }
+    if(entry != NULL && entry->failed)
+        return NULL;
+    if(entry != NULL && get_model_load_state(cache->loader, entry->load) == MODEL_LOAD_QUEUED)
+    {
+        // a prefetch still waiting in the queue, load it before the others
+        cancel_model_load(cache->loader, entry->load);
+        entry->load = request_model_load(cache->loader, model_file, true);
+    }
+    if(entry == NULL)
+        cache->misses++;
+    request_cached_model(cache, model_file, true);
+    return NULL;
+}
+
+void prefetch_cached_model(Model_Lru_Cache* cache, const char* model_file)
+{
+    request_cached_model(cache, model_file, false);
+}
+
+/* render thread, once per frame: uploads at most max_meshes meshes of the finished loads */
+void update_model_lru_cache(Model_Lru_Cache* cache, unsigned int max_meshes)
+{
+    for(unsigned int i = 0; i < cache->entries_count; i++)
+    {
+        Cached_Model* entry = &cache->entries[i];
+        if(entry->load == NULL)
+            continue;
+        unsigned int uploaded_meshes = entry->load->uploaded_meshes;
+        if(update_model_load(cache->loader, entry->load, max_meshes))
+        {
+            entry->memory_size = entry->load->memory_size;
+            entry->model = take_loaded_model(entry->load);
+            entry->load = NULL;
+            entry->failed = entry->model == NULL;
+            if(entry->failed)
+            {
+                printf("could not load model: %s \n", entry->file_name);
+                entry->memory_size = 0;
+            }
+            cache->memory_used += entry->memory_size;
+        }
+        unsigned int uploads = entry->load != NULL ? entry->load->uploaded_meshes :
+                               entry->model != NULL ? entry->model->meshes_count : uploaded_meshes;
+        uploads -= uploaded_meshes;
+        max_meshes = uploads < max_meshes ? max_meshes - uploads : 0;
+        if(max_meshes == 0)
+            break;
+    }
+    evict_cached_models(cache, 0);
+}
+
+void free_model_lru_cache(Model_Lru_Cache* cache)
+{
+    cache->shown = NULL;
+    while(cache->entries_count > 0)
+    {
+        free_cached_model(cache, &cache->entries[cache->entries_count - 1]);
+    }
+    free(cache->entries);  cache->entries = NULL;
+    free(cache);  cache = NULL;
+}
+
+#endif // MODEL_LRU_CACHE_H
@@ -0,0 +1,315 @@
+#ifndef MORPH_ENGINE_H
+#define MORPH_ENGINE_H
+
+#include "gltf_loader.h"
+
+/* morph targets of a primitive, any number of them, with their POSITION, NORMAL and TANGENT deltas.
+   a target only keeps the vertices it moves (sparse deltas), a facial rig target touches a few
+   hundred vertices of the head. the deltas of all the targets are in one texture buffer, MORPH_SLOTS
+   texels per delta at most: the position delta with the vertex index in w, then the normal and the
+   tangent deltas when the primitive has them.
+   blend_morph_targets adds the weighted deltas of the targets with a non zero weight in a float
+   texture (one texel per vertex and attribute): each delta texel is drawn as a point on the texel of
+   its vertex with additive blending, so the blend costs the deltas of the active targets only.
+   the vertex shader of the model then reads the sum of its vertex with texelFetch and gl_VertexID
+   (morph_delta in the shader of main_morph_target.cpp), the vertices must be drawn in the order of
+   the primitive. */
+
+#define MORPH_TEXTURE_WIDTH 1024
+#define MORPH_DELTA_EPSILON 1e-6f // smaller deltas are left out of the target
+#define MORPH_DELTAS_UNIT 3       // texture unit of the deltas during the blend
+
+enum
+{
+    MORPH_POSITION,
+    MORPH_NORMAL,
+    MORPH_TANGENT,
+    MORPH_SLOTS
+};
+
+const char* morph_blend_vertex_source = "#version 330 core\n"
+    "uniform samplerBuffer morph_deltas;\n"
+    "uniform int morph_slots;\n"
+    "uniform int morph_width;\n"
+    "uniform int morph_rows;\n"
+    "uniform float morph_weight;\n"
+    "out vec3 weighted_delta;\n"
+    "void main()\n"
+    "{\n"
+    "    int slot = gl_VertexID % morph_slots;\n"
+    "    int vertex = int(texelFetch(morph_deltas, gl_VertexID - slot).w);\n"
+    "    weighted_delta = morph_weight * texelFetch(morph_deltas, gl_VertexID).xyz;\n"
+    "    vec2 texel = vec2(vertex % morph_width, vertex / morph_width + slot * morph_rows) + 0.5;\n"
+    "    gl_Position = vec4(texel / vec2(morph_width, morph_rows * morph_slots) * 2.0 - 1.0, 0.0, 1.0);\n"
+    "}\n";
+const char* morph_blend_fragment_source = "#version 330 core\n"
+    "in vec3 weighted_delta;\n"
+    "out vec4 FragColor;\n"
+    "void main()\n"
+    "{\n"
+    "    FragColor = vec4(weighted_delta, 0.0);\n"
+    "}\n";
+
+typedef struct
+{
+    unsigned int first_delta;
+    unsigned int deltas_count;
+}Morph_Target;
+
+typedef struct
+{
+    unsigned int vertices_count;
+    unsigned int targets_count;
+    Morph_Target* targets;
+    unsigned int slots;          // texels per delta: position, normal, tangent
+    int normal_slot, tangent_slot; // -1 when the targets have no such deltas
+    unsigned int deltas_count;
+    float* deltas;               // deltas_count * slots texels of 4 floats
+    float* weights;              // weights of the last blend
+    unsigned int active_targets; // targets drawn by the last blend
+    int width, rows;             // blend texture of width x rows texels per slot
+    unsigned int delta_buffer, delta_texture;
+    unsigned int blend_texture, blend_framebuffer;
+    unsigned int blend_program, blend_vertex_array;
+    bool blended;                // false until the first blend
+}Morph_Targets;
+
+unsigned int compile_morph_blend_program(void)
+{
+    const char* sources[2] = {morph_blend_vertex_source, morph_blend_fragment_source};
+    unsigned int types[2] = {GL_VERTEX_SHADER, GL_FRAGMENT_SHADER};
+    unsigned int program = glCreateProgram();
+    int success;
+    char info_log[512];
+    for(int i = 0; i < 2; i++)
+    {
+        unsigned int shader = glCreateShader(types[i]);
+        glShaderSource(shader, 1, &sources[i], NULL);
+        glCompileShader(shader);
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+        if(!success)
+        {
+            glGetShaderInfoLog(shader, 512, NULL, info_log);
+            printf("morph blend shader: %s \n", info_log);
+        }
+        glAttachShader(program, shader);
+        glDeleteShader(shader);
+    }
+    glLinkProgram(program);
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if(!success)
+    {
+        glGetProgramInfoLog(program, 512, NULL, info_log);
+        printf("morph blend program: %s \n", info_log);
+    }
+    return program;
+}
+
+/* the delta accessor of the attribute in the target, NULL when the target does not move it */
+float* read_morph_target_attribute(cgltf_morph_target* target, cgltf_attribute_type type, unsigned int vertices_count)
+{
+    for(unsigned int i = 0; i < target->attributes_count; i++)
+    {
+        cgltf_attribute* attribute = &target->attributes[i];
+        if(attribute->type == type && attribute->data->count == vertices_count &&
+           cgltf_num_components(attribute->data->type) == 3)
+            return read_accessor(attribute->data);
+    }
+    return NULL;
+}
+
+bool has_morph_target_attribute(cgltf_primitive* primitive, cgltf_attribute_type type)
+{
+    for(unsigned int i = 0; i < primitive->targets_count; i++)
+    {
+        for(unsigned int j = 0; j < primitive->targets[i].attributes_count; j++)
+        {
+            if(primitive->targets[i].attributes[j].type == type)
+                return true;
+        }
+    }
+    return false;
+}
+
+bool is_morph_delta_zero(float* delta)
+{
+    return fabsf(delta[0]) < MORPH_DELTA_EPSILON && fabsf(delta[1]) < MORPH_DELTA_EPSILON &&
+           fabsf(delta[2]) < MORPH_DELTA_EPSILON;
+}
+
+/* reads the targets of the primitive and uploads their deltas, returns NULL when it has none */
+Morph_Targets* load_morph_targets(cgltf_primitive* primitive)
+{
+    cgltf_accessor* position_accessor = get_position_accessor(primitive);
+    if(primitive->targets_count == 0 || position_accessor == NULL)
+        return NULL;
+    Morph_Targets* morph = (Morph_Targets*)calloc(1, sizeof(Morph_Targets));
+    morph->vertices_count = position_accessor->count;
+    morph->targets_count = primitive->targets_count;
+    morph->targets = (Morph_Target*)malloc(sizeof(Morph_Target) * morph->targets_count);
+    morph->weights = (float*)calloc(morph->targets_count, sizeof(float));
+    morph->slots = 1;
+    morph->normal_slot = has_morph_target_attribute(primitive, cgltf_attribute_type_normal) ? morph->slots++ : -1;
+    morph->tangent_slot = has_morph_target_attribute(primitive, cgltf_attribute_type_tangent) ? morph->slots++ : -1;
+
+    unsigned int deltas_size = 1024;
+    morph->deltas = (float*)malloc(sizeof(float) * 4 * morph->slots * deltas_size);
+    cgltf_attribute_type types[MORPH_SLOTS] = {cgltf_attribute_type_position, cgltf_attribute_type_normal, cgltf_attribute_type_tangent};
+    int slots[MORPH_SLOTS] = {0, morph->normal_slot, morph->tangent_slot};
+    for(unsigned int i = 0; i < morph->targets_count; i++)
+    {
+        float* attributes[MORPH_SLOTS];
+        for(int j = 0; j < MORPH_SLOTS; j++)
+            attributes[j] = slots[j] >= 0 ? read_morph_target_attribute(&primitive->targets[i], types[j], morph->vertices_count) : NULL;
+        morph->targets[i].first_delta = morph->deltas_count;
+        for(unsigned int vertex = 0; vertex < morph->vertices_count; vertex++)
+        {
+            bool moved = false;
+            for(int j = 0; j < MORPH_SLOTS; j++)
+                moved |= attributes[j] != NULL && !is_morph_delta_zero(&attributes[j][vertex * 3]);
+            if(!moved)
+                continue;
+            if(morph->deltas_count == deltas_size)
+            {
+                deltas_size *= 2;
+                morph->deltas = (float*)realloc(morph->deltas, sizeof(float) * 4 * morph->slots * deltas_size);
+            }
+            float* delta = &morph->deltas[morph->deltas_count * morph->slots * 4];
+            memset(delta, 0, sizeof(float) * 4 * morph->slots);
+            for(int j = 0; j < MORPH_SLOTS; j++)
+            {
+                if(attributes[j] != NULL)
+                    memcpy(&delta[slots[j] * 4], &attributes[j][vertex * 3], sizeof(float) * 3);
+            }
+            delta[3] = (float)vertex;
+            morph->deltas_count++;
+        }
+        morph->targets[i].deltas_count = morph->deltas_count - morph->targets[i].first_delta;
+        for(int j = 0; j < MORPH_SLOTS; j++)
+            free(attributes[j]);
+    }
+
+    size_t deltas_bytes = sizeof(float) * 4 * morph->slots * std::max(morph->deltas_count, 1u);
+    glGenBuffers(1, &morph->delta_buffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, morph->delta_buffer);
+    glBufferData(GL_TEXTURE_BUFFER, deltas_bytes, morph->deltas_count > 0 ? morph->deltas : NULL, GL_STATIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    glGenTextures(1, &morph->delta_texture);
+    bind_texture(MORPH_DELTAS_UNIT, GL_TEXTURE_BUFFER, morph->delta_texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, morph->delta_buffer);
+
+    morph->width = std::min(morph->vertices_count, (unsigned int)MORPH_TEXTURE_WIDTH);
+    morph->rows = (morph->vertices_count + morph->width - 1) / morph->width;
+    glGenTextures(1, &morph->blend_texture);
+    bind_texture(0, GL_TEXTURE_2D, morph->blend_texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, morph->width, morph->rows * morph->slots, 0, GL_RGBA, GL_FLOAT, NULL);
+    int framebuffer = 0;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer);
+    glGenFramebuffers(1, &morph->blend_framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, morph->blend_framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, morph->blend_texture, 0);
+    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        printf("morph targets: the blend framebuffer is not complete \n");
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+    morph->blend_program = compile_morph_blend_program();
+    glGenVertexArrays(1, &morph->blend_vertex_array);
+    return morph;
+}
+
+void free_morph_targets(Morph_Targets* morph)
+{
+    delete_textures(1, &morph->delta_texture);
+    delete_textures(1, &morph->blend_texture);
+    delete_vertex_arrays(1, &morph->blend_vertex_array);
+    glDeleteBuffers(1, &morph->delta_buffer);
+    glDeleteFramebuffers(1, &morph->blend_framebuffer);
+    delete_shader_program(morph->blend_program);
+    free(morph->targets);  morph->targets = NULL;
+    free(morph->deltas);  morph->deltas = NULL;
+    free(morph->weights);  morph->weights = NULL;
+    free(morph);  morph = NULL;
+}
+
+/* sums the weighted deltas of the targets with a non zero weight in the blend texture,
+   nothing is drawn when the weights are those of the last blend */
+void blend_morph_targets(Morph_Targets* morph, const float* weights)
+{
+    if(morph->blended && memcmp(morph->weights, weights, sizeof(float) * morph->targets_count) == 0)
+        return;
+    memcpy(morph->weights, weights, sizeof(float) * morph->targets_count);
+    morph->blended = true;
+
+    // the caller may be drawing in its own framebuffer (post effects, headless rendering)
+    int framebuffer = 0;
+    int viewport[4];
+    float clear_color[4];
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glGetFloatv(GL_COLOR_CLEAR_VALUE, clear_color);
+    bool depth_test = glIsEnabled(GL_DEPTH_TEST);
+    bool blend = glIsEnabled(GL_BLEND);
+    int blend_source, blend_destination;
+    glGetIntegerv(GL_BLEND_SRC_RGB, &blend_source);
+    glGetIntegerv(GL_BLEND_DST_RGB, &blend_destination);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, morph->blend_framebuffer);
+    glViewport(0, 0, morph->width, morph->rows * morph->slots);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+
+    use_program(morph->blend_program);
+    bind_vertex_array(morph->blend_vertex_array);
+    bind_texture(MORPH_DELTAS_UNIT, GL_TEXTURE_BUFFER, morph->delta_texture);
+    glUniform1i(get_uniform_location(morph->blend_program, UNIFORM_MORPH_DELTAS), MORPH_DELTAS_UNIT);
+    glUniform1i(get_uniform_location(morph->blend_program, UNIFORM_MORPH_SLOTS), morph->slots);
+    glUniform1i(get_uniform_location(morph->blend_program, UNIFORM_MORPH_WIDTH), morph->width);
+    glUniform1i(get_uniform_location(morph->blend_program, UNIFORM_MORPH_ROWS), morph->rows);
+    int weight_location = get_uniform_location(morph->blend_program, UNIFORM_MORPH_WEIGHT);
+    morph->active_targets = 0;
+    for(unsigned int i = 0; i < morph->targets_count; i++)
+    {
+        Morph_Target* target = &morph->targets[i];
+        if(weights[i] == 0.0f || target->deltas_count == 0)
+            continue;
+        glUniform1f(weight_location, weights[i]);
+        glDrawArrays(GL_POINTS, target->first_delta * morph->slots, target->deltas_count * morph->slots);
+        morph->active_targets++;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    glClearColor(clear_color[0], clear_color[1], clear_color[2], clear_color[3]);
+    if(depth_test)
+        glEnable(GL_DEPTH_TEST);
+    if(!blend)
+        glDisable(GL_BLEND);
+    glBlendFunc(blend_source, blend_destination);
+}
+
+/* binds the blend texture on the unit for the shader drawing the primitive, which declares
+   morph_blend, morph_width, morph_rows, morph_normal_slot and morph_tangent_slot */
+void bind_morph_targets(Morph_Targets* morph, unsigned int shader_id, unsigned int unit)
+{
+    bind_texture(unit, GL_TEXTURE_2D, morph->blend_texture);
+    glUniform1i(get_uniform_location(shader_id, UNIFORM_MORPH_BLEND), unit);
+    glUniform1i(get_uniform_location(shader_id, UNIFORM_MORPH_WIDTH), morph->width);
+    glUniform1i(get_uniform_location(shader_id, UNIFORM_MORPH_ROWS), morph->rows);
+    glUniform1i(get_uniform_location(shader_id, UNIFORM_MORPH_NORMAL_SLOT), morph->normal_slot);
+    glUniform1i(get_uniform_location(shader_id, UNIFORM_MORPH_TANGENT_SLOT), morph->tangent_slot);
+}
+
+void print_morph_targets_stats(Morph_Targets* morph)
+{
+    printf("morph targets: %u targets, %u vertices, %u deltas (%.1f%% of dense), %u slots, %.1f KB, %u active \n",
+           morph->targets_count, morph->vertices_count, morph->deltas_count,
+           100.0f * morph->deltas_count / std::max(morph->targets_count * morph->vertices_count, 1u), morph->slots,
+           sizeof(float) * 4 * morph->slots * morph->deltas_count / 1024.0f, morph->active_targets);
+}
+
+#endif // MORPH_ENGINE_H
@@ -0,0 +1,144 @@
+#ifndef NODE_MATRIX_BUFFER_H
+#define NODE_MATRIX_BUFFER_H
+
+#include <stdio.h>
+#include <string.h>
+
+/* one uniform buffer holding the node matrices of every model drawn in a frame: each model writes
+   its matrices once per frame (write_node_matrices) and its draws bind their range of the buffer on
+   the Node_Matrices block of the shader, so no draw uploads a matrix uniform and the models of the
+   frame share a single upload.
+   the buffer has NODE_MATRIX_BUFFER_FRAMES regions used in turn. the region of the frame is mapped
+   unsynchronized while the GPU can still read the regions of the previous frames, a fence per region
+   makes the cpu wait in the rare case it comes back to a region the GPU has not finished reading.
+   GL 3.3 has no persistent mapping, the region is mapped in begin_node_matrix_frame and unmapped in
+   upload_node_matrices (the draws can not read a mapped buffer). */
+
+#define NODE_MATRIX_BUFFER_FRAMES 3
+
+typedef struct
+{
+    unsigned int buffer;
+    size_t frame_size;        // bytes of a region
+    size_t block_size;        // bytes bound per draw, the size of the Node_Matrices block
+    size_t alignment;         // GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+    unsigned int frame;       // region of the current frame
+    GLsync fences[NODE_MATRIX_BUFFER_FRAMES];
+    unsigned char* mapped;    // region of the current frame between begin and upload, else NULL
+    size_t used;              // bytes written in the region
+    unsigned int frames_count;
+    unsigned int waits;       // frames that waited on the GPU for their region
+    unsigned int overflows;   // writes that did not fit in the region
+}Node_Matrix_Buffer;
+
+size_t align_node_matrix_offset(size_t offset, size_t alignment)
+{
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+/* frame_matrices: matrices written per frame by all the models,
+   block_matrices: size of the matrix array of the Node_Matrices block in the shaders */
+Node_Matrix_Buffer* create_node_matrix_buffer(unsigned int frame_matrices, unsigned int block_matrices)
+{
+    Node_Matrix_Buffer* buffer = (Node_Matrix_Buffer*)calloc(1, sizeof(Node_Matrix_Buffer));
+    int alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    buffer->alignment = alignment > 0 ? alignment : 256;
+    buffer->block_size = block_matrices * sizeof(glm::mat4);
+    buffer->frame_size = align_node_matrix_offset(frame_matrices * sizeof(glm::mat4), buffer->alignment);
+    buffer->frame = NODE_MATRIX_BUFFER_FRAMES - 1;
+    glGenBuffers(1, &buffer->buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer->buffer);
+    // a range starting near the end of the last region is bound with the whole block size
+    glBufferData(GL_UNIFORM_BUFFER, buffer->frame_size * NODE_MATRIX_BUFFER_FRAMES + buffer->block_size, NULL, GL_STREAM_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    return buffer;
+}
+
+void free_node_matrix_buffer(Node_Matrix_Buffer* buffer)
+{
+    if(buffer->mapped != NULL)
+    {
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer->buffer);
+        glUnmapBuffer(GL_UNIFORM_BUFFER);
+    }
+    for(unsigned int i = 0; i < NODE_MATRIX_BUFFER_FRAMES; i++)
+    {
+        if(buffer->fences[i] != NULL)
+            glDeleteSync(buffer->fences[i]);
+    }
+    glDeleteBuffers(1, &buffer->buffer);
+    free(buffer);  buffer = NULL;
+}
+
+/* moves to the next region and maps it, once per frame before the models write their matrices */
+void begin_node_matrix_frame(Node_Matrix_Buffer* buffer)
+{
+    buffer->frame = (buffer->frame + 1) % NODE_MATRIX_BUFFER_FRAMES;
+    GLsync fence = buffer->fences[buffer->frame];
+    if(fence != NULL)
+    {
+        if(glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0) == GL_TIMEOUT_EXPIRED)
+        {
+            buffer->waits++;
+            while(glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED);
+        }
+        glDeleteSync(fence);
+        buffer->fences[buffer->frame] = NULL;
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer->buffer);
+    buffer->mapped = (unsigned char*)glMapBufferRange(GL_UNIFORM_BUFFER, buffer->frame * buffer->frame_size, buffer->frame_size,
+                                                      GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    buffer->used = 0;
+    buffer->frames_count++;
+}
+
+/* copies the matrices in the region, returns their offset in the buffer for bind_node_matrices
+   or -1 when the region is full or not mapped */
+long write_node_matrices(Node_Matrix_Buffer* buffer, const glm::mat4* matrices, unsigned int count)
+{
+    size_t size = count * sizeof(glm::mat4);
+    if(buffer->mapped == NULL || buffer->used + size > buffer->frame_size)
+    {
+        buffer->overflows++;
+        return -1;
+    }
+    memcpy(buffer->mapped + buffer->used, matrices, size);
+    long offset = buffer->frame * buffer->frame_size + buffer->used;
+    buffer->used = align_node_matrix_offset(buffer->used + size, buffer->alignment);
+    return offset;
+}
+
+/* unmaps the region, after the writes of the frame and before its draws */
+void upload_node_matrices(Node_Matrix_Buffer* buffer)
+{
+    if(buffer->mapped == NULL)
+        return;
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer->buffer);
+    // the store can be lost (screen mode change...), the next frame writes it again
+    if(!glUnmapBuffer(GL_UNIFORM_BUFFER))
+        printf("node matrix buffer: region %u lost \n", buffer->frame);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    buffer->mapped = NULL;
+}
+
+/* after the draws of the frame, the region is written again once the GPU is past this point */
+void end_node_matrix_frame(Node_Matrix_Buffer* buffer)
+{
+    buffer->fences[buffer->frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+/* the offset is one of write_node_matrices (plus a multiple of the alignment) */
+void bind_node_matrices(Node_Matrix_Buffer* buffer, size_t offset)
+{
+    glBindBufferRange(GL_UNIFORM_BUFFER, UNIFORM_BLOCK_NODE_MATRICES, buffer->buffer, offset, buffer->block_size);
+}
+
+void print_node_matrix_buffer_stats(Node_Matrix_Buffer* buffer)
+{
+    printf("node matrix buffer: %u frames, %d regions of %.1f KB, %u waits on the GPU, %u writes did not fit \n",
+           buffer->frames_count, NODE_MATRIX_BUFFER_FRAMES, buffer->frame_size / 1024.0f, buffer->waits, buffer->overflows);
+}
+
+#endif // NODE_MATRIX_BUFFER_H
@@ -0,0 +1,242 @@
+#ifndef PNG_WRITER_H
+#define PNG_WRITER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <algorithm>
+
+/* RGBA png files for the headless frames (headless_renderer.h). the rows are written with the
+   "up" filter (difference with the row above) and compressed by a small deflate: fixed huffman codes
+   and one candidate match per 3 byte hash, no lazy matching. a thumbnail is mostly background and
+   flat colored polygons, that is a few percent of the raw size for a fraction of zlib's time. */
+
+#define PNG_HASH_BITS 15
+#define PNG_WINDOW_SIZE 32768
+#define PNG_MIN_MATCH 3
+#define PNG_MAX_MATCH 258
+
+typedef struct
+{
+    unsigned char* data;
+    size_t size;
+    size_t capacity;
+    uint32_t bits;       // bits not written yet, the first one in bit 0
+    int bits_count;
+}Png_Stream;
+
+const unsigned short png_length_base[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+const unsigned char png_length_extra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+const unsigned short png_distance_base[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+const unsigned char png_distance_extra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+void png_stream_reserve(Png_Stream* stream, size_t size)
+{
+    if(stream->size + size <= stream->capacity)
+        return;
+    while(stream->size + size > stream->capacity)
+        stream->capacity = stream->capacity > 0 ? stream->capacity * 2 : 4096;
+    stream->data = (unsigned char*)realloc(stream->data, stream->capacity);
+}
+
+void png_write_byte(Png_Stream* stream, unsigned char byte)
+{
+    png_stream_reserve(stream, 1);
+    stream->data[stream->size++] = byte;
+}
+
+void png_write_u32(Png_Stream* stream, uint32_t value) // big endian
+{
+    png_write_byte(stream, value >> 24);
+    png_write_byte(stream, value >> 16);
+    png_write_byte(stream, value >> 8);
+    png_write_byte(stream, value);
+}
+
+void png_write_bits(Png_Stream* stream, uint32_t value, int count)
+{
+    stream->bits |= value << stream->bits_count;
+    stream->bits_count += count;
+    while(stream->bits_count >= 8)
+    {
+        png_write_byte(stream, stream->bits & 0xff);
+        stream->bits >>= 8;
+        stream->bits_count -= 8;
+    }
+}
+
+/* huffman codes are sent from their highest bit */
+void png_write_code(Png_Stream* stream, uint32_t code, int length)
+{
+    uint32_t reversed = 0;
+    for(int i = 0; i < length; i++)
+        reversed |= ((code >> i) & 1) << (length - 1 - i);
+    png_write_bits(stream, reversed, length);
+}
+
+/* fixed huffman code of a literal/length symbol */
+void png_write_symbol(Png_Stream* stream, int symbol)
+{
+    if(symbol < 144)
+        png_write_code(stream, 0x30 + symbol, 8);
+    else if(symbol < 256)
+        png_write_code(stream, 0x190 + symbol - 144, 9);
+    else if(symbol < 280)
+        png_write_code(stream, symbol - 256, 7);
+    else
+        png_write_code(stream, 0xc0 + symbol - 280, 8);
+}
+
+void png_write_match(Png_Stream* stream, int length, int distance)
+{
+    int code = 28;
+    while(png_length_base[code] > length)
+        code--;
+    png_write_symbol(stream, 257 + code);
+    png_write_bits(stream, length - png_length_base[code], png_length_extra[code]);
+    code = 29;
+    while(png_distance_base[code] > distance)
+        code--;
+    png_write_code(stream, code, 5);
+    png_write_bits(stream, distance - png_distance_base[code], png_distance_extra[code]);
+}
+
+uint32_t png_hash(const unsigned char* data)
+{
+    uint32_t value = data[0] | (data[1] << 8) | (data[2] << 16);
+    return (value * 2654435761u) >> (32 - PNG_HASH_BITS);
+}
+
+/* zlib stream of the data: one final deflate block with the fixed codes */
+void png_deflate(Png_Stream* stream, const unsigned char* data, size_t size)
+{
+    png_write_byte(stream, 0x78);
+    png_write_byte(stream, 0x01);
+    png_write_bits(stream, 1, 1); // final block
+    png_write_bits(stream, 1, 2); // fixed huffman codes
+    int* last_positions = (int*)malloc(sizeof(int) << PNG_HASH_BITS);
+    memset(last_positions, 0xff, sizeof(int) << PNG_HASH_BITS);
+    size_t position = 0;
+    while(position < size)
+    {
+        int length = 0;
+        int distance = 0;
+        if(position + PNG_MIN_MATCH <= size)
+        {
+            uint32_t hash = png_hash(&data[position]);
+            int candidate = last_positions[hash];
+            last_positions[hash] = (int)position;
+            if(candidate >= 0 && position - candidate <= PNG_WINDOW_SIZE)
+            {
+                size_t max_length = std::min((size_t)PNG_MAX_MATCH, size - position);
+                while((size_t)length < max_length && data[candidate + length] == data[position + length])
+                    length++;
+                distance = (int)(position - candidate);
+            }
+        }
+        if(length >= PNG_MIN_MATCH)
+        {
+            png_write_match(stream, length, distance);
+            position += length;
+        }
+        else
+            png_write_symbol(stream, data[position++]);
+    }
+    free(last_positions);
+    png_write_symbol(stream, 256); // end of block
+    png_write_bits(stream, 0, 7);  // flush the last byte
+    stream->bits = 0;
+    stream->bits_count = 0;
+    uint32_t a = 1, b = 0;         // adler32 of the uncompressed data
+    for(size_t i = 0; i < size; i++)
+    {
+        a = (a + data[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    png_write_u32(stream, (b << 16) | a);
+}
+
+uint32_t png_crc(const unsigned char* data, size_t size)
+{
+    static uint32_t table[256];
+    static bool table_ready = false;
+    if(!table_ready)
+    {
+        for(uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t c = i;
+            for(int k = 0; k < 8; k++)
+                c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+        table_ready = true;
+    }
+    uint32_t crc = 0xffffffffu;
+    for(size_t i = 0; i < size; i++)
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return crc ^ 0xffffffffu;
+}
+
+/* chunk: length, type, data, crc of the type and data */
+void png_write_chunk(Png_Stream* stream, const char* type, const unsigned char* data, size_t size)
+{
+    png_write_u32(stream, (uint32_t)size);
+    size_t start = stream->size;
+    png_stream_reserve(stream, 4 + size);
+    memcpy(stream->data + stream->size, type, 4);
+    if(size > 0)
+        memcpy(stream->data + stream->size + 4, data, size);
+    stream->size += 4 + size;
+    png_write_u32(stream, png_crc(stream->data + start, 4 + size));
+}
+
+/* pixels: RGBA rows from the top one, or from the bottom one (glReadPixels) with bottom_up */
+bool write_png_file(const char* file_name, const unsigned char* pixels, int width, int height, bool bottom_up)
+{
+    size_t row_size = (size_t)width * 4;
+    unsigned char* filtered = (unsigned char*)malloc((row_size + 1) * height);
+    for(int y = 0; y < height; y++)
+    {
+        const unsigned char* row = pixels + row_size * (bottom_up ? height - 1 - y : y);
+        const unsigned char* previous_row = y == 0 ? NULL : pixels + row_size * (bottom_up ? height - y : y - 1);
+        unsigned char* out = filtered + (row_size + 1) * y;
+        out[0] = 2; // up
+        for(size_t i = 0; i < row_size; i++)
+            out[i + 1] = row[i] - (previous_row != NULL ? previous_row[i] : 0);
+    }
+    Png_Stream idat = {};
+    png_deflate(&idat, filtered, (row_size + 1) * height);
+    free(filtered);
+
+    Png_Stream png = {};
+    const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    png_stream_reserve(&png, 8);
+    memcpy(png.data, signature, 8);
+    png.size = 8;
+    unsigned char header[13] = {0, 0, 0, 0, 0, 0, 0, 0, 8, 6, 0, 0, 0}; // 8 bit RGBA, no interlace
+    for(int i = 0; i < 4; i++)
+    {
+        header[i] = (unsigned char)(width >> (24 - i * 8));
+        header[4 + i] = (unsigned char)(height >> (24 - i * 8));
+    }
+    png_write_chunk(&png, "IHDR", header, 13);
+    png_write_chunk(&png, "IDAT", idat.data, idat.size);
+    png_write_chunk(&png, "IEND", NULL, 0);
+    free(idat.data);
+
+    FILE* file = fopen(file_name, "wb");
+    bool success = file != NULL && fwrite(png.data, 1, png.size, file) == png.size;
+    if(file != NULL)
+        fclose(file);
+    if(!success)
+        printf("could not write %s \n", file_name);
+    free(png.data);
+    return success;
+}
+
+#endif // PNG_WRITER_H
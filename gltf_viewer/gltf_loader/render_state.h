@@ -0,0 +1,346 @@
+#ifndef RENDER_STATE_H
+#define RENDER_STATE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* uniform reflection: when a program is linked (see Shader) its active uniforms are read once and
+   the ones the loader draws with are resolved into a table indexed by Uniform_Name, so the draw
+   functions and the dw*_model_transform never look a location up by string in the frame.
+   render state tracking: the programs, vertex arrays and textures are bound through use_program,
+   bind_vertex_array and bind_texture, which skip the call when the object is already bound and
+   count the skipped calls. the GL state must not be changed behind them: code binding objects
+   directly calls reset_render_state after, and deletes them through delete_textures and
+   delete_vertex_arrays (a deleted object is unbound and its name can be reused). */
+
+typedef enum
+{
+    UNIFORM_MODEL,
+    UNIFORM_VIEW,
+    UNIFORM_PROJECTION,
+    UNIFORM_BONE_MATRIX,
+    UNIFORM_BONE_MATRICES,
+    UNIFORM_BONE_PALETTE,
+    UNIFORM_BONE_FRAME_1,
+    UNIFORM_BONE_FRAME_2,
+    UNIFORM_BONE_FRAME_FACTOR,
+    UNIFORM_BONE_NODE,
+    UNIFORM_TEXTURE_DIFFUSE1,
+    UNIFORM_TEXTURE_PALETTE,
+    UNIFORM_PALETTE_ROW,
+    UNIFORM_TEXTURE_ARRAY,
+    UNIFORM_TEXTURE_RECT,
+    UNIFORM_TEXTURE_LAYER,
+    UNIFORM_TEXTURE_WRAP,
+    UNIFORM_NODE_BASE,
+    UNIFORM_JOINT_PALETTE,
+    UNIFORM_JOINT_BASE,
+    UNIFORM_SKINNED,
+    UNIFORM_MORPH_DELTAS,
+    UNIFORM_MORPH_SLOTS,
+    UNIFORM_MORPH_WIDTH,
+    UNIFORM_MORPH_ROWS,
+    UNIFORM_MORPH_WEIGHT,
+    UNIFORM_MORPH_BLEND,
+    UNIFORM_MORPH_NORMAL_SLOT,
+    UNIFORM_MORPH_TANGENT_SLOT,
+    UNIFORMS_COUNT
+}Uniform_Name;
+
+// same order as Uniform_Name
+const char* uniform_names[UNIFORMS_COUNT] =
+{
+    "model", "view", "projection", "bone_matrix", "bone_matrices", "bone_palette", "bone_frame_1",
+    "bone_frame_2", "bone_frame_factor", "bone_node", "texture_diffuse1", "texture_palette",
+    "palette_row", "texture_array", "texture_rect", "texture_layer", "texture_wrap", "node_base",
+    "joint_palette", "joint_base", "skinned", "morph_deltas", "morph_slots", "morph_width",
+    "morph_rows", "morph_weight", "morph_blend", "morph_normal_slot", "morph_tangent_slot"
+};
+
+/* GLSL 330 has no layout(binding), the blocks are bound to the binding point of their
+   Uniform_Block_Name when the program is reflected */
+typedef enum
+{
+    UNIFORM_BLOCK_NODE_MATRICES,
+    UNIFORM_BLOCKS_COUNT
+}Uniform_Block_Name;
+
+const char* uniform_block_names[UNIFORM_BLOCKS_COUNT] =
+{
+    "Node_Matrices"
+};
+
+#define UNIFORM_NAME_SIZE 64
+
+typedef struct
+{
+    char name[UNIFORM_NAME_SIZE]; // without the [0] of arrays
+    int location;
+    unsigned int type;            // GL_FLOAT_MAT4, GL_SAMPLER_2D...
+    int size;                     // elements of an array
+}Shader_Uniform;
+
+typedef struct
+{
+    unsigned int program;
+    int locations[UNIFORMS_COUNT]; // -1 for the uniforms the program does not use
+    Shader_Uniform* uniforms;      // every active uniform
+    int uniforms_count;
+}Shader_Uniforms;
+
+typedef struct
+{
+    Shader_Uniforms** programs;
+    unsigned int programs_count;
+    unsigned int programs_size;
+    Shader_Uniforms* last_program; // most lookups are for the program just used
+}Shader_Registry;
+
+Shader_Registry shader_registry = {NULL, 0, 0, NULL};
+
+/* reads the active uniforms of a linked program and adds them to the registry */
+Shader_Uniforms* reflect_shader_program(unsigned int program)
+{
+    Shader_Uniforms* uniforms = (Shader_Uniforms*)malloc(sizeof(Shader_Uniforms));
+    uniforms->program = program;
+    for(int i = 0; i < UNIFORMS_COUNT; i++)
+        uniforms->locations[i] = -1;
+    int active_uniforms = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &active_uniforms);
+    uniforms->uniforms = (Shader_Uniform*)malloc(sizeof(Shader_Uniform) * (active_uniforms > 0 ? active_uniforms : 1));
+    uniforms->uniforms_count = 0;
+    for(int i = 0; i < active_uniforms; i++)
+    {
+        Shader_Uniform* uniform = &uniforms->uniforms[uniforms->uniforms_count];
+        int name_length = 0;
+        glGetActiveUniform(program, i, UNIFORM_NAME_SIZE, &name_length, &uniform->size, &uniform->type, uniform->name);
+        // uniforms of blocks have no location
+        uniform->location = glGetUniformLocation(program, uniform->name);
+        if(uniform->location < 0)
+            continue;
+        char* bracket = strchr(uniform->name, '[');
+        if(bracket != NULL)
+            *bracket = '\0';
+        for(int j = 0; j < UNIFORMS_COUNT; j++)
+        {
+            if(strcmp(uniform->name, uniform_names[j]) == 0)
+                uniforms->locations[j] = uniform->location;
+        }
+        uniforms->uniforms_count++;
+    }
+    for(int i = 0; i < UNIFORM_BLOCKS_COUNT; i++)
+    {
+        unsigned int block_index = glGetUniformBlockIndex(program, uniform_block_names[i]);
+        if(block_index != GL_INVALID_INDEX)
+            glUniformBlockBinding(program, block_index, i);
+    }
+    if(shader_registry.programs_count == shader_registry.programs_size)
+    {
+        shader_registry.programs_size = shader_registry.programs_size > 0 ? shader_registry.programs_size * 2 : 8;
+        shader_registry.programs = (Shader_Uniforms**)realloc(shader_registry.programs,
+                                                              sizeof(Shader_Uniforms*) * shader_registry.programs_size);
+    }
+    shader_registry.programs[shader_registry.programs_count++] = uniforms;
+    return uniforms;
+}
+
+/* programs linked without Shader are reflected on their first lookup */
+Shader_Uniforms* get_shader_uniforms(unsigned int program)
+{
+    if(shader_registry.last_program != NULL && shader_registry.last_program->program == program)
+        return shader_registry.last_program;
+    Shader_Uniforms* uniforms = NULL;
+    for(unsigned int i = 0; i < shader_registry.programs_count && uniforms == NULL; i++)
+    {
+        if(shader_registry.programs[i]->program == program)
+            uniforms = shader_registry.programs[i];
+    }
+    if(uniforms == NULL)
+        uniforms = reflect_shader_program(program);
+    shader_registry.last_program = uniforms;
+    return uniforms;
+}
+
+int get_uniform_location(unsigned int program, Uniform_Name name)
+{
+    return get_shader_uniforms(program)->locations[name];
+}
+
+/* for the uniforms outside of Uniform_Name, still without asking the driver */
+int find_uniform_location(unsigned int program, const char* name)
+{
+    Shader_Uniforms* uniforms = get_shader_uniforms(program);
+    for(int i = 0; i < uniforms->uniforms_count; i++)
+    {
+        if(strcmp(uniforms->uniforms[i].name, name) == 0)
+            return uniforms->uniforms[i].location;
+    }
+    return -1;
+}
+
+/* removes the program from the registry before deleting it, its name can be reused */
+void delete_shader_program(unsigned int program)
+{
+    for(unsigned int i = 0; i < shader_registry.programs_count; i++)
+    {
+        Shader_Uniforms* uniforms = shader_registry.programs[i];
+        if(uniforms->program != program)
+            continue;
+        free(uniforms->uniforms);
+        free(uniforms);
+        shader_registry.programs[i] = shader_registry.programs[--shader_registry.programs_count];
+        break;
+    }
+    shader_registry.last_program = NULL;
+    glDeleteProgram(program);
+}
+
+#define RENDER_STATE_TEXTURE_UNITS 4
+#define RENDER_STATE_TEXTURE_TARGETS 3 // GL_TEXTURE_2D, GL_TEXTURE_BUFFER, GL_TEXTURE_2D_ARRAY
+
+typedef struct
+{
+    unsigned int calls;   // binds asked
+    unsigned int skipped; // binds of the object already bound
+}Render_State_Counter;
+
+typedef struct
+{
+    unsigned int program;
+    unsigned int vertex_array;
+    unsigned int active_unit;
+    unsigned int textures[RENDER_STATE_TEXTURE_UNITS][RENDER_STATE_TEXTURE_TARGETS];
+    bool textures_valid[RENDER_STATE_TEXTURE_UNITS][RENDER_STATE_TEXTURE_TARGETS];
+    bool program_valid, vertex_array_valid, active_unit_valid; // false until the first bind after reset_render_state
+    Render_State_Counter use_program_counter;
+    Render_State_Counter bind_vertex_array_counter;
+    Render_State_Counter bind_texture_counter;
+}Render_State;
+
+Render_State render_state;
+
+/* forgets what is bound, the next bind of every kind goes to GL */
+void reset_render_state(void)
+{
+    render_state.program_valid = false;
+    render_state.vertex_array_valid = false;
+    render_state.active_unit_valid = false;
+    memset(render_state.textures_valid, 0, sizeof(render_state.textures_valid));
+}
+
+void reset_render_state_counters(void)
+{
+    memset(&render_state.use_program_counter, 0, sizeof(Render_State_Counter));
+    memset(&render_state.bind_vertex_array_counter, 0, sizeof(Render_State_Counter));
+    memset(&render_state.bind_texture_counter, 0, sizeof(Render_State_Counter));
+}
+
+void use_program(unsigned int program)
+{
+    render_state.use_program_counter.calls++;
+    if(render_state.program_valid && render_state.program == program)
+    {
+        render_state.use_program_counter.skipped++;
+        return;
+    }
+    glUseProgram(program);
+    render_state.program = program;
+    render_state.program_valid = true;
+}
+
+void bind_vertex_array(unsigned int vertex_array)
+{
+    render_state.bind_vertex_array_counter.calls++;
+    if(render_state.vertex_array_valid && render_state.vertex_array == vertex_array)
+    {
+        render_state.bind_vertex_array_counter.skipped++;
+        return;
+    }
+    glBindVertexArray(vertex_array);
+    render_state.vertex_array = vertex_array;
+    render_state.vertex_array_valid = true;
+}
+
+int get_texture_target_index(unsigned int target)
+{
+    switch(target)
+    {
+        case GL_TEXTURE_2D: return 0;
+        case GL_TEXTURE_BUFFER: return 1;
+        case GL_TEXTURE_2D_ARRAY: return 2;
+    }
+    return -1;
+}
+
+void set_active_texture_unit(unsigned int unit)
+{
+    if(render_state.active_unit_valid && render_state.active_unit == unit)
+        return;
+    glActiveTexture(GL_TEXTURE0 + unit);
+    render_state.active_unit = unit;
+    render_state.active_unit_valid = true;
+}
+
+/* binds the texture on the unit and leaves the unit active, so the texture can be set up after */
+void bind_texture(unsigned int unit, unsigned int target, unsigned int texture)
+{
+    render_state.bind_texture_counter.calls++;
+    set_active_texture_unit(unit);
+    int target_index = get_texture_target_index(target);
+    if(unit >= RENDER_STATE_TEXTURE_UNITS || target_index < 0)
+    {
+        glBindTexture(target, texture);
+        return;
+    }
+    if(render_state.textures_valid[unit][target_index] && render_state.textures[unit][target_index] == texture)
+    {
+        render_state.bind_texture_counter.skipped++;
+        return;
+    }
+    glBindTexture(target, texture);
+    render_state.textures[unit][target_index] = texture;
+    render_state.textures_valid[unit][target_index] = true;
+}
+
+/* glDeleteTextures unbinds the textures from every unit */
+void delete_textures(int count, unsigned int* textures)
+{
+    for(int i = 0; i < count; i++)
+    {
+        for(unsigned int unit = 0; unit < RENDER_STATE_TEXTURE_UNITS; unit++)
+        {
+            for(unsigned int target = 0; target < RENDER_STATE_TEXTURE_TARGETS; target++)
+            {
+                if(textures[i] != 0 && render_state.textures[unit][target] == textures[i])
+                    render_state.textures[unit][target] = 0;
+            }
+        }
+    }
+    glDeleteTextures(count, textures);
+}
+
+void delete_vertex_arrays(int count, unsigned int* vertex_arrays)
+{
+    for(int i = 0; i < count; i++)
+    {
+        if(vertex_arrays[i] != 0 && render_state.vertex_array == vertex_arrays[i])
+            render_state.vertex_array = 0;
+    }
+    glDeleteVertexArrays(count, vertex_arrays);
+}
+
+void print_render_state_counter(const char* name, Render_State_Counter* counter)
+{
+    printf("%20s %10u calls %10u skipped (%.1f%%) \n", name, counter->calls, counter->skipped,
+           counter->calls > 0 ? counter->skipped * 100.0f / counter->calls : 0.0f);
+}
+
+void print_render_state_counters(void)
+{
+    print_render_state_counter("glUseProgram", &render_state.use_program_counter);
+    print_render_state_counter("glBindVertexArray", &render_state.bind_vertex_array_counter);
+    print_render_state_counter("glBindTexture", &render_state.bind_texture_counter);
+}
+
+#endif // RENDER_STATE_H
@@ -3,6 +3,7 @@
 
 #include "glad.h"
 #include "glm/glm.hpp"
+#include "render_state.h"
 
 #include <string>
 #include <fstream>
@@ -65,6 +66,8 @@ public:
         glAttachShader(ID, fragment);
         glLinkProgram(ID);
         checkCompileErrors(ID, "PROGRAM");
+        // resolve the uniform locations once, the set functions never ask the driver
+        reflect_shader_program(ID);
         // delete the shaders as they're linked into our program now and no longer necessary
         glDeleteShader(vertex);
         glDeleteShader(fragment);
@@ -74,65 +77,83 @@ public:
     // ------------------------------------------------------------------------
     void use() const
     {
-        glUseProgram(ID);
+        use_program(ID);
     }
     // utility uniform functions
     // ------------------------------------------------------------------------
     void setBool(const std::string &name, bool value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+        glUniform1i(find_uniform_location(ID, name.c_str()), (int)value);
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string &name, int value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        glUniform1i(find_uniform_location(ID, name.c_str()), value);
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string &name, float value) const
     {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        glUniform1f(find_uniform_location(ID, name.c_str()), value);
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string &name, const glm::vec2 &value) const
     {
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform2fv(find_uniform_location(ID, name.c_str()), 1, &value[0]);
     }
     void setVec2(const std::string &name, float x, float y) const
     {
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+        glUniform2f(find_uniform_location(ID, name.c_str()), x, y);
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string &name, const glm::vec3 &value) const
     {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform3fv(find_uniform_location(ID, name.c_str()), 1, &value[0]);
     }
     void setVec3(const std::string &name, float x, float y, float z) const
     {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+        glUniform3f(find_uniform_location(ID, name.c_str()), x, y, z);
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string &name, const glm::vec4 &value) const
     {
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform4fv(find_uniform_location(ID, name.c_str()), 1, &value[0]);
     }
     void setVec4(const std::string &name, float x, float y, float z, float w) const
     {
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+        glUniform4f(find_uniform_location(ID, name.c_str()), x, y, z, w);
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string &name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(find_uniform_location(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string &name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(find_uniform_location(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string &name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(find_uniform_location(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    }
+    // the uniforms of Uniform_Name, read straight from the location table
+    // ------------------------------------------------------------------------
+    void setInt(Uniform_Name name, int value) const
+    {
+        glUniform1i(get_uniform_location(ID, name), value);
+    }
+    void setFloat(Uniform_Name name, float value) const
+    {
+        glUniform1f(get_uniform_location(ID, name), value);
+    }
+    void setVec4(Uniform_Name name, const glm::vec4 &value) const
+    {
+        glUniform4fv(get_uniform_location(ID, name), 1, &value[0]);
+    }
+    void setMat4(Uniform_Name name, const glm::mat4 &mat) const
+    {
+        glUniformMatrix4fv(get_uniform_location(ID, name), 1, GL_FALSE, &mat[0][0]);
     }
 
 private:
@@ -0,0 +1,28 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+// textures of many models packed in one array (see texture_array.h)
+uniform sampler2DArray texture_array;
+uniform vec4 texture_rect; // xy: corner of the model image in its layer, zw: its size
+uniform int texture_layer;
+uniform ivec2 texture_wrap; // sampler wrap mode of the model in s and t: 0 repeat, 1 clamp to edge, 2 mirrored repeat
+
+// the image is wrapped inside its rect, not over the whole layer. clamped and mirrored coordinates
+// stop at the center of the border texels so the neighbour images are never read
+float wrap_coordinate(float coordinate, int wrap, float texels)
+{
+    if(wrap == 0)
+        return fract(coordinate);
+    if(wrap == 2)
+        coordinate = 1.0 - abs(mod(coordinate, 2.0) - 1.0);
+    return clamp(coordinate, 0.5 / texels, 1.0 - 0.5 / texels);
+}
+
+void main()
+{    
+    vec2 texels = vec2(textureSize(texture_array, 0).xy) * texture_rect.zw;
+    vec2 coords = vec2(wrap_coordinate(TexCoords.x, texture_wrap.x, texels.x), wrap_coordinate(TexCoords.y, texture_wrap.y, texels.y));
+    FragColor = texture(texture_array, vec3(texture_rect.xy + coords * texture_rect.zw, texture_layer));
+}
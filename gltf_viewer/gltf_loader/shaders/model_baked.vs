@@ -0,0 +1,50 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoords;
+// joints and weights of skinned meshes, see Skin_Vertex
+layout (location = 8) in uvec4 aJoints;
+layout (location = 9) in vec4 aWeights;
+
+out vec2 TexCoords;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+// baked animation matrices, 4 texels per matrix (see upload_baked_animation)
+uniform samplerBuffer bone_palette;
+uniform int bone_frame_1;
+uniform int bone_frame_2;
+uniform float bone_frame_factor;
+// the frames point at the first joint matrix for skinned meshes, see draw_model_baked
+uniform int skinned;
+
+mat4 fetch_bone_matrix(int offset)
+{
+    return mat4(texelFetch(bone_palette, offset),
+                texelFetch(bone_palette, offset + 1),
+                texelFetch(bone_palette, offset + 2),
+                texelFetch(bone_palette, offset + 3));
+}
+
+mat4 fetch_frame_matrix(int matrix)
+{
+    mat4 frame_matrix = fetch_bone_matrix(bone_frame_1 + matrix);
+    if(bone_frame_factor > 0.0)
+        frame_matrix += (fetch_bone_matrix(bone_frame_2 + matrix) - frame_matrix) * bone_frame_factor;
+    return frame_matrix;
+}
+
+void main()
+{
+    mat4 bone_matrix;
+    if(skinned == 0)
+        bone_matrix = fetch_frame_matrix(0);
+    else
+        bone_matrix = aWeights.x * fetch_frame_matrix(int(aJoints.x) * 4) +
+                      aWeights.y * fetch_frame_matrix(int(aJoints.y) * 4) +
+                      aWeights.z * fetch_frame_matrix(int(aJoints.z) * 4) +
+                      aWeights.w * fetch_frame_matrix(int(aJoints.w) * 4);
+    gl_Position = projection * view * model * bone_matrix * vec4(aPos, 1.0);
+    TexCoords = vec2(aTexCoords.x, aTexCoords.y);
+}
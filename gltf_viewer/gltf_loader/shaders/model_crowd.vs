@@ -0,0 +1,53 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoords;
+// per instance data, see Crowd_Instance_Data
+layout (location = 10) in mat4 instance_model;
+layout (location = 14) in ivec2 instance_frames;
+layout (location = 15) in float instance_frame_factor;
+// joints and weights of skinned meshes, see Skin_Vertex
+layout (location = 8) in uvec4 aJoints;
+layout (location = 9) in vec4 aWeights;
+
+out vec2 TexCoords;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+// baked frames of every animation, 4 texels per matrix (see create_model_crowd)
+uniform samplerBuffer bone_palette;
+uniform int bone_node;
+// texel of the first joint matrix in a frame, used by the skinned meshes
+uniform int joint_base;
+uniform int skinned;
+
+mat4 fetch_bone_matrix(int offset)
+{
+    return mat4(texelFetch(bone_palette, offset),
+                texelFetch(bone_palette, offset + 1),
+                texelFetch(bone_palette, offset + 2),
+                texelFetch(bone_palette, offset + 3));
+}
+
+mat4 fetch_frame_matrix(int matrix)
+{
+    mat4 frame_matrix = fetch_bone_matrix(instance_frames.x + matrix);
+    if(instance_frame_factor > 0.0)
+        frame_matrix += (fetch_bone_matrix(instance_frames.y + matrix) - frame_matrix) * instance_frame_factor;
+    return frame_matrix;
+}
+
+void main()
+{
+    mat4 bone_matrix;
+    // the vertices of rigid meshes and the rigid vertices of skinned meshes follow their node
+    if(skinned == 0 || aWeights == vec4(0.0))
+        bone_matrix = fetch_frame_matrix(bone_node);
+    else
+        bone_matrix = aWeights.x * fetch_frame_matrix(joint_base + int(aJoints.x) * 4) +
+                      aWeights.y * fetch_frame_matrix(joint_base + int(aJoints.y) * 4) +
+                      aWeights.z * fetch_frame_matrix(joint_base + int(aJoints.z) * 4) +
+                      aWeights.w * fetch_frame_matrix(joint_base + int(aJoints.w) * 4);
+    gl_Position = projection * view * instance_model * bone_matrix * vec4(aPos, 1.0);
+    TexCoords = vec2(aTexCoords.x, aTexCoords.y);
+}
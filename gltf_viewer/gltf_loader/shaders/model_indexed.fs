@@ -0,0 +1,18 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+// palettized texture (see create_tim_texture): the texel is a palette index, the color is read in the palette
+uniform usampler2D texture_diffuse1;
+uniform sampler2D texture_palette;
+uniform int palette_row;
+
+void main()
+{    
+    // integer textures have no sampler wrapping, repeat the coordinates here
+    ivec2 size = textureSize(texture_diffuse1, 0);
+    ivec2 texel = ivec2(fract(TexCoords) * vec2(size));
+    uint index = texelFetch(texture_diffuse1, texel, 0).r;
+    FragColor = texelFetch(texture_palette, ivec2(int(index), palette_row), 0);
+}
@@ -0,0 +1,24 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoords;
+layout (location = 2) in uint aBoneIndex;
+
+out vec2 TexCoords;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+// one matrix per mesh, the range of the frame uniform buffer bound by draw_model_merged (MODEL_MAX_BONES)
+layout (std140) uniform Node_Matrices
+{
+    mat4 node_matrices[64];
+};
+// first mesh of the range, models with more than 64 meshes are drawn in several ranges
+uniform int node_base;
+
+void main()
+{
+    gl_Position = projection * view * model * node_matrices[int(aBoneIndex) - node_base] * vec4(aPos, 1.0);
+    TexCoords = vec2(aTexCoords.x, aTexCoords.y);
+}
@@ -0,0 +1,47 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoords;
+layout (location = 2) in uint aBoneIndex;
+// joints and weights of skinned meshes, see Skin_Vertex
+layout (location = 8) in uvec4 aJoints;
+layout (location = 9) in vec4 aWeights;
+
+out vec2 TexCoords;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+// model_merged.vs for the vertices of rigid meshes
+layout (std140) uniform Node_Matrices
+{
+    mat4 node_matrices[64];
+};
+uniform int node_base;
+
+// joint matrices of every skin of the model, 4 texels per matrix (see bind_model_joint_palette)
+uniform samplerBuffer joint_palette;
+
+mat4 fetch_joint_matrix(uint joint)
+{
+    int offset = int(joint) * 4;
+    return mat4(texelFetch(joint_palette, offset),
+                texelFetch(joint_palette, offset + 1),
+                texelFetch(joint_palette, offset + 2),
+                texelFetch(joint_palette, offset + 3));
+}
+
+void main()
+{
+    mat4 vertex_matrix;
+    // rigid meshes have zero weights
+    if(aWeights == vec4(0.0))
+        vertex_matrix = node_matrices[int(aBoneIndex) - node_base];
+    else
+        vertex_matrix = aWeights.x * fetch_joint_matrix(aJoints.x) +
+                        aWeights.y * fetch_joint_matrix(aJoints.y) +
+                        aWeights.z * fetch_joint_matrix(aJoints.z) +
+                        aWeights.w * fetch_joint_matrix(aJoints.w);
+    gl_Position = projection * view * model * vertex_matrix * vec4(aPos, 1.0);
+    TexCoords = vec2(aTexCoords.x, aTexCoords.y);
+}
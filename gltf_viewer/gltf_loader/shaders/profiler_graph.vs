@@ -0,0 +1,12 @@
+#version 330 core
+layout (location = 0) in vec2 aPos;
+layout (location = 1) in vec3 aColor;
+
+out vec3 ourColor;
+
+// the graph of frame_profiler.h, positions already in clip space
+void main()
+{
+    gl_Position = vec4(aPos, 0.0, 1.0);
+    ourColor = aColor;
+}
@@ -0,0 +1,895 @@
+#ifndef SOFT_RASTERIZER_H
+#define SOFT_RASTERIZER_H
+
+#include "gltf_loader.h"
+
+#include <atomic>
+#include <chrono>
+
+/* a software rasterizer for machines without GPU, it draws the Model_Data of a model loaded with
+   MODEL_LOAD_NO_GPU like model_skinned.vs and model.fs: every vertex is moved by the bone matrix of its
+   mesh or its weighted joint matrices, the texture is sampled with nearest filtering and repeat, with
+   perspective correct coordinates, and the depth buffer keeps the nearest fragment. the depth buffer
+   holds 1/w instead of z/w: at the distance of the viewer camera z/w is so close to 1 that float can not
+   tell the two sides of a cape apart, 1/w keeps its precision. the far plane is clipped like the near one.
+   a frame runs in three stages on the thread pool, each task taking the next chunk from a shared
+   counter like skin_mesh_parallel:
+   - the vertices, in chunks of SOFT_VERTEX_CHUNK of a mesh, are transformed to clip space.
+   - the triangles, in chunks of SOFT_TRIANGLE_CHUNK, are clipped against the near and far planes, projected and
+     set up (edge functions and planes of the interpolated values), then sorted in the screen tiles
+     (SOFT_TILE_SIZE pixels) their bounding box touches. every chunk has its own bins, no lock needed.
+   - the tiles are cleared and filled, one task per tile at a time, reading the bins of every chunk in
+     order so the image does not depend on the number of threads.
+   the sse kernels transform a vertex with the matrix columns in registers, set up the three edges and
+   the three planes of a triangle at once, and fill 4 pixels of a row at once. the edge functions of a
+   tile are computed from the vertex of the edge shared by both its triangles, so they get opposite
+   values and the top left rule leaves no crack and draws no pixel twice. */
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define SOFT_RASTERIZER_X86_SIMD
+#include <immintrin.h>
+#endif
+
+#define SOFT_TILE_SIZE 64         // pixels per side of a bin
+#define SOFT_VERTEX_CHUNK 4096    // vertices per task of the vertex stage
+#define SOFT_TRIANGLE_CHUNK 1024  // triangles per task of the setup stage
+#define SOFT_SUBPIXEL_STEPS 16.0f // the screen positions are snapped to 1/16 pixel
+#define SOFT_GUARD_BAND 1.0e6f    // screen positions are clamped to +-SOFT_GUARD_BAND pixels, only the near and far planes are clipped
+#define SOFT_CLIPPED_TRIANGLES 3  // a triangle clipped by the near and far planes is a polygon of up to 5 vertices
+
+enum
+{
+    SOFT_RASTER_SCALAR,
+    SOFT_RASTER_SSE,
+    SOFT_RASTER_KERNELS_COUNT
+};
+
+const char* soft_raster_kernel_names[SOFT_RASTER_KERNELS_COUNT] = {"scalar", "sse"};
+
+typedef struct
+{
+    float x, y, z, w; // clip space
+    float u, v;
+}Soft_Vertex;
+
+typedef struct
+{
+    float edge_a[4], edge_b[4];    // edge k: a * (x - edge_x) + b * (y - edge_y), positive inside, the 4th is unused
+    float edge_x[4], edge_y[4];    // the vertex of the edge first in x then y, the same for both triangles of the edge
+    int top_left[4];               // -1 when the pixels exactly on the edge are inside
+    float x0, y0;                  // first vertex, origin of the planes
+    float planes[3][4];            // d/dx, d/dy and value at x0, y0 of 1/w, u/w and v/w, the 4th is unused
+    int min_x, min_y, max_x, max_y; // pixels whose center can be inside, clamped to the screen
+}Soft_Triangle;
+
+/* triangles of a chunk of the setup stage in a tile */
+typedef struct
+{
+    unsigned int* triangles;
+    unsigned int count;
+    unsigned int capacity;
+}Soft_Bin;
+
+/* vertices or triangles [first, end) of a mesh. triangle chunks write their triangles from slot on */
+typedef struct
+{
+    unsigned int mesh;
+    unsigned int first, end;
+    unsigned int slot;
+}Soft_Chunk;
+
+typedef struct
+{
+    const unsigned int* pixels; // RGBA
+    int width, height;
+}Soft_Texture;
+
+typedef struct
+{
+    int width, height;
+    int stride;             // pixels per row of the buffers, width rounded up to 4 for the sse loads
+    unsigned int* color;    // RGBA bytes, the first row is the top of the screen
+    float* depth;           // 1/w, 0 is the farthest
+    unsigned int clear_color;
+    int tiles_x, tiles_y, tiles_count;
+    Thread_Pool* pool;      // NULL to render on the calling thread
+    int kernel;
+    Soft_Vertex* vertices;
+    unsigned int vertices_capacity;
+    glm::mat4* mesh_matrices;  // clip matrix * bone matrix of every mesh
+    unsigned int meshes_capacity;
+    glm::mat4* joint_matrices; // clip matrix * joint matrix of every joint
+    unsigned int joints_capacity;
+    Soft_Chunk* vertex_chunks;
+    unsigned int vertex_chunks_count, vertex_chunks_capacity;
+    Soft_Chunk* triangle_chunks;
+    unsigned int triangle_chunks_count, triangle_chunks_capacity;
+    Soft_Triangle* triangles;  // SOFT_CLIPPED_TRIANGLES slots per triangle
+    unsigned int triangles_capacity;
+    Soft_Bin* bins;            // tiles_count bins per triangle chunk
+    unsigned int bins_capacity;
+    Soft_Texture texture;
+    unsigned int white_texel;  // texture of the models without image
+    // statistics since create_soft_rasterizer
+    unsigned int frames_count;
+    double vertex_ms, setup_ms, raster_ms;
+    std::atomic<unsigned int> triangles_drawn; // after culling and clipping, last frame
+}Soft_Rasterizer;
+
+typedef struct
+{
+    Soft_Rasterizer* rasterizer;
+    Model_Data* model;
+    unsigned int items_count;
+    std::atomic<unsigned int> next_item;
+}Soft_Raster_Job;
+
+double get_soft_time_ms(void)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int soft_raster_kernel(void)
+{
+#ifdef SOFT_RASTERIZER_X86_SIMD
+    static int kernel = -1;
+    if(kernel < 0)
+    {
+        __builtin_cpu_init();
+        kernel = __builtin_cpu_supports("sse2") ? SOFT_RASTER_SSE : SOFT_RASTER_SCALAR;
+    }
+    return kernel;
+#else
+    return SOFT_RASTER_SCALAR;
+#endif
+}
+
+/* RGBA bytes in memory order, the rasterizer runs on little endian cpus */
+unsigned int pack_soft_color(unsigned char r, unsigned char g, unsigned char b, unsigned char a)
+{
+    return r | (g << 8) | (b << 16) | ((unsigned int)a << 24);
+}
+
+/* grows the array to hold count elements, keeps it when it already does */
+void* reserve_soft_array(void* array, unsigned int* capacity, unsigned int count, size_t element_size)
+{
+    if(count <= *capacity)
+        return array;
+    *capacity = std::max(count, *capacity * 2);
+    return realloc(array, element_size * *capacity);
+}
+
+/* pool is optional, the rasterizer does not own it */
+Soft_Rasterizer* create_soft_rasterizer(int width, int height, Thread_Pool* pool)
+{
+    Soft_Rasterizer* rasterizer = (Soft_Rasterizer*)calloc(1, sizeof(Soft_Rasterizer));
+    rasterizer->width = width;
+    rasterizer->height = height;
+    rasterizer->stride = (width + 3) & ~3;
+    rasterizer->color = (unsigned int*)calloc((size_t)rasterizer->stride * height, sizeof(unsigned int));
+    rasterizer->depth = (float*)calloc((size_t)rasterizer->stride * height, sizeof(float));
+    rasterizer->clear_color = pack_soft_color(51, 76, 76, 255); // glClearColor of the viewer
+    rasterizer->tiles_x = (width + SOFT_TILE_SIZE - 1) / SOFT_TILE_SIZE;
+    rasterizer->tiles_y = (height + SOFT_TILE_SIZE - 1) / SOFT_TILE_SIZE;
+    rasterizer->tiles_count = rasterizer->tiles_x * rasterizer->tiles_y;
+    rasterizer->pool = pool;
+    rasterizer->kernel = soft_raster_kernel();
+    rasterizer->white_texel = pack_soft_color(255, 255, 255, 255);
+    rasterizer->triangles_drawn = 0;
+    return rasterizer;
+}
+
+void free_soft_rasterizer(Soft_Rasterizer* rasterizer)
+{
+    for(unsigned int i = 0; i < rasterizer->bins_capacity; i++)
+        free(rasterizer->bins[i].triangles);
+    free(rasterizer->bins);
+    free(rasterizer->triangles);
+    free(rasterizer->triangle_chunks);
+    free(rasterizer->vertex_chunks);
+    free(rasterizer->joint_matrices);
+    free(rasterizer->mesh_matrices);
+    free(rasterizer->vertices);
+    free(rasterizer->depth);
+    free(rasterizer->color);
+    free(rasterizer);  rasterizer = NULL;
+}
+
+/* ----- vertex stage ----- */
+
+/* the matrix of the vertex i of the mesh, NULL for a rigid vertex */
+const glm::mat4* get_soft_skin_matrix(Soft_Rasterizer* rasterizer, Mesh_Data* mesh, unsigned int i, glm::mat4* blended)
+{
+    if(mesh->skin_vertices == NULL)
+        return NULL;
+    Skin_Vertex* skin = &mesh->skin_vertices[i];
+    // like model_skinned.vs, zero weights use the mesh node
+    if(skin->weights[0] == 0.0f && skin->weights[1] == 0.0f && skin->weights[2] == 0.0f && skin->weights[3] == 0.0f)
+        return NULL;
+    *blended = glm::mat4(0.0f);
+    for(int j = 0; j < 4; j++)
+    {
+        if(skin->weights[j] != 0.0f)
+            *blended += rasterizer->joint_matrices[skin->joints[j]] * skin->weights[j];
+    }
+    return blended;
+}
+
+void transform_soft_vertices_scalar(Soft_Rasterizer* rasterizer, Model_Data* model, Soft_Chunk* chunk)
+{
+    Mesh_Data* mesh = model->meshes[chunk->mesh];
+    Soft_Vertex* vertices = rasterizer->vertices + mesh->base_vertex;
+    glm::mat4 blended;
+    for(unsigned int i = chunk->first; i < chunk->end; i++)
+    {
+        const glm::mat4* matrix = get_soft_skin_matrix(rasterizer, mesh, i, &blended);
+        if(matrix == NULL)
+            matrix = &rasterizer->mesh_matrices[chunk->mesh];
+        Vec3* position = &mesh->vertices[i];
+        glm::vec4 clip = *matrix * glm::vec4(position->x, position->y, position->z, 1.0f);
+        vertices[i].x = clip.x;
+        vertices[i].y = clip.y;
+        vertices[i].z = clip.z;
+        vertices[i].w = clip.w;
+        vertices[i].u = i < mesh->texcoord_count ? mesh->texcoord[i].x : 0.0f;
+        vertices[i].v = i < mesh->texcoord_count ? mesh->texcoord[i].y : 0.0f;
+    }
+}
+
+#ifdef SOFT_RASTERIZER_X86_SIMD
+
+__attribute__((target("sse2")))
+void transform_soft_vertices_sse(Soft_Rasterizer* rasterizer, Model_Data* model, Soft_Chunk* chunk)
+{
+    Mesh_Data* mesh = model->meshes[chunk->mesh];
+    Soft_Vertex* vertices = rasterizer->vertices + mesh->base_vertex;
+    const float* mesh_matrix = &rasterizer->mesh_matrices[chunk->mesh][0][0];
+    const float* joint_matrices = rasterizer->joint_matrices != NULL ? &rasterizer->joint_matrices[0][0][0] : NULL;
+    __m128 mesh_column_0 = _mm_loadu_ps(mesh_matrix);
+    __m128 mesh_column_1 = _mm_loadu_ps(mesh_matrix + 4);
+    __m128 mesh_column_2 = _mm_loadu_ps(mesh_matrix + 8);
+    __m128 mesh_column_3 = _mm_loadu_ps(mesh_matrix + 12);
+    for(unsigned int i = chunk->first; i < chunk->end; i++)
+    {
+        __m128 column_0 = mesh_column_0, column_1 = mesh_column_1, column_2 = mesh_column_2, column_3 = mesh_column_3;
+        if(mesh->skin_vertices != NULL)
+        {
+            Skin_Vertex* skin = &mesh->skin_vertices[i];
+            __m128 weights = _mm_loadu_ps(skin->weights);
+            if(_mm_movemask_ps(_mm_cmpneq_ps(weights, _mm_setzero_ps())) != 0)
+            {
+                column_0 = column_1 = column_2 = column_3 = _mm_setzero_ps();
+                for(int j = 0; j < 4; j++)
+                {
+                    if(skin->weights[j] == 0.0f)
+                        continue;
+                    const float* matrix = joint_matrices + skin->joints[j] * 16;
+                    __m128 weight = _mm_set1_ps(skin->weights[j]);
+                    column_0 = _mm_add_ps(column_0, _mm_mul_ps(weight, _mm_loadu_ps(matrix)));
+                    column_1 = _mm_add_ps(column_1, _mm_mul_ps(weight, _mm_loadu_ps(matrix + 4)));
+                    column_2 = _mm_add_ps(column_2, _mm_mul_ps(weight, _mm_loadu_ps(matrix + 8)));
+                    column_3 = _mm_add_ps(column_3, _mm_mul_ps(weight, _mm_loadu_ps(matrix + 12)));
+                }
+            }
+        }
+        Vec3* position = &mesh->vertices[i];
+        __m128 clip = _mm_add_ps(_mm_add_ps(_mm_mul_ps(column_0, _mm_set1_ps(position->x)),
+                                            _mm_mul_ps(column_1, _mm_set1_ps(position->y))),
+                                 _mm_add_ps(_mm_mul_ps(column_2, _mm_set1_ps(position->z)), column_3));
+        _mm_storeu_ps(&vertices[i].x, clip);
+        vertices[i].u = i < mesh->texcoord_count ? mesh->texcoord[i].x : 0.0f;
+        vertices[i].v = i < mesh->texcoord_count ? mesh->texcoord[i].y : 0.0f;
+    }
+}
+
+#endif
+
+void transform_soft_vertices(Soft_Rasterizer* rasterizer, Model_Data* model, Soft_Chunk* chunk)
+{
+#ifdef SOFT_RASTERIZER_X86_SIMD
+    if(rasterizer->kernel == SOFT_RASTER_SSE)
+    {
+        transform_soft_vertices_sse(rasterizer, model, chunk);
+        return;
+    }
+#endif
+    transform_soft_vertices_scalar(rasterizer, model, chunk);
+}
+
+/* ----- setup stage ----- */
+
+float snap_soft_position(float position)
+{
+    position = std::min(std::max(position, -SOFT_GUARD_BAND), SOFT_GUARD_BAND);
+    return floorf(position * SOFT_SUBPIXEL_STEPS + 0.5f) / SOFT_SUBPIXEL_STEPS;
+}
+
+/* the vertex first in x then y. the triangles start from it, so two triangles on the same vertices
+   (the two sides of a cape) get the same planes whatever their order and winding, and the depth test
+   keeps the first one drawn like GL_LESS */
+int get_first_soft_vertex(const float* x, const float* y)
+{
+    int first = 0;
+    for(int k = 1; k < 3; k++)
+    {
+        if(x[k] < x[first] || (x[k] == x[first] && y[k] < y[first]))
+            first = k;
+    }
+    return first;
+}
+
+/* bounding box of the pixel centers and the edge reference vertices from the screen positions,
+   returns false when no pixel center can be covered */
+bool set_soft_triangle_bounds(Soft_Rasterizer* rasterizer, Soft_Triangle* triangle, const float* x, const float* y)
+{
+    float min_x = std::min(x[0], std::min(x[1], x[2])), max_x = std::max(x[0], std::max(x[1], x[2]));
+    float min_y = std::min(y[0], std::min(y[1], y[2])), max_y = std::max(y[0], std::max(y[1], y[2]));
+    // pixel centers are at +0.5, far away vertices are clamped before the conversion to int
+    triangle->min_x = (int)std::max(0.0f, ceilf(min_x - 0.5f));
+    triangle->min_y = (int)std::max(0.0f, ceilf(min_y - 0.5f));
+    triangle->max_x = (int)std::min((float)rasterizer->width - 1.0f, floorf(max_x - 0.5f));
+    triangle->max_y = (int)std::min((float)rasterizer->height - 1.0f, floorf(max_y - 0.5f));
+    if(triangle->min_x > triangle->max_x || triangle->min_y > triangle->max_y)
+        return false;
+    for(int k = 0; k < 3; k++)
+    {
+        int j = (k + 1) % 3;
+        bool first = x[k] < x[j] || (x[k] == x[j] && y[k] < y[j]);
+        triangle->edge_x[k] = first ? x[k] : x[j];
+        triangle->edge_y[k] = first ? y[k] : y[j];
+    }
+    triangle->edge_x[3] = triangle->edge_y[3] = 0.0f;
+    return true;
+}
+
+/* projects the clip space vertices and sets up the triangle, returns false when it covers no pixel */
+bool setup_soft_triangle_scalar(Soft_Rasterizer* rasterizer, const Soft_Vertex** vertices, Soft_Triangle* triangle)
+{
+    float x[3], y[3], values[3][4];
+    for(int k = 0; k < 3; k++)
+    {
+        const Soft_Vertex* vertex = vertices[k];
+        float inverse_w = 1.0f / vertex->w;
+        x[k] = snap_soft_position((vertex->x * inverse_w * 0.5f + 0.5f) * rasterizer->width);
+        y[k] = snap_soft_position((0.5f - vertex->y * inverse_w * 0.5f) * rasterizer->height);
+        values[k][0] = inverse_w;
+        values[k][1] = vertex->u * inverse_w;
+        values[k][2] = vertex->v * inverse_w;
+        values[k][3] = 0.0f;
+    }
+    for(int first = get_first_soft_vertex(x, y); first > 0; first--)
+    {
+        std::rotate(x, x + 1, x + 3);
+        std::rotate(y, y + 1, y + 3);
+        std::rotate(&values[0][0], &values[0][0] + 4, &values[0][0] + 12); // the rows are contiguous
+    }
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if(!(area > 0.0f || area < 0.0f)) // degenerate or NaN
+        return false;
+    if(area < 0.0f)
+    {
+        // no culling, the back faces are turned
+        std::swap(x[1], x[2]);
+        std::swap(y[1], y[2]);
+        for(int i = 0; i < 4; i++)
+            std::swap(values[1][i], values[2][i]);
+        area = -area;
+    }
+    if(!set_soft_triangle_bounds(rasterizer, triangle, x, y))
+        return false;
+    for(int k = 0; k < 3; k++)
+    {
+        int j = (k + 1) % 3;
+        triangle->edge_a[k] = y[k] - y[j];
+        triangle->edge_b[k] = x[j] - x[k];
+        triangle->top_left[k] = triangle->edge_a[k] > 0.0f || (triangle->edge_a[k] == 0.0f && triangle->edge_b[k] > 0.0f) ? -1 : 0;
+    }
+    triangle->edge_a[3] = triangle->edge_b[3] = 0.0f;
+    triangle->top_left[3] = 0;
+    float dx_1 = x[1] - x[0], dy_1 = y[1] - y[0];
+    float dx_2 = x[2] - x[0], dy_2 = y[2] - y[0];
+    float inverse_area = 1.0f / area;
+    for(int i = 0; i < 4; i++)
+    {
+        float delta_1 = values[1][i] - values[0][i];
+        float delta_2 = values[2][i] - values[0][i];
+        triangle->planes[0][i] = (delta_1 * dy_2 - delta_2 * dy_1) * inverse_area;
+        triangle->planes[1][i] = (delta_2 * dx_1 - delta_1 * dx_2) * inverse_area;
+        triangle->planes[2][i] = values[0][i];
+    }
+    triangle->x0 = x[0];
+    triangle->y0 = y[0];
+    return true;
+}
+
+#ifdef SOFT_RASTERIZER_X86_SIMD
+
+__attribute__((target("sse2")))
+bool setup_soft_triangle_sse(Soft_Rasterizer* rasterizer, const Soft_Vertex** vertices, Soft_Triangle* triangle)
+{
+    // screen x and y of a vertex in the first two lanes
+    const __m128 scale = _mm_setr_ps(0.5f * rasterizer->width, -0.5f * rasterizer->height, 0.0f, 0.0f);
+    const __m128 offset = _mm_setr_ps(0.5f * rasterizer->width, 0.5f * rasterizer->height, 0.0f, 0.0f);
+    const __m128 steps = _mm_set1_ps(SOFT_SUBPIXEL_STEPS);
+    float x[3], y[3];
+    __m128 values[3]; // 1/w, u/w and v/w
+    for(int k = 0; k < 3; k++)
+    {
+        const Soft_Vertex* vertex = vertices[k];
+        __m128 inverse_w = _mm_div_ps(_mm_set1_ps(1.0f), _mm_set1_ps(vertex->w));
+        __m128 screen = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(&vertex->x), inverse_w), scale), offset);
+        screen = _mm_min_ps(_mm_max_ps(screen, _mm_set1_ps(-SOFT_GUARD_BAND)), _mm_set1_ps(SOFT_GUARD_BAND));
+        // snap x and y like snap_soft_position
+        __m128 scaled = _mm_add_ps(_mm_mul_ps(screen, steps), _mm_set1_ps(0.5f));
+        __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(scaled));
+        __m128 floored = _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, scaled), _mm_set1_ps(1.0f)));
+        float screen_values[4];
+        _mm_storeu_ps(screen_values, _mm_div_ps(floored, steps));
+        x[k] = screen_values[0];
+        y[k] = screen_values[1];
+        values[k] = _mm_mul_ps(_mm_setr_ps(1.0f, vertex->u, vertex->v, 0.0f), inverse_w);
+    }
+    for(int first = get_first_soft_vertex(x, y); first > 0; first--)
+    {
+        std::rotate(x, x + 1, x + 3);
+        std::rotate(y, y + 1, y + 3);
+        std::rotate(values, values + 1, values + 3);
+    }
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if(!(area > 0.0f || area < 0.0f))
+        return false;
+    if(area < 0.0f)
+    {
+        std::swap(x[1], x[2]);
+        std::swap(y[1], y[2]);
+        std::swap(values[1], values[2]);
+        area = -area;
+    }
+    if(!set_soft_triangle_bounds(rasterizer, triangle, x, y))
+        return false;
+    // the three edges in the lanes 0 to 2: a = y[k] - y[k + 1], b = x[k + 1] - x[k]
+    __m128 edge_x = _mm_setr_ps(x[0], x[1], x[2], 0.0f);
+    __m128 edge_y = _mm_setr_ps(y[0], y[1], y[2], 0.0f);
+    __m128 next_x = _mm_setr_ps(x[1], x[2], x[0], 0.0f);
+    __m128 next_y = _mm_setr_ps(y[1], y[2], y[0], 0.0f);
+    __m128 edge_a = _mm_sub_ps(edge_y, next_y);
+    __m128 edge_b = _mm_sub_ps(next_x, edge_x);
+    __m128 zero = _mm_setzero_ps();
+    __m128 top_left = _mm_or_ps(_mm_cmpgt_ps(edge_a, zero), _mm_and_ps(_mm_cmpeq_ps(edge_a, zero), _mm_cmpgt_ps(edge_b, zero)));
+    _mm_storeu_ps(triangle->edge_a, edge_a);
+    _mm_storeu_ps(triangle->edge_b, edge_b);
+    _mm_storeu_si128((__m128i*)triangle->top_left, _mm_castps_si128(top_left));
+    // the four planes in the lanes
+    __m128 inverse_area = _mm_set1_ps(1.0f / area);
+    __m128 delta_1 = _mm_sub_ps(values[1], values[0]);
+    __m128 delta_2 = _mm_sub_ps(values[2], values[0]);
+    __m128 dx_1 = _mm_set1_ps(x[1] - x[0]), dy_1 = _mm_set1_ps(y[1] - y[0]);
+    __m128 dx_2 = _mm_set1_ps(x[2] - x[0]), dy_2 = _mm_set1_ps(y[2] - y[0]);
+    _mm_storeu_ps(triangle->planes[0], _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(delta_1, dy_2), _mm_mul_ps(delta_2, dy_1)), inverse_area));
+    _mm_storeu_ps(triangle->planes[1], _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(delta_2, dx_1), _mm_mul_ps(delta_1, dx_2)), inverse_area));
+    _mm_storeu_ps(triangle->planes[2], values[0]);
+    triangle->x0 = x[0];
+    triangle->y0 = y[0];
+    return true;
+}
+
+#endif
+
+bool setup_soft_triangle(Soft_Rasterizer* rasterizer, const Soft_Vertex** vertices, Soft_Triangle* triangle)
+{
+#ifdef SOFT_RASTERIZER_X86_SIMD
+    if(rasterizer->kernel == SOFT_RASTER_SSE)
+        return setup_soft_triangle_sse(rasterizer, vertices, triangle);
+#endif
+    return setup_soft_triangle_scalar(rasterizer, vertices, triangle);
+}
+
+/* clips the polygon against the plane side * z <= w (-1 near plane, 1 far plane), returns its vertices count */
+int clip_soft_polygon(const Soft_Vertex* polygon, int count, float side, Soft_Vertex* clipped)
+{
+    int clipped_count = 0;
+    for(int k = 0; k < count; k++)
+    {
+        const Soft_Vertex* a = &polygon[k];
+        const Soft_Vertex* b = &polygon[(k + 1) % count];
+        float distance_a = a->w - side * a->z, distance_b = b->w - side * b->z;
+        if(distance_a >= 0.0f)
+            clipped[clipped_count++] = *a;
+        if((distance_a >= 0.0f) != (distance_b >= 0.0f))
+        {
+            float t = distance_a / (distance_a - distance_b);
+            Soft_Vertex* vertex = &clipped[clipped_count++];
+            vertex->x = a->x + (b->x - a->x) * t;
+            vertex->y = a->y + (b->y - a->y) * t;
+            vertex->z = a->z + (b->z - a->z) * t;
+            vertex->w = a->w + (b->w - a->w) * t;
+            vertex->u = a->u + (b->u - a->u) * t;
+            vertex->v = a->v + (b->v - a->v) * t;
+        }
+    }
+    return clipped_count;
+}
+
+void bin_soft_triangle(Soft_Rasterizer* rasterizer, Soft_Bin* bins, Soft_Triangle* triangle, unsigned int slot)
+{
+    for(int tile_y = triangle->min_y / SOFT_TILE_SIZE; tile_y <= triangle->max_y / SOFT_TILE_SIZE; tile_y++)
+    {
+        for(int tile_x = triangle->min_x / SOFT_TILE_SIZE; tile_x <= triangle->max_x / SOFT_TILE_SIZE; tile_x++)
+        {
+            Soft_Bin* bin = &bins[tile_y * rasterizer->tiles_x + tile_x];
+            bin->triangles = (unsigned int*)reserve_soft_array(bin->triangles, &bin->capacity, bin->count + 1, sizeof(unsigned int));
+            bin->triangles[bin->count++] = slot;
+        }
+    }
+}
+
+void setup_soft_chunk(Soft_Rasterizer* rasterizer, Model_Data* model, unsigned int chunk_index)
+{
+    Soft_Chunk* chunk = &rasterizer->triangle_chunks[chunk_index];
+    Mesh_Data* mesh = model->meshes[chunk->mesh];
+    const Soft_Vertex* mesh_vertices = rasterizer->vertices + mesh->base_vertex;
+    Soft_Bin* bins = rasterizer->bins + (size_t)chunk_index * rasterizer->tiles_count;
+    for(int i = 0; i < rasterizer->tiles_count; i++)
+        bins[i].count = 0;
+    unsigned int slot = chunk->slot;
+    for(unsigned int i = chunk->first; i < chunk->end; i++)
+    {
+        const Soft_Vertex* vertices[3];
+        int outside_mask = 0x3f;
+        bool clip = false;
+        for(int k = 0; k < 3; k++)
+        {
+            const Soft_Vertex* vertex = &mesh_vertices[mesh->indices[i * 3 + k]];
+            vertices[k] = vertex;
+            // the planes each vertex is outside of, the triangle is culled when they share one
+            int outside = (vertex->x < -vertex->w) | (vertex->x > vertex->w) << 1 | (vertex->y < -vertex->w) << 2 |
+                          (vertex->y > vertex->w) << 3 | (vertex->z < -vertex->w) << 4 | (vertex->z > vertex->w) << 5;
+            outside_mask &= outside;
+            clip |= (outside & 0x30) != 0;
+        }
+        if(outside_mask != 0)
+            continue;
+        if(!clip)
+        {
+            if(setup_soft_triangle(rasterizer, vertices, &rasterizer->triangles[slot]))
+            {
+                bin_soft_triangle(rasterizer, bins, &rasterizer->triangles[slot], slot);
+                slot++;
+            }
+            continue;
+        }
+        Soft_Vertex triangle[3] = {*vertices[0], *vertices[1], *vertices[2]};
+        Soft_Vertex near_clipped[4], clipped[5];
+        int clipped_count = clip_soft_polygon(triangle, 3, -1.0f, near_clipped);
+        clipped_count = clip_soft_polygon(near_clipped, clipped_count, 1.0f, clipped);
+        for(int k = 1; k + 1 < clipped_count; k++)
+        {
+            const Soft_Vertex* fan[3] = {&clipped[0], &clipped[k], &clipped[k + 1]};
+            if(setup_soft_triangle(rasterizer, fan, &rasterizer->triangles[slot]))
+            {
+                bin_soft_triangle(rasterizer, bins, &rasterizer->triangles[slot], slot);
+                slot++;
+            }
+        }
+    }
+    rasterizer->triangles_drawn += slot - chunk->slot;
+}
+
+/* ----- raster stage ----- */
+
+int wrap_soft_texel(int texel, int size)
+{
+    texel %= size;
+    return texel < 0 ? texel + size : texel;
+}
+
+unsigned int fetch_soft_texel(const Soft_Texture* texture, float u, float v)
+{
+    float texel_u = u * texture->width, texel_v = v * texture->height;
+    // floor, nearest filtering with repeat
+    int x = (int)texel_u - (texel_u < (int)texel_u);
+    int y = (int)texel_v - (texel_v < (int)texel_v);
+    return texture->pixels[wrap_soft_texel(y, texture->height) * texture->width + wrap_soft_texel(x, texture->width)] | 0xff000000u;
+}
+
+/* the pixels of the triangle in the tile rectangle [x_begin, x_end] x [y_begin, y_end] */
+void raster_soft_triangle_scalar(Soft_Rasterizer* rasterizer, const Soft_Triangle* triangle, int origin_x, int origin_y,
+                                 int x_begin, int y_begin, int x_end, int y_end)
+{
+    float edge_origin[3];
+    for(int k = 0; k < 3; k++)
+        edge_origin[k] = triangle->edge_a[k] * (origin_x - triangle->edge_x[k]) + triangle->edge_b[k] * (origin_y - triangle->edge_y[k]);
+    for(int y = y_begin; y <= y_end; y++)
+    {
+        float tile_y = y - origin_y + 0.5f;
+        float plane_y = y + 0.5f - triangle->y0;
+        float edge_row[3];
+        for(int k = 0; k < 3; k++)
+            edge_row[k] = edge_origin[k] + triangle->edge_b[k] * tile_y;
+        unsigned int* color = rasterizer->color + (size_t)y * rasterizer->stride;
+        float* depth = rasterizer->depth + (size_t)y * rasterizer->stride;
+        for(int x = x_begin; x <= x_end; x++)
+        {
+            float tile_x = x - origin_x + 0.5f;
+            bool inside = true;
+            for(int k = 0; k < 3; k++)
+            {
+                float edge = edge_row[k] + triangle->edge_a[k] * tile_x;
+                inside &= edge > 0.0f || (edge == 0.0f && triangle->top_left[k] != 0);
+            }
+            if(!inside)
+                continue;
+            float plane_x = x + 0.5f - triangle->x0;
+            float values[4];
+            for(int i = 0; i < 4; i++)
+                values[i] = triangle->planes[2][i] + triangle->planes[1][i] * plane_y + triangle->planes[0][i] * plane_x;
+            if(!(values[0] > depth[x]))
+                continue;
+            depth[x] = values[0];
+            color[x] = fetch_soft_texel(&rasterizer->texture, values[1] / values[0], values[2] / values[0]);
+        }
+    }
+}
+
+#ifdef SOFT_RASTERIZER_X86_SIMD
+
+__attribute__((target("sse2")))
+void raster_soft_triangle_sse(Soft_Rasterizer* rasterizer, const Soft_Triangle* triangle, int origin_x, int origin_y,
+                              int x_begin, int y_begin, int x_end, int y_end)
+{
+    __m128 zero = _mm_setzero_ps();
+    __m128 edge_a = _mm_loadu_ps(triangle->edge_a);
+    __m128 edge_b = _mm_loadu_ps(triangle->edge_b);
+    // same operations as the scalar kernel, the edges shared by two triangles get opposite values
+    __m128 edge_origin = _mm_add_ps(_mm_mul_ps(edge_a, _mm_sub_ps(_mm_set1_ps((float)origin_x), _mm_loadu_ps(triangle->edge_x))),
+                                    _mm_mul_ps(edge_b, _mm_sub_ps(_mm_set1_ps((float)origin_y), _mm_loadu_ps(triangle->edge_y))));
+    float edge_values[4];
+    _mm_storeu_ps(edge_values, edge_origin);
+    __m128 edge_a_0 = _mm_set1_ps(triangle->edge_a[0]), edge_a_1 = _mm_set1_ps(triangle->edge_a[1]), edge_a_2 = _mm_set1_ps(triangle->edge_a[2]);
+    __m128 top_left_0 = _mm_castsi128_ps(_mm_set1_epi32(triangle->top_left[0]));
+    __m128 top_left_1 = _mm_castsi128_ps(_mm_set1_epi32(triangle->top_left[1]));
+    __m128 top_left_2 = _mm_castsi128_ps(_mm_set1_epi32(triangle->top_left[2]));
+    __m128 inverse_w_dx = _mm_set1_ps(triangle->planes[0][0]);
+    __m128 u_dx = _mm_set1_ps(triangle->planes[0][1]), v_dx = _mm_set1_ps(triangle->planes[0][2]);
+    const Soft_Texture* texture = &rasterizer->texture;
+    const __m128 lane_offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    int x_first = x_begin & ~3;
+    for(int y = y_begin; y <= y_end; y++)
+    {
+        __m128 edge_row = _mm_add_ps(edge_origin, _mm_mul_ps(edge_b, _mm_set1_ps(y - origin_y + 0.5f)));
+        float rows[4];
+        _mm_storeu_ps(rows, edge_row);
+        __m128 edge_row_0 = _mm_set1_ps(rows[0]), edge_row_1 = _mm_set1_ps(rows[1]), edge_row_2 = _mm_set1_ps(rows[2]);
+        float plane_y = y + 0.5f - triangle->y0;
+        __m128 plane_row = _mm_add_ps(_mm_loadu_ps(triangle->planes[2]), _mm_mul_ps(_mm_loadu_ps(triangle->planes[1]), _mm_set1_ps(plane_y)));
+        float plane_values[4];
+        _mm_storeu_ps(plane_values, plane_row);
+        __m128 inverse_w_row = _mm_set1_ps(plane_values[0]);
+        __m128 u_row = _mm_set1_ps(plane_values[1]), v_row = _mm_set1_ps(plane_values[2]);
+        unsigned int* color = rasterizer->color + (size_t)y * rasterizer->stride;
+        float* depth = rasterizer->depth + (size_t)y * rasterizer->stride;
+        for(int x = x_first; x <= x_end; x += 4)
+        {
+            __m128 pixel_x = _mm_add_ps(_mm_set1_ps((float)x), lane_offsets);
+            __m128 lanes = _mm_and_ps(_mm_cmpgt_ps(pixel_x, _mm_set1_ps((float)x_begin)),
+                                      _mm_cmplt_ps(pixel_x, _mm_set1_ps(x_end + 1.0f)));
+            __m128 tile_x = _mm_sub_ps(pixel_x, _mm_set1_ps((float)origin_x));
+            __m128 edge_0 = _mm_add_ps(edge_row_0, _mm_mul_ps(edge_a_0, tile_x));
+            __m128 edge_1 = _mm_add_ps(edge_row_1, _mm_mul_ps(edge_a_1, tile_x));
+            __m128 edge_2 = _mm_add_ps(edge_row_2, _mm_mul_ps(edge_a_2, tile_x));
+            __m128 inside = _mm_and_ps(lanes, _mm_or_ps(_mm_cmpgt_ps(edge_0, zero), _mm_and_ps(_mm_cmpeq_ps(edge_0, zero), top_left_0)));
+            inside = _mm_and_ps(inside, _mm_or_ps(_mm_cmpgt_ps(edge_1, zero), _mm_and_ps(_mm_cmpeq_ps(edge_1, zero), top_left_1)));
+            inside = _mm_and_ps(inside, _mm_or_ps(_mm_cmpgt_ps(edge_2, zero), _mm_and_ps(_mm_cmpeq_ps(edge_2, zero), top_left_2)));
+            if(_mm_movemask_ps(inside) == 0)
+                continue;
+            __m128 plane_x = _mm_sub_ps(pixel_x, _mm_set1_ps(triangle->x0));
+            __m128 inverse_w = _mm_add_ps(inverse_w_row, _mm_mul_ps(inverse_w_dx, plane_x));
+            __m128 old_depth = _mm_loadu_ps(depth + x);
+            inside = _mm_and_ps(inside, _mm_cmpgt_ps(inverse_w, old_depth));
+            int mask = _mm_movemask_ps(inside);
+            if(mask == 0)
+                continue;
+            _mm_storeu_ps(depth + x, _mm_or_ps(_mm_and_ps(inside, inverse_w), _mm_andnot_ps(inside, old_depth)));
+            __m128 texel_u = _mm_mul_ps(_mm_div_ps(_mm_add_ps(u_row, _mm_mul_ps(u_dx, plane_x)), inverse_w), _mm_set1_ps((float)texture->width));
+            __m128 texel_v = _mm_mul_ps(_mm_div_ps(_mm_add_ps(v_row, _mm_mul_ps(v_dx, plane_x)), inverse_w), _mm_set1_ps((float)texture->height));
+            // floor: the truncation minus one where it rounded up
+            __m128i truncated_u = _mm_cvttps_epi32(texel_u), truncated_v = _mm_cvttps_epi32(texel_v);
+            __m128i texel_x = _mm_add_epi32(truncated_u, _mm_castps_si128(_mm_cmplt_ps(texel_u, _mm_cvtepi32_ps(truncated_u))));
+            __m128i texel_y = _mm_add_epi32(truncated_v, _mm_castps_si128(_mm_cmplt_ps(texel_v, _mm_cvtepi32_ps(truncated_v))));
+            int texels_x[4], texels_y[4];
+            unsigned int texels[4];
+            _mm_storeu_si128((__m128i*)texels_x, texel_x);
+            _mm_storeu_si128((__m128i*)texels_y, texel_y);
+            for(int i = 0; i < 4; i++)
+            {
+                if(mask & (1 << i))
+                    texels[i] = texture->pixels[wrap_soft_texel(texels_y[i], texture->height) * texture->width +
+                                                wrap_soft_texel(texels_x[i], texture->width)] | 0xff000000u;
+            }
+            __m128i old_color = _mm_loadu_si128((__m128i*)(color + x));
+            __m128i inside_mask = _mm_castps_si128(inside);
+            __m128i new_color = _mm_loadu_si128((__m128i*)texels);
+            _mm_storeu_si128((__m128i*)(color + x), _mm_or_si128(_mm_and_si128(inside_mask, new_color), _mm_andnot_si128(inside_mask, old_color)));
+        }
+    }
+}
+
+#endif
+
+void raster_soft_tile(Soft_Rasterizer* rasterizer, int tile)
+{
+    int origin_x = (tile % rasterizer->tiles_x) * SOFT_TILE_SIZE;
+    int origin_y = (tile / rasterizer->tiles_x) * SOFT_TILE_SIZE;
+    int tile_end_x = std::min(origin_x + SOFT_TILE_SIZE, rasterizer->width) - 1;
+    int tile_end_y = std::min(origin_y + SOFT_TILE_SIZE, rasterizer->height) - 1;
+    for(int y = origin_y; y <= tile_end_y; y++)
+    {
+        unsigned int* color = rasterizer->color + (size_t)y * rasterizer->stride;
+        float* depth = rasterizer->depth + (size_t)y * rasterizer->stride;
+        for(int x = origin_x; x <= tile_end_x; x++)
+        {
+            color[x] = rasterizer->clear_color;
+            depth[x] = 0.0f;
+        }
+    }
+    for(unsigned int chunk = 0; chunk < rasterizer->triangle_chunks_count; chunk++)
+    {
+        Soft_Bin* bin = &rasterizer->bins[(size_t)chunk * rasterizer->tiles_count + tile];
+        for(unsigned int i = 0; i < bin->count; i++)
+        {
+            const Soft_Triangle* triangle = &rasterizer->triangles[bin->triangles[i]];
+            int x_begin = std::max(triangle->min_x, origin_x), x_end = std::min(triangle->max_x, tile_end_x);
+            int y_begin = std::max(triangle->min_y, origin_y), y_end = std::min(triangle->max_y, tile_end_y);
+#ifdef SOFT_RASTERIZER_X86_SIMD
+            if(rasterizer->kernel == SOFT_RASTER_SSE)
+            {
+                raster_soft_triangle_sse(rasterizer, triangle, origin_x, origin_y, x_begin, y_begin, x_end, y_end);
+                continue;
+            }
+#endif
+            raster_soft_triangle_scalar(rasterizer, triangle, origin_x, origin_y, x_begin, y_begin, x_end, y_end);
+        }
+    }
+}
+
+/* ----- frame ----- */
+
+void soft_vertex_task(void* task_data)
+{
+    Soft_Raster_Job* job = (Soft_Raster_Job*)task_data;
+    unsigned int item;
+    while((item = job->next_item.fetch_add(1)) < job->items_count)
+        transform_soft_vertices(job->rasterizer, job->model, &job->rasterizer->vertex_chunks[item]);
+}
+
+void soft_setup_task(void* task_data)
+{
+    Soft_Raster_Job* job = (Soft_Raster_Job*)task_data;
+    unsigned int item;
+    while((item = job->next_item.fetch_add(1)) < job->items_count)
+        setup_soft_chunk(job->rasterizer, job->model, item);
+}
+
+void soft_raster_task(void* task_data)
+{
+    Soft_Raster_Job* job = (Soft_Raster_Job*)task_data;
+    unsigned int item;
+    while((item = job->next_item.fetch_add(1)) < job->items_count)
+        raster_soft_tile(job->rasterizer, item);
+}
+
+/* runs the task on the pool threads until the items are done, on the calling thread without pool */
+void run_soft_raster_job(Soft_Rasterizer* rasterizer, Model_Data* model, Thread_Task_Function task, unsigned int items_count)
+{
+    Soft_Raster_Job job;
+    job.rasterizer = rasterizer;
+    job.model = model;
+    job.items_count = items_count;
+    job.next_item = 0;
+    if(rasterizer->pool == NULL || items_count <= 1)
+    {
+        task(&job);
+        return;
+    }
+    unsigned int tasks_count = std::min(thread_pool_threads_count(rasterizer->pool), items_count);
+    for(unsigned int i = 0; i < tasks_count; i++)
+        thread_pool_add_task(rasterizer->pool, task, &job);
+    thread_pool_wait(rasterizer->pool);
+}
+
+/* cuts the meshes in chunks of the vertex and setup stages and sizes the buffers of the frame */
+void prepare_soft_frame(Soft_Rasterizer* rasterizer, Model_Data* model)
+{
+    rasterizer->vertices = (Soft_Vertex*)reserve_soft_array(rasterizer->vertices, &rasterizer->vertices_capacity,
+                                                            model->vertices_count, sizeof(Soft_Vertex));
+    rasterizer->vertex_chunks_count = rasterizer->triangle_chunks_count = 0;
+    unsigned int slot = 0;
+    for(unsigned int i = 0; i < model->meshes_count; i++)
+    {
+        Mesh_Data* mesh = model->meshes[i];
+        for(unsigned int first = 0; first < mesh->vertices_count; first += SOFT_VERTEX_CHUNK)
+        {
+            rasterizer->vertex_chunks = (Soft_Chunk*)reserve_soft_array(rasterizer->vertex_chunks, &rasterizer->vertex_chunks_capacity,
+                                                                        rasterizer->vertex_chunks_count + 1, sizeof(Soft_Chunk));
+            Soft_Chunk* chunk = &rasterizer->vertex_chunks[rasterizer->vertex_chunks_count++];
+            chunk->mesh = i;
+            chunk->first = first;
+            chunk->end = std::min(first + SOFT_VERTEX_CHUNK, mesh->vertices_count);
+            chunk->slot = 0;
+        }
+        unsigned int triangles_count = mesh->indices_count / 3;
+        for(unsigned int first = 0; first < triangles_count; first += SOFT_TRIANGLE_CHUNK)
+        {
+            rasterizer->triangle_chunks = (Soft_Chunk*)reserve_soft_array(rasterizer->triangle_chunks, &rasterizer->triangle_chunks_capacity,
+                                                                          rasterizer->triangle_chunks_count + 1, sizeof(Soft_Chunk));
+            Soft_Chunk* chunk = &rasterizer->triangle_chunks[rasterizer->triangle_chunks_count++];
+            chunk->mesh = i;
+            chunk->first = first;
+            chunk->end = std::min(first + SOFT_TRIANGLE_CHUNK, triangles_count);
+            chunk->slot = slot;
+            slot += (chunk->end - first) * SOFT_CLIPPED_TRIANGLES;
+        }
+    }
+    rasterizer->triangles = (Soft_Triangle*)reserve_soft_array(rasterizer->triangles, &rasterizer->triangles_capacity,
+                                                               slot, sizeof(Soft_Triangle));
+    unsigned int bins_count = rasterizer->triangle_chunks_count * rasterizer->tiles_count;
+    if(bins_count > rasterizer->bins_capacity)
+    {
+        unsigned int old_capacity = rasterizer->bins_capacity;
+        rasterizer->bins = (Soft_Bin*)reserve_soft_array(rasterizer->bins, &rasterizer->bins_capacity, bins_count, sizeof(Soft_Bin));
+        memset(rasterizer->bins + old_capacity, 0, sizeof(Soft_Bin) * (rasterizer->bins_capacity - old_capacity));
+    }
+}
+
+/* draws the model at its current pose (see update_skeletal_animation), clip_matrix is
+   projection * view * model transform */
+void render_soft_model(Soft_Rasterizer* rasterizer, Model_Data* model, const glm::mat4& clip_matrix)
+{
+    double start = get_soft_time_ms();
+    prepare_soft_frame(rasterizer, model);
+    rasterizer->mesh_matrices = (glm::mat4*)reserve_soft_array(rasterizer->mesh_matrices, &rasterizer->meshes_capacity,
+                                                               model->meshes_count, sizeof(glm::mat4));
+    for(unsigned int i = 0; i < model->meshes_count; i++)
+        rasterizer->mesh_matrices[i] = clip_matrix * model->meshes[i]->bone_matrix;
+    if(model->joints_count > 0)
+    {
+        rasterizer->joint_matrices = (glm::mat4*)reserve_soft_array(rasterizer->joint_matrices, &rasterizer->joints_capacity,
+                                                                    model->joints_count, sizeof(glm::mat4));
+        for(unsigned int i = 0; i < model->joints_count; i++)
+            rasterizer->joint_matrices[i] = clip_matrix * model->joint_matrices[i];
+    }
+    rasterizer->texture.pixels = (const unsigned int*)model->image_pixels;
+    rasterizer->texture.width = model->image_width;
+    rasterizer->texture.height = model->image_height;
+    if(rasterizer->texture.pixels == NULL)
+    {
+        rasterizer->texture.pixels = &rasterizer->white_texel;
+        rasterizer->texture.width = rasterizer->texture.height = 1;
+    }
+    run_soft_raster_job(rasterizer, model, soft_vertex_task, rasterizer->vertex_chunks_count);
+    double vertex_time = get_soft_time_ms();
+    rasterizer->triangles_drawn = 0;
+    run_soft_raster_job(rasterizer, model, soft_setup_task, rasterizer->triangle_chunks_count);
+    double setup_time = get_soft_time_ms();
+    run_soft_raster_job(rasterizer, model, soft_raster_task, rasterizer->tiles_count);
+    double end = get_soft_time_ms();
+    rasterizer->vertex_ms += vertex_time - start;
+    rasterizer->setup_ms += setup_time - vertex_time;
+    rasterizer->raster_ms += end - setup_time;
+    rasterizer->frames_count++;
+}
+
+void print_soft_rasterizer_stats(Soft_Rasterizer* rasterizer)
+{
+    if(rasterizer->frames_count == 0)
+        return;
+    double frames = rasterizer->frames_count;
+    double total_ms = rasterizer->vertex_ms + rasterizer->setup_ms + rasterizer->raster_ms;
+    printf("soft rasterizer %dx%d (%s, %u threads): %u frames, %.2f ms per frame (vertices %.2f, setup %.2f, raster %.2f), "
+           "%.1f frames/s, %u triangles drawn \n", rasterizer->width, rasterizer->height, soft_raster_kernel_names[rasterizer->kernel],
+           rasterizer->pool != NULL ? thread_pool_threads_count(rasterizer->pool) : 1, rasterizer->frames_count,
+           total_ms / frames, rasterizer->vertex_ms / frames, rasterizer->setup_ms / frames, rasterizer->raster_ms / frames,
+           frames * 1000.0 / total_ms, rasterizer->triangles_drawn.load());
+}
+
+#endif // SOFT_RASTERIZER_H
@@ -0,0 +1,253 @@
+#ifndef TEXTURE_ARRAY_H
+#define TEXTURE_ARRAY_H
+
+#include "gltf_loader.h"
+
+/* one GL_TEXTURE_2D_ARRAY holding the textures of many models, so a scene mixing models binds a
+   single texture per frame and each draw only sets where its image is (see bind_model_texture).
+   the images are packed on shelves (rows as high as their first image) in layers of width x height,
+   an image identical to one already packed (same size and same pixels, compared when the 64 bit
+   hashes match) is shared instead of stored again, the variants of a model often have the same texture.
+   the array has no mipmaps and wraps the coordinates inside the image rect in the shader
+   (shaders/model_array.fs) with the wrap modes of the model sampler, which is exact with the nearest
+   filtering of the PlayStation textures. */
+
+#define TEXTURE_ARRAY_REPEAT 0
+#define TEXTURE_ARRAY_CLAMP 1
+#define TEXTURE_ARRAY_MIRROR 2
+
+typedef struct
+{
+    unsigned long long hash;
+    unsigned char* pixels;   // kept to compare the images with the same hash
+    int width, height;
+    int x, y;             // corner in the layer, in texels
+    unsigned int layer;
+    unsigned int references; // models using the image, its space is kept for the same image at 0
+}Texture_Array_Image;
+
+typedef struct
+{
+    unsigned int layer;
+    int y, height;
+    int width_used;
+}Texture_Array_Shelf;
+
+typedef struct
+{
+    unsigned int texture;
+    int width, height;          // size of every layer
+    unsigned int layers_count;  // layers allocated on the GPU
+    int* layers_height_used;    // top of the next shelf of each layer
+    Texture_Array_Image* images;
+    unsigned int images_count;
+    unsigned int images_size;
+    Texture_Array_Shelf* shelves;
+    unsigned int shelves_count;
+    unsigned int shelves_size;
+    unsigned int shared_images; // adds that found the image already packed
+}Texture_Array;
+
+/* allocates layers_count layers of width x height RGBA texels, filter is GL_NEAREST or GL_LINEAR */
+Texture_Array* create_texture_array(int width, int height, unsigned int layers_count, int filter)
+{
+    Texture_Array* array = (Texture_Array*)malloc(sizeof(Texture_Array));
+    array->width = width;
+    array->height = height;
+    array->layers_count = layers_count;
+    array->layers_height_used = (int*)calloc(layers_count, sizeof(int));
+    array->images_count = 0;
+    array->images_size = 64;
+    array->images = (Texture_Array_Image*)malloc(sizeof(Texture_Array_Image) * array->images_size);
+    array->shelves_count = 0;
+    array->shelves_size = 64;
+    array->shelves = (Texture_Array_Shelf*)malloc(sizeof(Texture_Array_Shelf) * array->shelves_size);
+    array->shared_images = 0;
+    glGenTextures(1, &array->texture);
+    bind_texture(0, GL_TEXTURE_2D_ARRAY, array->texture);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, filter);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA, width, height, layers_count, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    return array;
+}
+
+void free_texture_array(Texture_Array* array)
+{
+    delete_textures(1, &array->texture);
+    for(unsigned int i = 0; i < array->images_count; i++)
+        free(array->images[i].pixels);
+    free(array->layers_height_used);  array->layers_height_used = NULL;
+    free(array->images);  array->images = NULL;
+    free(array->shelves);  array->shelves = NULL;
+    free(array);  array = NULL;
+}
+
+/* FNV-1a over the pixels */
+unsigned long long hash_texture_pixels(unsigned char* pixels, size_t size)
+{
+    unsigned long long hash = 14695981039346656037ULL;
+    for(size_t i = 0; i < size; i++)
+    {
+        hash ^= pixels[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/* finds room for a width x height image: the first shelf of the layers tall enough and not more than
+   twice as tall with the width left, else a new shelf. returns false when every layer is full */
+bool allocate_texture_array_rect(Texture_Array* array, int width, int height, unsigned int* layer, int* x, int* y)
+{
+    if(width > array->width || height > array->height)
+        return false;
+    for(unsigned int i = 0; i < array->shelves_count; i++)
+    {
+        Texture_Array_Shelf* shelf = &array->shelves[i];
+        if(shelf->height >= height && shelf->height <= height * 2 && array->width - shelf->width_used >= width)
+        {
+            *layer = shelf->layer;
+            *x = shelf->width_used;
+            *y = shelf->y;
+            shelf->width_used += width;
+            return true;
+        }
+    }
+    for(unsigned int i = 0; i < array->layers_count; i++)
+    {
+        if(array->height - array->layers_height_used[i] < height)
+            continue;
+        if(array->shelves_count == array->shelves_size)
+        {
+            array->shelves_size *= 2;
+            array->shelves = (Texture_Array_Shelf*)realloc(array->shelves, sizeof(Texture_Array_Shelf) * array->shelves_size);
+        }
+        Texture_Array_Shelf* shelf = &array->shelves[array->shelves_count++];
+        shelf->layer = i;
+        shelf->y = array->layers_height_used[i];
+        shelf->height = height;
+        shelf->width_used = width;
+        array->layers_height_used[i] += height;
+        *layer = i;
+        *x = 0;
+        *y = shelf->y;
+        return true;
+    }
+    return false;
+}
+
+/* returns the index of the image in array->images, -1 when it does not fit in the array */
+int add_texture_array_image(Texture_Array* array, unsigned char* pixels, int width, int height)
+{
+    size_t size = (size_t)width * height * 4;
+    unsigned long long hash = hash_texture_pixels(pixels, size);
+    for(unsigned int i = 0; i < array->images_count; i++)
+    {
+        Texture_Array_Image* image = &array->images[i];
+        if(image->hash == hash && image->width == width && image->height == height && memcmp(image->pixels, pixels, size) == 0)
+        {
+            image->references++;
+            array->shared_images++;
+            return i;
+        }
+    }
+    unsigned int layer;
+    int x, y;
+    if(!allocate_texture_array_rect(array, width, height, &layer, &x, &y))
+        return -1;
+    if(array->images_count == array->images_size)
+    {
+        array->images_size *= 2;
+        array->images = (Texture_Array_Image*)realloc(array->images, sizeof(Texture_Array_Image) * array->images_size);
+    }
+    Texture_Array_Image* image = &array->images[array->images_count];
+    image->hash = hash;
+    image->pixels = (unsigned char*)malloc(size);
+    memcpy(image->pixels, pixels, size);
+    image->width = width;
+    image->height = height;
+    image->x = x;
+    image->y = y;
+    image->layer = layer;
+    image->references = 1;
+    bind_texture(0, GL_TEXTURE_2D_ARRAY, array->texture);
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, x, y, layer, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    return array->images_count++;
+}
+
+/* TEXTURE_ARRAY_ wrap of model_array.fs for a GL wrap mode */
+int get_texture_array_wrap(int wrap)
+{
+    if(wrap == GL_CLAMP_TO_EDGE || wrap == GL_CLAMP_TO_BORDER)
+        return TEXTURE_ARRAY_CLAMP;
+    if(wrap == GL_MIRRORED_REPEAT)
+        return TEXTURE_ARRAY_MIRROR;
+    return TEXTURE_ARRAY_REPEAT;
+}
+
+/* moves the texture of the model into the array: the pixels are read back from the model texture,
+   which is deleted, and the model draws from its rect in the array from then on.
+   returns false (the model keeps its texture) for indexed textures and when the array is full */
+bool pack_model_texture(Texture_Array* array, Model_Data* model)
+{
+    if(model->texture == 0 || model->palette_texture != 0 || model->texture_array_image >= 0)
+        return false;
+    int width = 0, height = 0;
+    bind_texture(0, GL_TEXTURE_2D, model->texture);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+    if(width <= 0 || height <= 0)
+        return false;
+    int wrap_s = GL_REPEAT, wrap_t = GL_REPEAT;
+    glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, &wrap_s);
+    glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, &wrap_t);
+    unsigned char* pixels = (unsigned char*)malloc((size_t)width * height * 4);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    int image_index = add_texture_array_image(array, pixels, width, height);
+    free(pixels);
+    if(image_index < 0)
+        return false;
+    Texture_Array_Image* image = &array->images[image_index];
+    model->texture_array_image = image_index;
+    model->texture_rect = glm::vec4((float)image->x / array->width, (float)image->y / array->height,
+                                    (float)image->width / array->width, (float)image->height / array->height);
+    model->texture_layer = image->layer;
+    model->texture_wrap = glm::ivec2(get_texture_array_wrap(wrap_s), get_texture_array_wrap(wrap_t));
+    delete_textures(1, &model->texture);
+    model->texture = 0;
+    return true;
+}
+
+/* call before freeing a packed model */
+void unpack_model_texture(Texture_Array* array, Model_Data* model)
+{
+    if(model->texture_array_image < 0)
+        return;
+    array->images[model->texture_array_image].references--;
+    model->texture_array_image = -1;
+}
+
+/* binds the array on texture unit 0 once for all the packed models, their draws only set
+   their rect (see bind_model_texture) */
+void bind_texture_array(Texture_Array* array)
+{
+    bind_texture(0, GL_TEXTURE_2D_ARRAY, array->texture);
+}
+
+/* GPU bytes of the layers used against one texture per model with mipmaps */
+void print_texture_array_stats(Texture_Array* array, unsigned int models_count)
+{
+    size_t models_size = 0;
+    unsigned int layers_used = 0;
+    for(unsigned int i = 0; i < array->images_count; i++)
+        models_size += (size_t)array->images[i].width * array->images[i].height * 4 * array->images[i].references * 4 / 3;
+    for(unsigned int i = 0; i < array->layers_count; i++)
+        layers_used += array->layers_height_used[i] > 0;
+    printf("texture array: %u models, %u unique images (%u shared), %u of %u layers %dx%d used, %.1f KB instead of %.1f KB \n",
+           models_count, array->images_count, array->shared_images, layers_used, array->layers_count,
+           array->width, array->height, (size_t)array->width * array->height * 4 * layers_used / 1024.0f,
+           models_size / 1024.0f);
+}
+
+#endif // TEXTURE_ARRAY_H
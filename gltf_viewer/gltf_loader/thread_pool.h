@@ -0,0 +1,108 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <deque>
+
+typedef void (*Thread_Task_Function)(void* task_data);
+
+typedef struct
+{
+    Thread_Task_Function function;
+    void* task_data;
+}Thread_Task;
+
+typedef struct Thread_Pool
+{
+    std::vector<std::thread> threads;
+    std::deque<Thread_Task> tasks;
+    std::mutex mutex;
+    std::condition_variable task_available;
+    std::condition_variable tasks_done;
+    unsigned int pending_tasks;
+    bool running;
+}Thread_Pool;
+
+void thread_pool_worker(Thread_Pool* pool)
+{
+    Thread_Task task;
+    for(;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(pool->mutex);
+            while(pool->running && pool->tasks.empty())
+                pool->task_available.wait(lock);
+            if(!pool->running && pool->tasks.empty())
+                return;
+            task = pool->tasks.front();
+            pool->tasks.pop_front();
+        }
+        task.function(task.task_data);
+        {
+            std::lock_guard<std::mutex> lock(pool->mutex);
+            pool->pending_tasks--;
+            if(pool->pending_tasks == 0)
+                pool->tasks_done.notify_all();
+        }
+    }
+}
+
+/* threads_count = 0 uses one thread per hardware core */
+Thread_Pool* create_thread_pool(unsigned int threads_count)
+{
+    if(threads_count == 0)
+        threads_count = std::thread::hardware_concurrency();
+    if(threads_count == 0)
+        threads_count = 1;
+    Thread_Pool* pool = new Thread_Pool;
+    pool->pending_tasks = 0;
+    pool->running = true;
+    for(unsigned int i = 0; i < threads_count; i++)
+    {
+        pool->threads.push_back(std::thread(thread_pool_worker, pool));
+    }
+    return pool;
+}
+
+unsigned int thread_pool_threads_count(Thread_Pool* pool)
+{
+    return pool->threads.size();
+}
+
+void thread_pool_add_task(Thread_Pool* pool, Thread_Task_Function function, void* task_data)
+{
+    Thread_Task task = {function, task_data};
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        pool->tasks.push_back(task);
+        pool->pending_tasks++;
+    }
+    pool->task_available.notify_one();
+}
+
+/* blocks until every task added so far has finished */
+void thread_pool_wait(Thread_Pool* pool)
+{
+    std::unique_lock<std::mutex> lock(pool->mutex);
+    while(pool->pending_tasks > 0)
+        pool->tasks_done.wait(lock);
+}
+
+void free_thread_pool(Thread_Pool* pool)
+{
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        pool->running = false;
+    }
+    pool->task_available.notify_all();
+    for(unsigned int i = 0; i < pool->threads.size(); i++)
+    {
+        pool->threads[i].join();
+    }
+    delete pool;  pool = NULL;
+}
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,227 @@
+#ifndef TIM_LOADER_H
+#define TIM_LOADER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/* PlayStation .TIM images: a header, an optional CLUT block (palettes of 16 bit colors)
+   and the image block. 4 and 8 bit images are palette indices, 16 bit images are 15 bit BGR
+   colors plus a semi transparency bit, 24 bit images are RGB triplets.
+   the block widths are in 16 bit VRAM units, so a 4 bit image is 4 pixels per unit.
+   a color of 0 is fully transparent on the PlayStation, it gets alpha 0 here.
+   create_tim_texture (gltf_loader.h) keeps 4 and 8 bit images palettized on the GPU: an 8 bit index
+   texture and a small palette texture, the lookup is done by shaders/model_indexed.fs. that is 1 byte per texel
+   without mipmaps instead of 4 bytes plus mipmaps for the expanded RGBA image. */
+
+#define TIM_MAGIC 0x10
+#define TIM_HAS_CLUT 0x8
+
+typedef struct
+{
+    int bits_per_pixel;      // 4, 8, 16 or 24
+    int width, height;       // in pixels
+    unsigned char* indices;  // one palette index per pixel for 4 and 8 bit images, else NULL
+    unsigned char* palette;  // RGBA, palette_size colors per row, NULL without CLUT
+    int palette_size;
+    int palette_rows;
+    unsigned char* pixels;   // RGBA for 16 and 24 bit images, else NULL
+}Tim_Image;
+
+void convert_tim_color(uint16_t color, unsigned char* rgba)
+{
+    rgba[0] = ((color & 0x1f) * 255) / 31;
+    rgba[1] = (((color >> 5) & 0x1f) * 255) / 31;
+    rgba[2] = (((color >> 10) & 0x1f) * 255) / 31;
+    rgba[3] = color == 0 ? 0 : 255;
+}
+
+uint16_t read_tim_u16(const unsigned char* data)
+{
+    return data[0] | (data[1] << 8);
+}
+
+uint32_t read_tim_u32(const unsigned char* data)
+{
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+void free_tim_image(Tim_Image* image)
+{
+    free(image->indices);  image->indices = NULL;
+    free(image->palette);  image->palette = NULL;
+    free(image->pixels);  image->pixels = NULL;
+    free(image);  image = NULL;
+}
+
+/* returns NULL when the data is not a valid TIM image */
+Tim_Image* decode_tim_image(const unsigned char* data, size_t size)
+{
+    if(size < 8 || read_tim_u32(data) != TIM_MAGIC)
+        return NULL;
+    uint32_t flags = read_tim_u32(data + 4);
+    int bits_per_pixel_modes[4] = {4, 8, 16, 24};
+    if((flags & 7) > 3)
+        return NULL;
+    Tim_Image* image = (Tim_Image*)calloc(1, sizeof(Tim_Image));
+    image->bits_per_pixel = bits_per_pixel_modes[flags & 7];
+    size_t offset = 8;
+
+    if(flags & TIM_HAS_CLUT)
+    {
+        if(offset + 12 > size)
+        {
+            free_tim_image(image);
+            return NULL;
+        }
+        uint32_t block_size = read_tim_u32(data + offset);
+        int clut_width = read_tim_u16(data + offset + 8);
+        int clut_height = read_tim_u16(data + offset + 10);
+        if(block_size < 12 || offset + block_size > size || clut_width == 0 || clut_height == 0)
+        {
+            free_tim_image(image);
+            return NULL;
+        }
+        // some files overstate the clut width, the block size gives the real colors count
+        int colors_count = (block_size - 12) / 2;
+        if(clut_width * clut_height > colors_count)
+            clut_width = colors_count / clut_height;
+        if(clut_width == 0) // not a color for each row
+        {
+            free_tim_image(image);
+            return NULL;
+        }
+        image->palette_size = clut_width;
+        image->palette_rows = clut_height;
+        image->palette = (unsigned char*)malloc(clut_width * clut_height * 4);
+        for(int i = 0; i < clut_width * clut_height; i++)
+            convert_tim_color(read_tim_u16(data + offset + 12 + i * 2), image->palette + i * 4);
+        offset += block_size;
+    }
+
+    if(offset + 12 > size)
+    {
+        free_tim_image(image);
+        return NULL;
+    }
+    int units_width = read_tim_u16(data + offset + 8);
+    image->height = read_tim_u16(data + offset + 10);
+    image->width = units_width * 16 / image->bits_per_pixel;
+    const unsigned char* image_data = data + offset + 12;
+    size_t row_size = units_width * 2;
+    if(offset + 12 + row_size * image->height > size || image->width == 0 || image->height == 0 ||
+       (image->bits_per_pixel <= 8 && image->palette == NULL))
+    {
+        free_tim_image(image);
+        return NULL;
+    }
+    int pixels_count = image->width * image->height;
+    switch(image->bits_per_pixel)
+    {
+        case 4:
+            image->indices = (unsigned char*)malloc(pixels_count);
+            for(int i = 0; i < pixels_count; i += 2)
+            {
+                unsigned char byte = image_data[i / 2];
+                image->indices[i] = byte & 0xf;
+                image->indices[i + 1] = byte >> 4;
+            }
+            break;
+        case 8:
+            image->indices = (unsigned char*)malloc(pixels_count);
+            memcpy(image->indices, image_data, pixels_count);
+            break;
+        case 16:
+            image->pixels = (unsigned char*)malloc(pixels_count * 4);
+            for(int i = 0; i < pixels_count; i++)
+                convert_tim_color(read_tim_u16(image_data + i * 2), image->pixels + i * 4);
+            break;
+        case 24:
+            image->pixels = (unsigned char*)malloc(pixels_count * 4);
+            for(int y = 0; y < image->height; y++)
+            {
+                for(int x = 0; x < image->width; x++)
+                {
+                    const unsigned char* rgb = image_data + y * row_size + x * 3;
+                    unsigned char* rgba = image->pixels + (y * image->width + x) * 4;
+                    rgba[0] = rgb[0];  rgba[1] = rgb[1];  rgba[2] = rgb[2];  rgba[3] = 255;
+                }
+            }
+            break;
+    }
+    // palette indices past the palette read its last color
+    if(image->indices != NULL)
+    {
+        for(int i = 0; i < pixels_count; i++)
+        {
+            if(image->indices[i] >= image->palette_size)
+                image->indices[i] = image->palette_size - 1;
+        }
+    }
+    return image;
+}
+
+Tim_Image* load_tim_file(const char* file_name)
+{
+    FILE* file = fopen(file_name, "rb");
+    if(file == NULL)
+        return NULL;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    unsigned char* data = (unsigned char*)malloc(size > 0 ? size : 1);
+    Tim_Image* image = NULL;
+    if(size > 0 && fread(data, 1, size, file) == (size_t)size)
+        image = decode_tim_image(data, size);
+    free(data);
+    fclose(file);
+    if(image == NULL)
+        printf("invalid TIM file: %s \n", file_name);
+    return image;
+}
+
+/* RGBA pixels of the image, palettized images are looked up in the clut row palette_row */
+unsigned char* expand_tim_image(Tim_Image* image, int palette_row)
+{
+    int pixels_count = image->width * image->height;
+    unsigned char* pixels = (unsigned char*)malloc(pixels_count * 4);
+    if(image->pixels != NULL)
+    {
+        memcpy(pixels, image->pixels, pixels_count * 4);
+        return pixels;
+    }
+    unsigned char* palette = image->palette + palette_row * image->palette_size * 4;
+    for(int i = 0; i < pixels_count; i++)
+        memcpy(pixels + i * 4, palette + image->indices[i] * 4, 4);
+    return pixels;
+}
+
+/* the .TIM file next to a gltf file: same name, TIM extension */
+void get_tim_file_name(const char* model_file, char* tim_file, size_t tim_file_size)
+{
+    strncpy(tim_file, model_file, tim_file_size - 5);
+    tim_file[tim_file_size - 5] = '\0';
+    char* dot = strrchr(tim_file, '.');
+    char* slash = strrchr(tim_file, '/');
+    if(dot == NULL || (slash != NULL && dot < slash))
+        dot = tim_file + strlen(tim_file);
+    strcpy(dot, ".TIM");
+}
+
+void print_tim_image(Tim_Image* image)
+{
+    size_t rgba_size = (size_t)image->width * image->height * 4 * 4 / 3;
+    if(image->indices == NULL)
+    {
+        printf("TIM texture: %dx%d %d bit, %.1f KB RGBA \n", image->width, image->height, image->bits_per_pixel,
+               rgba_size / 1024.0f);
+        return;
+    }
+    size_t indexed_size = (size_t)image->width * image->height + image->palette_size * image->palette_rows * 4;
+    printf("TIM texture: %dx%d %d bit, %d colors x %d palettes, %.1f KB indexed instead of %.1f KB RGBA \n",
+           image->width, image->height, image->bits_per_pixel, image->palette_size, image->palette_rows,
+           indexed_size / 1024.0f, rgba_size / 1024.0f);
+}
+
+#endif // TIM_LOADER_H
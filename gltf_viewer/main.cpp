@@ -2,6 +2,9 @@
 #include "glad.h"
 
 #include "gltf_loader/gltf_loader.h"
+#include "gltf_loader/model_cache.h"
+#include "gltf_loader/headless_renderer.h"
+#include "gltf_loader/frame_pacer.h"
 
 #include "gltf_loader/shader_s.h"
 #include "gltf_loader/camera.h"
@@ -11,7 +14,6 @@
 
 
 void processInput(void);
-void sleep(void);
 void dw1_model_transform(Shader *shader);
 void dw2_model_transform(Shader *shader);
 void dw3_model_transform(Shader *shader);
@@ -40,10 +42,148 @@ bool main_loop = true;
 SDL_Event event;
 Uint8* keys;
 
+/* removes the switch from the arguments when it is present, so the others keep their positions */
+bool take_switch_argument(int* argc, char* argv[], const char* name)
+{
+    for(int i = 1; i < *argc; i++)
+    {
+        if(strcmp(argv[i], name) == 0)
+        {
+            for(int j = i; j < *argc - 1; j++)
+                argv[j] = argv[j + 1];
+            (*argc)--;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* removes the option and its value from the arguments, returns the value or NULL when the option is absent */
+char* take_value_argument(int* argc, char* argv[], const char* name)
+{
+    for(int i = 1; i < *argc - 1; i++)
+    {
+        if(strcmp(argv[i], name) == 0)
+        {
+            char* value = argv[i + 1];
+            for(int j = i; j < *argc - 2; j++)
+                argv[j] = argv[j + 2];
+            (*argc) -= 2;
+            return value;
+        }
+    }
+    return NULL;
+}
+
 int main(int argc, char *argv[])
 {
+    // reorder the meshes for the vertex cache at load or bake time
+    bool optimize_meshes = take_switch_argument(&argc, argv, "-optimize");
+    // texture from the PlayStation .TIM file next to the model, kept palettized on the GPU
+    bool tim_texture = take_switch_argument(&argc, argv, "-tim");
+    // Chrome trace of the profiled frames written on exit
+    char* trace_file = take_value_argument(&argc, argv, "-trace");
+
+    // offline bake of a gltf file into a .gvc model cache, no window needed
+    if(argc > 2 && strcmp(argv[1], "-bake") == 0)
+    {
+        char cache_file[260];
+        int cache_file_length;
+        if(argc > 3)
+            cache_file_length = snprintf(cache_file, sizeof(cache_file), "%s", argv[3]);
+        else
+        {
+            // the extension of the gltf file is replaced, a dot in a directory name is not one
+            int name_length = (int)strlen(argv[2]);
+            const char* dot = strrchr(argv[2], '.');
+            const char* slash = strrchr(argv[2], '/');
+            const char* backslash = strrchr(argv[2], '\\');
+            if(backslash != NULL && (slash == NULL || backslash > slash))
+                slash = backslash;
+            if(dot != NULL && (slash == NULL || dot > slash))
+                name_length = (int)(dot - argv[2]);
+            cache_file_length = snprintf(cache_file, sizeof(cache_file), "%.*s.gvc", name_length, argv[2]);
+        }
+        if(cache_file_length < 0 || cache_file_length >= (int)sizeof(cache_file))
+        {
+            printf("the cache file name is too long (%d characters max) \n", (int)sizeof(cache_file) - 1);
+            return 1;
+        }
+        Thread_Pool* bake_pool = create_thread_pool(0);
+        int success = bake_model_cache(argv[2], cache_file, bake_pool, optimize_meshes);
+        free_thread_pool(bake_pool);
+        return success ? 0 : 1;
+    }
+
+    // headless rendering of png frames on a surfaceless context, no window needed
+    char* clip_argument = take_value_argument(&argc, argv, "-clip");
+    char* times_argument = take_value_argument(&argc, argv, "-times");
+    char* size_argument = take_value_argument(&argc, argv, "-size");
+    char* processes_argument = take_value_argument(&argc, argv, "-processes");
+    if(argc > 3 && (strcmp(argv[1], "-headless") == 0 || strcmp(argv[1], "-headless-dir") == 0))
+    {
+        Headless_Job job = {};
+        job.clip = clip_argument != NULL ? atoi(clip_argument) : -1;
+        if(!parse_headless_times(times_argument != NULL ? times_argument : "0", &job))
+        {
+            printf("invalid times: %s \n", times_argument);
+            return 1;
+        }
+        if(optimize_meshes)
+            job.load_flags |= MODEL_LOAD_OPTIMIZE_MESHES;
+        if(tim_texture)
+            job.load_flags |= MODEL_LOAD_TIM_TEXTURE;
+        job.output_directory = argv[3];
+        job.model_transform = dw1_model_transform;
+        if(argc > 4 && argv[4][0] == '2')
+            job.model_transform = dw2_model_transform;
+        else if(argc > 4 && argv[4][0] == '3')
+            job.model_transform = dw3_model_transform;
+        int width = SCR_WIDTH, height = SCR_HEIGHT;
+        if(size_argument != NULL && sscanf(size_argument, "%dx%d", &width, &height) != 2)
+        {
+            printf("invalid size: %s \n", size_argument);
+            return 1;
+        }
+        if(strcmp(argv[1], "-headless-dir") == 0)
+        {
+            int processes_count = processes_argument != NULL ? atoi(processes_argument) : 0;
+            return render_headless_directory(argv[2], &job, width, height, processes_count) > 0 ? 0 : 1;
+        }
+        Headless_Renderer* renderer = create_headless_renderer(width, height);
+        if(renderer == NULL)
+            return 1;
+        int frames_count = render_headless_model(renderer, argv[2], &job);
+        double total_ms = renderer->render_ms + renderer->write_ms;
+        if(frames_count >= 0)
+            printf("%d frames of %dx%d: %.1f ms rendering, %.1f ms writing png, %.1f frames/s \n", frames_count, width, height,
+                   renderer->render_ms, renderer->write_ms, total_ms > 0.0 ? frames_count * 1000.0 / total_ms : 0.0);
+        free_headless_renderer(renderer);
+        return frames_count > 0 ? 0 : 1;
+    }
+
+    // frame pacing: uncapped, vsync or a target rate (60 fps by default)
+    int pace_mode = FRAME_PACE_TARGET;
+    double pace_rate = 60.0;
+    char* pace_argument = take_value_argument(&argc, argv, "-pace");
+    if(pace_argument != NULL && !parse_frame_pace_mode(pace_argument, &pace_mode, &pace_rate))
+    {
+        printf("invalid pace: %s \n", pace_argument);
+        return 1;
+    }
+    Frame_Pacer* frame_pacer = create_frame_pacer(pace_mode, pace_rate);
+    // animation sampled at every frame, or simulated in fixed steps and drawn between them, or step by step with -anim-steps
+    char* animation_rate_argument = take_value_argument(&argc, argv, "-anim-rate");
+    bool animation_steps = take_switch_argument(&argc, argv, "-anim-steps");
+    double animation_rate = animation_steps ? ANIMATION_STEP_RATE : 0.0;
+    if(animation_rate_argument != NULL)
+        animation_rate = atof(animation_rate_argument);
+    // baked animations draw the nearest frame instead of lerping the matrices of the two frames around the time
+    bool bake_nearest = take_switch_argument(&argc, argv, "-bake-nearest");
+
     SDL_Init(SDL_INIT_VIDEO);
     SDL_WM_SetCaption("gltf_viewer",NULL);
+    SDL_GL_SetAttribute(SDL_GL_SWAP_CONTROL, get_frame_pacer_swap_interval(frame_pacer));
     SDL_SetVideoMode(640, 480, 32, SDL_OPENGL);//|SDL_RESIZABLE);
 
     // glad: load all OpenGL function pointers
@@ -61,7 +201,24 @@ int main(int argc, char *argv[])
     if(argc > 1 && argv[1][0] == '-' && argv[1][1] == 'h')
     {
         printf("help: \n\n");
-        printf("gltf_viewer.exe file_name [model_version:(1,2,3)] \n\n");
+        printf("gltf_viewer.exe file_name [model_version:(1,2,3)] [loader_threads] [bake_fps] \n\n");
+        printf("loader_threads: decode the model buffers on a thread pool (0 = one thread per core) \n\n");
+        printf("bake_fps: pre-sample the animations at bake_fps into matrix palettes read by the vertex shader, \n");
+        printf("-bake-nearest: draw the nearest baked frame instead of lerping the matrices of two frames \n\n");
+        printf("gltf_viewer.exe -bake file_name.gltf [cache_name.gvc] \n\n");
+        printf("bakes the model into a .gvc cache file, which can be passed as file_name instead of the gltf file \n\n");
+        printf("-optimize: reorder the triangles and vertices of the meshes for the GPU vertex cache when loading or baking \n\n");
+        printf("-tim: load the texture from the .TIM file next to the gltf file instead of the embedded image \n\n");
+        printf("gltf_viewer.exe -headless file_name output_directory [model_version:(1,2,3)] \n");
+        printf("gltf_viewer.exe -headless-dir directory output_directory [model_version:(1,2,3)] \n\n");
+        printf("renders png frames without a window (build with HEADLESS_EGL or HEADLESS_OSMESA), every gltf and gvc file \n");
+        printf("of the directory with -headless-dir. options: -clip n (default every clip), -times 0,0.5,1 in seconds (default 0), \n");
+        printf("-size 640x480, -processes n for -headless-dir (default one per core) \n\n");
+        printf("-pace uncapped|vsync|fps: frame rate limit, none, the display refresh or a target rate (default 60) \n\n");
+        printf("-anim-rate fps: simulate the animation in fixed steps (default 0 = sampled every frame), the frames are \n");
+        printf("drawn between the steps, -anim-steps: show the steps without interpolation (30 fps without -anim-rate) \n\n");
+        printf("-trace file.json: write the cpu and GPU times of every frame as a Chrome trace on exit, \n");
+        printf("g shows the graph of the last frames \n\n");
         return 0;
     }
 
@@ -95,13 +252,61 @@ int main(int argc, char *argv[])
         if(!valid_file)
         {
             printf("no model to load ! \n\n");
-            printf("gltf_viewer.exe file_name [model_version:(1,2,3)] \n\n");
+            printf("gltf_viewer.exe file_name [model_version:(1,2,3)] [loader_threads] [bake_fps] \n\n");
             return 0;
         }
         fclose(valid_file);
     }
-    Model_Data* model = load_gltf_model(model_file);
+    // optional thread pool for base64 buffer decoding
+    Thread_Pool* loader_pool = NULL;
+    if(argc > 3 && isdigit(argv[3][0]))
+        loader_pool = create_thread_pool(atoi(argv[3]));
+
+    Model_Data* model = NULL;
+    if(is_model_cache_file(model_file))
+        model = load_model_cache(model_file);
+    else
+    {
+        unsigned int load_flags = 0;
+        if(optimize_meshes)
+            load_flags |= MODEL_LOAD_OPTIMIZE_MESHES;
+        if(tim_texture)
+            load_flags |= MODEL_LOAD_TIM_TEXTURE;
+        model = load_gltf_model_parallel(model_file, loader_pool, load_flags);
+    }
+
+    if(model == NULL)
+    {
+        printf("could not load model: %s \n\n", model_file);
+        SDL_Quit();
+        return 1;
+    }
+
+    if(loader_pool != NULL)
+        free_thread_pool(loader_pool);
+
+    // optional baked animations, the matrix palettes live in texture buffers
+    float bake_fps = 0.0f;
+    if(argc > 4 && isdigit(argv[4][0]))
+        bake_fps = atof(argv[4]);
+    if(bake_fps > 0.0f && model->animations_count == 0)
+    {
+        printf("no animations to bake in %s \n", model_file);
+        bake_fps = 0.0f;
+    }
+    if(bake_fps > 0.0f)
+    {
+        bake_model_animations(model, bake_fps, !bake_nearest);
+        upload_baked_animations(model);
+        size_t baked_size = 0;
+        for(unsigned int i = 0; i < model->animations_count; i++)
+            baked_size += model->animations[i]->baked->frames_count * model->animations[i]->baked->frame_matrices_count * sizeof(glm::mat4);
+        printf("baked animations: %.0f fps, %s, %.1f KB \n", bake_fps, bake_nearest ? "nearest frame" : "interpolated", baked_size / 1024.0f);
+    }
+
     animations_count = model->animations_count;
+    if(animations_count > 0)
+        set_animation_clock_rate(model, animation_rate, !animation_steps);
     //model_animation* animation = load_model_animation(&gltf_data->animations[0], gltf_data->nodes, model->anim_nodes);
     /*for(int i = 0; i < animation->anim_data_count; i++)
     {
@@ -118,13 +323,27 @@ int main(int argc, char *argv[])
 
     // build and compile our shader zprogram
     // ------------------------------------
-    Shader ourShader("gltf_loader/shaders/model.vs", "gltf_loader/shaders/model.fs");
+    // palettized textures are looked up in the fragment shader, skinned meshes are skinned in the vertex shader
+    const char* vertex_shader = "gltf_loader/shaders/model_merged.vs";
+    if(bake_fps > 0.0f)
+        vertex_shader = "gltf_loader/shaders/model_baked.vs";
+    else if(model->skin_VBO != 0)
+        vertex_shader = "gltf_loader/shaders/model_skinned.vs";
+    Shader ourShader(vertex_shader, model->palette_texture != 0 ? "gltf_loader/shaders/model_indexed.fs" : "gltf_loader/shaders/model.fs");
+    ourShader.use();
+    ourShader.setInt(UNIFORM_TEXTURE_PALETTE, 2);
+    // the node matrices of each frame, written once and read by the merged draw
+    Node_Matrix_Buffer* node_matrix_buffer = create_node_matrix_buffer(1024, MODEL_MAX_BONES);
+    // cpu and GPU time of the stages of each frame, graph toggled with g
+    frame_profiler = create_frame_profiler(trace_file != NULL);
+    Shader graphShader("gltf_loader/shaders/profiler_graph.vs", "gltf_loader/shaders/profiler_graph.fs");
 
     // uncomment this call to draw in wireframe polygons.
     //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
     // render loop
     // -----------
+    double last_frame_ns = get_pacer_time_ns();
     while (main_loop)
     {
         // per-frame time logic
@@ -132,6 +351,12 @@ int main(int argc, char *argv[])
 		currentFrame = SDL_GetTicks();
 		deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
+        // the animation clock gets the nanosecond time, SDL_GetTicks counts whole milliseconds
+        double current_frame_ns = get_pacer_time_ns();
+        double frame_seconds = (current_frame_ns - last_frame_ns) / 1.0e9;
+        last_frame_ns = current_frame_ns;
+
+        begin_profiler_frame(frame_profiler);
 
         if(change_animation)
         {
@@ -139,7 +364,14 @@ int main(int argc, char *argv[])
              change_animation = false;
         }
 
-        update_skeletal_animation(model, deltaTime);
+        advance_animation_clock(model, frame_seconds);
+        if(bake_fps <= 0.0f)
+        {
+            Profile_Scope scope(PROFILE_UPLOAD);
+            begin_node_matrix_frame(node_matrix_buffer);
+            write_model_node_matrices(node_matrix_buffer, model);
+            upload_node_matrices(node_matrix_buffer);
+        }
 
         // input
         // -----
@@ -150,30 +382,58 @@ int main(int argc, char *argv[])
         glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // activate shader
-        ourShader.use();
+        {
+            Profile_Scope scope(PROFILE_UPLOAD);
+            // activate shader
+            ourShader.use();
 
-        // pass projection matrix to shader (note that in this case it could change every frame)
-        glm::mat4 projection_mat = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        ourShader.setMat4("projection", projection_mat);
+            // pass projection matrix to shader (note that in this case it could change every frame)
+            glm::mat4 projection_mat = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+            ourShader.setMat4(UNIFORM_PROJECTION, projection_mat);
 
-        // camera/view transformation
-        glm::mat4 view_mat = camera.GetViewMatrix();
-        ourShader.setMat4("view", view_mat);
+            // camera/view transformation
+            glm::mat4 view_mat = camera.GetViewMatrix();
+            ourShader.setMat4(UNIFORM_VIEW, view_mat);
 
-        // calculate the model matrix for each object and pass it to shader before drawing
-        model_transform(&ourShader);
+            // calculate the model matrix for each object and pass it to shader before drawing
+            model_transform(&ourShader);
+        }
 
         // render model
-        draw_model(model, ourShader.ID);
+        {
+            Profile_Scope scope(PROFILE_DRAW);
+            if(bake_fps > 0.0f)
+                draw_model_baked(model, ourShader.ID);
+            else
+            {
+                draw_model_merged(model, ourShader.ID);
+                end_node_matrix_frame(node_matrix_buffer);
+            }
+        }
+
+        if(frame_profiler->show_graph)
+            draw_profiler_graph(frame_profiler, graphShader.ID, SCR_WIDTH, SCR_HEIGHT);
+        end_profiler_frame(frame_profiler);
 
         SDL_GL_SwapBuffers();
-        sleep();
+        pace_frame(frame_pacer);
     }
 
     // optional: de-allocate all resources once they've outlived their purpose:
     // ------------------------------------------------------------------------
-    glDeleteProgram(ourShader.ID);
+    // redundant binds skipped by the render state tracker over the whole run
+    print_render_state_counters();
+    print_frame_profiler_stats(frame_profiler);
+    print_frame_pacer_stats(frame_pacer);
+    free_frame_pacer(frame_pacer);
+    if(trace_file != NULL)
+        write_profiler_trace(frame_profiler, trace_file);
+    free_frame_profiler(frame_profiler);
+    delete_shader_program(graphShader.ID);
+    if(bake_fps <= 0.0f)
+        print_node_matrix_buffer_stats(node_matrix_buffer);
+    free_node_matrix_buffer(node_matrix_buffer);
+    delete_shader_program(ourShader.ID);
 
     //free_model_animation(animation);
     free_model(model);
@@ -216,6 +476,12 @@ void processInput(void)
                             animation_index = animations_count-1;
                         change_animation = true;
                         break;
+                    case SDLK_g:
+                        frame_profiler->show_graph = !frame_profiler->show_graph;
+                        if(frame_profiler->show_graph)
+                            printf("profiler graph: animation green, transforms blue, upload yellow, draw red, "
+                                   "rest of the cpu time grey, frame time dark grey, GPU time white \n");
+                        break;
                 }
                 break;
             case SDL_MOUSEMOTION:
@@ -279,21 +545,6 @@ void processInput(void)
         camera.ProcessMouseMovement(10, 0);
 }
 
-void sleep(void)
-{
-    static int old_time = 0,  actual_time = 0;
-    actual_time = SDL_GetTicks();
-    if (actual_time - old_time < 16) // if less than 16 ms has passed
-    {
-        SDL_Delay(16 - (actual_time - old_time));
-        old_time = SDL_GetTicks();
-    }
-    else
-    {
-        old_time = actual_time;
-    }
-}
-
 void dw1_model_transform(Shader *shader)
 {
     glm::mat4 model_mat = glm::mat4(1.0f); // make sure to initialize matrix to identity matrix first
@@ -301,7 +552,7 @@ void dw1_model_transform(Shader *shader)
     model_mat = glm::scale(model_mat, glm::vec3(0.02f, 0.02f, 0.02f));
     model_mat = glm::rotate(model_mat, glm::radians(180.0f), glm::vec3(0.0f, 0.0f, 1.0f));
     model_mat = glm::rotate(model_mat, glm::radians(210.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-    glUniformMatrix4fv(glGetUniformLocation(shader->ID, "model"), 1, GL_FALSE, &model_mat[0][0]);
+    shader->setMat4(UNIFORM_MODEL, model_mat);
 }
 
 void dw2_model_transform(Shader *shader)
@@ -309,7 +560,7 @@ void dw2_model_transform(Shader *shader)
     glm::mat4 model_mat = glm::mat4(1.0f); // make sure to initialize matrix to identity matrix first
     model_mat = glm::translate(model_mat, glm::vec3(10.0f, -20.0f, -40.0f)); // translate it down so it's at the center of the scene
     model_mat = glm::scale(model_mat, glm::vec3(0.02f, 0.02f, 0.02f));
-    glUniformMatrix4fv(glGetUniformLocation(shader->ID, "model"), 1, GL_FALSE, &model_mat[0][0]);
+    shader->setMat4(UNIFORM_MODEL, model_mat);
 }
 
 void dw3_model_transform(Shader *shader)
@@ -318,5 +569,5 @@ void dw3_model_transform(Shader *shader)
     model_mat = glm::translate(model_mat, glm::vec3(10.0f, 3.0f, 20.0f)); // translate it down so it's at the center of the scene
     model_mat = glm::rotate(model_mat, glm::radians(180.0f), glm::vec3(0.0f, 0.0f, 1.0f));
     model_mat = glm::rotate(model_mat, glm::radians(210.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-    glUniformMatrix4fv(glGetUniformLocation(shader->ID, "model"), 1, GL_FALSE, &model_mat[0][0]);
+    shader->setMat4(UNIFORM_MODEL, model_mat);
 }
@@ -9,8 +9,8 @@
 //#include <iostream>
 
 // ******* IMPORTANT ******* //
-// for this to work comment the call "setup_mesh(data)"
-// in function "load_mesh" in "gltf_loader.h" file
+// for this to work comment the call "setup_model_buffer(model)"
+// in function "load_model" in "gltf_loader.h" file
 // also don't forget "glad_compat.c" file
 
 